@@ -34,6 +34,7 @@ cmake \
 	-DWITH_SIG_MONITOR_SIGNALS=${WITH_SIG_MONITOR_SIGNALS:=ON} \
 	-DWITH_SIG_MONITOR_FOR_CALL=${WITH_SIG_MONITOR_FOR_CALL:=ON} \
 	-DWITH_SIG_MONITOR_TIMERS=${WITH_SIG_MONITOR_TIMERS:=ON} \
+	-DWITH_SIG_MONITOR_WATCHDOG=${WITH_SIG_MONITOR_WATCHDOG:=OFF} \
 	-DWITH_AFB_TRACE=${WITH_AFB_TRACE:=ON} \
 	-DWITH_SUPERVISION=${WITH_SUPERVISION:=ON} \
 	-DWITH_DYNAMIC_BINDING=${WITH_DYNAMIC_BINDING:=ON} \
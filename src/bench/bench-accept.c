@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of storms of connections
+ *
+ * A storm of clients connects at once to a loopback TCP server socket
+ * opened by afb_socket_open_listeners. Measures the time per connection
+ * for accepting all of them, either accepting one connection for each
+ * readiness event of the server socket, or draining the pending
+ * connections by batches. The time of the connections is included.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "misc/afb-socket.h"
+
+#include "bench.h"
+
+/* maximum count of clients in a storm */
+#define MAX_STORM 256
+
+struct storm {
+	int server;
+	int batched;
+	long size;
+	struct sockaddr_in addr;
+	int clients[MAX_STORM];
+	int accepted[MAX_STORM];
+};
+
+static void run_storm(void *closure, long count)
+{
+	struct storm *s = closure;
+	struct pollfd pfd;
+	struct linger lin;
+	long done, i, n;
+	int fd;
+
+	lin.l_onoff = 1;
+	lin.l_linger = 0;
+	pfd.fd = s->server;
+	pfd.events = POLLIN;
+	for (done = 0 ; done < count ; done += s->size) {
+		/* the storm of clients */
+		for (i = 0 ; i < s->size ; i++) {
+			fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+			if (fd < 0) {
+				perror("socket");
+				exit(1);
+			}
+			/* reset on close avoids exhausting ports in TIME_WAIT */
+			setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof lin);
+			if (connect(fd, (struct sockaddr*)&s->addr, sizeof s->addr) < 0
+			 && errno != EINPROGRESS) {
+				perror("connect");
+				exit(1);
+			}
+			s->clients[i] = fd;
+		}
+
+		/* accept it */
+		for (n = 0 ; n < s->size ; ) {
+			poll(&pfd, 1, -1);
+			do {
+				fd = afb_socket_accept(s->server, 1);
+				if (fd < 0)
+					break;
+				s->accepted[n++] = fd;
+			}
+			while (s->batched && n < s->size);
+		}
+
+		/* end */
+		for (i = 0 ; i < s->size ; i++) {
+			close(s->clients[i]);
+			close(s->accepted[i]);
+		}
+	}
+}
+
+int main(int ac, char **av)
+{
+	static const long sizes[] = { 16, 64, MAX_STORM };
+	static struct storm s;
+	socklen_t len;
+	unsigned i;
+
+	bench_begin(ac, av, "accept");
+
+	if (afb_socket_open_listeners("tcp:127.0.0.1:0", &s.server, 1) != 1) {
+		fprintf(stderr, "can't open the server socket\n");
+		exit(1);
+	}
+	len = (socklen_t)sizeof s.addr;
+	getsockname(s.server, (struct sockaddr*)&s.addr, &len);
+
+	for (i = 0 ; i < sizeof sizes / sizeof *sizes ; i++) {
+		s.size = sizes[i];
+		s.batched = 0;
+		bench_run("accept-single", "clients", s.size, 20 * s.size, run_storm, &s);
+		s.batched = 1;
+		bench_run("accept-batched", "clients", s.size, 20 * s.size, run_storm, &s);
+	}
+
+	close(s.server);
+	return bench_end();
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of data and types
+ *
+ * Measures the life cycle of data (creation, conversion, release)
+ * and the cost of the conversion chains of types: direct conversions,
+ * conversions through families and indirect conversions.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "core/afb-data.h"
+#include "core/afb-type.h"
+#include "core/afb-type-predefined.h"
+
+#include "bench.h"
+
+/* maximum size of copied data */
+#define MAX_SIZE 65536
+
+static char buffer[MAX_SIZE];
+
+/* types for conversion chains */
+static struct afb_type *type_a, *type_b, *type_c, *type_child;
+
+/*********************************************************************/
+/* data life cycle */
+
+static void run_create_raw(void *closure, long count)
+{
+	struct afb_data *data;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		if (afb_data_create_raw(&data, type_a, buffer, 16, NULL, NULL) == 0)
+			afb_data_unref(data);
+	}
+}
+
+static void run_create_copy(void *closure, long count)
+{
+	struct afb_data *data;
+	size_t size;
+	long i;
+
+	size = (size_t)(intptr_t)closure;
+	for (i = 0 ; i < count ; i++) {
+		if (afb_data_create_copy(&data, type_a, buffer, size) == 0)
+			afb_data_unref(data);
+	}
+}
+
+static void run_addref_unref(void *closure, long count)
+{
+	struct afb_data *data = closure;
+	long i;
+
+	for (i = 0 ; i < count ; i++)
+		afb_data_unref(afb_data_addref(data));
+}
+
+static void run_convert_fresh(void *closure, long count)
+{
+	struct afb_data *data, *result;
+	int32_t value;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		value = (int32_t)i;
+		if (afb_data_create_copy(&data, &afb_type_predefined_i32, &value, sizeof value) == 0) {
+			if (afb_data_convert(data, &afb_type_predefined_i64, &result) == 0)
+				afb_data_unref(result);
+			afb_data_unref(data);
+		}
+	}
+}
+
+static void run_convert_cached(void *closure, long count)
+{
+	struct afb_data *data = closure, *result;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		if (afb_data_convert(data, &afb_type_predefined_i64, &result) == 0)
+			afb_data_unref(result);
+	}
+}
+
+/*********************************************************************/
+/* conversion chains */
+
+struct chain {
+	struct afb_type *from;
+	struct afb_type *to;
+	struct afb_data *data;
+};
+
+static int alias_converter(void *closure, struct afb_data *from, struct afb_type *type, struct afb_data **to)
+{
+	return afb_data_create_alias(to, type, from);
+}
+
+static void run_chain(void *closure, long count)
+{
+	struct chain *ch = closure;
+	struct afb_data *result;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		if (afb_type_convert_data(ch->from, ch->data, ch->to, &result) == 0)
+			afb_data_unref(result);
+	}
+}
+
+static void bench_chain(const char *name, struct afb_type *from, struct afb_type *to, const void *value, size_t size)
+{
+	struct chain ch;
+	struct afb_data *result;
+
+	ch.from = from;
+	ch.to = to;
+	if (afb_data_create_copy(&ch.data, from, value, size) < 0) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	if (afb_type_convert_data(from, ch.data, to, &result) < 0)
+		fprintf(stderr, "can't convert for %s\n", name);
+	else {
+		afb_data_unref(result);
+		bench_run(name, NULL, 0, 1000000, run_chain, &ch);
+	}
+	afb_data_unref(ch.data);
+}
+
+/*********************************************************************/
+
+int main(int ac, char **av)
+{
+	static const int sizes[] = { 16, 256, 4096, MAX_SIZE };
+	struct afb_data *data, *result;
+	int32_t value = 421;
+	unsigned i;
+
+	bench_begin(ac, av, "data");
+
+	/* a -> b -> c and child of a */
+	if (afb_type_register(&type_a, "bench-a", 0, 1, 0) < 0
+	 || afb_type_register(&type_b, "bench-b", 0, 1, 0) < 0
+	 || afb_type_register(&type_c, "bench-c", 0, 1, 0) < 0
+	 || afb_type_register(&type_child, "bench-child", 0, 1, 0) < 0
+	 || afb_type_add_converter(type_a, type_b, alias_converter, NULL) < 0
+	 || afb_type_add_converter(type_b, type_c, alias_converter, NULL) < 0
+	 || afb_type_set_family(type_child, type_a) < 0) {
+		fprintf(stderr, "can't register types\n");
+		return 1;
+	}
+
+	/* life cycle */
+	bench_run("data-create-raw", NULL, 0, 2000000, run_create_raw, NULL);
+	for (i = 0 ; i < sizeof sizes / sizeof *sizes ; i++)
+		bench_run("data-create-copy", "size", sizes[i], 1000000,
+				run_create_copy, (void*)(intptr_t)sizes[i]);
+	afb_data_create_copy(&data, &afb_type_predefined_i32, &value, sizeof value);
+	bench_run("data-addref-unref", NULL, 0, 5000000, run_addref_unref, data);
+	bench_run("data-convert-fresh", NULL, 0, 1000000, run_convert_fresh, NULL);
+	if (afb_data_convert(data, &afb_type_predefined_i64, &result) == 0) {
+		afb_data_unref(result);
+		bench_run("data-convert-cached", NULL, 0, 5000000, run_convert_cached, data);
+	}
+	afb_data_unref(data);
+
+	/* conversion chains */
+	bench_chain("type-convert-i32-json", &afb_type_predefined_i32,
+			&afb_type_predefined_json, &value, sizeof value);
+	bench_chain("type-convert-i32-stringz", &afb_type_predefined_i32,
+			&afb_type_predefined_stringz, &value, sizeof value);
+	bench_chain("type-convert-direct", type_a, type_b, buffer, 16);
+	bench_chain("type-convert-family", type_child, type_b, buffer, 16);
+	bench_chain("type-convert-indirect", type_a, type_c, buffer, 16);
+
+	return bench_end();
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the event loop
+ *
+ * Pairs of connected sockets exchange small messages: each message
+ * received is sent back to the peer. Measures the time per message
+ * received, that is for waiting the event, dispatching it, reading
+ * the message and sending it back. With many pairs, many events are
+ * ready at each wait.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "sys/ev-mgr.h"
+
+#include "bench.h"
+
+/* maximum count of pairs of sockets */
+#define MAX_PAIRS 256
+
+struct pingpong {
+	struct ev_mgr *mgr;
+	long pairs;
+	long left;
+	int fds[MAX_PAIRS][2];
+	struct ev_fd *efds[MAX_PAIRS][2];
+};
+
+static void pong(struct ev_fd *efd, int fd, uint32_t revents, void *closure)
+{
+	struct pingpong *pp = closure;
+	uint64_t msg;
+
+	if (read(fd, &msg, sizeof msg) == (ssize_t)sizeof msg && --pp->left > 0)
+		write(fd, &msg, sizeof msg);
+}
+
+static void run_pingpong(void *closure, long count)
+{
+	struct pingpong *pp = closure;
+	uint64_t msg = 0;
+	long i;
+
+	pp->left = count;
+	for (i = 0 ; i < pp->pairs ; i++)
+		write(pp->fds[i][0], &msg, sizeof msg);
+	while (pp->left > 0)
+		ev_mgr_run(pp->mgr, -1);
+
+	/* drain the messages in flight */
+	while (ev_mgr_run(pp->mgr, 0) > 0);
+}
+
+int main(int ac, char **av)
+{
+	static const long pairs[] = { 1, 16, MAX_PAIRS };
+	static struct pingpong pp;
+	unsigned i;
+	long j;
+
+	bench_begin(ac, av, "evmgr");
+
+	if (ev_mgr_create(&pp.mgr) < 0) {
+		fprintf(stderr, "can't create the event loop\n");
+		exit(1);
+	}
+	for (i = 0 ; i < sizeof pairs / sizeof *pairs ; i++) {
+		pp.pairs = pairs[i];
+		for (j = 0 ; j < pp.pairs ; j++) {
+			if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pp.fds[j]) < 0) {
+				perror("socketpair");
+				exit(1);
+			}
+			ev_mgr_add_fd(pp.mgr, &pp.efds[j][0], pp.fds[j][0], EV_FD_IN, pong, &pp, 0, 1);
+			ev_mgr_add_fd(pp.mgr, &pp.efds[j][1], pp.fds[j][1], EV_FD_IN, pong, &pp, 0, 1);
+		}
+		bench_run("evmgr-pingpong", "pairs", pp.pairs, 1000000, run_pingpong, &pp);
+		for (j = 0 ; j < pp.pairs ; j++) {
+			ev_fd_unref(pp.efds[j][0]);
+			ev_fd_unref(pp.efds[j][1]);
+		}
+		ev_mgr_run(pp.mgr, 0);
+	}
+
+	ev_mgr_unref(pp.mgr);
+	return bench_end();
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of events
+ *
+ * Measures the cost of pushing an event until it is delivered
+ * to all its subscribers, for growing counts of subscribers.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+
+#include "core/afb-evt.h"
+#include "core/afb-jobs.h"
+#include "core/afb-sched.h"
+#include "core/afb-sig-monitor.h"
+
+#include "bench.h"
+
+/* count of threads delivering events */
+#define THREADS 4
+
+/* maximum count of pending jobs */
+#define MAX_JOBS 60000
+
+struct fanout {
+	struct afb_evt *evt;
+	int subscribers;
+	long count;
+	long delivered;
+};
+
+/* listeners are distinguished by their closure */
+struct subscriber {
+	struct fanout *fanout;
+	struct afb_evt_listener *listener;
+};
+
+static void on_push(void *closure, const struct afb_evt_pushed *event)
+{
+	struct subscriber *sub = closure;
+	__atomic_add_fetch(&sub->fanout->delivered, 1, __ATOMIC_RELAXED);
+}
+
+static const struct afb_evt_itf listener_itf = {
+	.push = on_push
+};
+
+static void start_fanout(int signum, void *arg)
+{
+	struct fanout *fo = arg;
+	long i, n, batch, expected;
+
+	/* push by batches not overflowing the jobs queue */
+	batch = MAX_JOBS / fo->subscribers;
+	if (batch < 1)
+		batch = 1;
+	expected = 0;
+	for (i = 0 ; i < fo->count ; i += n) {
+		n = fo->count - i < batch ? fo->count - i : batch;
+		expected += n * fo->subscribers;
+		while (n--)
+			afb_evt_push(fo->evt, 0, NULL);
+		while (__atomic_load_n(&fo->delivered, __ATOMIC_RELAXED) < expected)
+			sched_yield();
+	}
+	bench_stop_timer();
+	afb_sched_exit(0, NULL, NULL, 0);
+}
+
+static void run_fanout(void *closure, long count)
+{
+	struct fanout *fo = closure;
+
+	fo->count = count;
+	fo->delivered = 0;
+	afb_sched_start(THREADS + 1, THREADS, MAX_JOBS + 1, start_fanout, fo);
+}
+
+int main(int ac, char **av)
+{
+	static const int subscribers[] = { 1, 10, 100, 1000 };
+	struct subscriber *subs;
+	struct fanout fo;
+	unsigned i;
+	int s;
+
+	bench_begin(ac, av, "evt");
+
+	afb_sig_monitor_init(1);
+	afb_jobs_set_max_count(MAX_JOBS + 1);
+
+	for (i = 0 ; i < sizeof subscribers / sizeof *subscribers ; i++) {
+		fo.subscribers = subscribers[i];
+		subs = calloc((size_t)fo.subscribers, sizeof *subs);
+		if (subs == NULL || afb_evt_create(&fo.evt, "bench/fanout") < 0) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		for (s = 0 ; s < fo.subscribers ; s++) {
+			subs[s].fanout = &fo;
+			subs[s].listener = afb_evt_listener_create(&listener_itf, &subs[s], NULL);
+			if (subs[s].listener == NULL
+			 || afb_evt_listener_add(subs[s].listener, fo.evt, 0) < 0) {
+				fprintf(stderr, "can't subscribe\n");
+				return 1;
+			}
+		}
+
+		bench_run("evt-push-fanout", "subscribers", fo.subscribers,
+				200000 / fo.subscribers, run_fanout, &fo);
+
+		for (s = 0 ; s < fo.subscribers ; s++)
+			afb_evt_listener_unref(subs[s].listener);
+		afb_evt_unref(fo.evt);
+		free(subs);
+	}
+
+	return bench_end();
+}
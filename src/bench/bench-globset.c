@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+/*
+ * Benchmark of globset_match
+ *
+ * Measures globset_match on a set of many glob patterns, as
+ * registered by APIs having many event handlers, and compares
+ * it to the one by one evaluation of globmatch.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utils/globset.h"
+#include "utils/globmatch.h"
+
+#include "bench.h"
+
+#define MAX_PATTERNS 1000
+#define TEXT_COUNT   8
+
+static char patterns[MAX_PATTERNS][40];
+
+static const char *texts[TEXT_COUNT] = {
+	"hvac/temperature-changed",
+	"sensors/front-left/pressure",
+	"api17/event17-updated",
+	"api3/event42",
+	"media/track",
+	"unknown/event",
+	"signal/vehicle.speed",
+	"can/frame/0x123"
+};
+
+struct context {
+	struct globset *set;
+	int npat;
+	long found;
+};
+
+static void run_globset(void *closure, long count)
+{
+	struct context *ctx = closure;
+	long i;
+
+	for (i = 0 ; i < count ; i++)
+		ctx->found += globset_match(ctx->set, texts[i % TEXT_COUNT]) != NULL;
+}
+
+static void run_linear(void *closure, long count)
+{
+	struct context *ctx = closure;
+	unsigned s, g;
+	long i;
+	int k;
+
+	for (i = 0 ; i < count ; i++) {
+		for (s = 0, k = 0 ; k < ctx->npat ; k++) {
+			g = globmatch(patterns[k], texts[i % TEXT_COUNT]);
+			if (g > s)
+				s = g;
+		}
+		ctx->found += s != 0;
+	}
+}
+
+int main(int ac, char **av)
+{
+	static const int counts[] = { 10, 50, 200, MAX_PATTERNS };
+	struct context ctx;
+	unsigned i;
+	int j;
+
+	bench_begin(ac, av, "globset");
+
+	for (j = 0 ; j < MAX_PATTERNS ; j++) {
+		switch (j % 4) {
+		case 0: snprintf(patterns[j], sizeof patterns[j], "api%d/event%d*", j, j); break;
+		case 1: snprintf(patterns[j], sizeof patterns[j], "*/signal%d", j); break;
+		case 2: snprintf(patterns[j], sizeof patterns[j], "sensors/*/item%d", j); break;
+		default: snprintf(patterns[j], sizeof patterns[j], "*%d*", j); break;
+		}
+	}
+
+	for (i = 0 ; i < sizeof counts / sizeof *counts ; i++) {
+		ctx.npat = counts[i];
+		ctx.found = 0;
+		ctx.set = globset_create();
+		for (j = 0 ; j < ctx.npat ; j++)
+			globset_add(ctx.set, patterns[j], NULL, NULL);
+		bench_run("globset-match", "patterns", ctx.npat, 200000, run_globset, &ctx);
+		bench_run("globmatch-linear", "patterns", ctx.npat, 2000000 / ctx.npat, run_linear, &ctx);
+		globset_destroy(ctx.set);
+	}
+
+	return bench_end();
+}
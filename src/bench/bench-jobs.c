@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of jobs
+ *
+ * Measures the cost of posting and dequeuing jobs without threads
+ * and the throughput of the scheduler for growing counts of threads.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sys/x-thread.h"
+
+#include "core/afb-jobs.h"
+#include "core/afb-sched.h"
+#include "core/afb-threads.h"
+#include "core/afb-sig-monitor.h"
+
+#include "bench.h"
+
+/* count of jobs in flight per thread */
+#define INFLIGHT_PER_THREAD 4
+
+/*********************************************************************/
+/* jobs queue without threads */
+
+static void nop_job(int signum, void *arg)
+{
+}
+
+static void run_post_dequeue(void *closure, long count)
+{
+	struct afb_job *job;
+	long i, delayms;
+
+	for (i = 0 ; i < count ; i++) {
+		afb_jobs_post(NULL, 0, 0, nop_job, NULL);
+		job = afb_jobs_dequeue(&delayms);
+		if (job != NULL)
+			afb_jobs_run(job);
+	}
+}
+
+static void run_post_burst(void *closure, long count)
+{
+	struct afb_job *job;
+	long i, n, depth, delayms;
+
+	depth = (long)(intptr_t)closure;
+	for (i = 0 ; i < count ; i += depth) {
+		for (n = 0 ; n < depth ; n++)
+			afb_jobs_post(NULL, 0, 0, nop_job, NULL);
+		while ((job = afb_jobs_dequeue(&delayms)) != NULL)
+			afb_jobs_run(job);
+	}
+}
+
+static void run_post_group(void *closure, long count)
+{
+	struct afb_job *job;
+	long i, delayms;
+	int n, groups;
+
+	groups = (int)(intptr_t)closure;
+	for (i = 0 ; i < count ; i += groups) {
+		for (n = 0 ; n < groups ; n++)
+			afb_jobs_post((void*)(intptr_t)(n + 1), 0, 0, nop_job, NULL);
+		while ((job = afb_jobs_dequeue(&delayms)) != NULL)
+			afb_jobs_run(job);
+	}
+}
+
+/*********************************************************************/
+/* scheduler throughput */
+
+struct throughput {
+	long count;
+	long left;
+	long done;
+};
+
+static void chain_job(int signum, void *arg)
+{
+	struct throughput *tp = arg;
+
+	if (__atomic_add_fetch(&tp->done, 1, __ATOMIC_RELAXED) == tp->count) {
+		bench_stop_timer();
+		afb_sched_exit(0, NULL, NULL, 0);
+	}
+	else if (__atomic_sub_fetch(&tp->left, 1, __ATOMIC_RELAXED) >= 0)
+		afb_sched_post_job(NULL, 0, 0, chain_job, tp, Afb_Sched_Mode_Normal);
+}
+
+static void start_throughput(int signum, void *arg)
+{
+	struct throughput *tp = arg;
+	long n;
+
+	bench_start_timer();
+	for (n = tp->count - tp->left ; n > 0 ; n--)
+		afb_sched_post_job(NULL, 0, 0, chain_job, tp, Afb_Sched_Mode_Normal);
+}
+
+static void run_throughput(void *closure, long count)
+{
+	struct throughput tp;
+	int threads, inflight;
+
+	threads = (int)(intptr_t)closure;
+	inflight = threads * INFLIGHT_PER_THREAD;
+	if (count < inflight)
+		count = inflight;
+	tp.count = count;
+	tp.left = count - inflight;
+	tp.done = 0;
+	afb_sched_start(threads, threads, 2 * inflight, start_throughput, &tp);
+}
+
+static void run_throughput_pinned(void *closure, long count)
+{
+	char workers[32];
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* event loop alone on the first CPU, workers on the others */
+	if (ncpus > 1)
+		snprintf(workers, sizeof workers, "1-%ld", ncpus - 1);
+	else
+		snprintf(workers, sizeof workers, "0");
+	afb_threads_set_cpus(workers, "0");
+	run_throughput(closure, count);
+	afb_threads_set_cpus(NULL, NULL);
+}
+
+/*********************************************************************/
+
+int main(int ac, char **av)
+{
+	static const int depths[] = { 1, 16, 256, 4096 };
+	static const int threads[] = { 1, 2, 4, 8, 16 };
+	unsigned i;
+
+	bench_begin(ac, av, "jobs");
+
+	afb_sig_monitor_init(1);
+	afb_jobs_set_max_count(AFB_JOBS_MAX_COUNT_MAX);
+
+	bench_run("jobs-post-dequeue", NULL, 0, 1000000, run_post_dequeue, NULL);
+	for (i = 0 ; i < sizeof depths / sizeof *depths ; i++)
+		bench_run("jobs-post-burst", "depth", depths[i], 1000000,
+				run_post_burst, (void*)(intptr_t)depths[i]);
+	for (i = 0 ; i < sizeof depths / sizeof *depths ; i++)
+		bench_run("jobs-post-group", "groups", depths[i], 1000000,
+				run_post_group, (void*)(intptr_t)depths[i]);
+	for (i = 0 ; i < sizeof threads / sizeof *threads ; i++)
+		bench_run("sched-throughput", "threads", threads[i], 200000,
+				run_throughput, (void*)(intptr_t)threads[i]);
+	for (i = 0 ; i < sizeof threads / sizeof *threads ; i++)
+		bench_run("sched-throughput-pinned", "threads", threads[i], 200000,
+				run_throughput_pinned, (void*)(intptr_t)threads[i]);
+
+	return bench_end();
+}
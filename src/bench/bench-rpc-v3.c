@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the RPC protocol version 3
+ *
+ * Measures the encoding and the decoding of call requests
+ * for growing sizes of the parameter.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rpc/afb-rpc-coder.h"
+#include "rpc/afb-rpc-decoder.h"
+#include "rpc/afb-rpc-v3.h"
+
+#include "bench.h"
+
+/* maximum size of the parameter */
+#define MAX_SIZE 60000
+
+/* size of the buffers */
+#define BUFFER_SIZE (MAX_SIZE + 1024)
+
+struct message {
+	afb_rpc_v3_value_t value;
+	afb_rpc_v3_value_array_t array;
+	afb_rpc_v3_msg_t msg;
+	uint32_t length;
+	char buffer[BUFFER_SIZE];
+};
+
+static char payload[MAX_SIZE];
+
+static void make_message(struct message *m, uint16_t size)
+{
+	memset(&m->msg, 0, sizeof m->msg);
+	m->msg.oper = AFB_RPC_V3_ID_OP_CALL_REQUEST;
+	m->msg.head.call_request.callid = 1;
+	m->msg.head.call_request.api.length = 6;
+	m->msg.head.call_request.api.data = "bench";
+	m->msg.head.call_request.verb.length = 5;
+	m->msg.head.call_request.verb.data = "call";
+	m->msg.head.call_request.timeout = 0;
+	m->value.id = AFB_RPC_V3_ID_TYPE_BYTEARRAY;
+	m->value.length = size;
+	m->value.data = payload;
+	m->array.count = 1;
+	m->array.values = &m->value;
+	m->msg.values.array = &m->array;
+}
+
+static void run_encode(void *closure, long count)
+{
+	struct message *m = closure;
+	afb_rpc_coder_t coder;
+	long i;
+
+	afb_rpc_coder_init(&coder);
+	for (i = 0 ; i < count ; i++) {
+		afb_rpc_v3_code(&coder, &m->msg);
+		m->length = afb_rpc_coder_output_get_buffer(&coder, m->buffer, BUFFER_SIZE);
+		afb_rpc_coder_output_dispose(&coder);
+	}
+}
+
+static void run_decode(void *closure, long count)
+{
+	struct message *m = closure;
+	afb_rpc_decoder_t decoder;
+	afb_rpc_v3_pckt_t pckt;
+	afb_rpc_v3_value_t value;
+	afb_rpc_v3_value_array_t array;
+	afb_rpc_v3_msg_t msg;
+	long i;
+
+	msg.values.array = &array;
+	msg.values.allocator = NULL;
+	for (i = 0 ; i < count ; i++) {
+		afb_rpc_decoder_init(&decoder, m->buffer, m->length);
+		array.count = 1;
+		array.values = &value;
+		if (afb_rpc_v3_decode_packet(&decoder, &pckt) == 0)
+			afb_rpc_v3_decode_operation(&pckt, &msg);
+	}
+}
+
+int main(int ac, char **av)
+{
+	static const int sizes[] = { 0, 16, 256, 4096, MAX_SIZE };
+	static struct message m;
+	unsigned i;
+
+	bench_begin(ac, av, "rpc-v3");
+
+	memset(payload, 'x', sizeof payload);
+	for (i = 0 ; i < sizeof sizes / sizeof *sizes ; i++) {
+		make_message(&m, (uint16_t)sizes[i]);
+		bench_run("rpc-v3-encode-call", "size", sizes[i], 1000000, run_encode, &m);
+		bench_run("rpc-v3-decode-call", "size", sizes[i], 1000000, run_decode, &m);
+	}
+
+	return bench_end();
+}
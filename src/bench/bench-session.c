@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of sessions
+ *
+ * Measures the lookup of sessions by their UUID for growing
+ * counts of living sessions.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "core/afb-session.h"
+
+#include "bench.h"
+
+/* maximum count of sessions */
+#define MAX_SESSIONS 1000
+
+/* timeout of sessions in seconds */
+#define TIMEOUT 3600
+
+struct lookup {
+	int count;
+	struct afb_session *sessions[MAX_SESSIONS];
+	char uuids[MAX_SESSIONS][40];
+	long found;
+};
+
+static void run_lookup(void *closure, long count)
+{
+	struct lookup *lk = closure;
+	struct afb_session *session;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		session = afb_session_search(lk->uuids[(i * 7919) % lk->count]);
+		if (session != NULL) {
+			lk->found++;
+			afb_session_unref(session);
+		}
+	}
+}
+
+static void run_lookup_miss(void *closure, long count)
+{
+	struct afb_session *session;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		session = afb_session_search("00000000-0000-0000-0000-000000000000");
+		if (session != NULL)
+			afb_session_unref(session);
+	}
+}
+
+static void run_create(void *closure, long count)
+{
+	struct afb_session *session;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		if (afb_session_create(&session, TIMEOUT) == 0) {
+			afb_session_close(session);
+			afb_session_unref(session);
+		}
+	}
+}
+
+int main(int ac, char **av)
+{
+	static const int counts[] = { 10, 100, MAX_SESSIONS / 2, MAX_SESSIONS - 1 };
+	static struct lookup lk;
+	unsigned i;
+	int s;
+
+	bench_begin(ac, av, "session");
+
+	afb_session_init(MAX_SESSIONS, TIMEOUT);
+
+	for (i = 0 ; i < sizeof counts / sizeof *counts ; i++) {
+		for (lk.count = 0 ; lk.count < counts[i] ; lk.count++) {
+			s = lk.count;
+			if (afb_session_create(&lk.sessions[s], TIMEOUT) < 0) {
+				fprintf(stderr, "can't create session\n");
+				return 1;
+			}
+			strncpy(lk.uuids[s], afb_session_uuid(lk.sessions[s]), sizeof lk.uuids[s] - 1);
+		}
+
+		bench_run("session-search", "sessions", lk.count, 1000000, run_lookup, &lk);
+		bench_run("session-search-miss", "sessions", lk.count, 1000000, run_lookup_miss, NULL);
+		bench_run("session-create", "sessions", lk.count, 100000, run_create, NULL);
+
+		for (s = 0 ; s < lk.count ; s++) {
+			afb_session_close(lk.sessions[s]);
+			afb_session_unref(lk.sessions[s]);
+		}
+	}
+
+	return bench_end();
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of websockets
+ *
+ * Measures the framing of binary messages, masked or not, and
+ * the parsing of received frames including unmasking, for growing
+ * sizes of the payload. The transport is a memory buffer.
+ *
+ * Measures also the reception of batches of small frames written at
+ * once in a socket, with or without input buffer. The time of the write
+ * is included.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "sys/x-uio.h"
+#include "utils/websock.h"
+
+#include "bench.h"
+
+/* maximum size of the payload */
+#define MAX_SIZE 65536
+
+/* size of the buffers */
+#define BUFFER_SIZE (MAX_SIZE + 64)
+
+/* count of frames in a batch sent through the socket */
+#define BATCH 32
+
+/* maximum size of the payload of frames of batches */
+#define BATCH_MAX_SIZE 1024
+
+struct transport {
+	struct websock *ws;
+	size_t wrpos;
+	size_t rdpos;
+	size_t length;
+	int fds[2];
+	long nframes;
+	char buffer[BUFFER_SIZE];
+	char received[MAX_SIZE];
+};
+
+static char payload[MAX_SIZE];
+
+static ssize_t t_writev(void *closure, const struct iovec *iov, int iovcnt)
+{
+	struct transport *t = closure;
+	size_t sz, total = 0;
+	int i;
+
+	for (i = 0 ; i < iovcnt ; i++) {
+		sz = iov[i].iov_len;
+		if (sz > BUFFER_SIZE - t->wrpos)
+			sz = BUFFER_SIZE - t->wrpos;
+		memcpy(&t->buffer[t->wrpos], iov[i].iov_base, sz);
+		t->wrpos += sz;
+		total += sz;
+	}
+	return (ssize_t)total;
+}
+
+static ssize_t t_readv(void *closure, const struct iovec *iov, int iovcnt)
+{
+	struct transport *t = closure;
+	size_t sz, total = 0;
+	int i;
+
+	for (i = 0 ; i < iovcnt ; i++) {
+		sz = iov[i].iov_len;
+		if (sz > t->length - t->rdpos)
+			sz = t->length - t->rdpos;
+		memcpy(iov[i].iov_base, &t->buffer[t->rdpos], sz);
+		t->rdpos += sz;
+		total += sz;
+	}
+	return (ssize_t)total;
+}
+
+static void t_on_close(void *closure, uint16_t code, size_t size)
+{
+}
+
+static void t_on_binary(void *closure, int last, size_t size)
+{
+	struct transport *t = closure;
+	websock_read(t->ws, t->received, size);
+}
+
+static const struct websock_itf itf = {
+	.writev = t_writev,
+	.readv = t_readv,
+	.on_close = t_on_close,
+	.on_binary = t_on_binary
+};
+
+static ssize_t s_readv(void *closure, const struct iovec *iov, int iovcnt)
+{
+	struct transport *t = closure;
+	ssize_t rc = readv(t->fds[0], iov, iovcnt);
+	return rc < 0 ? -errno : rc;
+}
+
+static void s_on_binary(void *closure, int last, size_t size)
+{
+	struct transport *t = closure;
+	size_t pos = 0;
+	ssize_t rc;
+
+	while (pos < size) {
+		rc = websock_read(t->ws, &t->received[pos], size - pos);
+		if (rc <= 0)
+			break;
+		pos += (size_t)rc;
+	}
+	t->nframes++;
+}
+
+static const struct websock_itf sitf = {
+	.writev = t_writev,
+	.readv = s_readv,
+	.on_close = t_on_close,
+	.on_binary = s_on_binary
+};
+
+static void run_send(void *closure, long count)
+{
+	struct transport *t = closure;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		t->wrpos = 0;
+		websock_binary(t->ws, 1, payload, t->length);
+	}
+}
+
+static void run_receive(void *closure, long count)
+{
+	struct transport *t = closure;
+	long i;
+
+	for (i = 0 ; i < count ; i++) {
+		t->rdpos = 0;
+		websock_dispatch(t->ws, 0);
+	}
+}
+
+static void bench_size(struct transport *t, size_t size, int masked)
+{
+	long count;
+
+	t->ws = websock_create_v13(&itf, t);
+	if (t->ws == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	websock_set_max_length(t->ws, MAX_SIZE);
+	websock_set_masking(t->ws, masked);
+	count = (long)(100000000 / (size + 256));
+
+	/* framing */
+	t->length = size;
+	bench_run(masked ? "websock-send-masked" : "websock-send",
+			"size", (long)size, count, run_send, t);
+
+	/* parsing of the frame produced */
+	t->wrpos = 0;
+	websock_binary(t->ws, 1, payload, size);
+	t->length = t->wrpos;
+	bench_run(masked ? "websock-receive-masked" : "websock-receive",
+			"size", (long)size, count, run_receive, t);
+
+	websock_destroy(t->ws);
+}
+
+static void run_socket(void *closure, long count)
+{
+	struct transport *t = closure;
+	long i;
+
+	for (i = 0 ; i < count ; i += BATCH) {
+		if (write(t->fds[1], t->buffer, t->length) != (ssize_t)t->length) {
+			perror("write");
+			exit(1);
+		}
+		t->nframes = 0;
+		while (t->nframes < BATCH)
+			websock_dispatch(t->ws, 1);
+	}
+}
+
+static void bench_socket(struct transport *t, size_t size, int buffered)
+{
+	struct websock *ws;
+	int i;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, t->fds) < 0) {
+		perror("socketpair");
+		exit(1);
+	}
+	fcntl(t->fds[0], F_SETFL, O_NONBLOCK);
+
+	/* prepare the batch of frames */
+	ws = websock_create_v13(&itf, t);
+	t->ws = websock_create_v13(&sitf, t);
+	if (ws == NULL || t->ws == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	t->wrpos = 0;
+	for (i = 0 ; i < BATCH ; i++)
+		websock_binary(ws, 1, payload, size);
+	t->length = t->wrpos;
+	websock_destroy(ws);
+
+	websock_set_input_buffer(t->ws, buffered ? 16384 : 0);
+	bench_run(buffered ? "websock-socket-buffered" : "websock-socket",
+			"size", (long)size, 100000, run_socket, t);
+
+	websock_destroy(t->ws);
+	close(t->fds[0]);
+	close(t->fds[1]);
+}
+
+int main(int ac, char **av)
+{
+	static const size_t sizes[] = { 16, 125, 1024, 16384, MAX_SIZE };
+	static struct transport t;
+	unsigned i;
+
+	bench_begin(ac, av, "websock");
+
+	memset(payload, 'x', sizeof payload);
+	for (i = 0 ; i < sizeof sizes / sizeof *sizes ; i++) {
+		bench_size(&t, sizes[i], 0);
+		bench_size(&t, sizes[i], 1);
+	}
+	for (i = 0 ; sizes[i] <= BATCH_MAX_SIZE ; i++) {
+		bench_socket(&t, sizes[i], 0);
+		bench_socket(&t, sizes[i], 1);
+	}
+
+	return bench_end();
+}
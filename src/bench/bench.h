@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Minimal harness for micro-benchmarks
+ * ------------------------------------
+ *
+ * Each benchmark program calls bench_begin, then bench_run for each
+ * measured case and finally bench_end.
+ *
+ * A measured case is a function receiving a count of operations to
+ * perform. It is called once or more for warming up and then for each
+ * repetition. The result is reported in nanoseconds per operation
+ * (minimum, median and maximum over the repetitions).
+ *
+ * By default, the time measured is the time of the call to the function.
+ * The function can reduce it to its core part by calling bench_start_timer
+ * and/or bench_stop_timer.
+ *
+ * The results are emitted as JSON on the standard output (or in the file
+ * given with option -o) using the format:
+ *
+ *   {
+ *     "suite": "jobs",
+ *     "repeat": 5,
+ *     "results": [
+ *       {
+ *         "name": "sched-post",
+ *         "param": "threads",
+ *         "value": 4,
+ *         "count": 50000,
+ *         "ns_per_op": { "min": 310.2, "median": 325.7, "max": 402.9 },
+ *         "ops_per_sec": 3070310.1
+ *       },
+ *       ...
+ *     ]
+ *   }
+ *
+ * Common options are:
+ *
+ *   -r REPEAT   count of measured repetitions (default 5)
+ *   -w WARMUP   count of warming up runs (default 1)
+ *   -s SCALE    scaling factor of counts of operations (default 1.0)
+ *   -f FILTER   only run the cases whose name contains FILTER
+ *   -o FILE     write the JSON result to FILE
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** maximum count of repetitions */
+#define BENCH_REPEAT_MAX 101
+
+/** type of the measured functions */
+typedef void bench_fun_t(void *closure, long count);
+
+/** name of the suite */
+static const char *bench_suite;
+
+/** output of the results */
+static FILE *bench_out;
+
+/** count of repetitions */
+static int bench_repeat = 5;
+
+/** count of warming up runs */
+static int bench_warmup = 1;
+
+/** scale of the counts */
+static double bench_scale = 1.0;
+
+/** filter of names */
+static const char *bench_filter;
+
+/** count of emitted results */
+static int bench_count;
+
+/** timer values */
+static uint64_t bench_t0, bench_t1;
+
+/** returns the monotonic time in nanoseconds */
+static inline uint64_t bench_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/** start (or restart) the timer of the current measure */
+static inline void bench_start_timer()
+{
+	bench_t0 = bench_now();
+}
+
+/** stop the timer of the current measure */
+static inline void bench_stop_timer()
+{
+	bench_t1 = bench_now();
+}
+
+/** print the usage and exit */
+static void bench_usage(const char *prog, int code)
+{
+	fprintf(code ? stderr : stdout,
+		"usage: %s [-r REPEAT] [-w WARMUP] [-s SCALE] [-f FILTER] [-o FILE]\n",
+		prog);
+	exit(code);
+}
+
+/** compare for sorting doubles */
+static int bench_cmp(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Begin the suite of benchmarks
+ *
+ * @param ac count of arguments of the program
+ * @param av arguments of the program
+ * @param suite name of the suite
+ */
+static void bench_begin(int ac, char **av, const char *suite)
+{
+	int opt;
+
+	bench_out = stdout;
+	while ((opt = getopt(ac, av, "r:w:s:f:o:h")) != -1) {
+		switch (opt) {
+		case 'r':
+			bench_repeat = atoi(optarg);
+			if (bench_repeat < 1 || bench_repeat > BENCH_REPEAT_MAX)
+				bench_usage(av[0], 1);
+			break;
+		case 'w':
+			bench_warmup = atoi(optarg);
+			if (bench_warmup < 0)
+				bench_usage(av[0], 1);
+			break;
+		case 's':
+			bench_scale = atof(optarg);
+			if (!(bench_scale > 0))
+				bench_usage(av[0], 1);
+			break;
+		case 'f':
+			bench_filter = optarg;
+			break;
+		case 'o':
+			bench_out = fopen(optarg, "w");
+			if (bench_out == NULL) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 'h':
+			bench_usage(av[0], 0);
+			break;
+		default:
+			bench_usage(av[0], 1);
+			break;
+		}
+	}
+	bench_suite = suite;
+	fprintf(bench_out, "{\n  \"suite\": \"%s\",\n  \"repeat\": %d,\n  \"results\": [",
+		suite, bench_repeat);
+}
+
+/**
+ * Scale the given count of operations
+ *
+ * @param count the nominal count
+ *
+ * @return the scaled count, at least 1
+ */
+static inline long bench_scaled(long count)
+{
+	long result = (long)((double)count * bench_scale);
+	return result > 0 ? result : 1;
+}
+
+/**
+ * Measure a case and emit its result
+ *
+ * @param name    name of the case
+ * @param param   name of the varying parameter or NULL
+ * @param value   value of the varying parameter
+ * @param count   nominal count of operations (scaled)
+ * @param fun     the measured function
+ * @param closure closure of the measured function
+ */
+static void bench_run(
+		const char *name,
+		const char *param,
+		long value,
+		long count,
+		bench_fun_t *fun,
+		void *closure
+) {
+	double ns[BENCH_REPEAT_MAX], median;
+	int i;
+
+	if (bench_filter != NULL && strstr(name, bench_filter) == NULL)
+		return;
+
+	count = bench_scaled(count);
+	for (i = 0 ; i < bench_warmup ; i++)
+		fun(closure, count);
+	for (i = 0 ; i < bench_repeat ; i++) {
+		bench_t1 = 0;
+		bench_start_timer();
+		fun(closure, count);
+		if (bench_t1 == 0)
+			bench_stop_timer();
+		ns[i] = (double)(bench_t1 - bench_t0) / (double)count;
+	}
+	qsort(ns, (size_t)bench_repeat, sizeof *ns, bench_cmp);
+	median = bench_repeat & 1 ? ns[bench_repeat / 2]
+		: (ns[bench_repeat / 2 - 1] + ns[bench_repeat / 2]) / 2;
+
+	fprintf(bench_out, "%s\n    {\n      \"name\": \"%s\",\n", bench_count++ ? "," : "", name);
+	if (param != NULL)
+		fprintf(bench_out, "      \"param\": \"%s\",\n      \"value\": %ld,\n", param, value);
+	fprintf(bench_out, "      \"count\": %ld,\n", count);
+	fprintf(bench_out, "      \"ns_per_op\": { \"min\": %.1f, \"median\": %.1f, \"max\": %.1f },\n",
+		ns[0], median, ns[bench_repeat - 1]);
+	fprintf(bench_out, "      \"ops_per_sec\": %.1f\n    }", median > 0 ? 1e9 / median : 0.0);
+	fflush(bench_out);
+}
+
+/**
+ * End the suite of benchmarks
+ *
+ * @return the exit code of the program
+ */
+static int bench_end()
+{
+	fprintf(bench_out, "\n  ]\n}\n");
+	return fclose(bench_out) == 0 ? 0 : 1;
+}
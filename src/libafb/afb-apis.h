@@ -27,5 +27,6 @@
 #include "apis/afb-api-so.h"
 #include "apis/afb-api-so-v3.h"
 #include "apis/afb-api-so-v4.h"
+#include "apis/afb-api-lazy.h"
 #include "apis/afb-api-ws.h"
 #include "apis/afb-api-rpc.h"
@@ -38,6 +38,7 @@
 #include "core/afb-error-text.h"
 #include "core/afb-ev-mgr.h"
 #include "core/afb-evt.h"
+#include "core/afb-fibers.h"
 #include "core/afb-global.h"
 #include "core/afb-hook-flags.h"
 #include "core/afb-hook.h"
@@ -45,8 +46,12 @@
 #include "core/afb-jobs.h"
 #include "core/afb-json-legacy.h"
 #include "core/afb-perm.h"
+#include "core/afb-perm-cache.h"
 #include "core/afb-permission-text.h"
+#include "core/afb-req-cache.h"
 #include "core/afb-req-common.h"
+#include "core/afb-req-prio.h"
+#include "core/afb-req-stats.h"
 #include "core/afb-req-v3.h"
 #include "core/afb-req-v4.h"
 #include "core/afb-sched.h"
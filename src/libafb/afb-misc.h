@@ -27,11 +27,13 @@
 #include "misc/afb-autoset.h"
 #include "misc/afb-debug.h"
 #include "misc/afb-monitor.h"
+#include "misc/afb-so-probe.h"
 #include "misc/afb-socket.h"
 #include "misc/afb-supervision.h"
 #include "misc/afb-supervisor.h"
 #include "misc/afb-systemd.h"
 #include "misc/afb-trace.h"
+#include "misc/afb-trace-ring.h"
 #include "misc/afb-vcomm.h"
 #include "misc/afb-verbose.h"
 #include "misc/afb-watchdog.h"
@@ -41,3 +41,4 @@
 #include "sys/x-socket.h"
 #include "sys/x-thread.h"
 #include "sys/x-uio.h"
+#include "sys/x-uring.h"
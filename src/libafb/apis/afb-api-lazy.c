@@ -0,0 +1,515 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "../libafb-config.h"
+
+#if WITH_DYNAMIC_BINDING
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <rp-utils/rp-verbose.h>
+
+#include "core/afb-apiname.h"
+#include "core/afb-apiset.h"
+#include "core/afb-req-common.h"
+#include "core/afb-sched.h"
+#include "apis/afb-api-so.h"
+#include "apis/afb-api-lazy.h"
+#include "sys/x-errno.h"
+#include "sys/x-mutex.h"
+
+/* states of lazy bindings */
+#define LAZY_IDLE	0
+#define LAZY_LOADING	1
+#define LAZY_LOADED	2
+#define LAZY_FAILED	3
+
+/* request waiting the end of the loading */
+struct pending
+{
+	struct pending *next;
+	struct afb_req_common *req;
+};
+
+/* a lazily loaded binding */
+struct lazy_binding
+{
+	/* link of the list of bindings */
+	struct lazy_binding *next;
+
+	/* count of declared APIs */
+	int refcount;
+
+	/* state of the binding */
+	int state;
+
+	/* set if services were exited */
+	int exited;
+
+	/* private apiset receiving the loaded APIs */
+	struct afb_apiset *realset;
+
+	/* apiset used for calls */
+	struct afb_apiset *call_set;
+
+	/* requests waiting the loading */
+	struct pending *pendings;
+
+	/* path of the binding */
+	char path[];
+};
+
+/* a declared API */
+struct lazy_api
+{
+	/* the binding */
+	struct lazy_binding *binding;
+
+	/* the logmask set before loading */
+	int logmask;
+
+	/* if not zero, loading starts with the service */
+	int background;
+
+	/* NULL or the comma separated list of the verbs */
+	char *verbs;
+
+	/* name of the API */
+	char name[];
+};
+
+/* list of the lazy bindings */
+static struct lazy_binding *bindings;
+
+/* mutex protecting bindings and their state */
+static x_mutex_t mutex = X_MUTEX_INITIALIZER;
+
+/******************************************************************************/
+
+/* release the binding if not used, called with mutex locked */
+static void put_binding_locked(struct lazy_binding *binding)
+{
+	struct lazy_binding **prv;
+
+	if (binding->refcount == 0) {
+		for (prv = &bindings ; *prv != binding ; prv = &(*prv)->next);
+		*prv = binding->next;
+		afb_apiset_unref(binding->realset);
+		afb_apiset_unref(binding->call_set);
+		free(binding);
+	}
+}
+
+/* process the request by the loaded binding */
+static void forward(struct lazy_binding *binding, struct afb_req_common *req, int status)
+{
+	if (status >= 0)
+		afb_req_common_process(afb_req_common_addref(req), binding->realset);
+	else
+		afb_req_common_reply_unavailable_error_hookable(req);
+}
+
+/* job loading the binding and flushing the pending requests */
+static void load_job(int signum, void *closure)
+{
+	struct lazy_binding *binding = closure;
+	struct pending *pendings, *pend;
+	int rc;
+
+	if (signum != 0) {
+		RP_ERROR("lazy loading of %s interrupted by signal %d", binding->path, signum);
+		rc = X_EINTR;
+	}
+	else {
+		RP_INFO("lazy loading of binding %s", binding->path);
+		rc = afb_api_so_add_binding(binding->path, binding->realset, binding->call_set);
+		if (rc >= 0)
+			rc = afb_apiset_start_all_services(binding->realset);
+		if (rc < 0)
+			RP_ERROR("lazy loading of binding %s failed", binding->path);
+	}
+
+	x_mutex_lock(&mutex);
+	__atomic_store_n(&binding->state, rc >= 0 ? LAZY_LOADED : LAZY_FAILED, __ATOMIC_RELEASE);
+	pendings = NULL;
+	while ((pend = binding->pendings) != NULL) {
+		/* reverse the order to process in arrival order */
+		binding->pendings = pend->next;
+		pend->next = pendings;
+		pendings = pend;
+	}
+	x_mutex_unlock(&mutex);
+
+	while ((pend = pendings) != NULL) {
+		pendings = pend->next;
+		forward(binding, pend->req, rc);
+		afb_req_common_unref(pend->req);
+		free(pend);
+	}
+}
+
+/* check if the binding is loaded, can be called without lock */
+static int is_loaded(struct lazy_binding *binding)
+{
+	return __atomic_load_n(&binding->state, __ATOMIC_ACQUIRE) == LAZY_LOADED;
+}
+
+/* start the loading, called with mutex locked */
+static void load_locked(struct lazy_binding *binding)
+{
+	int rc;
+
+	binding->state = LAZY_LOADING;
+	rc = afb_sched_post_job(binding, 0, 0, load_job, binding, Afb_Sched_Mode_Start);
+	if (rc < 0) {
+		RP_ERROR("can't schedule lazy loading of %s", binding->path);
+		binding->state = LAZY_FAILED;
+	}
+}
+
+/* check if verb is in the list of verbs */
+static int has_verb(const char *verbs, const char *verb)
+{
+	size_t len = strlen(verb);
+
+	while (*verbs) {
+		if (!strncasecmp(verbs, verb, len) && (verbs[len] == ',' || verbs[len] == 0))
+			return 1;
+		verbs = strchrnul(verbs, ',');
+		if (*verbs)
+			verbs++;
+	}
+	return 0;
+}
+
+/******************************************************************************/
+
+static void api_process(void *closure, struct afb_req_common *req)
+{
+	struct lazy_api *api = closure;
+	struct lazy_binding *binding = api->binding;
+	struct pending *pend;
+	int state;
+
+	if (api->verbs != NULL && !has_verb(api->verbs, req->verbname)) {
+		afb_req_common_reply_verb_unknown_error_hookable(req);
+		return;
+	}
+
+	x_mutex_lock(&mutex);
+	state = binding->state;
+	if (state == LAZY_IDLE || state == LAZY_LOADING) {
+		pend = malloc(sizeof *pend);
+		if (pend == NULL)
+			state = LAZY_FAILED;
+		else {
+			pend->req = afb_req_common_addref(req);
+			pend->next = binding->pendings;
+			binding->pendings = pend;
+			if (state == LAZY_IDLE)
+				load_locked(binding);
+			state = LAZY_LOADING;
+		}
+	}
+	x_mutex_unlock(&mutex);
+
+	if (state != LAZY_LOADING)
+		forward(binding, req, state == LAZY_LOADED ? 0 : X_ENOTSUP);
+}
+
+static int api_service_start(void *closure)
+{
+	struct lazy_api *api = closure;
+	struct lazy_binding *binding = api->binding;
+
+	if (api->background) {
+		x_mutex_lock(&mutex);
+		if (binding->state == LAZY_IDLE)
+			load_locked(binding);
+		x_mutex_unlock(&mutex);
+	}
+	return 0;
+}
+
+static void api_service_exit(void *closure, int code)
+{
+	struct lazy_api *api = closure;
+	struct lazy_binding *binding = api->binding;
+	int doexit;
+
+	x_mutex_lock(&mutex);
+	doexit = binding->state == LAZY_LOADED && !binding->exited;
+	binding->exited = 1;
+	x_mutex_unlock(&mutex);
+	if (doexit)
+		afb_apiset_exit_all_services(binding->realset, code);
+}
+
+#if WITH_AFB_HOOK
+static void api_update_hooks(void *closure)
+{
+	struct lazy_api *api = closure;
+
+	if (is_loaded(api->binding))
+		afb_apiset_update_hooks(api->binding->realset, api->name);
+}
+#endif
+
+static int api_get_logmask(void *closure)
+{
+	struct lazy_api *api = closure;
+
+	if (is_loaded(api->binding))
+		return afb_apiset_get_logmask(api->binding->realset, api->name);
+	return api->logmask;
+}
+
+static void api_set_logmask(void *closure, int level)
+{
+	struct lazy_api *api = closure;
+	int loaded;
+
+	x_mutex_lock(&mutex);
+	api->logmask = level;
+	loaded = api->binding->state == LAZY_LOADED;
+	x_mutex_unlock(&mutex);
+	if (loaded)
+		afb_apiset_set_logmask(api->binding->realset, api->name, level);
+}
+
+static void api_unref(void *closure)
+{
+	struct lazy_api *api = closure;
+	struct lazy_binding *binding = api->binding;
+
+	x_mutex_lock(&mutex);
+	binding->refcount--;
+	put_binding_locked(binding);
+	x_mutex_unlock(&mutex);
+
+	free(api->verbs);
+	free(api);
+}
+
+static struct afb_api_itf lazy_api_itf =
+{
+	.process = api_process,
+	.service_start = api_service_start,
+	.service_exit = api_service_exit,
+#if WITH_AFB_HOOK
+	.update_hooks = api_update_hooks,
+#endif
+	.get_logmask = api_get_logmask,
+	.set_logmask = api_set_logmask,
+	.unref = api_unref
+};
+
+/******************************************************************************/
+
+/* get the lazy binding of path for call_set, creating it if needed */
+static struct lazy_binding *get_binding_locked(const char *path, struct afb_apiset *declare_set, struct afb_apiset *call_set)
+{
+	struct lazy_binding *binding;
+
+	for (binding = bindings ; binding != NULL ; binding = binding->next)
+		if (binding->call_set == call_set && !strcmp(binding->path, path))
+			return binding;
+
+	binding = malloc(sizeof *binding + 1 + strlen(path));
+	if (binding != NULL) {
+		binding->realset = afb_apiset_create(path, afb_apiset_timeout_get(declare_set));
+		if (binding->realset == NULL) {
+			free(binding);
+			return NULL;
+		}
+		binding->refcount = 0;
+		binding->state = LAZY_IDLE;
+		binding->exited = 0;
+		binding->call_set = afb_apiset_addref(call_set);
+		binding->pendings = NULL;
+		strcpy(binding->path, path);
+		binding->next = bindings;
+		bindings = binding;
+	}
+	return binding;
+}
+
+int afb_api_lazy_add(
+		const char *path,
+		const char *apiname,
+		const char *verbs,
+		struct afb_apiset *declare_set,
+		struct afb_apiset *call_set,
+		int background
+) {
+	struct lazy_api *api;
+	struct afb_api_item item;
+	int rc;
+
+	/* check the api name */
+	if (!afb_apiname_is_valid(apiname)) {
+		RP_ERROR("invalid API name %s for lazy binding %s", apiname, path);
+		return X_EINVAL;
+	}
+
+	/* create the declared api */
+	api = malloc(sizeof *api + 1 + strlen(apiname));
+	if (api == NULL)
+		return X_ENOMEM;
+	api->verbs = NULL;
+	if (verbs != NULL && (api->verbs = strdup(verbs)) == NULL) {
+		free(api);
+		return X_ENOMEM;
+	}
+	api->logmask = rp_logmask;
+	api->background = background;
+	strcpy(api->name, apiname);
+
+	/* attach it to its binding */
+	x_mutex_lock(&mutex);
+	api->binding = get_binding_locked(path, declare_set, call_set);
+	if (api->binding == NULL) {
+		x_mutex_unlock(&mutex);
+		free(api->verbs);
+		free(api);
+		return X_ENOMEM;
+	}
+	api->binding->refcount++;
+	x_mutex_unlock(&mutex);
+
+	/* declare it */
+	item.closure = api;
+	item.itf = &lazy_api_itf;
+	item.group = NULL;
+	rc = afb_apiset_add(declare_set, api->name, item);
+	if (rc < 0) {
+		RP_ERROR("can't declare API %s of lazy binding %s", apiname, path);
+		api_unref(api);
+	}
+	return rc;
+}
+
+/* apply the list of classes */
+static int add_classes(
+		struct afb_apiset *declare_set,
+		const char *apiname,
+		char *classes,
+		int (*fun)(struct afb_apiset*, const char*, const char*)
+) {
+	char *name, *save;
+	int rc = 0;
+
+	for (name = strtok_r(classes, ",", &save) ; name != NULL && rc >= 0 ; name = strtok_r(NULL, ",", &save))
+		rc = fun(declare_set, apiname, name);
+	return rc;
+}
+
+/* process one line of the manifest */
+static int add_manifest_line(
+		const char *manifest,
+		int lino,
+		char *line,
+		struct afb_apiset *declare_set,
+		struct afb_apiset *call_set
+) {
+	static const char seps[] = " \t\n";
+	char *path, *apiname, *field, *verbs, *provides, *requires, *save;
+	char fullpath[PATH_MAX];
+	const char *slash;
+	int rc, background, len;
+
+	/* split the line */
+	path = strtok_r(line, seps, &save);
+	if (path == NULL || *path == '#')
+		return 0;
+	apiname = strtok_r(NULL, seps, &save);
+	if (apiname == NULL)
+		goto bad;
+	verbs = provides = requires = NULL;
+	background = 0;
+	while ((field = strtok_r(NULL, seps, &save)) != NULL) {
+		if (!strncmp(field, "verbs=", 6))
+			verbs = &field[6];
+		else if (!strncmp(field, "provide=", 8))
+			provides = &field[8];
+		else if (!strncmp(field, "require=", 8))
+			requires = &field[8];
+		else if (!strcmp(field, "background"))
+			background = 1;
+		else
+			goto bad;
+	}
+
+	/* relative paths are relative to the manifest */
+	slash = strrchr(manifest, '/');
+	if (*path != '/' && slash != NULL) {
+		len = snprintf(fullpath, sizeof fullpath, "%.*s/%s",
+				(int)(slash - manifest), manifest, path);
+		if (len < 0 || len >= (int)sizeof fullpath)
+			goto bad;
+		path = fullpath;
+	}
+
+	/* declare the api */
+	rc = afb_api_lazy_add(path, apiname, verbs, declare_set, call_set, background);
+	if (rc >= 0 && provides != NULL)
+		rc = add_classes(declare_set, apiname, provides, afb_apiset_provide_class);
+	if (rc >= 0 && requires != NULL)
+		rc = add_classes(declare_set, apiname, requires, afb_apiset_require_class);
+	return rc < 0 ? rc : 1;
+bad:
+	RP_ERROR("bad line %d of lazy manifest %s", lino, manifest);
+	return X_EINVAL;
+}
+
+int afb_api_lazy_add_manifest(
+		const char *manifest,
+		struct afb_apiset *declare_set,
+		struct afb_apiset *call_set
+) {
+	char line[2 * PATH_MAX];
+	FILE *file;
+	int rc, lino, count;
+
+	file = fopen(manifest, "r");
+	if (file == NULL) {
+		rc = -errno;
+		RP_ERROR("can't open lazy manifest %s: %s", manifest, strerror(-rc));
+		return rc;
+	}
+	rc = count = lino = 0;
+	while (rc >= 0 && fgets(line, (int)sizeof line, file) != NULL) {
+		rc = add_manifest_line(manifest, ++lino, line, declare_set, call_set);
+		count += rc > 0;
+	}
+	fclose(file);
+	return rc < 0 ? rc : count;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#if WITH_DYNAMIC_BINDING
+
+struct afb_apiset;
+
+/**
+ * Declare in 'declare_set' the API 'apiname' as provided by the binding
+ * of 'path' without loading it. The binding is loaded on the first request
+ * to one of its declared APIs or, when 'background' isn't zero, as soon as
+ * the declared API is started. Requests received during the loading are
+ * queued and processed when the loading completes.
+ *
+ * Declarations of a same path for a same call set share the same loading.
+ *
+ * @param path        path of the binding
+ * @param apiname     name of the API
+ * @param verbs       NULL or comma separated list of the verbs of the API,
+ *                    requests to other verbs are rejected without loading
+ * @param declare_set the apiset where the API is declared
+ * @param call_set    the apiset used by the binding for its calls
+ * @param background  if not zero, load the binding when the API is started
+ *
+ * @return 0 in case of success or a negative error code
+ */
+extern int afb_api_lazy_add(
+		const char *path,
+		const char *apiname,
+		const char *verbs,
+		struct afb_apiset *declare_set,
+		struct afb_apiset *call_set,
+		int background);
+
+/**
+ * Declare the APIs of the lazy bindings listed in 'manifest'.
+ *
+ * The manifest is a text file. Empty lines and lines starting with #
+ * are ignored. Other lines declare one API using the format:
+ *
+ *   PATH API [verbs=VERB,...] [provide=CLASS,...] [require=CLASS,...] [background]
+ *
+ * @param manifest    path of the manifest file
+ * @param declare_set the apiset where the APIs are declared
+ * @param call_set    the apiset used by the bindings for their calls
+ *
+ * @return the count of declared APIs or a negative error code
+ */
+extern int afb_api_lazy_add_manifest(
+		const char *manifest,
+		struct afb_apiset *declare_set,
+		struct afb_apiset *call_set);
+
+#endif
@@ -60,8 +60,11 @@ struct server
 	/** the apiset for declaring */
 	struct afb_apiset *declare_set;
 
-	/** ev_fd handler */
-	struct ev_fd *efd;
+	/** ev_fd handlers of the listening sockets */
+	struct ev_fd *efds[AFB_SOCKET_LISTENERS_MAX];
+
+	/** count of listening sockets */
+	unsigned nefds;
 
 	/** spec of the server */
 	struct afb_rpc_spec *spec;
@@ -208,48 +211,52 @@ int afb_api_rpc_add_client_weak(const char *uri, struct afb_apiset *declare_set,
 /***       S E R V E R                                                      ***/
 /******************************************************************************/
 
-static void server_accept(struct server *server, int fd)
+static void server_serve(struct server *server, int fdc)
 {
-	int fdc, rc;
-	struct sockaddr addr;
-	socklen_t lenaddr;
+	int rc;
 	struct afb_wrap_rpc *wrap;
 
-	lenaddr = (socklen_t)sizeof addr;
-	fdc = accept(fd, &addr, &lenaddr);
-	if (fdc < 0) {
-		RP_ERROR("can't accept connection to %s: %m", server->uri);
-	} else {
-		fcntl(fdc, F_SETFL, O_NONBLOCK);
-		rc = 1;
-		setsockopt(fdc, IPPROTO_TCP, TCP_NODELAY, &rc, (socklen_t)sizeof rc);
-
-		rc = afb_wrap_rpc_create_fd(&wrap, fdc, 1, server->mode, server->uri,
-				server->spec, server->call_set);
+	rc = afb_wrap_rpc_create_fd(&wrap, fdc, 1, server->mode, server->uri,
+			server->spec, server->call_set);
+	if (rc < 0) {
+		RP_ERROR("can't serve accepted connection to %s", server->uri);
+		close(fdc);
+	}
+	else {
+		rc = afb_wrap_rpc_start_server(wrap, server->declare_set);
 		if (rc < 0) {
-			RP_ERROR("can't serve accepted connection to %s", server->uri);
+			RP_ERROR("can't start server connection %s", server->uri);
 			close(fdc);
+			/* TODO: afb_wrap_rpc_unref(wrap); */
 		}
-		else {
-			rc = afb_wrap_rpc_start_server(wrap, server->declare_set);
-			if (rc < 0) {
-				RP_ERROR("can't start server connection %s", server->uri);
-				close(fdc);
-				/* TODO: afb_wrap_rpc_unref(wrap); */
-			}
 #if WITH_CRED
-			else {
-				/*
-				* creds of the peer are not changing
-				* except if passed to other processes
-				* TODO check how to track changes if needed
-				*/
-				struct afb_cred *cred;
-				afb_cred_create_for_socket(&cred, fdc); /* TODO: check retcode */
-				afb_wrap_rpc_set_cred(wrap, cred);
-			}
+		else {
+			/*
+			* creds of the peer are not changing
+			* except if passed to other processes
+			* TODO check how to track changes if needed
+			*/
+			struct afb_cred *cred;
+			afb_cred_create_for_socket(&cred, fdc); /* TODO: check retcode */
+			afb_wrap_rpc_set_cred(wrap, cred);
+		}
 #endif
+	}
+}
+
+/* accept pending connections until none remains or the batch is full */
+static void server_accept(struct server *server, int fd)
+{
+	int fdc, count;
+
+	for (count = 0 ; count < AFB_SOCKET_ACCEPT_BATCH ; count++) {
+		fdc = afb_socket_accept(fd, 1);
+		if (fdc < 0) {
+			if (fdc != X_EAGAIN)
+				RP_ERROR("can't accept connection to %s: %s", server->uri, strerror(-fdc));
+			break;
 		}
+		server_serve(server, fdc);
 	}
 }
 
@@ -276,24 +283,35 @@ static void server_listen_callback(struct ev_fd *efd, int fd, uint32_t revents,
 
 static void server_disconnect(struct server *server)
 {
-	ev_fd_unref(server->efd);
-	server->efd = 0;
+	while (server->nefds) {
+		server->nefds--;
+		ev_fd_unref(server->efds[server->nefds]);
+		server->efds[server->nefds] = 0;
+	}
 }
 
 static int server_connect(struct server *server)
 {
-	int fd, rc;
+	int fds[AFB_SOCKET_LISTENERS_MAX];
+	int count, idx, rc;
 
 	/* request the service object name */
-	rc = afb_socket_open(server->uri, 1);
+	rc = afb_socket_open_listeners(server->uri, fds, afb_socket_get_listeners_count());
 	if (rc < 0)
 		RP_ERROR("can't create socket %s", server->uri);
 	else {
-		/* listen for service */
-		fd = rc;
-		rc = afb_ev_mgr_add_fd(&server->efd, fd, EV_FD_IN, server_listen_callback, server, 0, 1);
+		/* listen for service, the listeners are spread over event loops */
+		count = rc;
+		for (idx = 0 ; idx < count ; idx++) {
+			rc = afb_ev_mgr_add_fd_sharded(&server->efds[idx], fds[idx], EV_FD_IN, server_listen_callback, server, 0, 1);
+			if (rc < 0)
+				break;
+			server->nefds++;
+		}
 		if (rc < 0) {
-			close(fd);
+			while (idx < count)
+				close(fds[idx++]);
+			server_disconnect(server);
 			RP_ERROR("can't connect socket %s", server->uri);
 		}
 	}
@@ -377,7 +395,7 @@ int afb_api_rpc_add_server(const char *uri, struct afb_apiset *declare_set, stru
 	server->declare_set = afb_apiset_addref(declare_set);
 	server->spec = spec;
 	server->mode = mode;
-	server->efd = 0;
+	server->nefds = 0;
 	strcpy(server->uri, turi);
 
 	/* connect for serving */
@@ -26,6 +26,7 @@
 #if WITH_DYNAMIC_BINDING
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -38,6 +39,7 @@
 #include "apis/afb-api-so-v3.h"
 #include "apis/afb-api-so-v4.h"
 #include "core/afb-sig-monitor.h"
+#include "misc/afb-so-probe.h"
 
 struct safe_dlopen
 {
@@ -146,6 +148,12 @@ struct search
 	int failstops;
 	/** final status */
 	int status;
+	/** count of found files */
+	int count;
+	/** allocated count of paths */
+	int alloc;
+	/** paths of the found files */
+	char **paths;
 };
 
 /**
@@ -153,23 +161,67 @@ struct search
  */
 static int processfiles(void *closure, const rp_path_search_entry_t *item)
 {
-	int rc;
 	struct search *s = closure;
+	char **paths, *path;
 
 	/* only try files having ".so" extension */
 	if (item->namelen < 3 || memcmp(&item->name[item->namelen - 3], ".so", 4))
 		return 0;
 
-	/* try to get it as a binding */
-	rc = load_binding(item->path, s->declare_set, s->call_set, NULL, s->failstops);
-	if (rc >= 0 || !s->failstops)
-		return 0; /* got it or fails ignored */
-
-	/* report the error and tell to stop exploration of files */
-	s->status = rc;
+	/* record it for loading it later */
+	if (s->count == s->alloc) {
+		paths = realloc(s->paths, (size_t)(s->alloc + 32) * sizeof *paths);
+		if (paths == NULL)
+			goto oom;
+		s->paths = paths;
+		s->alloc += 32;
+	}
+	path = strdup(item->path);
+	if (path == NULL)
+		goto oom;
+	s->paths[s->count++] = path;
+	return 0;
+
+oom:
+	RP_ERROR("out of memory");
+	s->status = X_ENOMEM;
 	return 1;
 }
 
+/**
+ * load the found files that are bindings
+ */
+static void loadfiles(struct search *s)
+{
+	int i, rc, *kinds;
+
+	/* get the kinds of the files in parallel */
+	kinds = malloc((size_t)s->count * sizeof *kinds);
+	if (kinds == NULL) {
+		RP_ERROR("out of memory");
+		s->status = X_ENOMEM;
+		return;
+	}
+	afb_so_probe(s->count, (const char * const *)s->paths, kinds, AFB_SO_PROBE_BINDING);
+
+	/* load the bindings in order */
+	for (i = 0 ; i < s->count ; i++) {
+		if (kinds[i] >= 0 && !(kinds[i] & AFB_SO_PROBE_BINDING)) {
+			/* not a binding, don't load it */
+			_RP_VERBOSE_(s->failstops ? rp_Log_Level_Error : rp_Log_Level_Info, "binding [%s] %s",
+					s->paths[i], "isn't a supported AFB binding");
+			rc = s->failstops ? X_ENOTSUP : 0;
+		}
+		else
+			rc = load_binding(s->paths[i], s->declare_set, s->call_set, NULL, s->failstops);
+		if (rc < 0 && s->failstops) {
+			s->status = rc;
+			break;
+		}
+	}
+	free(kinds);
+}
+
 /**
  * function to filter out the directories that must not be entered
  */
@@ -221,8 +273,16 @@ See https://sourceware.org/bugzilla/show_bug.cgi?id=22101
 
 int afb_api_so_add_path_search(rp_path_search_t *pathsearch, struct afb_apiset *declare_set, struct afb_apiset *call_set, int failstops)
 {
-	struct search s = { .declare_set = declare_set, .call_set = call_set, .failstops = failstops, .status = 0 };
+	struct search s = { .declare_set = declare_set, .call_set = call_set, .failstops = failstops, .status = 0,
+				.count = 0, .alloc = 0, .paths = NULL };
+	int i;
+
 	rp_path_search_filter(pathsearch, RP_PATH_SEARCH_FILE|RP_PATH_SEARCH_RECURSIVE|RP_PATH_SEARCH_FLEXIBLE, processfiles, &s, filterdirs, &s);
+	if (s.status == 0 && s.count > 0)
+		loadfiles(&s);
+	for (i = 0 ; i < s.count ; i++)
+		free(s.paths[i]);
+	free(s.paths);
 	return s.status;
 }
 
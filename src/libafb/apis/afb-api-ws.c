@@ -48,7 +48,8 @@
 struct api_ws_server
 {
 	struct afb_apiset *apiset;	/* the apiset for calling */
-	struct ev_fd *efd;		/* ev_fd handler */
+	struct ev_fd *efds[AFB_SOCKET_LISTENERS_MAX]; /* ev_fd handlers */
+	uint16_t nefds;			/* count of listening sockets */
 	uint16_t offapi;		/* api name of the interface */
 	char uri[];			/* the uri of the server socket */
 };
@@ -139,20 +140,19 @@ static void server_on_hangup(struct afb_stub_ws *server)
 	afb_stub_ws_unref(server);
 }
 
+/* accept pending connections until none remains or the batch is full */
 static void api_ws_server_accept(struct api_ws_server *apiws, int fd)
 {
-	int fdc;
-	struct sockaddr addr;
-	socklen_t lenaddr;
+	int fdc, count;
 	struct afb_stub_ws *server;
 
-	lenaddr = (socklen_t)sizeof addr;
-	fdc = accept(fd, &addr, &lenaddr);
-	if (fdc < 0) {
-		RP_ERROR("can't accept connection to %s: %m", apiws->uri);
-	} else {
-		int opt = 1;
-		setsockopt(fdc, IPPROTO_TCP, TCP_NODELAY, &opt, (socklen_t)sizeof opt);
+	for (count = 0 ; count < AFB_SOCKET_ACCEPT_BATCH ; count++) {
+		fdc = afb_socket_accept(fd, 0);
+		if (fdc < 0) {
+			if (fdc != X_EAGAIN)
+				RP_ERROR("can't accept connection to %s: %s", apiws->uri, strerror(-fdc));
+			break;
+		}
 		server = afb_stub_ws_create_server(fdc, 1, &apiws->uri[apiws->offapi], apiws->apiset);
 		if (server)
 			afb_stub_ws_set_on_hangup(server, server_on_hangup);
@@ -175,27 +175,38 @@ static void api_ws_server_listen_callback(struct ev_fd *efd, int fd, uint32_t re
 
 static void api_ws_server_disconnect(struct api_ws_server *apiws)
 {
-	ev_fd_unref(apiws->efd);
-	apiws->efd = 0;
+	while (apiws->nefds) {
+		apiws->nefds--;
+		ev_fd_unref(apiws->efds[apiws->nefds]);
+		apiws->efds[apiws->nefds] = 0;
+	}
 }
 
 static int api_ws_server_connect(struct api_ws_server *apiws)
 {
-	int fd, rc;
+	int fds[AFB_SOCKET_LISTENERS_MAX];
+	int count, idx, rc;
 
 	/* ensure disconnected */
 	api_ws_server_disconnect(apiws);
 
 	/* request the service object name */
-	rc = afb_socket_open(apiws->uri, 1);
+	rc = afb_socket_open_listeners(apiws->uri, fds, afb_socket_get_listeners_count());
 	if (rc < 0)
 		RP_ERROR("can't create socket %s", apiws->uri);
 	else {
-		/* listen for service */
-		fd = rc;
-		rc = afb_ev_mgr_add_fd(&apiws->efd, fd, EV_FD_IN, api_ws_server_listen_callback, apiws, 0, 1);
+		/* listen for service, the listeners are spread over event loops */
+		count = rc;
+		for (idx = 0 ; idx < count ; idx++) {
+			rc = afb_ev_mgr_add_fd_sharded(&apiws->efds[idx], fds[idx], EV_FD_IN, api_ws_server_listen_callback, apiws, 0, 1);
+			if (rc < 0)
+				break;
+			apiws->nefds++;
+		}
 		if (rc < 0) {
-			close(fd);
+			while (idx < count)
+				close(fds[idx++]);
+			api_ws_server_disconnect(apiws);
 			RP_ERROR("can't connect socket %s", apiws->uri);
 		}
 	}
@@ -244,7 +255,7 @@ int afb_api_ws_add_server(const char *uri, struct afb_apiset *declare_set, struc
 	}
 
 	apiws->apiset = afb_apiset_addref(call_set);
-	apiws->efd = 0;
+	apiws->nefds = 0;
 	strcpy(apiws->uri, uri);
 	if (!extra)
 		apiws->offapi = (uint16_t)(api - uri);
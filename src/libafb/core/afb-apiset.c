@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <rp-utils/rp-verbose.h>
 
@@ -33,12 +34,19 @@
 #include "core/afb-apiname.h"
 #include "core/afb-apiset.h"
 #include "core/afb-sched.h"
+#if WITH_SCHED_FIBERS
+#include "core/afb-fibers.h"
+#endif
 
 #include "sys/x-errno.h"
+#include "sys/x-mutex.h"
+#include "sys/x-cond.h"
+#include "sys/x-thread.h"
 #include "utils/namecmp.h"
 
 #define INCR		8	/* CAUTION: must be a power of 2 */
 #define NOT_STARTED 	1
+#define STARTING 	2
 
 struct afb_apiset;
 struct api_desc;
@@ -69,8 +77,11 @@ struct api_desc
 	const char *name;		/**< name of the api */
 	int status;			/**< initialisation status:
 						- NOT_STARTED not started,
+						- STARTING being started,
 						- 0 started without error,
 						- minus than 0, error number of start */
+	const void *starter;		/**< flow starting the api */
+	uint32_t start_duration;	/**< duration of the start in microseconds */
 	struct afb_api_item api;	/**< handler of the api */
 	struct {
 		struct api_array classes;
@@ -135,6 +146,39 @@ static struct api_desc *all_apis;
  */
 static struct api_class *all_classes;
 
+/**
+ * waiting of a flow for the start of an api
+ */
+struct start_wait
+{
+	struct start_wait *next;	/**< next waiting */
+	const void *flow;		/**< the waiting flow */
+	struct api_desc *api;		/**< the waited api */
+};
+
+/**
+ * protection of the starts
+ */
+static x_mutex_t start_mutex = X_MUTEX_INITIALIZER;
+
+/**
+ * signaling end of starts
+ */
+static x_cond_t start_cond = X_COND_INITIALIZER;
+
+/**
+ * the flows waiting the start of an api
+ */
+static struct start_wait *start_waits;
+
+/**
+ * counter of threads for identifying flows
+ */
+static uint32_t start_thread_counter;
+
+/* number of the thread plus one */
+X_TLS(void,start_thread_number)
+
 /**
  * Ensure enough room in 'array' for 'count' items
  */
@@ -716,7 +760,7 @@ int afb_apiset_get_api(struct afb_apiset *set, const char *name, int rec, int st
 	if (!i)
 		result = X_ENOENT;
 	else if (started)
-		result = i->status == NOT_STARTED ? start_api(i) : i->status;
+		result = i->status > 0 ? start_api(i) : i->status;
 	else
 		result = 0;
 	if (api)
@@ -740,6 +784,8 @@ static int start_array_apis(struct api_array *array)
 				rc = rc2;
 			i = 0;
 		} else {
+			if (rc2 == STARTING)
+				rc2 = start_api(array->apis[i]);
 			if (rc2)
 				rc = rc2;
 			i++;
@@ -797,6 +843,8 @@ static int start_array_depends(struct api_array *array)
 					rc = rc2;
 				i = 0;
 			} else {
+				if (rc2 == STARTING)
+					rc2 = start_api(api);
 				if (rc2 < 0  && rc == 0)
 					rc = rc2;
 				i++;
@@ -807,20 +855,94 @@ static int start_array_depends(struct api_array *array)
 	return rc;
 }
 
+/**
+ * Get the flow of execution of the caller: the fiber if any
+ * or else the thread.
+ */
+static const void *start_flow()
+{
+	uintptr_t num;
+
+#if WITH_SCHED_FIBERS
+	struct afb_fiber *fiber = afb_fiber_current();
+	if (fiber != NULL)
+		return fiber;
+#endif
+	num = (uintptr_t)x_tls_get_start_thread_number();
+	if (num == 0) {
+		num = (uintptr_t)__atomic_add_fetch(&start_thread_counter, 1, __ATOMIC_RELAXED);
+		x_tls_set_start_thread_number((void*)num);
+	}
+	return (const void*)num;
+}
+
+/**
+ * Check if waiting the end of the start of 'api' by 'flow'
+ * would wait for 'flow' itself (the start_mutex must be held)
+ */
+static int start_would_loop(struct api_desc *api, const void *flow)
+{
+	const void *f;
+	struct start_wait *w;
+
+	for (f = api->starter ; f != flow ; f = w->api->starter) {
+		for (w = start_waits ; w != NULL && w->flow != f ; w = w->next);
+		if (w == NULL)
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Get the monotonic time in microseconds
+ */
+static uint64_t start_now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
 /**
  * Starts the service 'api'.
+ * When the api is being started by an other flow,
+ * waits the end of that start.
  * @param api the api
  * @return zero on success, -1 on error
  */
 static int start_api(struct api_desc *api)
 {
 	int rc;
+	const void *flow;
+	struct start_wait wait, **pwait;
+	uint64_t t0;
 
-	if (api->status != NOT_STARTED)
+	if (api->status <= 0)
 		return api->status;
 
+	/* check the status */
+	flow = start_flow();
+	x_mutex_lock(&start_mutex);
+	while (api->status == STARTING && !start_would_loop(api, flow)) {
+		wait.flow = flow;
+		wait.api = api;
+		wait.next = start_waits;
+		start_waits = &wait;
+		x_cond_wait(&start_cond, &start_mutex);
+		for (pwait = &start_waits ; *pwait != &wait ; pwait = &(*pwait)->next);
+		*pwait = wait.next;
+	}
+	rc = api->status;
+	if (rc == NOT_STARTED) {
+		api->status = STARTING;
+		api->starter = flow;
+	}
+	x_mutex_unlock(&start_mutex);
+	if (rc != NOT_STARTED)
+		return rc == STARTING ? X_EBUSY : rc;
+
 	RP_NOTICE("API %s starting...", api->name);
-	api->status = X_EBUSY;
+	t0 = start_now_us();
 	rc = start_array_classes(&api->require.classes);
 	if (rc < 0)
 		RP_ERROR("Cannot start classes needed by api %s", api->name);
@@ -834,9 +956,17 @@ static int start_api(struct api_desc *api)
 				RP_ERROR("The api %s failed to start", api->name);
 		}
 	}
+
+	/* record the status and wake up the waiters */
+	x_mutex_lock(&start_mutex);
+	api->start_duration = (uint32_t)(start_now_us() - t0);
 	api->status = rc;
+	api->starter = NULL;
+	x_cond_broadcast(&start_cond);
+	x_mutex_unlock(&start_mutex);
 	if (rc == 0)
-		RP_INFO("API %s started", api->name);
+		RP_INFO("API %s started in %u.%03u ms", api->name,
+			api->start_duration / 1000, api->start_duration % 1000);
 	return rc;
 }
 
@@ -883,6 +1013,8 @@ int afb_apiset_start_all_services(struct afb_apiset *set)
 				set = rootset;
 				i = 0;
 			} else {
+				if (rc == STARTING)
+					rc = start_api(set->apis.apis[i]);
 				if (rc)
 					ret = -1;
 				i++;
@@ -893,6 +1025,285 @@ int afb_apiset_start_all_services(struct afb_apiset *set)
 	return ret;
 }
 
+/**
+ * Node of the graph of requirements for parallel starts
+ */
+struct start_node
+{
+	struct api_desc *api;		/**< the api to start */
+	int pending;			/**< count of requirements not started */
+	int ndependents;		/**< count of nodes requiring this one */
+	struct start_node **dependents;	/**< nodes requiring this one */
+};
+
+/**
+ * State of a parallel start
+ */
+struct start_graph
+{
+	int count;			/**< count of nodes */
+	int done;			/**< count of nodes processed */
+	int running;			/**< count of running start jobs */
+	int concurrency;		/**< maximum count of running start jobs */
+	int nready;			/**< count of ready nodes */
+	int timeout;			/**< timeout of start jobs */
+	int status;			/**< global status */
+	struct start_node *nodes;	/**< the nodes */
+	struct start_node **ready;	/**< stack of ready nodes */
+	struct afb_sched_lock *lock;	/**< lock of the waiting flow */
+};
+
+/**
+ * Get the node of 'api' in 'graph' or NULL if 'api' isn't part of it
+ */
+static struct start_node *start_graph_node(struct start_graph *graph, struct api_desc *api)
+{
+	int i;
+
+	for (i = 0 ; i < graph->count ; i++)
+		if (graph->nodes[i].api == api)
+			return &graph->nodes[i];
+	return NULL;
+}
+
+/**
+ * Add the edge telling that 'node' requires 'api'
+ */
+static int start_graph_link(struct start_graph *graph, struct start_node *node, struct api_desc *api)
+{
+	struct start_node *req, **deps;
+	int i;
+
+	req = start_graph_node(graph, api);
+	if (req == NULL || req == node)
+		return 0;
+	for (i = 0 ; i < req->ndependents ; i++)
+		if (req->dependents[i] == node)
+			return 0;
+	deps = realloc(req->dependents, (size_t)(req->ndependents + 1) * sizeof *deps);
+	if (deps == NULL)
+		return X_ENOMEM;
+	deps[req->ndependents++] = node;
+	req->dependents = deps;
+	node->pending++;
+	return 0;
+}
+
+/**
+ * Build the graph of requirements of the apis of 'set' not started
+ */
+static int start_graph_build(struct start_graph *graph, struct afb_apiset *set)
+{
+	struct afb_apiset *s;
+	struct start_node *node;
+	struct api_array *classes, *depends;
+	struct api_desc *api;
+	int i, j, k, rc;
+
+	/* count the apis to start */
+	graph->count = 0;
+	for (s = set ; s ; s = s->subset)
+		for (i = 0 ; i < s->apis.count ; i++)
+			graph->count += s->apis.apis[i]->status == NOT_STARTED;
+	graph->nodes = calloc((size_t)graph->count, sizeof *graph->nodes);
+	graph->ready = calloc((size_t)graph->count, sizeof *graph->ready);
+	if (graph->count && (graph->nodes == NULL || graph->ready == NULL)) {
+		graph->count = 0;
+		return X_ENOMEM;
+	}
+
+	/* create the nodes */
+	graph->count = 0;
+	for (s = set ; s ; s = s->subset)
+		for (i = 0 ; i < s->apis.count ; i++)
+			if (s->apis.apis[i]->status == NOT_STARTED)
+				graph->nodes[graph->count++].api = s->apis.apis[i];
+
+	/* create the edges */
+	for (i = 0 ; i < graph->count ; i++) {
+		node = &graph->nodes[i];
+		classes = &node->api->require.classes;
+		for (j = 0 ; j < classes->count ; j++) {
+			for (k = 0 ; k < classes->classes[j]->providers.count ; k++) {
+				rc = start_graph_link(graph, node, classes->classes[j]->providers.apis[k]);
+				if (rc < 0)
+					return rc;
+			}
+		}
+		depends = &node->api->require.apis;
+		for (j = 0 ; j < depends->count ; j++) {
+			api = lookup(depends->depends[j]->callset, depends->depends[j]->name, 1);
+			if (api != NULL) {
+				rc = start_graph_link(graph, node, api);
+				if (rc < 0)
+					return rc;
+			}
+		}
+	}
+
+	/* initial ready nodes */
+	for (i = 0 ; i < graph->count ; i++)
+		if (graph->nodes[i].pending == 0)
+			graph->ready[graph->nready++] = &graph->nodes[i];
+	return 0;
+}
+
+/**
+ * Release the memory used by the graph
+ */
+static void start_graph_release(struct start_graph *graph)
+{
+	int i;
+
+	for (i = 0 ; i < graph->count ; i++)
+		free(graph->nodes[i].dependents);
+	free(graph->nodes);
+	free(graph->ready);
+}
+
+static void start_graph_job(int signum, void *closure1, void *closure2);
+
+/**
+ * Post jobs for starting ready nodes (the start_mutex must be held)
+ * Returns 1 when nothing remains to be done.
+ */
+static int start_graph_post_locked(struct start_graph *graph)
+{
+	struct start_node *node;
+	int rc;
+
+	while (graph->nready > 0 && graph->running < graph->concurrency) {
+		node = graph->ready[--graph->nready];
+		rc = afb_sched_post_job2(NULL, 0, graph->timeout, start_graph_job,
+					graph, node, Afb_Sched_Mode_Start);
+		if (rc < 0) {
+			/* can't post, will be started later sequentially */
+			RP_WARNING("can't post the start of api %s", node->api->name);
+			graph->ready[graph->nready++] = node;
+			break;
+		}
+		graph->running++;
+	}
+	return graph->running == 0;
+}
+
+/**
+ * Job starting the api of one node of the graph
+ */
+static void start_graph_job(int signum, void *closure1, void *closure2)
+{
+	struct start_graph *graph = closure1;
+	struct start_node *node = closure2;
+	struct afb_sched_lock *lock;
+	int i, rc, end;
+
+	if (signum == 0)
+		rc = start_api(node->api);
+	else {
+		RP_ERROR("start of api %s interrupted by signal %d", node->api->name, signum);
+		rc = X_EINTR;
+	}
+
+	x_mutex_lock(&start_mutex);
+	if (signum != 0 && node->api->status == STARTING) {
+		node->api->status = rc;
+		node->api->starter = NULL;
+		x_cond_broadcast(&start_cond);
+	}
+	if (rc < 0)
+		graph->status = rc;
+	graph->running--;
+	graph->done++;
+	for (i = 0 ; i < node->ndependents ; i++)
+		if (--node->dependents[i]->pending == 0)
+			graph->ready[graph->nready++] = node->dependents[i];
+	end = start_graph_post_locked(graph);
+	lock = graph->lock;
+	x_cond_broadcast(&start_cond);
+	x_mutex_unlock(&start_mutex);
+	if (end)
+		afb_sched_leave(lock);
+}
+
+/**
+ * Callback of the synchronous wait of the parallel start
+ */
+static void start_graph_sync(int signum, void *closure, struct afb_sched_lock *lock)
+{
+	struct start_graph *graph = closure;
+	int end;
+
+	if (signum == 0) {
+		x_mutex_lock(&start_mutex);
+		graph->lock = lock;
+		end = start_graph_post_locked(graph);
+		x_mutex_unlock(&start_mutex);
+		if (end)
+			afb_sched_leave(lock);
+	}
+}
+
+/**
+ * Starts all possible services, starting in parallel the services
+ * whose required apis and classes are started. The requirements
+ * are the ones declared using 'afb_apiset_require',
+ * 'afb_apiset_require_class' and 'afb_apiset_provide_class'.
+ *
+ * This function must be called from a job of the scheduler.
+ * The services not started in parallel (because of cycles in
+ * requirements or because added during the start) are started
+ * sequentially after.
+ *
+ * @param set the api set
+ * @param concurrency maximum count of services started in parallel,
+ *                    when lower than 2, the starting is sequential
+ * @return 0 on success or a negative number when an error is found
+ */
+int afb_apiset_start_all_services_parallel(struct afb_apiset *set, int concurrency)
+{
+	struct start_graph graph;
+	uint64_t t0, sum;
+	int i, rc;
+
+	if (concurrency < 2)
+		return afb_apiset_start_all_services(set);
+
+	t0 = start_now_us();
+	memset(&graph, 0, sizeof graph);
+	graph.concurrency = concurrency;
+	graph.timeout = set->timeout;
+	rc = start_graph_build(&graph, set);
+	if (rc < 0)
+		RP_ERROR("can't prepare parallel start of apis");
+	else if (graph.nready > 0) {
+		rc = afb_sched_sync(0, start_graph_sync, &graph);
+		if (rc < 0) {
+			/* interrupted, wait the end of the running jobs */
+			RP_ERROR("parallel start of apis interrupted");
+			x_mutex_lock(&start_mutex);
+			graph.concurrency = 0;
+			while (graph.running > 0)
+				x_cond_wait(&start_cond, &start_mutex);
+			x_mutex_unlock(&start_mutex);
+		}
+		if (graph.done < graph.count)
+			RP_NOTICE("%d apis left to start sequentially", graph.count - graph.done);
+	}
+
+	/* report the starts */
+	if (graph.done > 0) {
+		for (sum = 0, i = 0 ; i < graph.count ; i++)
+			sum += graph.nodes[i].api->start_duration;
+		RP_NOTICE("%d apis started in parallel in %u ms (cumulated %u ms)",
+			graph.done, (unsigned)((start_now_us() - t0) / 1000), (unsigned)(sum / 1000));
+	}
+	start_graph_release(&graph);
+
+	/* start the remaining services and compute the status */
+	rc = afb_apiset_start_all_services(set);
+	return rc < 0 ? rc : graph.status;
+}
+
 /**
  * Exits all started services
  * @param set the api set
@@ -81,6 +81,7 @@ extern int afb_apiset_get_api(struct afb_apiset *set, const char *name, int rec,
 
 extern int afb_apiset_start_service(struct afb_apiset *set, const char *name);
 extern int afb_apiset_start_all_services(struct afb_apiset *set);
+extern int afb_apiset_start_all_services_parallel(struct afb_apiset *set, int concurrency);
 extern void afb_apiset_exit_all_services(struct afb_apiset *set, int code);
 
 #if WITH_AFB_HOOK
@@ -220,6 +220,10 @@ make_call_req(
 	/* initialise the common request */
 	afb_req_common_init(&req->comreq, itf, apiname, verbname, nparams, params, comapi->group);
 
+	/* subcalls don't outlive their caller */
+	if (caller != NULL)
+		afb_req_common_set_deadline(&req->comreq, caller->deadline);
+
 	/* set the session of the request */
 	session = (flags & afb_req_subcall_api_session)
 			? afb_api_common_session_get(comapi)
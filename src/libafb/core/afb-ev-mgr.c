@@ -22,6 +22,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <limits.h>
 #include <string.h>
 
@@ -30,6 +31,8 @@
 #include "sys/ev-mgr.h"
 #include "core/afb-jobs.h"
 #include "core/afb-ev-mgr.h"
+#include "core/afb-sig-monitor.h"
+#include "core/afb-threads.h"
 
 #include "sys/x-mutex.h"
 #include "sys/x-cond.h"
@@ -500,3 +503,215 @@ void afb_ev_mgr_try_recover_for_me()
 {
 	afb_ev_mgr_try_recover(x_thread_self());
 }
+
+/**********************************************************************
+ * SECONDARY REACTORS
+ *********************************************************************/
+
+#if WITH_EV_REACTORS
+
+/**
+ * A reactor is an event manager run by its own thread.
+ * It only handles file descriptors of connections, timers
+ * and preparers are kept in the main event manager.
+ */
+struct reactor
+{
+	/** the event manager of the reactor */
+	struct ev_mgr *mgr;
+
+	/** protects the list of fds of mgr against other threads */
+	x_mutex_t mutex;
+
+	/** the thread running the reactor */
+	x_thread_t tid;
+
+	/** is the mutex locked by the reactor */
+	uint8_t locked;
+
+	/** is the reactor stopping */
+	uint8_t stopping;
+};
+
+/* the reactors */
+static struct reactor *reactors = NULL;
+static unsigned reactor_count = 0;
+static unsigned reactor_next = 0;
+
+/**
+ * run one loop of the reactor
+ */
+static void reactor_sig_run(int signum, void *closure)
+{
+	struct reactor *reactor = closure;
+	int rc;
+
+	if (signum) {
+		RP_ERROR("Signal %s catched in reactor", strsignal(signum));
+		ev_mgr_recover_run(reactor->mgr);
+		if (reactor->locked) {
+			reactor->locked = 0;
+			x_mutex_unlock(&reactor->mutex);
+		}
+	}
+	else {
+		x_mutex_lock(&reactor->mutex);
+		reactor->locked = 1;
+		rc = ev_mgr_prepare(reactor->mgr);
+		reactor->locked = 0;
+		x_mutex_unlock(&reactor->mutex);
+		if (rc >= 0 && ev_mgr_wait(reactor->mgr, -1) > 0) {
+			x_mutex_lock(&reactor->mutex);
+			reactor->locked = 1;
+			ev_mgr_dispatch(reactor->mgr);
+			reactor->locked = 0;
+			x_mutex_unlock(&reactor->mutex);
+		}
+	}
+}
+
+/**
+ * main of the threads of the reactors
+ */
+static void *reactor_main(void *arg)
+{
+	struct reactor *reactor = arg;
+
+	afb_threads_place_evloop(1);
+	while (!__atomic_load_n(&reactor->stopping, __ATOMIC_RELAXED))
+		afb_sig_monitor_run(0, reactor_sig_run, reactor);
+	return NULL;
+}
+
+/**
+ * stops the 'count' first reactors of the array 'array' and free it
+ */
+static void stop_reactors(struct reactor *array, unsigned count)
+{
+	struct reactor *reactor;
+
+	while (count) {
+		reactor = &array[--count];
+		__atomic_store_n(&reactor->stopping, 1, __ATOMIC_RELAXED);
+		ev_mgr_wakeup(reactor->mgr);
+		x_thread_join(reactor->tid, NULL);
+		ev_mgr_unref(reactor->mgr);
+		x_mutex_destroy(&reactor->mutex);
+	}
+	free(array);
+}
+
+int afb_ev_mgr_start_reactors(unsigned count)
+{
+	struct reactor *array, *reactor;
+	unsigned idx;
+	int rc;
+
+	if (count == 0)
+		return X_EINVAL;
+
+	x_mutex_lock(&mutex);
+	if (reactors != NULL) {
+		x_mutex_unlock(&mutex);
+		return X_EBUSY;
+	}
+	array = calloc(count, sizeof *array);
+	if (array == NULL) {
+		x_mutex_unlock(&mutex);
+		return X_ENOMEM;
+	}
+	for (idx = 0 ; idx < count ; idx++) {
+		reactor = &array[idx];
+		rc = ev_mgr_create(&reactor->mgr);
+		if (rc < 0)
+			break;
+		x_mutex_init(&reactor->mutex);
+		rc = x_thread_create(&reactor->tid, reactor_main, reactor, 0);
+		if (rc < 0) {
+			x_mutex_destroy(&reactor->mutex);
+			ev_mgr_unref(reactor->mgr);
+			break;
+		}
+	}
+	if (idx < count) {
+		x_mutex_unlock(&mutex);
+		RP_ERROR("Can't start reactors: %s", strerror(-rc));
+		stop_reactors(array, idx);
+		return rc;
+	}
+	reactors = array;
+	reactor_count = count;
+	x_mutex_unlock(&mutex);
+	return 0;
+}
+
+void afb_ev_mgr_stop_reactors()
+{
+	struct reactor *array;
+	unsigned count;
+
+	x_mutex_lock(&mutex);
+	array = reactors;
+	count = reactor_count;
+	reactors = NULL;
+	reactor_count = 0;
+	x_mutex_unlock(&mutex);
+	if (array != NULL)
+		stop_reactors(array, count);
+}
+
+unsigned afb_ev_mgr_reactor_count()
+{
+	return reactor_count;
+}
+
+int afb_ev_mgr_add_fd_sharded(
+	struct ev_fd **efd,
+	int fd,
+	uint32_t events,
+	ev_fd_cb_t handler,
+	void *closure,
+	int autounref,
+	int autoclose
+) {
+	struct reactor *reactor;
+	unsigned count = reactor_count;
+	int rc;
+
+	if (count == 0)
+		return afb_ev_mgr_add_fd(efd, fd, events, handler, closure,
+		                         autounref, autoclose);
+
+	/* round robin attribution */
+	reactor = &reactors[__atomic_fetch_add(&reactor_next, 1, __ATOMIC_RELAXED) % count];
+	if (SAME_TID(reactor->tid, x_thread_self()))
+		/* called by the reactor itself, already locked */
+		rc = ev_mgr_add_fd(reactor->mgr, efd, fd, events, handler,
+		                   closure, autounref, autoclose);
+	else {
+		x_mutex_lock(&reactor->mutex);
+		rc = ev_mgr_add_fd(reactor->mgr, efd, fd, events, handler,
+		                   closure, autounref, autoclose);
+		x_mutex_unlock(&reactor->mutex);
+		/* let the reactor prepare its new fd */
+		ev_mgr_wakeup(reactor->mgr);
+	}
+	return rc;
+}
+
+#else
+
+int afb_ev_mgr_add_fd_sharded(
+	struct ev_fd **efd,
+	int fd,
+	uint32_t events,
+	ev_fd_cb_t handler,
+	void *closure,
+	int autounref,
+	int autoclose
+) {
+	return afb_ev_mgr_add_fd(efd, fd, events, handler, closure,
+	                         autounref, autoclose);
+}
+
+#endif
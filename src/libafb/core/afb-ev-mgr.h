@@ -78,6 +78,17 @@ int afb_ev_mgr_add_fd(
 	int autoclose
 );
 
+extern
+int afb_ev_mgr_add_fd_sharded(
+	struct ev_fd **efd,
+	int fd,
+	uint32_t events,
+	ev_fd_cb_t handler,
+	void *closure,
+	int autounref,
+	int autoclose
+);
+
 extern
 int afb_ev_mgr_add_prepare(
 	struct ev_prepare **prep,
@@ -110,3 +121,14 @@ void afb_ev_mgr_try_recover(x_thread_t tid);
 
 extern
 void afb_ev_mgr_try_recover_for_me();
+
+#if WITH_EV_REACTORS
+extern
+int afb_ev_mgr_start_reactors(unsigned count);
+
+extern
+void afb_ev_mgr_stop_reactors();
+
+extern
+unsigned afb_ev_mgr_reactor_count();
+#endif
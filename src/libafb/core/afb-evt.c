@@ -36,6 +36,7 @@
 #include "core/afb-data.h"
 #include "core/afb-data-array.h"
 #include "core/afb-sched.h"
+#include "core/afb-req-cache.h"
 #include "sys/x-mutex.h"
 #include "sys/x-rwlock.h"
 #include "sys/x-errno.h"
@@ -65,7 +66,18 @@
 #  define EVENT_BROADCAST_MEMORY_COUNT  8
 #endif
 
+/* count of heads of the index of pending pushs by event id, a power of 2 */
+#if !defined(EVT_PENDING_INDEX_COUNT)
+#  define EVT_PENDING_INDEX_COUNT  64
+#endif
+
+/* maximum count of pending pushs delivered by one drain job */
+#if !defined(EVT_DRAIN_BATCH_MAX)
+#  define EVT_DRAIN_BATCH_MAX  64
+#endif
+
 struct afb_evt_watch;
+struct evt_pending;
 
 /*
  * Structure for event listeners
@@ -84,8 +96,14 @@ struct afb_evt_listener {
 	/* group of the listener */
 	void *group;
 
-	/* head of the list of events listened */
-	struct afb_evt_watch *watchs;
+	/* hash table of the events listened, indexed by event id */
+	struct afb_evt_watch **watchs;
+
+	/* size of the hash table (zero or a power of 2) */
+	unsigned wsize;
+
+	/* count of events listened */
+	unsigned wcount;
 
 	/* rwlock of the listener */
 	x_rwlock_t rwlock;
@@ -95,6 +113,33 @@ struct afb_evt_listener {
 
 	/* internal count of reference to the listener */
 	uint16_t intcount;
+
+	/* delivery policy of pushed events */
+	uint8_t policy;
+
+	/* is a job draining the pending pushs? */
+	uint8_t draining;
+
+	/* bound of the count of pending pushs or 0 */
+	uint16_t bound;
+
+	/* count of pending pushs */
+	uint16_t npending;
+
+	/* count of pushs dropped or conflated */
+	unsigned dropped;
+
+	/* mutex protecting the pending pushs */
+	x_mutex_t mutex;
+
+	/* sequence number, incremented when notifying a watch or unwatch */
+	uint32_t seq;
+
+	/* pending pushs, in delivery order */
+	struct evt_pending *pendings, **ptail;
+
+	/* index of pending pushs by event id, allocated with the policy */
+	struct evt_pending **pindex;
 };
 
 /*
@@ -107,7 +152,7 @@ struct afb_evt {
 	struct afb_event_x2 x2;
 #endif
 
-	/* next event */
+	/* next event in the same bucket of the table of events */
 	struct afb_evt *next;
 
 	/* head of the list of listeners watching the event */
@@ -121,16 +166,34 @@ struct afb_evt {
 	unsigned hookflags;
 #endif
 
+	/* last value pushed when retaining */
+	struct evt_retained *retained;
+
 	/* refcount */
 	uint16_t refcount;
 
 	/* id of the event */
 	uint16_t id;
 
+	/* is the last value retained? */
+	uint8_t retain;
+
 	/* fullname of the event */
 	char fullname[];
 };
 
+/*
+ * Structure recording the last value pushed on events retaining it
+ */
+struct evt_retained {
+
+	/* count of parameters */
+	uint16_t nparams;
+
+	/* the parameters */
+	struct afb_data *params[];
+};
+
 /*
  * Structure for associating events and listeners
  */
@@ -142,13 +205,23 @@ struct afb_evt_watch {
 	/* link to the next watcher for the same evt */
 	struct afb_evt_watch *next_by_evt;
 
+	/* link pointing to this watcher for the same evt (NULL when detached) */
+	struct afb_evt_watch **prv_by_evt;
+
 	/* the listener */
 	struct afb_evt_listener *listener;
 
-	/* link to the next watcher for the same listener */
+	/* link to the next watcher in the same bucket of the listener */
 	struct afb_evt_watch *next_by_listener;
 };
 
+/* initial sizes of the hash tables, must be powers of 2 */
+#define EVENTS_INITIAL_SIZE 16
+#define WATCHS_INITIAL_SIZE 4
+
+/* maximal size of the hash tables (count of distinct ids) */
+#define MAXIMAL_SIZE 65536
+
 #if WITH_BINDINGS_V3
 /* the interface for events */
 static struct afb_event_x2_itf afb_evt_event_x2_itf;
@@ -158,9 +231,14 @@ static struct afb_event_x2_itf afb_evt_event_x2_itf;
 static x_rwlock_t listeners_rwlock = X_RWLOCK_INITIALIZER;
 static struct afb_evt_listener *listeners = NULL;
 
-/* handling id of events */
+/* policy of listeners of remote clients */
+static enum afb_evt_policy remote_policy = Afb_Evt_Policy_Unbounded;
+static uint16_t remote_bound = 0;
+
+/* handling id of events: hash table of events indexed by id */
 static x_rwlock_t events_rwlock = X_RWLOCK_INITIALIZER;
-static struct afb_evt *evt_list_head = NULL;
+static struct afb_evt **evt_table = NULL;
+static unsigned evt_table_size = 0;
 static uint16_t event_genid = 0;
 static uint16_t event_count = 0;
 
@@ -168,6 +246,8 @@ static uint16_t event_count = 0;
 /** MANAGE LISTENERS INTERNALY                                           **/
 /**************************************************************************/
 
+static void listener_drop_pendings(struct afb_evt_listener *listener);
+
 /*
  * Increases the internal reference count of 'listener'
  */
@@ -176,6 +256,54 @@ static void listener_internal_addref(struct afb_evt_listener *listener)
 	__atomic_add_fetch(&listener->intcount, 1, __ATOMIC_RELAXED);
 }
 
+/*
+ * Search in 'listener' the watch of 'evt' or, when 'evt' is NULL, of 'eventid'.
+ * Returns the link to the watch: it points to NULL if not found.
+ * Returns NULL if the listener has no table.
+ * Must be called with the listener's rwlock held.
+ */
+static struct afb_evt_watch **listener_search_watch(struct afb_evt_listener *listener, struct afb_evt *evt, uint16_t eventid)
+{
+	struct afb_evt_watch **prv, *watch;
+
+	if (listener->wsize == 0)
+		return NULL;
+	prv = &listener->watchs[eventid & (listener->wsize - 1)];
+	while ((watch = *prv) != NULL
+	    && (evt != NULL ? watch->evt != evt : watch->evt->id != eventid))
+		prv = &watch->next_by_listener;
+	return prv;
+}
+
+/*
+ * Doubles the size of the table of watchs of 'listener'
+ * The table is kept unchanged when memory is exhausted.
+ * Must be called with the listener's rwlock held for writing.
+ */
+static void listener_grow_watchs(struct afb_evt_listener *listener)
+{
+	unsigned size, idx, i;
+	struct afb_evt_watch **watchs, *watch, *next;
+
+	size = listener->wsize ? listener->wsize << 1 : WATCHS_INITIAL_SIZE;
+	if (size > MAXIMAL_SIZE)
+		return;
+	watchs = calloc(size, sizeof *watchs);
+	if (watchs == NULL)
+		return;
+	for (i = 0 ; i < listener->wsize ; i++) {
+		for (watch = listener->watchs[i] ; watch != NULL ; watch = next) {
+			next = watch->next_by_listener;
+			idx = watch->evt->id & (size - 1);
+			watch->next_by_listener = watchs[idx];
+			watchs[idx] = watch;
+		}
+	}
+	free(listener->watchs);
+	listener->watchs = watchs;
+	listener->wsize = size;
+}
+
 /*
  * Decreases the internal reference count of the 'listener' and destroys it
  * when no more used.
@@ -197,6 +325,10 @@ static void listener_internal_unref(struct afb_evt_listener *listener)
 			x_rwlock_unlock(&listeners_rwlock);
 
 			/* free the listener */
+			listener_drop_pendings(listener);
+			free(listener->pindex);
+			free(listener->watchs);
+			x_mutex_destroy(&listener->mutex);
 			x_rwlock_destroy(&listener->rwlock);
 			free(listener);
 			return;
@@ -335,6 +467,9 @@ static int broadcast(const char *event, unsigned nparams, struct afb_data * cons
 	struct job_evt_broadcast *jb;
 	int rc, rc2;
 
+#if WITH_AFB_REQ_CACHE
+	afb_req_cache_event(event);
+#endif
 	x_rwlock_rdlock(&listeners_rwlock);
 	listener = listeners;
 	if (listener == NULL) {
@@ -557,6 +692,311 @@ static void push_job(int signum, void *closure1, void *closure2)
 	job_evt_push_unref(je);
 }
 
+/*
+ * Structure recording a push pending for a listener
+ */
+struct evt_pending {
+
+	/* next pending push */
+	struct evt_pending *next;
+
+	/* next pending push of the same index head */
+	struct evt_pending *inext;
+
+	/* sequence number of the listener when queued */
+	uint32_t seq;
+
+	/* the pushed event */
+	struct job_evt_push *je;
+};
+
+/*
+ * Get the head of the index of the pending pushs of 'evt'
+ */
+static inline struct evt_pending **pending_head(struct afb_evt_listener *listener, struct afb_evt *evt)
+{
+	return &listener->pindex[evt->id & (EVT_PENDING_INDEX_COUNT - 1)];
+}
+
+/*
+ * Removes 'pending' from the index of 'listener'
+ */
+static void pending_unindex(struct afb_evt_listener *listener, struct evt_pending *pending)
+{
+	struct evt_pending **prv;
+
+	for (prv = pending_head(listener, pending->je->ev.evt) ; *prv != pending ; prv = &(*prv)->inext);
+	*prv = pending->inext;
+}
+
+/*
+ * Releases the pending pushs of 'listener'
+ */
+static void listener_drop_pendings(struct afb_evt_listener *listener)
+{
+	struct evt_pending *pending;
+
+	while ((pending = listener->pendings) != NULL) {
+		listener->pendings = pending->next;
+		job_evt_push_unref(pending->je);
+		free(pending);
+	}
+	listener->ptail = &listener->pendings;
+	listener->npending = 0;
+	if (listener->pindex != NULL)
+		memset(listener->pindex, 0, EVT_PENDING_INDEX_COUNT * sizeof *listener->pindex);
+}
+
+/*
+ * Increments the sequence number of the listener before posting a job
+ * that must not be overtaken by pushs queued after it
+ */
+static void listener_next_seq(struct afb_evt_listener *listener)
+{
+	if (listener->policy != Afb_Evt_Policy_Unbounded) {
+		x_mutex_lock(&listener->mutex);
+		listener->seq++;
+		x_mutex_unlock(&listener->mutex);
+	}
+}
+
+static void drain_job(int signum, void *closure1, void *closure2);
+
+/*
+ * Posts the job draining the pending pushs queued until now
+ * Returns 0 on success or a negative error code
+ */
+static int post_drain_job(struct afb_evt_listener *listener, uint32_t seq)
+{
+	return afb_sched_post_job2(listener->group, 0, 0, drain_job,
+			listener, (void*)(uintptr_t)seq, Afb_Sched_Mode_Normal);
+}
+
+/*
+ * Jobs callback delivering the pending pushs of the listener queued
+ * before the job was posted or since. The pushs queued after a job of
+ * the listener posted meanwhile, like the notification of a new watch,
+ * have a greater sequence number and are delivered by a drain job
+ * posted again, keeping their order relative to that job.
+ */
+static void drain_job(int signum, void *closure1, void *closure2)
+{
+	struct afb_evt_listener *listener = closure1;
+	uint32_t seq = (uint32_t)(uintptr_t)closure2;
+	struct evt_pending *batch, *pending, **ptail;
+	int count, again;
+
+	/* pick the pending pushs of the batch */
+	x_mutex_lock(&listener->mutex);
+	batch = listener->pendings;
+	for (ptail = &batch, count = 0 ;
+	     count < EVT_DRAIN_BATCH_MAX && (pending = *ptail) != NULL
+	      && (int32_t)(pending->seq - seq) <= 0 ;
+	     ptail = &pending->next, count++)
+		pending_unindex(listener, pending);
+	listener->pendings = *ptail;
+	*ptail = NULL;
+	if (listener->pendings == NULL)
+		listener->ptail = &listener->pendings;
+	listener->npending = (uint16_t)(listener->npending - count);
+	again = listener->pendings != NULL;
+	listener->draining = (uint8_t)again;
+	seq = listener->seq;
+	x_mutex_unlock(&listener->mutex);
+
+	/* deliver it */
+	while ((pending = batch) != NULL) {
+		batch = pending->next;
+		x_mutex_lock(&pending->je->mutex);
+		if (signum == 0)
+			listener->itf->push(listener->closure, &pending->je->ev);
+		x_mutex_unlock(&pending->je->mutex);
+		job_evt_push_unref(pending->je);
+		free(pending);
+	}
+
+	/* continue or stop */
+	if (again && post_drain_job(listener, seq) >= 0)
+		return;
+	if (again) {
+		RP_ERROR("Can't queue drain job of evt listener");
+		x_mutex_lock(&listener->mutex);
+		listener->draining = 0;
+		x_mutex_unlock(&listener->mutex);
+	}
+	listener_internal_unref(listener);
+}
+
+/*
+ * Records the push of 'je' as pending for 'listener' accordingly to
+ * its policy and ensure that a job is draining the pending pushs.
+ */
+static void queue_push(struct job_evt_push *je, struct afb_evt_listener *listener)
+{
+	struct evt_pending *pending, **head;
+	struct job_evt_push *dropje = NULL;
+	uint32_t seq;
+	int rc, post = 0;
+
+	x_mutex_lock(&listener->mutex);
+
+	/* conflation replaces the pending push of the same event */
+	head = pending_head(listener, je->ev.evt);
+	if (listener->policy == Afb_Evt_Policy_Conflate) {
+		for (pending = *head ; pending != NULL ; pending = pending->inext) {
+			if (pending->je->ev.evt == je->ev.evt) {
+				dropje = pending->je;
+				job_evt_push_addref(je);
+				pending->je = je;
+				listener->dropped++;
+				x_mutex_unlock(&listener->mutex);
+				job_evt_push_unref(dropje);
+				return;
+			}
+		}
+	}
+
+	/* append a new pending push */
+	pending = malloc(sizeof *pending);
+	if (pending == NULL) {
+		listener->dropped++;
+		x_mutex_unlock(&listener->mutex);
+		RP_ERROR("Can't queue push of evt %s", je->ev.data.name);
+		return;
+	}
+	job_evt_push_addref(je);
+	pending->je = je;
+	pending->seq = listener->seq;
+	pending->next = NULL;
+	*listener->ptail = pending;
+	listener->ptail = &pending->next;
+	pending->inext = *head;
+	*head = pending;
+
+	/* drop the oldest when above the bound */
+	if (listener->bound == 0 || listener->npending < listener->bound) {
+		listener->npending++;
+		pending = NULL;
+	}
+	else {
+		pending = listener->pendings;
+		listener->pendings = pending->next;
+		pending_unindex(listener, pending);
+		dropje = pending->je;
+		listener->dropped++;
+	}
+
+	/* start draining if needed */
+	if (!listener->draining) {
+		listener->draining = 1;
+		post = 1;
+	}
+	seq = listener->seq;
+	x_mutex_unlock(&listener->mutex);
+
+	if (pending != NULL) {
+		job_evt_push_unref(dropje);
+		free(pending);
+	}
+	if (post) {
+		listener_internal_addref(listener);
+		rc = post_drain_job(listener, seq);
+		if (rc < 0) {
+			/* retried on next push */
+			RP_ERROR("Can't queue drain job of evt listener");
+			x_mutex_lock(&listener->mutex);
+			listener->draining = 0;
+			x_mutex_unlock(&listener->mutex);
+			listener_internal_unref(listener);
+		}
+	}
+}
+
+/*
+ * Queues the job pushing 'je' to 'listener'
+ */
+static void post_push_job(struct job_evt_push *je, struct afb_evt_listener *listener)
+{
+	int rc;
+
+	if (listener->policy != Afb_Evt_Policy_Unbounded) {
+		queue_push(je, listener);
+		return;
+	}
+	job_evt_push_addref(je);
+	listener_internal_addref(listener);
+	rc = afb_sched_post_job2(listener->group, 0, 0,
+			push_job, je, listener, Afb_Sched_Mode_Normal);
+	if (rc < 0)
+		RP_ERROR("Can't queue push an evt job for %s", je->ev.data.name);
+}
+
+/*
+ * Releases the retained value 'retained'
+ */
+static void release_retained(struct evt_retained *retained)
+{
+	if (retained != NULL) {
+		afb_data_array_unref(retained->nparams, retained->params);
+		free(retained);
+	}
+}
+
+/*
+ * Creates a retainable copy of 'params' for 'evt'
+ */
+static struct evt_retained *make_retained(struct afb_evt *evt, unsigned nparams, struct afb_data * const params[])
+{
+	struct evt_retained *retained;
+
+	retained = malloc(sizeof *retained + nparams * sizeof retained->params[0]);
+	if (retained == NULL)
+		RP_ERROR("Can't retain the value of evt %s", evt->fullname);
+	else {
+		retained->nparams = (uint16_t)nparams;
+		afb_data_array_copy_addref(nparams, params, retained->params);
+	}
+	return retained;
+}
+
+/*
+ * Replaces the value retained by 'evt' with 'retained' and returns
+ * the value to release. On failure ('retained' == NULL), forgets the
+ * previous value that is no more the last one.
+ * Must be called with the write lock of 'evt' held
+ */
+static struct evt_retained *swap_retained_locked(struct afb_evt *evt, struct evt_retained *retained)
+{
+	struct evt_retained *previous;
+
+	if (!evt->retain)
+		return retained;
+	previous = evt->retained;
+	evt->retained = retained;
+	return previous;
+}
+
+/*
+ * Queues the push of the value retained by 'evt' to 'listener'
+ * Must be called with the lock of 'evt' held
+ */
+static void push_retained(struct afb_evt *evt, struct afb_evt_listener *listener)
+{
+	struct evt_retained *retained = evt->retained;
+	struct job_evt_push *je;
+
+	if (retained != NULL) {
+		afb_data_array_addref(retained->nparams, retained->params);
+		je = job_evt_push_create(evt, retained->nparams, retained->params);
+		if (je == NULL)
+			RP_ERROR("Can't create push evt job item for %s", evt->fullname);
+		else {
+			post_push_job(je, listener);
+			job_evt_push_unref(je);
+		}
+	}
+}
+
 /*
  * Pushes the event 'evt' with 'obj' to its listeners
  * 'obj' is released (like afb_dataset_unref)
@@ -567,9 +1007,23 @@ int afb_evt_push(struct afb_evt *evt, unsigned nparams, struct afb_data * const
 {
 	struct afb_evt_watch *watch;
 	struct job_evt_push *je;
-	int rc, rc2;
+	struct evt_retained *retained = NULL;
+	int rc;
 
-	x_rwlock_rdlock(&evt->rwlock);
+#if WITH_AFB_REQ_CACHE
+	afb_req_cache_event(evt->fullname);
+#endif
+	/*
+	 * the retained value and the listeners are handled under the same
+	 * lock so that a listener added concurrently receives the value once
+	 */
+	if (__atomic_load_n(&evt->retain, __ATOMIC_RELAXED)) {
+		retained = make_retained(evt, nparams, params);
+		x_rwlock_wrlock(&evt->rwlock);
+		retained = swap_retained_locked(evt, retained);
+	}
+	else
+		x_rwlock_rdlock(&evt->rwlock);
 	watch = evt->watchs;
 	if (watch == NULL) {
 		afb_data_array_unref(nparams, params);
@@ -585,18 +1039,14 @@ int afb_evt_push(struct afb_evt *evt, unsigned nparams, struct afb_data * const
 			x_mutex_lock(&je->mutex);
 			for (rc = 0; watch != NULL; watch = watch->next_by_evt) {
 				rc++;
-				job_evt_push_addref(je);
-				listener_internal_addref(watch->listener);
-				rc2 = afb_sched_post_job2(watch->listener->group, 0, 0,
-					       push_job, je, watch->listener, Afb_Sched_Mode_Normal);
-				if (rc2 < 0)
-					RP_ERROR("Can't queue push an evt job for %s", evt->fullname);
+				post_push_job(je, watch->listener);
 			}
 			x_mutex_unlock(&je->mutex);
 			job_evt_push_unref(je);
 		}
 	}
 	x_rwlock_unlock(&evt->rwlock);
+	release_retained(retained);
 	return rc;
 }
 
@@ -621,6 +1071,7 @@ static void do_watch(struct afb_evt_listener *listener, struct afb_evt *evt)
 	if (listener->itf->add != NULL) {
 		afb_evt_addref(evt);
 		listener_internal_addref(listener);
+		listener_next_seq(listener);
 		afb_sched_post_job2(listener->group, 0, 0, watch_job, listener, evt, Afb_Sched_Mode_Normal);
 	}
 }
@@ -642,23 +1093,19 @@ static void do_unwatch(struct afb_evt_listener *listener, struct afb_evt *evt)
 	if (listener->itf->remove != NULL) {
 		afb_evt_addref(evt);
 		listener_internal_addref(listener);
+		listener_next_seq(listener);
 		afb_sched_post_job2(listener->group, 0, 0, unwatch_job, listener, evt, Afb_Sched_Mode_Normal);
 	}
 }
 
 static void listener_unwatch(struct afb_evt_listener *listener, struct afb_evt *evt, struct afb_evt_watch *watch, int notify)
 {
-	struct afb_evt_watch **prv;
-
 	/* unlink the watch for its event */
 	x_rwlock_wrlock(&evt->rwlock);
-	prv = &evt->watchs;
-	while(*prv) {
-		if (*prv == watch) {
-			*prv = watch->next_by_evt;
-			break;
-		}
-		prv = &(*prv)->next_by_evt;
+	if (watch->prv_by_evt != NULL) {
+		*watch->prv_by_evt = watch->next_by_evt;
+		if (watch->next_by_evt != NULL)
+			watch->next_by_evt->prv_by_evt = watch->prv_by_evt;
 	}
 	x_rwlock_unlock(&evt->rwlock);
 
@@ -691,6 +1138,7 @@ static void evt_finalize_destroy(struct afb_evt *evt, struct afb_evt_watch *watc
 {
 	if (watch == NULL) {
 		/* free */
+		release_retained(evt->retained);
 		x_rwlock_destroy(&evt->rwlock);
 		free(evt);
 	}
@@ -700,13 +1148,10 @@ static void evt_finalize_destroy(struct afb_evt *evt, struct afb_evt_watch *watc
 
 		/* unlink the watch for the event in the listener */
 		x_rwlock_wrlock(&listener->rwlock);
-		prv = &listener->watchs;
-		while(*prv) {
-			if (*prv == watch) {
-				*prv = watch->next_by_listener;
-				break;
-			}
-			prv = &(*prv)->next_by_listener;
+		prv = listener_search_watch(listener, evt, evt->id);
+		if (prv != NULL && *prv == watch) {
+			*prv = watch->next_by_listener;
+			listener->wcount--;
 		}
 		x_rwlock_unlock(&listener->rwlock);
 
@@ -733,13 +1178,43 @@ static void evt_finalize_destroy(struct afb_evt *evt, struct afb_evt_watch *watc
 /** MANAGE EVENTS                                                        **/
 /**************************************************************************/
 
+/*
+ * Doubles the size of the table of events
+ * The table is kept unchanged when memory is exhausted.
+ * Must be called with events_rwlock held for writing.
+ */
+static void grow_evt_table()
+{
+	unsigned size, idx, i;
+	struct afb_evt **table, *evt, *next;
+
+	size = evt_table_size ? evt_table_size << 1 : EVENTS_INITIAL_SIZE;
+	if (size > MAXIMAL_SIZE)
+		return;
+	table = calloc(size, sizeof *table);
+	if (table == NULL)
+		return;
+	for (i = 0 ; i < evt_table_size ; i++) {
+		for (evt = evt_table[i] ; evt != NULL ; evt = next) {
+			next = evt->next;
+			idx = evt->id & (size - 1);
+			evt->next = table[idx];
+			table[idx] = evt;
+		}
+	}
+	free(evt_table);
+	evt_table = table;
+	evt_table_size = size;
+}
+
 /*
  * Creates an event of name 'fullname'
  */
 static int create_evt(struct afb_evt **evt, const char *fullname, size_t len)
 {
-	struct afb_evt *nevt, *oevt;
+	struct afb_evt *nevt, *oevt, **prv;
 	uint16_t id;
+	unsigned steps;
 
 	/* allocates the event */
 	nevt = malloc(len + 1 + sizeof * nevt);
@@ -751,6 +1226,8 @@ static int create_evt(struct afb_evt **evt, const char *fullname, size_t len)
 	memcpy(nevt->fullname, fullname, len + 1);
 	nevt->refcount = 1;
 	nevt->watchs = NULL;
+	nevt->retained = NULL;
+	nevt->retain = 0;
 #if WITH_BINDINGS_V3
 	nevt->x2.itf = NULL;
 #endif
@@ -769,21 +1246,39 @@ static int create_evt(struct afb_evt **evt, const char *fullname, size_t len)
 		*evt = NULL;
 		return X_ECANCELED;
 	}
+	if (event_count >= evt_table_size)
+		grow_evt_table();
+	if (evt_table_size == 0) {
+		x_rwlock_unlock(&events_rwlock);
+		x_rwlock_destroy(&nevt->rwlock);
+		free(nevt);
+		*evt = NULL;
+		return X_ENOMEM;
+	}
+	/*
+	 * The ids are the UINT16_MAX values from 1 to UINT16_MAX. The check
+	 * above ensures that, before counting the new event, less than
+	 * UINT16_MAX of them are used. So the search below finds a free id
+	 * in at most UINT16_MAX steps.
+	 */
+	assert(event_count < UINT16_MAX);
 	event_count++;
+	steps = 0;
 	do {
-		/* TODO add a guard (counting number of event created) */
+		assert(steps++ < UINT16_MAX);
 		id = ++event_genid;
 		if (!id)
 			id = event_genid = 1;
-		oevt = evt_list_head;
+		oevt = evt_table[id & (evt_table_size - 1)];
 		while(oevt != NULL && oevt->id != id)
 			oevt = oevt->next;
 	} while (oevt != NULL);
 
 	/* initialize the event */
-	nevt->next = evt_list_head;
+	prv = &evt_table[id & (evt_table_size - 1)];
+	nevt->next = *prv;
 	nevt->id = id;
-	evt_list_head = nevt;
+	*prv = nevt;
 	x_rwlock_unlock(&events_rwlock);
 
 	/* returns the event */
@@ -839,12 +1334,12 @@ struct afb_evt *afb_evt_addref(struct afb_evt *evt)
 void afb_evt_unref(struct afb_evt *evt)
 {
 	struct afb_evt **prv, *oev;
-	struct afb_evt_watch *watch;
+	struct afb_evt_watch *watch, *oew;
 
 	if (!__atomic_sub_fetch(&evt->refcount, 1, __ATOMIC_RELAXED)) {
 		/* unlinks the event if valid! */
 		x_rwlock_wrlock(&events_rwlock);
-		prv = &evt_list_head;
+		prv = &evt_table[evt->id & (evt_table_size - 1)];
 		for(;;) {
 			oev = *prv;
 			if (oev == evt)
@@ -864,6 +1359,8 @@ void afb_evt_unref(struct afb_evt *evt)
 		x_rwlock_wrlock(&evt->rwlock);
 		watch = evt->watchs;
 		evt->watchs = NULL;
+		for (oew = watch ; oew != NULL ; oew = oew->next_by_evt)
+			oew->prv_by_evt = NULL;
 		x_rwlock_unlock(&evt->rwlock);
 		evt_finalize_destroy(evt, watch);
 	}
@@ -894,6 +1391,61 @@ uint16_t afb_evt_id(struct afb_evt *evt)
 	return evt->id;
 }
 
+/*
+ * Set whether the event 'evt' retains the value of its last push.
+ * The retained value is pushed to new listeners when they are added.
+ * Stopping to retain releases the retained value.
+ */
+void afb_evt_set_retain(struct afb_evt *evt, int retain)
+{
+	struct evt_retained *retained;
+
+	x_rwlock_wrlock(&evt->rwlock);
+	__atomic_store_n(&evt->retain, retain != 0, __ATOMIC_RELAXED);
+	if (retain)
+		retained = NULL;
+	else {
+		retained = evt->retained;
+		evt->retained = NULL;
+	}
+	x_rwlock_unlock(&evt->rwlock);
+	release_retained(retained);
+}
+
+/*
+ * Returns whether the event 'evt' retains the value of its last push
+ */
+int afb_evt_is_retaining(struct afb_evt *evt)
+{
+	return __atomic_load_n(&evt->retain, __ATOMIC_RELAXED);
+}
+
+/*
+ * Calls 'fun' with 'closure' and the value retained by 'evt' if any.
+ * The call is made with the lock of 'evt' held, so 'fun' must not use
+ * 'evt' but can hold the given data by adding a reference to them.
+ * Returns 1 if 'fun' was called or 0 if no value is retained.
+ */
+int afb_evt_retained_apply(
+	struct afb_evt *evt,
+	void (*fun)(void *closure, unsigned nparams, struct afb_data * const params[]),
+	void *closure
+) {
+	struct evt_retained *retained;
+	int rc;
+
+	x_rwlock_rdlock(&evt->rwlock);
+	retained = evt->retained;
+	if (retained == NULL)
+		rc = 0;
+	else {
+		fun(closure, retained->nparams, retained->params);
+		rc = 1;
+	}
+	x_rwlock_unlock(&evt->rwlock);
+	return rc;
+}
+
 /****************************************************************/
 #if !WITH_AFB_HOOK
 /****************************************************************/
@@ -1049,8 +1601,12 @@ struct afb_evt_listener *afb_evt_listener_create(const struct afb_evt_itf *itf,
 		listener->closure = closure;
 		listener->group = group;
 		listener->watchs = NULL;
+		listener->wsize = 0;
+		listener->wcount = 0;
 		listener->extcount = 1;
 		listener->intcount = 1;
+		listener->ptail = &listener->pendings;
+		x_mutex_init(&listener->mutex);
 		x_rwlock_init(&listener->rwlock);
 		listener->next = listeners;
 		listeners = listener;
@@ -1081,14 +1637,104 @@ void afb_evt_listener_unref(struct afb_evt_listener *listener)
 	}
 }
 
+/*
+ * Set the delivery 'policy' of the events pushed to 'listener'.
+ * With the policy Afb_Evt_Policy_Unbounded, each push is delivered
+ * by its own job. Otherwise, the pushs are pending in the listener
+ * and delivered one after the other. When 'bound' isn't zero, the
+ * oldest pending push is dropped when more than 'bound' pushs are
+ * pending. With Afb_Evt_Policy_Conflate, a push replaces the pending
+ * push of the same event.
+ * The policy should be set before watching events.
+ * Returns 0 on success, X_EINVAL if the bound is missing or too big
+ * or X_ENOMEM if the index of pending pushs can't be allocated.
+ */
+int afb_evt_listener_set_policy(struct afb_evt_listener *listener, enum afb_evt_policy policy, unsigned bound)
+{
+	struct evt_pending **pindex = NULL;
+
+	switch (policy) {
+	case Afb_Evt_Policy_Unbounded:
+		bound = 0;
+		break;
+	case Afb_Evt_Policy_Drop_Oldest:
+		if (bound == 0)
+			return X_EINVAL;
+		break;
+	case Afb_Evt_Policy_Conflate:
+		break;
+	default:
+		return X_EINVAL;
+	}
+	if (bound > UINT16_MAX)
+		return X_EINVAL;
+
+	/* pending pushs are indexed by event id */
+	if (policy != Afb_Evt_Policy_Unbounded && listener->pindex == NULL) {
+		pindex = calloc(EVT_PENDING_INDEX_COUNT, sizeof *pindex);
+		if (pindex == NULL)
+			return X_ENOMEM;
+	}
+
+	x_mutex_lock(&listener->mutex);
+	if (pindex != NULL && listener->pindex == NULL) {
+		listener->pindex = pindex;
+		pindex = NULL;
+	}
+	listener->policy = (uint8_t)policy;
+	listener->bound = (uint16_t)bound;
+	x_mutex_unlock(&listener->mutex);
+	free(pindex);
+	return 0;
+}
+
+/*
+ * Returns the count of pushs that were not delivered to 'listener'
+ * because of its delivery policy
+ */
+unsigned afb_evt_listener_dropped(struct afb_evt_listener *listener)
+{
+	return __atomic_load_n(&listener->dropped, __ATOMIC_RELAXED);
+}
+
+/*
+ * Set the delivery 'policy' and its 'bound' for listeners of remote
+ * clients. See afb_evt_listener_set_policy.
+ * Returns 0 on success or X_EINVAL if the bound is missing or too big.
+ */
+int afb_evt_set_remote_policy(enum afb_evt_policy policy, unsigned bound)
+{
+	if (policy == Afb_Evt_Policy_Unbounded)
+		bound = 0;
+	else if ((policy != Afb_Evt_Policy_Drop_Oldest && policy != Afb_Evt_Policy_Conflate)
+			|| (policy == Afb_Evt_Policy_Drop_Oldest && bound == 0)
+			|| bound > UINT16_MAX)
+		return X_EINVAL;
+	remote_policy = policy;
+	remote_bound = (uint16_t)bound;
+	return 0;
+}
+
+/*
+ * Set the delivery policy of the 'listener' of a remote client
+ * to the one set by afb_evt_set_remote_policy
+ */
+void afb_evt_listener_set_remote_policy(struct afb_evt_listener *listener)
+{
+	afb_evt_listener_set_policy(listener, remote_policy, remote_bound);
+}
+
 /*
  * Makes the 'listener' watching 'evt'
  * Dont call the listener 'add' callback if 'notify' == 0.
+ * When 'notify' != 0, the value retained by 'evt', if any, is pushed
+ * to the listener after the call to 'add'. Otherwise, the caller can
+ * get it using 'afb_evt_retained_apply'.
  * Returns 0 if already existing, 1 if added or else X_ENOMEM.
  */
 int afb_evt_listener_add(struct afb_evt_listener *listener, struct afb_evt *evt, int notify)
 {
-	struct afb_evt_watch *watch;
+	struct afb_evt_watch *watch, **prv;
 
 	/* check parameter */
 	if (listener->itf->push == NULL)
@@ -1096,13 +1742,16 @@ int afb_evt_listener_add(struct afb_evt_listener *listener, struct afb_evt *evt,
 
 	/* search the existing watch for the listener */
 	x_rwlock_wrlock(&listener->rwlock);
-	watch = listener->watchs;
-	while(watch != NULL) {
-		if (watch->evt == evt) {
-			x_rwlock_unlock(&listener->rwlock);
-			return 0;
-		}
-		watch = watch->next_by_listener;
+	if (listener->wcount >= listener->wsize)
+		listener_grow_watchs(listener);
+	prv = listener_search_watch(listener, evt, evt->id);
+	if (prv == NULL) {
+		x_rwlock_unlock(&listener->rwlock);
+		return X_ENOMEM;
+	}
+	if (*prv != NULL) {
+		x_rwlock_unlock(&listener->rwlock);
+		return 0;
 	}
 
 	/* not found, allocate a new */
@@ -1115,16 +1764,26 @@ int afb_evt_listener_add(struct afb_evt_listener *listener, struct afb_evt *evt,
 	/* initialise and link */
 	watch->evt = evt;
 	watch->listener = listener;
-	watch->next_by_listener = listener->watchs;
-	listener->watchs = watch;
+	watch->next_by_listener = NULL;
+	*prv = watch;
+	listener->wcount++;
+
+	/* the job calling 'add' is queued before the watch is visible to
+	 * pushers, so it precedes any push, without holding the lock of evt */
+	if (notify)
+		do_watch(listener, evt);
+
 	x_rwlock_wrlock(&evt->rwlock);
 	watch->next_by_evt = evt->watchs;
+	if (watch->next_by_evt != NULL)
+		watch->next_by_evt->prv_by_evt = &watch->next_by_evt;
+	watch->prv_by_evt = &evt->watchs;
 	evt->watchs = watch;
+	/* queued under lock for being before any later push */
+	if (notify)
+		push_retained(evt, listener);
 	x_rwlock_unlock(&evt->rwlock);
 	x_rwlock_unlock(&listener->rwlock);
-
-	if (notify)
-		do_watch(listener, evt);
 	return 1;
 }
 
@@ -1145,26 +1804,19 @@ int afb_evt_listener_watch_evt(struct afb_evt_listener *listener, struct afb_evt
 int afb_evt_listener_remove(struct afb_evt_listener *listener, struct afb_evt *evt, uint16_t eventid, int notify)
 {
 	struct afb_evt_watch *watch, **pwatch;
-	struct afb_evt *wev;
 
 	/* search the existing watch */
 	x_rwlock_wrlock(&listener->rwlock);
-	pwatch = &listener->watchs;
-	for (;;) {
-		watch = *pwatch;
-		if (!watch) {
-			x_rwlock_unlock(&listener->rwlock);
-			return 0;
-		}
-		wev = watch->evt;
-		if (evt != NULL ? (evt == wev) : (wev->id == eventid)) {
-			*pwatch = watch->next_by_listener;
-			x_rwlock_unlock(&listener->rwlock);
-			listener_unwatch(listener, wev, watch, notify);
-			return 1;
-		}
-		pwatch = &watch->next_by_listener;
+	pwatch = listener_search_watch(listener, evt, evt != NULL ? evt->id : eventid);
+	if (pwatch == NULL || (watch = *pwatch) == NULL) {
+		x_rwlock_unlock(&listener->rwlock);
+		return 0;
 	}
+	*pwatch = watch->next_by_listener;
+	listener->wcount--;
+	x_rwlock_unlock(&listener->rwlock);
+	listener_unwatch(listener, watch->evt, watch, notify);
+	return 1;
 }
 
 /*
@@ -1191,18 +1843,24 @@ int afb_evt_listener_unwatch_id(struct afb_evt_listener *listener, uint16_t even
  */
 void afb_evt_listener_unwatch_all(struct afb_evt_listener *listener, int notify)
 {
-	struct afb_evt_watch *watch, *nwatch;
+	struct afb_evt_watch **watchs, *watch, *nwatch;
+	unsigned i, size;
 
-	/* search the existing watch */
+	/* detach the existing watchs */
 	x_rwlock_wrlock(&listener->rwlock);
-	watch = listener->watchs;
+	watchs = listener->watchs;
+	size = listener->wsize;
 	listener->watchs = NULL;
+	listener->wsize = 0;
+	listener->wcount = 0;
 	x_rwlock_unlock(&listener->rwlock);
-	while(watch) {
-		nwatch = watch->next_by_listener;
-		listener_unwatch(listener, watch->evt, watch, notify);
-		watch = nwatch;
+	for (i = 0 ; i < size ; i++) {
+		for (watch = watchs[i] ; watch != NULL ; watch = nwatch) {
+			nwatch = watch->next_by_listener;
+			listener_unwatch(listener, watch->evt, watch, notify);
+		}
 	}
+	free(watchs);
 }
 
 #if WITH_BINDINGS_V3
@@ -1277,10 +1935,12 @@ inline struct afb_event_x2 *afb_evt_make_x2(struct afb_evt *evt)
 void afb_evt_update_hooks()
 {
 	struct afb_evt *evt;
+	unsigned i;
 
 	x_rwlock_rdlock(&events_rwlock);
-	for (evt = evt_list_head ; evt ; evt = evt->next)
-		evt->hookflags = afb_hook_flags_evt(evt->fullname);
+	for (i = 0 ; i < evt_table_size ; i++)
+		for (evt = evt_table[i] ; evt ; evt = evt->next)
+			evt->hookflags = afb_hook_flags_evt(evt->fullname);
 	x_rwlock_unlock(&events_rwlock);
 }
 #endif
@@ -72,10 +72,30 @@ struct afb_evt_itf
 	void (*remove)(void *closure, const char *event, uint16_t evtid);
 };
 
+/**
+ * Delivery policies of pushed events to listeners
+ */
+enum afb_evt_policy
+{
+	/** each push is delivered */
+	Afb_Evt_Policy_Unbounded,
+
+	/** the oldest pending pushs are dropped above a bound */
+	Afb_Evt_Policy_Drop_Oldest,
+
+	/** only the latest pending push of each event is kept */
+	Afb_Evt_Policy_Conflate
+};
+
 extern struct afb_evt_listener *afb_evt_listener_create(const struct afb_evt_itf *itf, void *closure, void *group);
 extern struct afb_evt_listener *afb_evt_listener_addref(struct afb_evt_listener *listener);
 extern void afb_evt_listener_unref(struct afb_evt_listener *listener);
 
+extern int afb_evt_listener_set_policy(struct afb_evt_listener *listener, enum afb_evt_policy policy, unsigned bound);
+extern unsigned afb_evt_listener_dropped(struct afb_evt_listener *listener);
+extern int afb_evt_set_remote_policy(enum afb_evt_policy policy, unsigned bound);
+extern void afb_evt_listener_set_remote_policy(struct afb_evt_listener *listener);
+
 extern int afb_evt_listener_add(struct afb_evt_listener *listener, struct afb_evt *evt, int notify);
 extern int afb_evt_listener_remove(struct afb_evt_listener *listener, struct afb_evt *evt, uint16_t eventid, int notify);
 extern int afb_evt_listener_watch_evt(struct afb_evt_listener *listener, struct afb_evt *evt);
@@ -94,6 +114,9 @@ extern const char *afb_evt_fullname(struct afb_evt *evt);
 extern const char *afb_evt_name(struct afb_evt *evt);
 
 extern int afb_evt_push(struct afb_evt *evt, unsigned nparams, struct afb_data * const params[]);
+extern void afb_evt_set_retain(struct afb_evt *evt, int retain);
+extern int afb_evt_is_retaining(struct afb_evt *evt);
+extern int afb_evt_retained_apply(struct afb_evt *evt, void (*fun)(void *closure, unsigned nparams, struct afb_data * const params[]), void *closure);
 extern int afb_evt_broadcast(struct afb_evt *evt, unsigned nparams, struct afb_data * const params[]);
 
 extern int afb_evt_broadcast_name_hookable(const char *event, unsigned nparams, struct afb_data * const params[]);
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "../libafb-config.h"
+
+#if WITH_SCHED_FIBERS
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include "core/afb-fibers.h"
+#include "core/afb-jobs.h"
+#include "core/afb-sig-monitor.h"
+
+#include "sys/x-mutex.h"
+#include "sys/x-thread.h"
+#include "sys/x-errno.h"
+
+#include "core/afb-threads.h"
+
+/* default size of the stacks */
+#ifndef AFB_FIBERS_STACK_SIZE
+#  define AFB_FIBERS_STACK_SIZE	(1024 * 1024)
+#endif
+
+/* maximum count of unused fibers kept for reuse */
+#ifndef AFB_FIBERS_POOL_MAX
+#  define AFB_FIBERS_POOL_MAX	64
+#endif
+
+/* count of pools of unused fibers, one per NUMA node */
+#ifndef AFB_FIBERS_NODES_MAX
+#  define AFB_FIBERS_NODES_MAX	8
+#endif
+
+/**
+ * Description of a fiber
+ */
+struct afb_fiber
+{
+	/** next unused fiber */
+	struct afb_fiber *next;
+
+	/** the function of the fiber, NULL when terminated */
+	void (*function)(void *arg);
+
+	/** the argument of the function */
+	void *arg;
+
+	/** function receiving the suspended fiber */
+	void (*parked)(struct afb_fiber *fiber, void *closure);
+
+	/** closure of the parked function */
+	void *closure;
+
+	/** saved recovery context of signal monitoring */
+	void *recovery;
+
+	/** saved current job */
+	struct afb_job *job;
+
+	/** size of the allocated area of the stack */
+	size_t size;
+
+	/** pool of the fiber, the NUMA node where its stack was first used */
+	unsigned node;
+
+	/** context of the fiber */
+	ucontext_t context;
+
+	/** context of the thread that started or resumed the fiber */
+	ucontext_t back;
+};
+
+/* size of stacks */
+static size_t stack_size = AFB_FIBERS_STACK_SIZE;
+
+/* unused fibers by NUMA node, stacks being kept near the CPUs using them */
+static struct afb_fiber *pool[AFB_FIBERS_NODES_MAX];
+static unsigned pool_count;
+static x_mutex_t pool_mutex = X_MUTEX_INITIALIZER;
+
+/* the current fiber */
+X_TLS(struct afb_fiber,fiber)
+
+/* setup of fibers */
+int afb_fibers_setup(size_t stacksize)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+	size_t mask = (size_t)(pagesize > 0 ? pagesize : 4096) - 1;
+
+	stacksize = stacksize ? stacksize : AFB_FIBERS_STACK_SIZE;
+	stack_size = (stacksize + mask) & ~mask;
+	return 0;
+}
+
+/* release the fiber */
+static void release(struct afb_fiber *fiber)
+{
+	x_mutex_lock(&pool_mutex);
+	if (pool_count < AFB_FIBERS_POOL_MAX && fiber->size == stack_size + sizeof *fiber) {
+		fiber->next = pool[fiber->node];
+		pool[fiber->node] = fiber;
+		pool_count++;
+		fiber = NULL;
+	}
+	x_mutex_unlock(&pool_mutex);
+	if (fiber != NULL)
+		munmap((char*)&fiber[1] - fiber->size, fiber->size);
+}
+
+/* get an unused fiber */
+static struct afb_fiber *get()
+{
+	struct afb_fiber *fiber;
+	size_t size;
+	char *area;
+	unsigned node = (unsigned)afb_threads_numa_node() % AFB_FIBERS_NODES_MAX;
+
+	/* get one from the pool of the node */
+	x_mutex_lock(&pool_mutex);
+	fiber = pool[node];
+	if (fiber != NULL) {
+		pool[node] = fiber->next;
+		pool_count--;
+	}
+	x_mutex_unlock(&pool_mutex);
+	if (fiber != NULL)
+		return fiber;
+
+	/* allocate the stack and the fiber at its top, the lowest page being a guard */
+	size = stack_size + sizeof *fiber;
+	area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if (area == MAP_FAILED)
+		return NULL;
+	mprotect(area, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+	fiber = (struct afb_fiber*)&area[stack_size];
+	fiber->size = size;
+	fiber->node = node;
+	return fiber;
+}
+
+/* entry of fibers */
+static void entry()
+{
+	struct afb_fiber *fiber = x_tls_get_fiber();
+
+	fiber->function(fiber->arg);
+	fiber->function = NULL;
+	setcontext(&fiber->back);
+}
+
+/* switch to the fiber until it terminates or suspends */
+static void enter(struct afb_fiber *fiber)
+{
+	struct afb_fiber *previous;
+	void (*parked)(struct afb_fiber *fiber, void *closure);
+	void *recovery;
+#if WITH_TRACK_JOB_CALL
+	struct afb_job *job;
+#endif
+
+	/* switch the thread context to the fiber */
+	previous = x_tls_get_fiber();
+	x_tls_set_fiber(fiber);
+	recovery = afb_sig_monitor_switch(fiber->recovery);
+#if WITH_TRACK_JOB_CALL
+	job = afb_jobs_switch_current(fiber->job);
+#endif
+
+	swapcontext(&fiber->back, &fiber->context);
+
+	/* restore the thread context */
+#if WITH_TRACK_JOB_CALL
+	fiber->job = afb_jobs_switch_current(job);
+#endif
+	fiber->recovery = afb_sig_monitor_switch(recovery);
+	x_tls_set_fiber(previous);
+
+	/* terminated or suspended */
+	if (fiber->function == NULL)
+		release(fiber);
+	else {
+		parked = fiber->parked;
+		fiber->parked = NULL;
+		parked(fiber, fiber->closure);
+	}
+}
+
+/* start a fiber */
+int afb_fiber_start(void (*function)(void *arg), void *arg)
+{
+	struct afb_fiber *fiber;
+
+	fiber = get();
+	if (fiber == NULL)
+		return X_ENOMEM;
+
+	fiber->function = function;
+	fiber->arg = arg;
+	fiber->parked = NULL;
+	fiber->recovery = NULL;
+	fiber->job = NULL;
+	getcontext(&fiber->context);
+	fiber->context.uc_stack.ss_sp = (char*)&fiber[1] - fiber->size;
+	fiber->context.uc_stack.ss_size = stack_size;
+	fiber->context.uc_link = NULL;
+	makecontext(&fiber->context, entry, 0);
+	enter(fiber);
+	return 0;
+}
+
+/* get the current fiber */
+struct afb_fiber *afb_fiber_current(void)
+{
+	return x_tls_get_fiber();
+}
+
+/* suspend the current fiber */
+void afb_fiber_suspend(void (*parked)(struct afb_fiber *fiber, void *closure), void *closure)
+{
+	struct afb_fiber *fiber = x_tls_get_fiber();
+
+	fiber->parked = parked;
+	fiber->closure = closure;
+	swapcontext(&fiber->context, &fiber->back);
+}
+
+/* resume the fiber */
+void afb_fiber_resume(struct afb_fiber *fiber)
+{
+	enter(fiber);
+}
+
+#endif
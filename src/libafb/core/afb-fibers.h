@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#if WITH_SCHED_FIBERS
+
+#include <stddef.h>
+
+/**
+ * This module implements fibers: functions running on their own
+ * stack that can suspend their execution and be resumed later,
+ * possibly by an other thread.
+ *
+ * A fiber is started with 'afb_fiber_start'. It runs until it
+ * returns or until it calls 'afb_fiber_suspend'. In both cases,
+ * the execution continues in the caller of 'afb_fiber_start'
+ * or of 'afb_fiber_resume'.
+ *
+ * When suspending, the fiber gives a function that is called
+ * by the thread that started or resumed the fiber, after the
+ * context of the fiber is saved. That function is in charge of
+ * recording the fiber for its later resumption.
+ *
+ * The recovery context of signal monitoring and the tracking of
+ * jobs are saved and restored with the fiber. Because a fiber can
+ * be resumed by an other thread, code running in fibers must not
+ * keep pointers to thread local data across suspensions.
+ */
+
+struct afb_fiber;
+
+/**
+ * Setup the fibers
+ *
+ * @param stacksize size of the stacks of fibers, 0 for default
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_fibers_setup(size_t stacksize);
+
+/**
+ * Run the function in a new fiber. The function returns when
+ * the fiber terminates or when it suspends.
+ *
+ * @param function the function to run in the fiber
+ * @param arg the argument to give to the function
+ *
+ * @return 0 on success or X_ENOMEM if the fiber can not be created
+ */
+extern int afb_fiber_start(void (*function)(void *arg), void *arg);
+
+/**
+ * Get the fiber currently running
+ *
+ * @return the current fiber or NULL if not in a fiber
+ */
+extern struct afb_fiber *afb_fiber_current(void);
+
+/**
+ * Suspend the current fiber. The function 'parked' is called with
+ * the suspended fiber and 'closure' by the thread that started or
+ * resumed the fiber. The fiber is continued by calling 'afb_fiber_resume'.
+ *
+ * Must be called from a fiber.
+ *
+ * @param parked the function receiving the suspended fiber
+ * @param closure closure of the function
+ */
+extern void afb_fiber_suspend(void (*parked)(struct afb_fiber *fiber, void *closure), void *closure);
+
+/**
+ * Resume the suspended fiber. The function returns when
+ * the fiber terminates or when it suspends again.
+ *
+ * @param fiber the fiber to resume
+ */
+extern void afb_fiber_resume(struct afb_fiber *fiber);
+
+#endif
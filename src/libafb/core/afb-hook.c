@@ -56,6 +56,8 @@
 #include "sys/x-uio.h"
 #include "sys/x-mutex.h"
 #include "sys/x-rwlock.h"
+#include "sys/x-thread.h"
+#include "sys/x-errno.h"
 
 #define MATCHNAME(pattern,string)  !fnmatch(pattern,string,NAME_FOLD_FNM|FNM_EXTMATCH|FNM_PERIOD)
 #define MATCHVALUE(pattern,string) !fnmatch(pattern,string,FNM_EXTMATCH|FNM_PERIOD)
@@ -75,6 +77,7 @@
 struct afb_hook_req {
 	struct afb_hook_req *next; /**< next hook */
 	unsigned refcount; /**< reference count */
+	unsigned snaprefs; /**< count of snapshots referencing the hook */
 	unsigned flags; /**< hook flags */
 	char *api; /**< api hooked or NULL for any */
 	char *verb; /**< verb hooked or NULL for any */
@@ -130,13 +133,65 @@ struct afb_hook_global {
 	void *closure; /**< closure for callbacks */
 };
 
+/**
+ * Count of hooks for req whose matching is recorded in the mask
+ * of the request. The matching of the following hooks, if any,
+ * is evaluated at each hook call.
+ */
+#define AFB_HOOK_REQ_MASK_BITS 64
+
+/**
+ * Immutable snapshot of the hooks for req
+ */
+struct afb_hook_reqs {
+	unsigned refcount; /**< reference count */
+	unsigned count; /**< count of hooks */
+	struct afb_hook_req *hooks[]; /**< the hooks */
+};
+
 /* synchronization across threads */
 static x_rwlock_t rwlock = X_RWLOCK_INITIALIZER;
 static x_mutex_t mutex = X_MUTEX_INITIALIZER;
 
-/* list of hooks for req */
+/* list of hooks for req, modified under mutex */
 static struct afb_hook_req *list_of_req_hooks = NULL;
 
+/* count of stripes of the counters of readers, a power of 2 */
+#if !defined(AFB_HOOK_READERS_STRIPES)
+#  define AFB_HOOK_READERS_STRIPES 16
+#endif
+
+/**
+ * Generation of the snapshot of hooks for req. Readers are counted in
+ * the generation that is current when they read its snapshot. When a
+ * new generation is published, the snapshot of the previous one is
+ * retired and released by the last of its readers. Generations are
+ * never freed: they are reused once their snapshot is released.
+ */
+struct afb_hook_req_gen {
+	struct afb_hook_req_gen *next; /**< next generation */
+	struct afb_hook_reqs *hooks; /**< the snapshot or NULL when none */
+	unsigned retired; /**< is the snapshot waiting end of its readers? */
+	/** count of readers, striped by thread for keeping readers
+	 * of distinct threads on distinct cache lines */
+	struct {
+		unsigned count;
+		char pad[64 - sizeof(unsigned)];
+	} readers[AFB_HOOK_READERS_STRIPES];
+};
+
+/* first generation, head of the list of generations */
+static struct afb_hook_req_gen first_req_gen;
+
+/* current generation of the snapshot of hooks for req */
+static struct afb_hook_req_gen *current_req_gen = &first_req_gen;
+
+/* count of threads that got a stripe */
+static unsigned readers_threads = 0;
+
+/* stripe of the thread plus one */
+X_TLS(void,readers_stripe)
+
 /* list of hooks for comapi */
 static struct afb_hook_api *list_of_api_hooks = NULL;
 
@@ -463,24 +518,33 @@ static struct afb_hook_req_itf hook_req_default_itf = {
  * section: hooks for tracing requests
  *****************************************************************************/
 
+/* check if the hook applies to the request */
+static int req_hook_match(const struct afb_hook_req *hook, const struct afb_req_common *req)
+{
+	return (!hook->session || hook->session == req->session)
+		&& MATCH_API(hook->api, req->apiname)
+		&& MATCH_VERB(hook->verb, req->verbname);
+}
+
 #define _HOOK_XREQ_2_(flag,func,...)   \
 	struct afb_hook_req *hook; \
 	struct afb_hookid hookid; \
-	x_rwlock_rdlock(&rwlock); \
-	init_hookid(&hookid); \
-	hook = list_of_req_hooks; \
-	while (hook) { \
-		if (hook->refcount \
+	const struct afb_hook_reqs *hooks = req->hooks; \
+	unsigned idx, count = hooks ? hooks->count : 0; \
+	int idset = 0; \
+	for (idx = 0 ; idx < count ; idx++) { \
+		hook = hooks->hooks[idx]; \
+		if ((idx < AFB_HOOK_REQ_MASK_BITS ? (req->hookmask >> idx) & 1 : req_hook_match(hook, req)) \
+		 && __atomic_load_n(&hook->refcount, __ATOMIC_RELAXED) \
 		 && hook->itf->hook_req_##func \
-		 && (hook->flags & afb_hook_flag_req_##flag) != 0 \
-		 && (!hook->session || hook->session == req->session) \
-		 && MATCH_API(hook->api, req->apiname) \
-		 && MATCH_VERB(hook->verb, req->verbname)) { \
+		 && (hook->flags & afb_hook_flag_req_##flag) != 0) { \
+			if (!idset) { \
+				init_hookid(&hookid); \
+				idset = 1; \
+			} \
 			hook->itf->hook_req_##func(hook->closure, &hookid, __VA_ARGS__); \
 		} \
-		hook = hook->next; \
-	} \
-	x_rwlock_unlock(&rwlock);
+	}
 
 #define _HOOK_XREQ_(what,...)   _HOOK_XREQ_2_(what,what,__VA_ARGS__)
 
@@ -657,29 +721,187 @@ int afb_hook_req_interface_by_id(const struct afb_req_common *req, int id, void
  * section: hooking reqs
  *****************************************************************************/
 
+/* release a reference to a snapshot of hooks for req */
+static void req_hooks_unref(struct afb_hook_reqs *hooks)
+{
+	unsigned idx;
+	struct afb_hook_req *hook;
+
+	if (hooks && !__atomic_sub_fetch(&hooks->refcount, 1, __ATOMIC_ACQ_REL)) {
+		for (idx = 0 ; idx < hooks->count ; idx++) {
+			hook = hooks->hooks[idx];
+			if (!__atomic_sub_fetch(&hook->snaprefs, 1, __ATOMIC_ACQ_REL)) {
+				/* not in any snapshot, not in the list */
+				free(hook->api);
+				free(hook->verb);
+				if (hook->session)
+					afb_session_unref(hook->session);
+				free(hook);
+			}
+		}
+		free(hooks);
+	}
+}
+
+/*
+ * Release the snapshot of the retired generation if it has no more
+ * readers, making the generation reusable. Must be called with mutex held.
+ */
+static void req_hooks_reclaim(struct afb_hook_req_gen *gen)
+{
+	unsigned idx;
+	struct afb_hook_reqs *hooks;
+
+	if (!__atomic_load_n(&gen->retired, __ATOMIC_SEQ_CST))
+		return;
+	for (idx = 0 ; idx < AFB_HOOK_READERS_STRIPES ; idx++)
+		if (__atomic_load_n(&gen->readers[idx].count, __ATOMIC_SEQ_CST))
+			return;
+	hooks = gen->hooks;
+	__atomic_store_n(&gen->hooks, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&gen->retired, 0, __ATOMIC_SEQ_CST);
+	req_hooks_unref(hooks);
+}
+
+/* leave reading the snapshot of hooks for req of the generation */
+static void req_hooks_read_leave(struct afb_hook_req_gen *gen, unsigned *readers)
+{
+	if (!__atomic_sub_fetch(readers, 1, __ATOMIC_SEQ_CST)
+	 && __atomic_load_n(&gen->retired, __ATOMIC_SEQ_CST)) {
+		/* the last reader of a retired generation releases the snapshot */
+		x_mutex_lock(&mutex);
+		req_hooks_reclaim(gen);
+		x_mutex_unlock(&mutex);
+	}
+}
+
+/* enter reading the snapshot of hooks for req of the current generation */
+static struct afb_hook_req_gen *req_hooks_read_enter(unsigned **readers)
+{
+	uintptr_t stripe;
+	struct afb_hook_req_gen *gen;
+
+	stripe = (uintptr_t)x_tls_get_readers_stripe();
+	if (stripe == 0) {
+		stripe = 1 + __atomic_fetch_add(&readers_threads, 1, __ATOMIC_RELAXED) % AFB_HOOK_READERS_STRIPES;
+		x_tls_set_readers_stripe((void*)stripe);
+	}
+	for (;;) {
+		/* the snapshot is not released while readers of its generation are counted */
+		gen = __atomic_load_n(&current_req_gen, __ATOMIC_SEQ_CST);
+		*readers = &gen->readers[stripe - 1].count;
+		__atomic_add_fetch(*readers, 1, __ATOMIC_SEQ_CST);
+		if (gen == __atomic_load_n(&current_req_gen, __ATOMIC_SEQ_CST))
+			return gen;
+		/* retired meanwhile, its snapshot might be released */
+		req_hooks_read_leave(gen, *readers);
+	}
+}
+
+/*
+ * Publish a new snapshot of the hooks for req, removing the unreferenced
+ * hooks from the list. Must be called with mutex held.
+ */
+static int req_hooks_publish()
+{
+	unsigned count;
+	struct afb_hook_req **prv, *hook;
+	struct afb_hook_reqs *hooks;
+	struct afb_hook_req_gen *gen, *older;
+
+	/* count the living hooks */
+	count = 0;
+	for (hook = list_of_req_hooks ; hook ; hook = hook->next)
+		if (__atomic_load_n(&hook->refcount, __ATOMIC_RELAXED))
+			count++;
+
+	/* create the new snapshot */
+	if (count == 0)
+		hooks = NULL;
+	else {
+		hooks = malloc(sizeof *hooks + count * sizeof *hooks->hooks);
+		if (hooks == NULL)
+			return X_ENOMEM;
+		hooks->refcount = 1;
+		hooks->count = 0;
+	}
+
+	/* get a free generation: neither current nor retired */
+	older = current_req_gen;
+	for (gen = &first_req_gen ; gen && (gen == older || gen->retired) ; gen = gen->next);
+	if (gen == NULL) {
+		gen = calloc(1, sizeof *gen);
+		if (gen == NULL) {
+			free(hooks);
+			return X_ENOMEM;
+		}
+		gen->next = first_req_gen.next;
+		first_req_gen.next = gen;
+	}
+
+	/* fill it and unlink unreferenced hooks */
+	prv = &list_of_req_hooks;
+	while ((hook = *prv)) {
+		if (!__atomic_load_n(&hook->refcount, __ATOMIC_RELAXED))
+			*prv = hook->next;
+		else {
+			if (hooks->count < count) {
+				__atomic_add_fetch(&hook->snaprefs, 1, __ATOMIC_RELAXED);
+				hooks->hooks[hooks->count++] = hook;
+			}
+			prv = &hook->next;
+		}
+	}
+
+	/* publish it in the new generation and retire the older one */
+	__atomic_store_n(&gen->hooks, hooks, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&current_req_gen, gen, __ATOMIC_SEQ_CST);
+	if (older->hooks != NULL) {
+		__atomic_store_n(&older->retired, 1, __ATOMIC_SEQ_CST);
+		req_hooks_reclaim(older);
+	}
+	return 0;
+}
+
 void afb_hook_init_req(struct afb_req_common *req)
 {
 	static unsigned reqindex = 0;
 
-	unsigned int f, flags, x;
-	int add;
+	unsigned int f, flags, x, idx, *readers;
+	uint64_t mask;
 	struct afb_hook_req *hook;
+	struct afb_hook_reqs *hooks;
+	struct afb_hook_req_gen *gen;
 
-	/* scan hook list to get the expected flags */
+	/* resolve once the hooks of the request, fast path when no hook */
 	flags = req->hookflags;
-	x_rwlock_rdlock(&rwlock);
-	hook = list_of_req_hooks;
-	while (hook) {
-		f = hook->flags;
-		add = f != 0
-		   && (!hook->session || hook->session == req->session)
-		   && MATCH_API(hook->api, req->apiname)
-		   && MATCH_VERB(hook->verb, req->verbname);
-		if (add)
-			flags |= f;
-		hook = hook->next;
+	mask = 0;
+	gen = __atomic_load_n(&current_req_gen, __ATOMIC_RELAXED);
+	hooks = __atomic_load_n(&gen->hooks, __ATOMIC_RELAXED);
+	if (hooks != NULL) {
+		gen = req_hooks_read_enter(&readers);
+		hooks = __atomic_load_n(&gen->hooks, __ATOMIC_SEQ_CST);
+		if (hooks != NULL) {
+			for (idx = 0 ; idx < hooks->count ; idx++) {
+				hook = hooks->hooks[idx];
+				f = hook->flags;
+				if (f != 0 && req_hook_match(hook, req)) {
+					flags |= f;
+					if (idx < AFB_HOOK_REQ_MASK_BITS)
+						mask |= (uint64_t)1 << idx;
+				}
+			}
+			/* only requests having hooks keep the snapshot */
+			if (mask != 0 || hooks->count > AFB_HOOK_REQ_MASK_BITS)
+				__atomic_add_fetch(&hooks->refcount, 1, __ATOMIC_RELAXED);
+			else
+				hooks = NULL;
+		}
+		req_hooks_read_leave(gen, readers);
 	}
-	x_rwlock_unlock(&rwlock);
+	req_hooks_unref(req->hooks);
+	req->hooks = hooks;
+	req->hookmask = mask;
 
 	/* store the hooking data */
 	f = req->hookflags;
@@ -693,9 +915,17 @@ void afb_hook_init_req(struct afb_req_common *req)
 	}
 }
 
+void afb_hook_release_req(struct afb_req_common *req)
+{
+	req_hooks_unref(req->hooks);
+	req->hooks = NULL;
+	req->hookmask = 0;
+}
+
 struct afb_hook_req *afb_hook_create_req(const char *api, const char *verb, struct afb_session *session, unsigned flags, struct afb_hook_req_itf *itf, void *closure)
 {
 	struct afb_hook_req *hook;
+	int rc;
 
 	/* alloc the result */
 	hook = calloc(1, sizeof *hook);
@@ -725,7 +955,18 @@ struct afb_hook_req *afb_hook_create_req(const char *api, const char *verb, stru
 	x_mutex_lock(&mutex);
 	hook->next = list_of_req_hooks;
 	list_of_req_hooks = hook;
+	rc = req_hooks_publish();
+	if (rc < 0)
+		list_of_req_hooks = hook->next;
 	x_mutex_unlock(&mutex);
+	if (rc < 0) {
+		if (session)
+			afb_session_unref(session);
+		free(hook->api);
+		free(hook->verb);
+		free(hook);
+		return NULL;
+	}
 
 	/* returns it */
 	return hook;
@@ -737,45 +978,15 @@ struct afb_hook_req *afb_hook_addref_req(struct afb_hook_req *hook)
 	return hook;
 }
 
-static void hook_clean_req()
+void afb_hook_unref_req(struct afb_hook_req *hook)
 {
-	struct afb_hook_req **prv, *hook, *head;
-
-	if (x_rwlock_trywrlock(&rwlock) == 0) {
-		/* unlink under mutex */
-		head = NULL;
+	if (hook && !__atomic_sub_fetch(&hook->refcount, 1, __ATOMIC_RELAXED)) {
 		x_mutex_lock(&mutex);
-		prv = &list_of_req_hooks;
-		while ((hook = *prv)) {
-			if (hook->refcount)
-				prv = &(*prv)->next;
-			else {
-				*prv = hook->next;
-				hook->next = head;
-				head = hook;
-			}
-		}
+		req_hooks_publish();
 		x_mutex_unlock(&mutex);
-		x_rwlock_unlock(&rwlock);
-
-		/* free found hooks */
-		while((hook = head)) {
-			head = hook->next;
-			free(hook->api);
-			free(hook->verb);
-			if (hook->session)
-				afb_session_unref(hook->session);
-			free(hook);
-		}
 	}
 }
 
-void afb_hook_unref_req(struct afb_hook_req *hook)
-{
-	if (hook && !__atomic_sub_fetch(&hook->refcount, 1, __ATOMIC_RELAXED))
-		hook_clean_req();
-}
-
 /******************************************************************************
  * section: default callbacks for tracing daemon interface
  *****************************************************************************/
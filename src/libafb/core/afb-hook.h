@@ -151,6 +151,7 @@ struct afb_hook_req_itf {
 };
 
 extern void afb_hook_init_req(struct afb_req_common *req);
+extern void afb_hook_release_req(struct afb_req_common *req);
 
 extern struct afb_hook_req *afb_hook_create_req(const char *api, const char *verb, struct afb_session *session, unsigned flags, struct afb_hook_req_itf *itf, void *closure);
 extern struct afb_hook_req *afb_hook_addref_req(struct afb_hook_req *spec);
@@ -42,6 +42,10 @@
 #    error "AFB_JOBS_DEFAULT_MAX_COUNT too big"
 #endif
 
+#if !defined(AFB_JOBS_DEFAULT_STARVATION_MS)
+#    define AFB_JOBS_DEFAULT_STARVATION_MS    1000
+#endif
+
 #if WITH_TRACK_JOB_CALL
 #include "sys/x-thread.h"
 X_TLS(struct afb_job, current_job)
@@ -51,6 +55,10 @@ X_TLS(struct afb_job, current_job)
 struct afb_job
 {
 	struct afb_job *next;    /**< link to the next job enqueued */
+	struct afb_job *wprev;   /**< previous runnable job by ready time */
+	struct afb_job *wnext;   /**< next runnable job by ready time */
+	struct afb_job *qprev;   /**< previous job in its run or delay queue */
+	struct afb_job *qnext;   /**< next job in its run or delay queue */
 	const void *group;   /**< group of the request */
 	void (*callback)(int,void*,void*);   /**< processing callback */
 	void *arg1;           /**< arguments */
@@ -58,13 +66,16 @@ struct afb_job
 #if WITH_TRACK_JOB_CALL
 	struct afb_job *caller;
 #endif
-	long delayms;
+	uint64_t ready;      /**< time in ms when the job becomes runnable */
+	uint64_t deadline;   /**< time in ms when the job should be done */
 #if WITH_SIG_MONITOR_TIMERS
 	int timeout;         /**< timeout in second for processing the request */
 #endif
 	int id;              /**< id of the job */
 	uint8_t blocked: 1;  /**< is an other request blocking this one ? */
 	uint8_t active: 1;   /**< is the request active ? */
+	uint8_t priority: 2; /**< priority of the job */
+	uint8_t delayed: 1;  /**< is the job in the delay queue ? */
 };
 
 #define NEXT_ID(id)   ((((id) + 1) & 0x7fffffff) ?: 1)
@@ -76,15 +87,28 @@ static x_mutex_t mutex = X_MUTEX_INITIALIZER;
 /* counts for jobs */
 static int max_pending_count = AFB_JOBS_DEFAULT_MAX_COUNT;  /** maximum count of pending jobs */
 static int pending_count = 0;      /** count of pending jobs */
+static int starvation_ms = AFB_JOBS_DEFAULT_STARVATION_MS; /** delay of raising priority */
 static int idgen;
 
 /* queue of jobs */
 static struct afb_job *pending_jobs;
 static struct afb_job *free_jobs;
 
-/* delayed jobs */
-static int delayed_count = 0;
-static uint64_t delayed_base;
+
+/* jobs not blocked sorted by ready time, the first is the oldest */
+static struct afb_job *waiting_head;
+static struct afb_job *waiting_tail;
+static uint64_t oldest_ready;
+
+/* queues of the jobs not blocked: jobs ready to run are in the run
+ * queue of their priority level sorted by deadline, the first being the
+ * candidate of the level, and jobs not yet ready are in the delay queue
+ * sorted by ready time */
+#define LEVEL_COUNT  (Afb_Jobs_Priority_Background + 1)
+struct queue { struct afb_job *head, *tail; };
+static struct queue run_queues[LEVEL_COUNT];
+static struct queue delay_queue;
+static int run_count = 0;
 
 static uint64_t getnow()
 {
@@ -94,11 +118,176 @@ static uint64_t getnow()
 	return (uint64_t)(ts.tv_sec * 1000) + (uint64_t)((ts.tv_nsec >> 6) / 15625);
 }
 
+/**
+ * Insert the job in the list of waiting jobs. The search of its place
+ * starts from the tail for new jobs and from the head for unblocked
+ * jobs that are usually old.
+ */
+static void waiting_add(struct afb_job *job, int fromtail)
+{
+	struct afb_job *prev, *next;
+
+	if (fromtail) {
+		for (prev = waiting_tail ; prev && prev->ready > job->ready ; prev = prev->wprev);
+		next = prev ? prev->wnext : waiting_head;
+	}
+	else {
+		for (next = waiting_head ; next && next->ready <= job->ready ; next = next->wnext);
+		prev = next ? next->wprev : waiting_tail;
+	}
+	job->wprev = prev;
+	job->wnext = next;
+	if (prev)
+		prev->wnext = job;
+	else {
+		waiting_head = job;
+		__atomic_store_n(&oldest_ready, job->ready, __ATOMIC_RELAXED);
+	}
+	if (next)
+		next->wprev = job;
+	else
+		waiting_tail = job;
+}
+
+/**
+ * Remove the job from the list of waiting jobs
+ */
+static void waiting_remove(struct afb_job *job)
+{
+	if (job->wnext)
+		job->wnext->wprev = job->wprev;
+	else
+		waiting_tail = job->wprev;
+	if (job->wprev)
+		job->wprev->wnext = job->wnext;
+	else {
+		waiting_head = job->wnext;
+		__atomic_store_n(&oldest_ready, waiting_head ? waiting_head->ready : 0, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * Insert the job in the queue after 'prev', NULL for the head
+ */
+static void queue_insert(struct queue *queue, struct afb_job *prev, struct afb_job *job)
+{
+	struct afb_job *next = prev ? prev->qnext : queue->head;
+
+	job->qprev = prev;
+	job->qnext = next;
+	if (prev)
+		prev->qnext = job;
+	else
+		queue->head = job;
+	if (next)
+		next->qprev = job;
+	else
+		queue->tail = job;
+}
+
+/**
+ * Remove the job from the queue
+ */
+static void queue_remove(struct queue *queue, struct afb_job *job)
+{
+	if (job->qnext)
+		job->qnext->qprev = job->qprev;
+	else
+		queue->tail = job->qprev;
+	if (job->qprev)
+		job->qprev->qnext = job->qnext;
+	else
+		queue->head = job->qnext;
+}
+
+/**
+ * Insert the job in the run queue of its level by deadline, after
+ * the jobs of same deadline. The search starts from the tail because
+ * most jobs are due when posted.
+ */
+static void run_add(struct afb_job *job)
+{
+	struct queue *queue = &run_queues[job->priority];
+	struct afb_job *prev;
+
+	for (prev = queue->tail ; prev && prev->deadline > job->deadline ; prev = prev->qprev);
+	queue_insert(queue, prev, job);
+	job->delayed = 0;
+	run_count++;
+}
+
+/**
+ * Insert the job in the delay queue by ready time
+ */
+static void delay_add(struct afb_job *job)
+{
+	struct afb_job *prev;
+
+	for (prev = delay_queue.tail ; prev && prev->ready > job->ready ; prev = prev->qprev);
+	queue_insert(&delay_queue, prev, job);
+	job->delayed = 1;
+}
+
+/**
+ * Queue the job not blocked in the run queue or the delay queue
+ */
+static void job_enqueue(struct afb_job *job, uint64_t now)
+{
+	if (job->ready > now)
+		delay_add(job);
+	else
+		run_add(job);
+}
+
+/**
+ * Remove the job not blocked from its queue
+ */
+static void job_dequeue(struct afb_job *job)
+{
+	if (job->delayed)
+		queue_remove(&delay_queue, job);
+	else {
+		queue_remove(&run_queues[job->priority], job);
+		run_count--;
+	}
+}
+
+/**
+ * Move the jobs of the delay queue that are ready to their run queue
+ */
+static void undelay(uint64_t now)
+{
+	struct afb_job *job;
+
+	while ((job = delay_queue.head) != NULL && job->ready <= now) {
+		queue_remove(&delay_queue, job);
+		run_add(job);
+	}
+}
+
+/**
+ * Compute the priority of the job at time now: jobs waiting are
+ * raised by one level of priority each starvation delay.
+ */
+static int job_priority(struct afb_job *job, uint64_t now)
+{
+	uint64_t raise;
+	int prio = job->priority;
+
+	if (prio != Afb_Jobs_Priority_High && starvation_ms > 0 && now > job->ready) {
+		raise = (now - job->ready) / (uint64_t)starvation_ms;
+		prio = raise >= (uint64_t)prio ? Afb_Jobs_Priority_High : prio - (int)raise;
+	}
+	return prio;
+}
+
 /**
  * Create a new job with the given parameters
  * @param group    the group of the job
  * @param delayms  minimal delay in ms before starting the job
  * @param timeout  the timeout of the job (0 if none)
+ * @param dueto    the time in ms after ready when the job is due
+ * @param priority the priority of the job
  * @param callback the function that achieves the job
  * @param arg      the argument of the callback
  * @return zero in case of success or a negative ernno like number
@@ -107,13 +296,15 @@ static int job_add(
 		const void *group,
 		long delayms,
 		int timeout,
+		uint64_t dueto,
+		enum afb_jobs_priority priority,
 		void (*callback)(int, void*, void*),
 		void *arg1,
 		void *arg2,
 		struct afb_job **result)
 {
 	int rc;
-	uint64_t dt;
+	uint64_t now;
 	struct afb_job *job, *ijob, **pjob;
 
 	/* try recycle existing job */
@@ -129,25 +320,13 @@ static int job_add(
 		}
 	}
 	/* update the delay */
-	if (delayms > 0) {
-		if (!delayed_count)
-			delayed_base = getnow();
-		else {
-			dt = (getnow() + (uint64_t)delayms) - delayed_base;
-			if (dt > LONG_MAX) {
-				job->next = free_jobs;
-				free_jobs = job;
-				job = 0;
-				rc = X_E2BIG;
-				goto end;
-			}
-			delayms = (long)dt;
-		}
-		delayed_count++;
-	}
+	now = getnow();
+	job->ready = delayms > 0 ? now + (uint64_t)delayms : now;
+
 	/* initializes the job */
+	job->deadline = job->ready + dueto;
+	job->priority = priority;
 	job->group = group;
-	job->delayms = delayms;
 	job->callback = callback;
 	job->arg1 = arg1;
 	job->arg2 = arg2;
@@ -182,6 +361,10 @@ static int job_add(
 	/* queue the jobs */
 	idgen = job->id;
 	*pjob = job;
+	if (!job->blocked) {
+		waiting_add(job, 1);
+		job_enqueue(job, now);
+	}
 	rc = ++pending_count;
 end:
 	*result = job;
@@ -189,10 +372,12 @@ end:
 }
 
 /* enqueue the job */
-int afb_jobs_post2(
+static int job_post(
 		const void *group,
 		long delayms,
 		int timeout,
+		uint64_t dueto,
+		enum afb_jobs_priority priority,
 		void (*callback)(int, void*, void*),
 		void *arg1,
 		void *arg2
@@ -209,7 +394,7 @@ int afb_jobs_post2(
 		rc = X_EBUSY;
 	} else {
 		/* add the job */
-		rc = job_add(group, delayms, timeout, callback, arg1, arg2, &job);
+		rc = job_add(group, delayms, timeout, dueto, priority, callback, arg1, arg2, &job);
 		if (rc >= 0)
 			rc = (int)job->id;
 	}
@@ -220,6 +405,32 @@ int afb_jobs_post2(
 	return rc;
 }
 
+/* enqueue the job, due at its timeout */
+int afb_jobs_post_priority(
+		const void *group,
+		long delayms,
+		int timeout,
+		enum afb_jobs_priority priority,
+		void (*callback)(int, void*, void*),
+		void *arg1,
+		void *arg2
+) {
+	uint64_t dueto = timeout > 0 ? (uint64_t)timeout * 1000 : 0;
+	return job_post(group, delayms, timeout, dueto, priority, callback, arg1, arg2);
+}
+
+/* enqueue the job */
+int afb_jobs_post2(
+		const void *group,
+		long delayms,
+		int timeout,
+		void (*callback)(int, void*, void*),
+		void *arg1,
+		void *arg2
+) {
+	return job_post(group, delayms, timeout, 0, Afb_Jobs_Priority_Normal, callback, arg1, arg2);
+}
+
 /* enqueue the job */
 int afb_jobs_post(
 		const void *group,
@@ -260,8 +471,11 @@ static void job_release(struct afb_job *job)
 	/* then unblock jobs of the same group */
 	if (group) {
 		do { ijob = ijob->next; } while (ijob && ijob->group != group);
-		if (ijob)
+		if (ijob) {
 			ijob->blocked = 0;
+			waiting_add(ijob, 0);
+			job_enqueue(ijob, getnow());
+		}
 	}
 
 	/* recycle the job */
@@ -272,44 +486,68 @@ static void job_release(struct afb_job *job)
 	x_mutex_unlock(&mutex);
 }
 
+/**
+ * Get the job to run now, the first of highest priority and earliest
+ * deadline among the candidates of the levels, or NULL
+ */
+static struct afb_job *job_next(uint64_t now)
+{
+	struct afb_job *job, *ijob;
+	int lvl, prio, iprio;
+
+	job = NULL;
+	prio = 0;
+	for (lvl = 0 ; lvl < LEVEL_COUNT ; lvl++) {
+		ijob = run_queues[lvl].head;
+		if (ijob != NULL) {
+			iprio = job_priority(ijob, now);
+			if (job == NULL || iprio < prio
+			 || (iprio == prio && ijob->deadline < job->deadline)) {
+				job = ijob;
+				prio = iprio;
+			}
+		}
+	}
+	if (job != NULL) {
+		waiting_remove(job);
+		job_dequeue(job);
+		job->blocked = 1; /* mark job as blocked */
+		job->active = 1; /* mark job as active */
+		pending_count--;
+	}
+	return job;
+}
+
+/**
+ * Get the delay in ms until the first delayed job is ready
+ * or -1 if no job is delayed
+ */
+static long next_delay(uint64_t now)
+{
+	struct afb_job *job = delay_queue.head;
+	uint64_t dt;
+
+	if (job == NULL)
+		return -1;
+	dt = job->ready - now;
+	return dt > LONG_MAX ? LONG_MAX : (long)dt;
+}
+
 /* get next pending job */
 struct afb_job *afb_jobs_dequeue(long *delayms)
 {
 	struct afb_job *job;
-	uint64_t dt;
+	uint64_t now;
 	long d;
 
 	/* enter critical */
 	x_mutex_lock(&mutex);
 
 	/* search a job */
-	if (!delayed_count)
-		d = LONG_MAX;
-	else {
-		dt = getnow() - delayed_base;
-		d = dt > LONG_MAX ? LONG_MAX : (long)dt;
-	}
-	for (job = pending_jobs ; job && (job->blocked || job->delayms > d); job = job->next);
-	if (job) {
-		job->blocked = 1; /* mark job as blocked */
-		job->active = 1; /* mark job as active */
-		pending_count--;
-		if (job->delayms)
-			delayed_count--;
-		d = 0;
-	}
-	else if (delayed_count) {
-		d = LONG_MAX;
-		for (job = pending_jobs ; job ; job = job->next)
-			if (!job->blocked && job->delayms && job->delayms < d)
-				d = job->delayms;
-		d = (long)((delayed_base + (uint64_t)d) - getnow());
-		if (d < 0)
-			d = -1;
-	}
-	else {
-		d = -1;
-	}
+	now = delay_queue.head != NULL || starvation_ms > 0 ? getnow() : 0;
+	undelay(now);
+	job = job_next(now);
+	d = job != NULL ? 0 : next_delay(now);
 
 	/* leave critical */
 	x_mutex_unlock(&mutex);
@@ -323,47 +561,24 @@ struct afb_job *afb_jobs_dequeue(long *delayms)
 int afb_jobs_dequeue_multiple(struct afb_job **jobs, int njobs, long *delayms)
 {
 	int idx, nava;
-	struct afb_job *job;
-	uint64_t dt;
-	long dtrig, delay, d;
+	uint64_t now;
+	long d;
 
 	/* enter critical */
 	x_mutex_lock(&mutex);
 
-	/* search a job */
-	delay = -1;
-	if (!delayed_count)
-		dtrig = LONG_MAX;
-	else {
-		dt = getnow() - delayed_base;
-		dtrig = dt > LONG_MAX ? LONG_MAX : (long)dt;
-	}
-	for (idx = nava = 0, job = pending_jobs ; job ; job = job->next) {
-		if (!job->blocked) {
-			d = job->delayms - dtrig;
-			if (d > 0) {
-				if ((unsigned long)d < (unsigned long)delay)
-					delay = d;
-			}
-			else {
-				nava++;
-				if (idx < njobs) {
-					job->blocked = 1; /* mark job as blocked */
-					job->active = 1; /* mark job as active */
-					pending_count--;
-					if (job->delayms)
-						delayed_count--;
-					jobs[idx++] = job;
-				}
-			}
-		}
-	}
+	/* get the jobs in the order of afb_jobs_dequeue */
+	now = delay_queue.head != NULL || starvation_ms > 0 ? getnow() : 0;
+	undelay(now);
+	nava = run_count;
+	for (idx = 0 ; idx < njobs && (jobs[idx] = job_next(now)) != NULL ; idx++);
+	d = next_delay(now);
 
 	/* leave critical */
 	x_mutex_unlock(&mutex);
 
 	if (delayms)
-		*delayms = delay;
+		*delayms = d;
 	return nava;
 }
 
@@ -391,6 +606,10 @@ int afb_jobs_abort(int jobid)
 		rc = X_EBUSY;
 	else {
 		rc = 0;
+		if (!job->blocked) {
+			waiting_remove(job);
+			job_dequeue(job);
+		}
 		job->blocked = 1; /* mark job as blocked */
 		job->active = 1; /* mark job as active */
 		pending_count--;
@@ -429,19 +648,59 @@ void afb_jobs_run(struct afb_job *job)
 	afb_sig_monitor_run(0, runjob, job);
 #endif
 #if WITH_TRACK_JOB_CALL
-	x_tls_set_current_job(job->caller);
+	afb_jobs_switch_current(job->caller);
 	job->caller = NULL;
 #endif
 	/* release the run job */
 	job_release(job);
 }
 
+/* get the callback of the job */
+const void *afb_jobs_get_callback(struct afb_job *job)
+{
+	return (const void*)job->callback;
+}
+
+/* get the arguments of the callback */
+void afb_jobs_get_args(struct afb_job *job, void **arg1, void **arg2)
+{
+	*arg1 = job->arg1;
+	*arg2 = job->arg2;
+}
+
 /* get pending count of jobs */
 int afb_jobs_get_pending_count(void)
 {
 	return pending_count;
 }
 
+/* get the waiting time of the oldest runnable job */
+int afb_jobs_get_oldest_wait(void)
+{
+	uint64_t now, oldest;
+
+	oldest = __atomic_load_n(&oldest_ready, __ATOMIC_RELAXED);
+	if (oldest == 0)
+		return 0;
+	now = getnow();
+	if (now <= oldest)
+		return 0;
+	now -= oldest;
+	return now > INT_MAX ? INT_MAX : (int)now;
+}
+
+/* get the starvation delay */
+int afb_jobs_get_starvation_delay(void)
+{
+	return starvation_ms;
+}
+
+/* set the starvation delay */
+void afb_jobs_set_starvation_delay(int delayms)
+{
+	starvation_ms = delayms < 0 ? 0 : delayms;
+}
+
 /* get maximum pending count */
 int afb_jobs_get_max_count(void)
 {
@@ -488,4 +747,16 @@ int afb_jobs_check_group(void *group)
 	return job != NULL;
 }
 
+/* Replace the current job of the thread */
+#if WITH_SCHED_FIBERS
+/* fibers can continue on an other thread: avoid reuse of thread local addresses */
+__attribute__((noinline))
+#endif
+struct afb_job *afb_jobs_switch_current(struct afb_job *job)
+{
+	struct afb_job *older = x_tls_get_current_job();
+	x_tls_set_current_job(job);
+	return older;
+}
+
 #endif
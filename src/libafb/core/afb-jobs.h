@@ -30,11 +30,26 @@
 
 struct afb_job;
 
+/**
+ * Priorities of jobs. Runnable jobs are dequeued by priority
+ * then by earliest deadline. Jobs posted by @ref afb_jobs_post_priority
+ * with a timeout are due at the time of posting plus the timeout, other
+ * jobs are due when posted: they keep their arrival order and are not
+ * overtaken by jobs posted after them. Jobs waiting are raised one level
+ * of priority each starvation delay.
+ */
+enum afb_jobs_priority
+{
+	Afb_Jobs_Priority_High,		/**< before others */
+	Afb_Jobs_Priority_Normal,	/**< default priority */
+	Afb_Jobs_Priority_Background	/**< after others */
+};
+
 /**
  * Queues a new asynchronous job represented by 'callback' and 'arg'
  * for the 'group' and the 'timeout'.
  * Jobs are queued in a FIFO (first in first out) structure.
- * They are dequeued by arrival order.
+ * They are dequeued by arrival order within same priority and deadline.
  * The group if not NULL is used to group jobs of that same group
  * sequentially. This is of importance if jobs are executed in
  * parallel concurrently.
@@ -64,7 +79,7 @@ extern int afb_jobs_post(
  * Queues a new asynchronous job represented by 'callback' and 'arg'
  * for the 'group' and the 'timeout'.
  * Jobs are queued in a FIFO (first in first out) structure.
- * They are dequeued by arrival order.
+ * They are dequeued by arrival order within same priority and deadline.
  * The group if not NULL is used to group jobs of that same group
  * sequentially. This is of importance if jobs are executed in
  * parallel concurrently.
@@ -92,6 +107,32 @@ extern int afb_jobs_post2(
 		void *arg1,
 		void *arg2);
 
+/**
+ * Queues a new asynchronous job like @ref afb_jobs_post2 but
+ * with the given priority. The timeout also gives the deadline
+ * of the job.
+ *
+ * @param group    The group of the job or NULL when no group.
+ * @param delayms  Minimal delay in ms before starting the job
+ * @param timeout  The maximum execution time in seconds of the job
+ *                 or 0 for unlimited time.
+ * @param priority The priority of the job
+ * @param callback The function to execute for achieving the job.
+ * @param arg1     The second argument for 'callback'
+ * @param arg2     The third argument for 'callback'
+ *
+ * @return the id of the job, greater than zero, or in case
+ *         of error a negative number in -errno like form
+ */
+extern int afb_jobs_post_priority(
+		const void *group,
+		long delayms,
+		int timeout,
+		enum afb_jobs_priority priority,
+		void (*callback)(int, void*, void*),
+		void *arg1,
+		void *arg2);
+
 /**
  * Get the next job to process or NULL if none, i.e.
  * if all jobs are blocked or if no job exists.
@@ -110,7 +151,8 @@ extern struct afb_job *afb_jobs_dequeue(long *delayms);
  * Returns the count of jobs that can be started immediately.
  * The returned value can be greater than the given count 'njobs',
  * Allowing to pass a value of zero njobs and get in return the count
- * of available jobs.
+ * of available jobs. The jobs are stored in the order in which
+ * afb_jobs_dequeue would return them.
  *
  * If not NULL, the value pointed by delayms is filled with the delay
  * in milliseconds of the first delayed job to be run.
@@ -121,7 +163,7 @@ extern struct afb_job *afb_jobs_dequeue(long *delayms);
  * @param njobs the count of jobs that can be stored in the array jobs
  * @param delayms the long pointed receives the delay in ms before first delayed job.
  *
- * @return the first job that isn't blocked or NULL
+ * @return the count of jobs available to start immediately
  */
 extern int afb_jobs_dequeue_multiple(struct afb_job **jobs, int njobs, long *delayms);
 
@@ -132,6 +174,25 @@ extern int afb_jobs_dequeue_multiple(struct afb_job **jobs, int njobs, long *del
  */
 extern void afb_jobs_run(struct afb_job *job);
 
+/**
+ * Get the callback of the job. Jobs posted with the same
+ * callback are of the same kind.
+ *
+ * @param job   a job a retrieved with afb_jobs_dequeue
+ *
+ * @return the callback of the job
+ */
+extern const void *afb_jobs_get_callback(struct afb_job *job);
+
+/**
+ * Get the arguments given to the callback of the job.
+ *
+ * @param job   a job a retrieved with afb_jobs_dequeue
+ * @param arg1  where to store the first argument
+ * @param arg2  where to store the second argument
+ */
+extern void afb_jobs_get_args(struct afb_job *job, void **arg1, void **arg2);
+
 /**
  * Cancel the job gotten by afb_jobs_dequeue.
  *
@@ -161,6 +222,28 @@ extern int afb_jobs_abort(int jobid);
  */
 extern int afb_jobs_get_pending_count(void);
 
+/**
+ * Get the time that the oldest runnable job is waiting for a thread.
+ * Jobs blocked by their group or still delayed are not accounted.
+ *
+ * @return the waiting time in milliseconds, 0 when no job is waiting
+ */
+extern int afb_jobs_get_oldest_wait(void);
+
+/**
+ * Get the delay of waiting after which jobs are raised of one priority
+ *
+ * @return the delay in milliseconds, 0 when jobs are never raised
+ */
+extern int afb_jobs_get_starvation_delay(void);
+
+/**
+ * Set the delay of waiting after which jobs are raised of one priority
+ *
+ * @param delayms the delay in milliseconds, 0 for never raising jobs
+ */
+extern void afb_jobs_set_starvation_delay(int delayms);
+
 /**
  * Get the maximum count of pending job
  *
@@ -191,4 +274,14 @@ extern int afb_jobs_get_active_count(void);
  * @return 1 if the group is in the stack of jobs of the thread
  */
 extern int afb_jobs_check_group(void *group);
+
+/**
+ * Replace the current job of the thread by 'job' and return
+ * the replaced one. It is intended for switching stacks (fibers).
+ *
+ * @param job the job to set as current
+ *
+ * @return the replaced current job
+ */
+extern struct afb_job *afb_jobs_switch_current(struct afb_job *job);
 #endif
\ No newline at end of file
@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "../libafb-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "core/afb-perm-cache.h"
+#include "sys/x-mutex.h"
+#include "sys/x-errno.h"
+
+/** count of hash heads per shard, must be a power of 2 */
+#define BUCKETS_COUNT	64
+
+/** a recorded decision */
+struct entry
+{
+	/** next entry of the same bucket */
+	struct entry *next;
+	/** previous entry in LRU order (more recent) */
+	struct entry *prev_lru;
+	/** next entry in LRU order (less recent) */
+	struct entry *next_lru;
+	/** expiration time in microseconds */
+	uint64_t expire;
+	/** hash of the key */
+	uint32_t hash;
+	/** length of the key */
+	uint16_t length;
+	/** offset of the session in the key */
+	uint16_t offsession;
+	/** the decision */
+	int status;
+	/** the key: client, user, session and permission */
+	char key[];
+};
+
+/** a shard of the cache */
+struct shard
+{
+	/** lock of the shard */
+	x_mutex_t mutex;
+	/** count of entries */
+	unsigned count;
+	/** most recently used entry */
+	struct entry *head;
+	/** least recently used entry */
+	struct entry *tail;
+	/** the buckets */
+	struct entry *buckets[BUCKETS_COUNT];
+};
+
+/** the shards */
+static struct shard shards[AFB_PERM_CACHE_SHARDS];
+
+/** initialisation of shards */
+static x_mutex_t setup_mutex = X_MUTEX_INITIALIZER;
+static int initialized;
+
+/** time to live in microseconds */
+static uint64_t ttl = (uint64_t)AFB_PERM_CACHE_TTL * 1000;
+
+/** maximum count of entries per shard */
+static unsigned maxcount = (AFB_PERM_CACHE_SIZE + AFB_PERM_CACHE_SHARDS - 1) / AFB_PERM_CACHE_SHARDS;
+
+/** generation, incremented when entries are dropped */
+static unsigned generation;
+
+/** global count of entries */
+static unsigned total;
+
+/** statistics */
+static uint64_t hits, misses;
+
+/******************************************************************************/
+
+/* returns the current time in microseconds */
+static uint64_t now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* initialise the shards once */
+static void init()
+{
+	int idx;
+
+	if (!__atomic_load_n(&initialized, __ATOMIC_ACQUIRE)) {
+		x_mutex_lock(&setup_mutex);
+		if (!initialized) {
+			for (idx = 0 ; idx < AFB_PERM_CACHE_SHARDS ; idx++)
+				x_mutex_init(&shards[idx].mutex);
+			__atomic_store_n(&initialized, 1, __ATOMIC_RELEASE);
+		}
+		x_mutex_unlock(&setup_mutex);
+	}
+}
+
+/* compute the length of the key */
+static size_t key_length(const char *strings[4])
+{
+	return strlen(strings[0]) + strlen(strings[1]) + strlen(strings[2]) + strlen(strings[3]) + 4;
+}
+
+/* make the key and returns its hash */
+static uint32_t key_make(char *key, const char *strings[4], uint16_t *offsession)
+{
+	uint32_t hash = 2166136261u;
+	size_t len;
+	char *iter;
+	int idx;
+
+	for (iter = key, idx = 0 ; idx < 4 ; idx++) {
+		if (idx == 2)
+			*offsession = (uint16_t)(iter - key);
+		len = strlen(strings[idx]) + 1;
+		memcpy(iter, strings[idx], len);
+		iter += len;
+	}
+	/* FNV-1a */
+	for (len = (size_t)(iter - key), iter = key ; len ; len--, iter++)
+		hash = (hash ^ (uint8_t)*iter) * 16777619u;
+	return hash;
+}
+
+/* unlink the entry from the LRU list */
+static void lru_unlink(struct shard *shard, struct entry *entry)
+{
+	if (entry->prev_lru)
+		entry->prev_lru->next_lru = entry->next_lru;
+	else
+		shard->head = entry->next_lru;
+	if (entry->next_lru)
+		entry->next_lru->prev_lru = entry->prev_lru;
+	else
+		shard->tail = entry->prev_lru;
+}
+
+/* link the entry at head of the LRU list */
+static void lru_link(struct shard *shard, struct entry *entry)
+{
+	entry->prev_lru = NULL;
+	entry->next_lru = shard->head;
+	if (shard->head)
+		shard->head->prev_lru = entry;
+	else
+		shard->tail = entry;
+	shard->head = entry;
+}
+
+/* remove the entry of the shard */
+static void remove_locked(struct shard *shard, struct entry *entry)
+{
+	struct entry **prv;
+
+	prv = &shard->buckets[entry->hash & (BUCKETS_COUNT - 1)];
+	while (*prv != entry)
+		prv = &(*prv)->next;
+	*prv = entry->next;
+	lru_unlink(shard, entry);
+	shard->count--;
+	__atomic_sub_fetch(&total, 1, __ATOMIC_RELAXED);
+	free(entry);
+}
+
+/* search the entry of key */
+static struct entry *search_locked(struct shard *shard, const char *key, size_t length, uint32_t hash)
+{
+	struct entry *entry;
+
+	entry = shard->buckets[hash & (BUCKETS_COUNT - 1)];
+	while (entry != NULL
+		&& (entry->hash != hash || entry->length != length || memcmp(entry->key, key, length)))
+		entry = entry->next;
+	return entry;
+}
+
+/* get the shard of hash */
+static inline struct shard *shard_of(uint32_t hash)
+{
+	/* upper bits for shards, lower bits for buckets */
+	return &shards[(hash >> 24) & (AFB_PERM_CACHE_SHARDS - 1)];
+}
+
+/* drop the entries of session or all entries if session is NULL */
+static void drop(const char *session)
+{
+	struct shard *shard;
+	struct entry *entry, *next;
+	int idx;
+
+	__atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+	if (__atomic_load_n(&total, __ATOMIC_RELAXED) == 0)
+		return;
+
+	for (idx = 0 ; idx < AFB_PERM_CACHE_SHARDS ; idx++) {
+		shard = &shards[idx];
+		x_mutex_lock(&shard->mutex);
+		for (entry = shard->head ; entry != NULL ; entry = next) {
+			next = entry->next_lru;
+			if (session == NULL || !strcmp(&entry->key[entry->offsession], session))
+				remove_locked(shard, entry);
+		}
+		x_mutex_unlock(&shard->mutex);
+	}
+}
+
+/******************************************************************************/
+
+void afb_perm_cache_setup(unsigned ttlms, unsigned count)
+{
+	init();
+	x_mutex_lock(&setup_mutex);
+	__atomic_store_n(&ttl, (uint64_t)ttlms * 1000, __ATOMIC_RELAXED);
+	count = (count + AFB_PERM_CACHE_SHARDS - 1) / AFB_PERM_CACHE_SHARDS;
+	__atomic_store_n(&maxcount, count ? count : 1, __ATOMIC_RELAXED);
+	x_mutex_unlock(&setup_mutex);
+	drop(NULL);
+}
+
+int afb_perm_cache_get(
+	const char *client,
+	const char *user,
+	const char *session,
+	const char *permission,
+	unsigned *gen
+) {
+	const char *strings[4] = { client ?: "", user ?: "", session ?: "", permission ?: "" };
+	struct shard *shard;
+	struct entry *entry;
+	size_t length;
+	uint32_t hash;
+	uint16_t offsession;
+	int status;
+
+	if (gen != NULL)
+		*gen = __atomic_load_n(&generation, __ATOMIC_RELAXED);
+	if (__atomic_load_n(&ttl, __ATOMIC_RELAXED) == 0)
+		return X_ENOENT;
+
+	length = key_length(strings);
+	if (length > UINT16_MAX)
+		return X_ENOENT;
+
+	init();
+	{
+		char key[length];
+		hash = key_make(key, strings, &offsession);
+		shard = shard_of(hash);
+		x_mutex_lock(&shard->mutex);
+		entry = search_locked(shard, key, length, hash);
+		if (entry == NULL)
+			status = X_ENOENT;
+		else if (entry->expire <= now_us()) {
+			remove_locked(shard, entry);
+			status = X_ENOENT;
+		}
+		else {
+			status = entry->status;
+			lru_unlink(shard, entry);
+			lru_link(shard, entry);
+		}
+		x_mutex_unlock(&shard->mutex);
+	}
+	__atomic_add_fetch(status >= 0 ? &hits : &misses, 1, __ATOMIC_RELAXED);
+	return status;
+}
+
+void afb_perm_cache_put(
+	const char *client,
+	const char *user,
+	const char *session,
+	const char *permission,
+	int status,
+	unsigned gen
+) {
+	const char *strings[4] = { client ?: "", user ?: "", session ?: "", permission ?: "" };
+	struct shard *shard;
+	struct entry *entry, *old;
+	size_t length;
+	uint64_t expire;
+	uint32_t hash;
+	uint16_t offsession;
+
+	expire = __atomic_load_n(&ttl, __ATOMIC_RELAXED);
+	if (expire == 0 || status < 0)
+		return;
+	length = key_length(strings);
+	if (length > UINT16_MAX)
+		return;
+	expire += now_us();
+
+	init();
+	entry = malloc(sizeof *entry + length);
+	if (entry == NULL)
+		return;
+	entry->hash = hash = key_make(entry->key, strings, &offsession);
+	entry->length = (uint16_t)length;
+	entry->offsession = offsession;
+	entry->status = status;
+	entry->expire = expire;
+
+	shard = shard_of(hash);
+	x_mutex_lock(&shard->mutex);
+	if (gen != __atomic_load_n(&generation, __ATOMIC_RELAXED)) {
+		/* dropped since the check started */
+		x_mutex_unlock(&shard->mutex);
+		free(entry);
+		return;
+	}
+	/* replace the previous one */
+	old = search_locked(shard, entry->key, length, hash);
+	if (old != NULL)
+		remove_locked(shard, old);
+	/* evict the least recently used if full */
+	if (shard->count >= __atomic_load_n(&maxcount, __ATOMIC_RELAXED) && shard->tail != NULL)
+		remove_locked(shard, shard->tail);
+	entry->next = shard->buckets[hash & (BUCKETS_COUNT - 1)];
+	shard->buckets[hash & (BUCKETS_COUNT - 1)] = entry;
+	lru_link(shard, entry);
+	shard->count++;
+	__atomic_add_fetch(&total, 1, __ATOMIC_RELAXED);
+	x_mutex_unlock(&shard->mutex);
+}
+
+void afb_perm_cache_drop_session(const char *session)
+{
+	if (session != NULL) {
+		init();
+		drop(session);
+	}
+}
+
+void afb_perm_cache_clear(void)
+{
+	init();
+	drop(NULL);
+}
+
+void afb_perm_cache_stats(struct afb_perm_cache_stats *stats)
+{
+	stats->hits = __atomic_load_n(&hits, __ATOMIC_RELAXED);
+	stats->misses = __atomic_load_n(&misses, __ATOMIC_RELAXED);
+	stats->count = __atomic_load_n(&total, __ATOMIC_RELAXED);
+}
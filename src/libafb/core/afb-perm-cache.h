@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#include <stdint.h>
+
+/**
+ * Cache of permission decisions
+ * -----------------------------
+ *
+ * Decisions of the permission backend are recorded for a short time,
+ * keyed by client, user, session and permission, avoiding a round trip
+ * to the backend for repeated checks. The cache is split in shards,
+ * each having its own lock and its own bounded LRU list.
+ *
+ * The decisions are dropped when they expire, when the session is
+ * closed or when the cache is cleared.
+ */
+
+/** count of shards, must be a power of 2 */
+#ifndef AFB_PERM_CACHE_SHARDS
+#define AFB_PERM_CACHE_SHARDS	16
+#endif
+
+/** default time to live of decisions in milliseconds (0 disables) */
+#ifndef AFB_PERM_CACHE_TTL
+#define AFB_PERM_CACHE_TTL	1000
+#endif
+
+/** default maximum count of recorded decisions */
+#ifndef AFB_PERM_CACHE_SIZE
+#define AFB_PERM_CACHE_SIZE	4096
+#endif
+
+/** statistics of the cache */
+struct afb_perm_cache_stats
+{
+	/** count of checks answered by the cache */
+	uint64_t hits;
+	/** count of checks not answered by the cache */
+	uint64_t misses;
+	/** current count of recorded decisions */
+	unsigned count;
+};
+
+/**
+ * Setup the cache, dropping recorded decisions
+ *
+ * @param ttlms    time to live of decisions in milliseconds, 0 to disable
+ * @param maxcount maximum count of recorded decisions
+ */
+extern void afb_perm_cache_setup(unsigned ttlms, unsigned maxcount);
+
+/**
+ * Get the recorded decision for the key
+ *
+ * @param client     the client
+ * @param user       the user
+ * @param session    the session
+ * @param permission the permission
+ * @param generation where to store the generation to give to
+ *                   afb_perm_cache_put when not found (can be NULL)
+ *
+ * @return the recorded decision (0 or 1) or X_ENOENT if not found
+ */
+extern int afb_perm_cache_get(
+	const char *client,
+	const char *user,
+	const char *session,
+	const char *permission,
+	unsigned *generation
+);
+
+/**
+ * Record the decision for the key if the cache wasn't cleared
+ * since the generation was got
+ *
+ * @param client     the client
+ * @param user       the user
+ * @param session    the session
+ * @param permission the permission
+ * @param status     the decision (0 or 1)
+ * @param generation the generation got by afb_perm_cache_get
+ */
+extern void afb_perm_cache_put(
+	const char *client,
+	const char *user,
+	const char *session,
+	const char *permission,
+	int status,
+	unsigned generation
+);
+
+/**
+ * Drop the decisions recorded for the session
+ *
+ * @param session the session
+ */
+extern void afb_perm_cache_drop_session(const char *session);
+
+/**
+ * Drop all the recorded decisions
+ */
+extern void afb_perm_cache_clear(void);
+
+/**
+ * Get the statistics of the cache
+ *
+ * @param stats where to store the statistics
+ */
+extern void afb_perm_cache_stats(struct afb_perm_cache_stats *stats);
@@ -31,6 +31,7 @@
 #include <rp-utils/rp-verbose.h>
 
 #include "core/afb-perm.h"
+#include "core/afb-perm-cache.h"
 #include "core/afb-cred.h"
 #include "core/afb-token.h"
 #include "core/afb-sched.h"
@@ -99,8 +100,14 @@ static void warn_if_bypass()
 struct memo_check
 {
 	int status;
+	unsigned generation;
 	void *closure;
 	void (*checkcb)(void *closure, int status);
+	const char *client;
+	const char *user;
+	const char *session;
+	const char *permission;
+	char strings[];
 };
 
 static bool mute_errors = false;
@@ -131,6 +138,8 @@ static void unlock()
 static void async_job_cb(int status, void *closure)
 {
 	struct memo_check *memo = closure;
+	afb_perm_cache_put(memo->client, memo->user, memo->session, memo->permission,
+			memo->status, memo->generation);
 	memo->checkcb(memo->closure, memo->status);
 	free(memo);
 }
@@ -187,7 +196,8 @@ static int cynagora_acquire()
 #if !NO_PERMISSION_BYPASS
 		warn_if_bypass();
 #endif
-		/* lazy initialisation */
+		/* lazy initialisation, forgetting decisions of previous connection */
+		afb_perm_cache_clear();
 		rc = cynagora_create(&cynagora, cynagora_Check, 1000, NULL);
 		if (rc < 0) {
 			cynagora = NULL;
@@ -218,20 +228,40 @@ void afb_perm_check_async(
 )
 {
 	int rc;
+	unsigned generation;
+	size_t lenc, lenu, lens, lenp;
 	cynagora_key_t key;
 	struct memo_check *memo;
 
+	/* answer from the cache if possible */
+	rc = afb_perm_cache_get(client, user, session, permission, &generation);
+	if (rc >= 0) {
+		callback(closure, rc);
+		return;
+	}
+
 	rc = cynagora_acquire();
 	if (rc >= 0) {
-		memo = malloc(sizeof *memo);
+		lenc = client ? strlen(client) + 1 : 0;
+		lenu = user ? strlen(user) + 1 : 0;
+		lens = session ? strlen(session) + 1 : 0;
+		lenp = permission ? strlen(permission) + 1 : 0;
+		memo = malloc(sizeof *memo + lenc + lenu + lens + lenp);
 		if (memo == NULL) {
+			unlock();
 			rc = -ENOMEM;
 			RP_ERROR("Can't query cynagora: %s", strerror(-rc));
 		}
 		else {
 			memo->status = -EFAULT;
+			memo->generation = generation;
 			memo->closure = closure;
 			memo->checkcb = callback;
+			/* copy the key for recording the decision */
+			memo->client = client ? memcpy(memo->strings, client, lenc) : NULL;
+			memo->user = user ? memcpy(&memo->strings[lenc], user, lenu) : NULL;
+			memo->session = session ? memcpy(&memo->strings[lenc + lenu], session, lens) : NULL;
+			memo->permission = permission ? memcpy(&memo->strings[lenc + lenu + lens], permission, lenp) : NULL;
 			key.client = client;
 			key.user = user;
 			key.session = session;
@@ -242,6 +272,7 @@ void afb_perm_check_async(
 				mute_errors = false;
 				return;
 			}
+			free(memo);
 			if (!mute_errors)
 				RP_ERROR("Can't query cynagora: %s", strerror(-rc));
 		}
@@ -0,0 +1,669 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "../libafb-config.h"
+
+#if WITH_AFB_REQ_CACHE
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "core/afb-req-cache.h"
+#include "core/afb-req-common.h"
+#include "core/afb-data.h"
+#include "core/afb-data-array.h"
+#include "core/afb-type.h"
+#include "core/afb-type-predefined.h"
+#include "core/afb-session.h"
+#include "sys/x-mutex.h"
+#include "sys/x-errno.h"
+#include "utils/namecmp.h"
+
+/** count of buckets of rules, a power of 2 */
+#define RULES_COUNT	16
+
+/** count of buckets of recorded replies, a power of 2 */
+#define BUCKETS_COUNT	256
+
+/** a recorded reply */
+struct entry
+{
+	/** next entry of the bucket */
+	struct entry *next;
+	/** previous entry of the rule, older */
+	struct entry *older;
+	/** next entry of the rule, newer */
+	struct entry *newer;
+	/** the rule of the entry */
+	struct rule *rule;
+	/** hash of the key */
+	uint64_t hash;
+	/** expiration time in microseconds */
+	uint64_t expire;
+	/** length of the key */
+	size_t keylen;
+	/** status of the reply */
+	int status;
+	/** count of replied data */
+	unsigned nreplies;
+	/** the replied data, followed by the key */
+	struct afb_data *replies[];
+};
+
+/**
+ * a cacheable api/verb
+ *
+ * Rules are read without lock: once published in their bucket,
+ * they are never removed nor freed because waiting keys refer to them.
+ */
+struct rule
+{
+	/** next rule of the bucket */
+	struct rule *next;
+	/** lock of the entries of the rule, taken before the buckets */
+	x_mutex_t mutex;
+	/** is enabled? */
+	int enabled;
+	/** flags of the rule */
+	int flags;
+	/** generation, incremented on invalidation */
+	unsigned generation;
+	/** maximum count of entries */
+	unsigned maxcount;
+	/** current count of entries */
+	unsigned count;
+	/** time to live in microseconds */
+	uint64_t ttl;
+	/** the oldest recorded reply, the first to expire */
+	struct entry *oldest;
+	/** the newest recorded reply */
+	struct entry *newest;
+	/** the verb name (follows the api name) */
+	const char *verb;
+	/** the api name */
+	char api[];
+};
+
+/** a bucket of recorded replies */
+struct bucket
+{
+	/** lock of the bucket */
+	x_mutex_t mutex;
+	/** the entries */
+	struct entry *entries;
+};
+
+/** invalidation of api/verb on event */
+struct trigger
+{
+	/** next trigger */
+	struct trigger *next;
+	/** the api name */
+	const char *api;
+	/** the verb name or NULL */
+	const char *verb;
+	/** the event name */
+	char event[];
+};
+
+/** key of a request waiting its reply */
+struct afb_req_cache_key
+{
+	/** the rule */
+	struct rule *rule;
+	/** generation of the rule */
+	unsigned generation;
+	/** hash of the key */
+	uint64_t hash;
+	/** length of the key */
+	size_t length;
+	/** allocated size of the key */
+	size_t size;
+	/** the key */
+	char key[];
+};
+
+/** count of enabled rules */
+static int active;
+
+/** count of triggers */
+static int triggered;
+
+/** the rules by bucket */
+static struct rule *rules[RULES_COUNT];
+
+/** the recorded replies by hash of their key */
+static struct bucket buckets[BUCKETS_COUNT];
+
+/** initialisation of buckets */
+static int initialized;
+
+/** the triggers */
+static struct trigger *triggers;
+
+/** mutex for modifying rules and for triggers */
+static x_mutex_t mutex = X_MUTEX_INITIALIZER;
+
+/******************************************************************************/
+
+/* returns the current time in microseconds */
+static uint64_t now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* initialise the buckets once, with mutex locked */
+static void init_locked()
+{
+	int idx;
+
+	if (!initialized) {
+		for (idx = 0 ; idx < BUCKETS_COUNT ; idx++)
+			x_mutex_init(&buckets[idx].mutex);
+		initialized = 1;
+	}
+}
+
+/* get the key of the entry */
+static inline char *entry_key(struct entry *entry)
+{
+	return (char*)&entry->replies[entry->nreplies];
+}
+
+/* get the bucket of the hash */
+static inline struct bucket *bucket_of(uint64_t hash)
+{
+	return &buckets[hash & (BUCKETS_COUNT - 1)];
+}
+
+/* release a list of entries */
+static void drop_entries(struct entry *entries)
+{
+	struct entry *entry;
+
+	while ((entry = entries) != NULL) {
+		entries = entry->next;
+		afb_data_array_unref(entry->nreplies, entry->replies);
+		free(entry);
+	}
+}
+
+/* get the head of the bucket of rules of api/verb */
+static struct rule **rules_of(const char *api, const char *verb)
+{
+	unsigned hash = 0;
+
+	while (*api)
+		hash = hash * 31 + (unsigned char)namefoldc(*api++);
+	while (*verb)
+		hash = hash * 31 + (unsigned char)namefoldc(*verb++);
+	return &rules[hash & (RULES_COUNT - 1)];
+}
+
+/* search the rule of api/verb */
+static struct rule *search_rule(const char *api, const char *verb)
+{
+	struct rule *rule;
+
+	rule = __atomic_load_n(rules_of(api, verb), __ATOMIC_ACQUIRE);
+	while (rule != NULL && (namecmp(rule->api, api) || namecmp(rule->verb, verb)))
+		rule = __atomic_load_n(&rule->next, __ATOMIC_ACQUIRE);
+	return rule;
+}
+
+/* remove the entry from its bucket */
+static void unlink_bucket(struct entry *entry)
+{
+	struct bucket *bucket = bucket_of(entry->hash);
+	struct entry **prv;
+
+	x_mutex_lock(&bucket->mutex);
+	for (prv = &bucket->entries ; *prv != entry ; prv = &(*prv)->next);
+	*prv = entry->next;
+	x_mutex_unlock(&bucket->mutex);
+}
+
+/* remove the entry from its rule */
+static void unlink_rule(struct rule *rule, struct entry *entry)
+{
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		rule->oldest = entry->newer;
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		rule->newest = entry->older;
+	rule->count--;
+}
+
+/* remove the entry of the rule and add it to the list, rule locked */
+static void remove_entry_locked(struct rule *rule, struct entry *entry, struct entry **list)
+{
+	unlink_bucket(entry);
+	unlink_rule(rule, entry);
+	entry->next = *list;
+	*list = entry;
+}
+
+/* invalidate the entries of the rule, adding dropped entries to list */
+static void invalidate_rule(struct rule *rule, struct entry **list)
+{
+	x_mutex_lock(&rule->mutex);
+	__atomic_add_fetch(&rule->generation, 1, __ATOMIC_RELAXED);
+	while (rule->oldest != NULL)
+		remove_entry_locked(rule, rule->oldest, list);
+	x_mutex_unlock(&rule->mutex);
+}
+
+/* invalidate the rules matching api/verb, adding dropped entries to list */
+static void invalidate_locked(const char *api, const char *verb, struct entry **list)
+{
+	struct rule *rule;
+	int idx;
+
+	for (idx = 0 ; idx < RULES_COUNT ; idx++)
+		for (rule = rules[idx] ; rule != NULL ; rule = rule->next)
+			if ((api == NULL || !namecmp(rule->api, api))
+			 && (verb == NULL || !namecmp(rule->verb, verb)))
+				invalidate_rule(rule, list);
+}
+
+/******************************************************************************/
+
+int afb_req_cache_enable(const char *api, const char *verb, unsigned ttlms, unsigned maxcount, int flags)
+{
+	struct rule *rule, **head;
+	struct entry *list = NULL;
+	size_t lenapi, lenverb;
+	int rc = 0;
+
+	x_mutex_lock(&mutex);
+	init_locked();
+	rule = search_rule(api, verb);
+	if (rule != NULL)
+		invalidate_rule(rule, &list);
+	else {
+		lenapi = strlen(api) + 1;
+		lenverb = strlen(verb) + 1;
+		rule = malloc(sizeof *rule + lenapi + lenverb);
+		if (rule == NULL)
+			rc = X_ENOMEM;
+		else {
+			memcpy(rule->api, api, lenapi);
+			rule->verb = memcpy(&rule->api[lenapi], verb, lenverb);
+			x_mutex_init(&rule->mutex);
+			rule->enabled = 0;
+			rule->generation = 0;
+			rule->count = 0;
+			rule->oldest = rule->newest = NULL;
+			head = rules_of(api, verb);
+			rule->next = *head;
+			__atomic_store_n(head, rule, __ATOMIC_RELEASE);
+		}
+	}
+	if (rule != NULL) {
+		x_mutex_lock(&rule->mutex);
+		__atomic_store_n(&rule->flags, flags, __ATOMIC_RELAXED);
+		rule->ttl = (uint64_t)ttlms * 1000;
+		rule->maxcount = maxcount ? maxcount : AFB_REQ_CACHE_DEFAULT_COUNT;
+		if (!rule->enabled) {
+			__atomic_store_n(&rule->enabled, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&active, 1, __ATOMIC_RELAXED);
+		}
+		x_mutex_unlock(&rule->mutex);
+	}
+	x_mutex_unlock(&mutex);
+	drop_entries(list);
+	return rc;
+}
+
+void afb_req_cache_disable(const char *api, const char *verb)
+{
+	struct rule *rule;
+	struct entry *list = NULL;
+
+	x_mutex_lock(&mutex);
+	rule = search_rule(api, verb);
+	if (rule != NULL && rule->enabled) {
+		/* rules are kept because waiting keys refer to them */
+		__atomic_store_n(&rule->enabled, 0, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&active, 1, __ATOMIC_RELAXED);
+		invalidate_rule(rule, &list);
+	}
+	x_mutex_unlock(&mutex);
+	drop_entries(list);
+}
+
+void afb_req_cache_invalidate(const char *api, const char *verb)
+{
+	struct entry *list = NULL;
+
+	x_mutex_lock(&mutex);
+	invalidate_locked(api, verb, &list);
+	x_mutex_unlock(&mutex);
+	drop_entries(list);
+}
+
+int afb_req_cache_invalidate_on_event(const char *api, const char *verb, const char *event)
+{
+	struct trigger *trigger;
+	size_t lenevt, lenapi, lenverb;
+	char *str;
+
+	lenevt = strlen(event) + 1;
+	lenapi = strlen(api) + 1;
+	lenverb = verb == NULL ? 0 : strlen(verb) + 1;
+	trigger = malloc(sizeof *trigger + lenevt + lenapi + lenverb);
+	if (trigger == NULL)
+		return X_ENOMEM;
+
+	str = mempcpy(trigger->event, event, lenevt);
+	trigger->api = str;
+	str = mempcpy(str, api, lenapi);
+	trigger->verb = verb == NULL ? NULL : memcpy(str, verb, lenverb);
+
+	x_mutex_lock(&mutex);
+	trigger->next = triggers;
+	triggers = trigger;
+	__atomic_add_fetch(&triggered, 1, __ATOMIC_RELAXED);
+	x_mutex_unlock(&mutex);
+	return 0;
+}
+
+void afb_req_cache_event(const char *event)
+{
+	struct trigger *trigger;
+	struct entry *list = NULL;
+
+	if (__atomic_load_n(&triggered, __ATOMIC_RELAXED) == 0)
+		return;
+
+	x_mutex_lock(&mutex);
+	for (trigger = triggers ; trigger != NULL ; trigger = trigger->next)
+		if (!namecmp(trigger->event, event))
+			invalidate_locked(trigger->api, trigger->verb, &list);
+	x_mutex_unlock(&mutex);
+	drop_entries(list);
+}
+
+/******************************************************************************/
+
+/* append bytes to the key, reallocating it if needed */
+static struct afb_req_cache_key *key_add(struct afb_req_cache_key *key, const void *bytes, size_t length)
+{
+	struct afb_req_cache_key *nkey;
+	const unsigned char *iter, *end;
+	uint64_t hash;
+	size_t size;
+
+	if (key == NULL)
+		return NULL;
+
+	if (key->length + length > key->size) {
+		size = key->size;
+		while (key->length + length > size)
+			size <<= 1;
+		nkey = realloc(key, sizeof *key + size);
+		if (nkey == NULL) {
+			free(key);
+			return NULL;
+		}
+		key = nkey;
+		key->size = size;
+	}
+
+	/* FNV-1a */
+	hash = key->hash;
+	for (iter = bytes, end = &iter[length] ; iter != end ; iter++)
+		hash = (hash ^ *iter) * 0x100000001b3ull;
+	key->hash = hash;
+
+	memcpy(&key->key[key->length], bytes, length);
+	key->length += length;
+	return key;
+}
+
+/* append the data to the key */
+static struct afb_req_cache_key *key_add_data(struct afb_req_cache_key *key, struct afb_data *data)
+{
+	struct afb_type *type;
+	struct afb_data *conv;
+	const char *name;
+	uint32_t size;
+
+	/* ensure that the data can be serialized */
+	type = afb_data_type(data);
+	if (afb_type_is_streamable(type))
+		conv = afb_data_addref(data);
+	else if (afb_data_convert(data, &afb_type_predefined_json, &conv) < 0) {
+		free(key);
+		return NULL;
+	}
+	else
+		type = &afb_type_predefined_json;
+
+	/* add the type name, the size and the bytes */
+	name = afb_type_name(type);
+	size = (uint32_t)afb_data_size(conv);
+	key = key_add(key, name, strlen(name) + 1);
+	key = key_add(key, &size, sizeof size);
+	key = key_add(key, afb_data_ro_pointer(conv), size);
+	afb_data_unref(conv);
+	return key;
+}
+
+/* make the key of the request */
+static struct afb_req_cache_key *make_key(struct afb_req_common *req, int flags)
+{
+	struct afb_req_cache_key *key;
+	const char *uuid;
+	unsigned idx;
+	int loa;
+
+	key = malloc(sizeof *key + 128);
+	if (key == NULL)
+		return NULL;
+	key->hash = 0xcbf29ce484222325ull;
+	key->length = 0;
+	key->size = 128;
+
+	if (flags & AFB_REQ_CACHE_SESSION) {
+		uuid = req->session == NULL ? "" : afb_session_uuid(req->session);
+		loa = req->session == NULL ? 0 : afb_session_get_loa(req->session, req->api);
+		key = key_add(key, uuid, strlen(uuid) + 1);
+		key = key_add(key, &loa, sizeof loa);
+	}
+	for (idx = 0 ; key != NULL && idx < req->params.ndata ; idx++)
+		key = key_add_data(key, req->params.data[idx]);
+	return key;
+}
+
+/* search the entry of key in its bucket, bucket locked */
+static struct entry **search_entry_locked(struct bucket *bucket, struct afb_req_cache_key *key)
+{
+	struct entry *entry, **prv;
+
+	for (prv = &bucket->entries ; (entry = *prv) != NULL ; prv = &entry->next)
+		if (entry->hash == key->hash
+		 && entry->rule == key->rule
+		 && entry->keylen == key->length
+		 && !memcmp(entry_key(entry), key->key, key->length))
+			return prv;
+	return NULL;
+}
+
+int afb_req_cache_process(struct afb_req_common *req)
+{
+	struct rule *rule;
+	struct entry *entry, **prv;
+	struct bucket *bucket;
+	struct afb_req_cache_key *key;
+	unsigned generation, nreplies;
+	int status;
+
+	if (__atomic_load_n(&active, __ATOMIC_RELAXED) == 0 || req->cachekey != NULL)
+		return 0;
+
+	/* is the verb cacheable? */
+	rule = search_rule(req->apiname, req->verbname);
+	if (rule == NULL || !__atomic_load_n(&rule->enabled, __ATOMIC_RELAXED))
+		return 0;
+	generation = __atomic_load_n(&rule->generation, __ATOMIC_RELAXED);
+
+	/* compute the key, its hash depending on the rule */
+	key = make_key(req, __atomic_load_n(&rule->flags, __ATOMIC_RELAXED));
+	if (key == NULL)
+		return 0;
+	key->rule = rule;
+	key->generation = generation;
+	key->hash ^= (uint64_t)(uintptr_t)rule * 0x9e3779b97f4a7c15ull;
+	key->hash ^= key->hash >> 32;
+
+	/* search the recorded reply, expired ones are removed when storing */
+	bucket = bucket_of(key->hash);
+	x_mutex_lock(&bucket->mutex);
+	prv = search_entry_locked(bucket, key);
+	if (prv == NULL || (*prv)->expire <= now_us()) {
+		x_mutex_unlock(&bucket->mutex);
+		/* record the key for storing the reply */
+		req->cachekey = key;
+		return 0;
+	}
+
+	/* reply the recorded reply */
+	entry = *prv;
+	nreplies = entry->nreplies;
+	status = entry->status;
+	{
+		struct afb_data *replies[nreplies];
+		memcpy(replies, entry->replies, nreplies * sizeof *replies);
+		afb_data_array_addref(nreplies, replies);
+		x_mutex_unlock(&bucket->mutex);
+		free(key);
+		afb_req_common_reply_hookable(req, status, nreplies, replies);
+		return 1;
+	}
+}
+
+void afb_req_cache_store(
+		struct afb_req_common *req,
+		int status,
+		unsigned nreplies,
+		struct afb_data * const replies[]
+) {
+	struct afb_req_cache_key *key;
+	struct entry *entry, *list = NULL, **prv, *previous;
+	struct bucket *bucket;
+	struct rule *rule;
+	uint64_t now;
+	unsigned idx;
+
+	key = req->cachekey;
+	if (key == NULL)
+		return;
+	req->cachekey = NULL;
+
+	/* only successful replies of not volatile data are recorded */
+	if (status < 0)
+		goto end;
+	for (idx = 0 ; idx < nreplies ; idx++)
+		if (afb_data_is_volatile(replies[idx]))
+			goto end;
+
+	/* create the entry */
+	entry = malloc(sizeof *entry + nreplies * sizeof *replies + key->length);
+	if (entry == NULL)
+		goto end;
+	entry->rule = rule = key->rule;
+	entry->hash = key->hash;
+	entry->keylen = key->length;
+	entry->status = status;
+	entry->nreplies = nreplies;
+	for (idx = 0 ; idx < nreplies ; idx++) {
+		afb_data_set_constant(replies[idx]);
+		entry->replies[idx] = afb_data_addref(replies[idx]);
+	}
+	memcpy(entry_key(entry), key->key, key->length);
+
+	/* record it if still valid */
+	x_mutex_lock(&rule->mutex);
+	if (!rule->enabled || rule->generation != key->generation) {
+		entry->next = NULL;
+		list = entry;
+	}
+	else {
+		/* remove the expired replies, the oldest expiring first */
+		now = now_us();
+		entry->expire = now + rule->ttl;
+		while (rule->oldest != NULL && rule->oldest->expire <= now)
+			remove_entry_locked(rule, rule->oldest, &list);
+
+		/* remove the previous reply */
+		bucket = bucket_of(key->hash);
+		x_mutex_lock(&bucket->mutex);
+		prv = search_entry_locked(bucket, key);
+		if (prv == NULL)
+			previous = NULL;
+		else {
+			previous = *prv;
+			*prv = previous->next;
+		}
+		x_mutex_unlock(&bucket->mutex);
+		if (previous != NULL) {
+			unlink_rule(rule, previous);
+			previous->next = list;
+			list = previous;
+		}
+
+		/* remove the oldest one if full */
+		if (rule->count >= rule->maxcount)
+			remove_entry_locked(rule, rule->oldest, &list);
+
+		/* add the entry */
+		x_mutex_lock(&bucket->mutex);
+		entry->next = bucket->entries;
+		bucket->entries = entry;
+		x_mutex_unlock(&bucket->mutex);
+		entry->newer = NULL;
+		entry->older = rule->newest;
+		if (rule->newest)
+			rule->newest->newer = entry;
+		else
+			rule->oldest = entry;
+		rule->newest = entry;
+		rule->count++;
+	}
+	x_mutex_unlock(&rule->mutex);
+	drop_entries(list);
+end:
+	free(key);
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#if WITH_AFB_REQ_CACHE
+
+#include <stdint.h>
+
+struct afb_req_common;
+struct afb_data;
+
+/**
+ * Cache of replies
+ * ----------------
+ *
+ * Replies of verbs declared cacheable are recorded and reused for
+ * later requests with the same parameters until they expire or are
+ * invalidated. The cache is consulted by the bindings after the verb
+ * is resolved and its session, LOA and permission checks succeeded, so
+ * a request is never replied from the cache if it would have been
+ * rejected. Requests replied from the cache are not processed by the
+ * verb. Verbs whose result depends on the client must be declared with
+ * AFB_REQ_CACHE_SESSION.
+ *
+ * The key of a recorded reply is made of the type and of the bytes of
+ * each parameter, and, if required, of the session of the request and
+ * of its LOA for the API.
+ * Parameters of types that can not be serialized are converted to JSON.
+ * Only successful replies (status >= 0) without volatile data are
+ * recorded. The recorded data are set constant and shared by reference.
+ */
+
+/** the key includes the session of the request and its LOA */
+#define AFB_REQ_CACHE_SESSION	1
+
+/** default count of recorded replies per verb */
+#define AFB_REQ_CACHE_DEFAULT_COUNT	64
+
+/**
+ * Enable caching of the replies of api/verb
+ *
+ * @param api      name of the api
+ * @param verb     name of the verb
+ * @param ttlms    time to live of recorded replies in milliseconds
+ * @param maxcount maximum count of recorded replies (0 for default)
+ * @param flags    flags (AFB_REQ_CACHE_SESSION)
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_req_cache_enable(const char *api, const char *verb, unsigned ttlms, unsigned maxcount, int flags);
+
+/**
+ * Disable caching of the replies of api/verb and drop its recorded replies
+ *
+ * @param api      name of the api
+ * @param verb     name of the verb
+ */
+extern void afb_req_cache_disable(const char *api, const char *verb);
+
+/**
+ * Drop the recorded replies of api/verb
+ *
+ * @param api      name of the api or NULL for any api
+ * @param verb     name of the verb or NULL for any verb
+ */
+extern void afb_req_cache_invalidate(const char *api, const char *verb);
+
+/**
+ * Drop the recorded replies of api/verb each time the event of name
+ * is pushed or broadcasted.
+ *
+ * @param api      name of the api
+ * @param verb     name of the verb or NULL for any verb of api
+ * @param event    full name of the event
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_req_cache_invalidate_on_event(const char *api, const char *verb, const char *event);
+
+/**
+ * Signal that the event of name is emitted
+ *
+ * @param event    full name of the event
+ */
+extern void afb_req_cache_event(const char *event);
+
+/**
+ * Reply to the request from the cache if possible. Otherwise, if the
+ * verb is cacheable, prepares the request for recording its reply.
+ * It must be called only once the verb checks of the request succeeded.
+ *
+ * @param req      the request to process
+ *
+ * @return 1 if the request was replied or 0 otherwise
+ */
+extern int afb_req_cache_process(struct afb_req_common *req);
+
+/**
+ * Record the reply of the request if it was prepared for it
+ *
+ * @param req      the replied request
+ * @param status   the status of the reply
+ * @param nreplies count of replied data
+ * @param replies  the replied data
+ */
+extern void afb_req_cache_store(
+		struct afb_req_common *req,
+		int status,
+		unsigned nreplies,
+		struct afb_data * const replies[]);
+
+#endif
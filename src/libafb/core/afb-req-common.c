@@ -23,10 +23,12 @@
 
 #include "../libafb-config.h"
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
 
 #if !WITHOUT_JSON_C
 #include <json-c/json.h>
@@ -53,11 +55,15 @@
 #include "core/afb-token.h"
 #include "core/afb-hook.h"
 #include "core/afb-req-common.h"
+#include "core/afb-req-stats.h"
+#include "core/afb-req-cache.h"
+#include "core/afb-req-prio.h"
 #include "core/afb-json-legacy.h"
 #include "core/afb-sched.h"
 #include "core/afb-session.h"
 #include "core/afb-perm.h"
 #include "core/afb-permission-text.h"
+#include "utils/namecmp.h"
 
 #include "containerof.h"
 
@@ -341,6 +347,52 @@ afb_req_common_set_token(
 	afb_token_unref(otoken);
 }
 
+/* returns the current time in ms of the monotonic clock */
+static uint64_t now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+/* is the deadline of the request passed? */
+static int is_expired(struct afb_req_common *req)
+{
+	return req->deadline != 0 && now_ms() >= req->deadline;
+}
+
+void
+afb_req_common_set_deadline(
+	struct afb_req_common *req,
+	uint64_t deadline
+) {
+	/* a deadline is never delayed */
+	if (deadline != 0 && (req->deadline == 0 || deadline < req->deadline))
+		req->deadline = deadline;
+}
+
+void
+afb_req_common_set_timeout(
+	struct afb_req_common *req,
+	int timeout
+) {
+	if (timeout > 0)
+		afb_req_common_set_deadline(req, now_ms() + (uint64_t)timeout * 1000);
+}
+
+int
+afb_req_common_get_timeout(
+	struct afb_req_common *req
+) {
+	uint64_t now;
+
+	if (req->deadline == 0)
+		return 0;
+	/* remaining seconds rounded up, at least one */
+	now = now_ms();
+	return req->deadline <= now ? 1 : (int)((req->deadline - now + 999) / 1000);
+}
+
 int
 afb_req_common_set_token_string(
 	struct afb_req_common *req,
@@ -381,6 +433,9 @@ afb_req_common_cleanup(
 #if WITH_CRED
 	afb_req_common_set_cred(req, NULL);
 #endif
+#if WITH_AFB_HOOK
+	afb_hook_release_req(req);
+#endif
 }
 
 static
@@ -450,7 +505,7 @@ afb_req_common_interface_by_name_hookable(
 /**
  * job callback for asynchronous and secured processing of the x2.
  */
-static void req_common_process_async_cb(int signum, void *arg)
+static void req_common_process_async_cb(int signum, void *arg, void *unused)
 {
 	struct afb_req_common *req = arg;
 	const struct afb_api_item *api;
@@ -459,8 +514,15 @@ static void req_common_process_async_cb(int signum, void *arg)
 		/* emit the error (assumes that hooking is initialised) */
 		RP_ERROR("received signal %d (%s) when processing request", signum, strsignal(signum));
 		afb_req_common_reply_internal_error_hookable(req, X_EINTR);
+	} else if (is_expired(req)) {
+		/* the caller doesn't wait anymore, don't process */
+		reply_error(req, AFB_ERRNO_TIMEOUT);
 	} else {
 		/* invoke api call method to process the x2 */
+#if WITH_AFB_REQ_STATS
+		if (req->statstimes[0])
+			req->statstimes[1] = afb_req_stats_now();
+#endif
 		api = req->api;
 		api->itf->process(api->closure, req);
 	}
@@ -468,12 +530,52 @@ static void req_common_process_async_cb(int signum, void *arg)
 	afb_req_common_unref(req);
 }
 
+#if WITH_SCHED_FIBERS
+/**
+ * kind of the jobs processing requests: their api/verb, so that only
+ * the verbs known to wait in 'afb_sched_sync' are run in fibers
+ */
+static const void *req_common_process_kind(void *arg1, void *arg2)
+{
+	struct afb_req_common *req = arg1;
+	const char *name;
+	uintptr_t hash = 0;
+
+	for (name = req->apiname ; *name ; name++)
+		hash = hash * 31 + (unsigned char)namefoldc(*name);
+	hash = hash * 31 + '/';
+	for (name = req->verbname ; *name ; name++)
+		hash = hash * 31 + (unsigned char)namefoldc(*name);
+	/* odd values don't match aligned callbacks */
+	return (const void*)(hash | 1);
+}
+#endif
+
+/**
+ * Post the job processing the request. The job is given the timeout
+ * of the apiset as limit of its execution time or, when shorter,
+ * the time remaining before the deadline of the request.
+ */
 static void req_common_process_api(struct afb_req_common *req, int timeout)
 {
-	int rc;
+	int rc, remain;
+#if WITH_SCHED_FIBERS
+	static char kind_set = 0;
+
+	if (!__atomic_load_n(&kind_set, __ATOMIC_RELAXED)) {
+		afb_sched_set_job_kind((const void*)req_common_process_async_cb, req_common_process_kind);
+		__atomic_store_n(&kind_set, 1, __ATOMIC_RELAXED);
+	}
+#endif
+
+	remain = afb_req_common_get_timeout(req);
+	if (remain > 0 && (timeout <= 0 || remain < timeout))
+		timeout = remain;
 
 	afb_req_common_addref(req);
-	rc = afb_sched_post_job(req->api->group, 0, timeout, req_common_process_async_cb, req, Afb_Sched_Mode_Normal);
+	rc = afb_sched_post_job_priority(req->api->group, 0, timeout,
+			afb_req_prio_get(req->apiname, req->verbname),
+			req_common_process_async_cb, req, NULL, Afb_Sched_Mode_Normal);
 	if (rc < 0) {
 		/* TODO: allows or not to proccess it directly as when no threading? (see above) */
 		RP_ERROR("can't process job with threads: %s", strerror(-rc));
@@ -487,6 +589,9 @@ static void req_common_process_api(struct afb_req_common *req, int timeout)
 static inline void req_common_process_api(struct afb_req_common *req, int timeout)
 {
 	const struct afb_api_item *api = req->api;
+#if WITH_AFB_REQ_STATS
+	req->statstimes[1] = req->statstimes[0];
+#endif
 	api->itf->process(api->closure, req);
 }
 
@@ -506,7 +611,15 @@ afb_req_common_process(
 	/* lookup at the api */
 	rc = afb_apiset_get_api(apiset, req->apiname, 1, 1, &req->api);
 	if (rc >= 0) {
-		req_common_process_api(req, afb_apiset_timeout_get(apiset));
+#if WITH_AFB_REQ_STATS
+		req->statstimes[0] = afb_req_stats_now();
+#endif
+		/* only an explicit deadline drops the request, the timeout
+		 * of the apiset limits the execution time of its job */
+		if (is_expired(req))
+			reply_error(req, AFB_ERRNO_TIMEOUT);
+		else
+			req_common_process_api(req, afb_apiset_timeout_get(apiset));
 	}
 	else if (rc == X_ENOENT) {
 		afb_req_common_reply_api_unknown_error_hookable(req);
@@ -1069,6 +1182,14 @@ afb_req_common_reply(
 	else {
 		/* first reply, so emit it */
 		req->replied = 1;
+#if WITH_AFB_REQ_STATS
+		if (req->statstimes[1])
+			afb_req_stats_record(req, status, nreplies, replies);
+#endif
+#if WITH_AFB_REQ_CACHE
+		if (req->cachekey)
+			afb_req_cache_store(req, status, nreplies, replies);
+#endif
 #if WITH_AFB_CALL_SYNC
 		do_reply_sync(req, status, nreplies, replies);
 #else
@@ -40,6 +40,7 @@ struct afb_session;
 
 struct afb_auth;
 struct afb_event_x2;
+struct afb_hook_reqs;
 
 #if WITH_AFB_CALL_SYNC
 struct afb_sched_lock;
@@ -132,6 +133,18 @@ struct afb_req_common
 	unsigned hookflags;
 	/** hook index of the request if hooked */
 	unsigned hookindex;
+	/** mask of the hooks of the snapshot applying to the request */
+	uint64_t hookmask;
+	/** snapshot of the hooks when the request was hooked */
+	struct afb_hook_reqs *hooks;
+#endif
+#if WITH_AFB_REQ_STATS
+	/** times of enqueuing and of processing for statistics */
+	uint64_t statstimes[2];
+#endif
+#if WITH_AFB_REQ_CACHE
+	/** key for recording the reply in the cache */
+	struct afb_req_cache_key *cachekey;
 #endif
 	/** preallocated stack for asynchronous processing */
 	void *asyncitems[REQ_COMMON_NASYNC];
@@ -164,6 +177,9 @@ struct afb_req_common
 	/** the parameters (arguments) of the request */
 	struct afb_req_common_arg params;
 
+	/** deadline in ms of the monotonic clock or 0 when none */
+	uint64_t deadline;
+
 #if WITH_AFB_CALL_SYNC && WITH_REPLY_JOB
 	union {
 #endif
@@ -303,6 +319,26 @@ afb_req_common_set_token(
 	struct afb_token *token
 );
 
+extern
+void
+afb_req_common_set_deadline(
+	struct afb_req_common *req,
+	uint64_t deadline
+);
+
+extern
+void
+afb_req_common_set_timeout(
+	struct afb_req_common *req,
+	int timeout
+);
+
+extern
+int
+afb_req_common_get_timeout(
+	struct afb_req_common *req
+);
+
 extern
 int
 afb_req_common_set_session_string(
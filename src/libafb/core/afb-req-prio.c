@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "../libafb-config.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/afb-req-prio.h"
+#include "sys/x-mutex.h"
+#include "sys/x-errno.h"
+#include "utils/namecmp.h"
+
+/** count of buckets of the rules, a power of 2 */
+#define BUCKET_COUNT 16
+
+/** value of the priority of a rule unset */
+#define UNSET        -1
+
+/**
+ * priority of an api/verb
+ *
+ * The rules are read without lock: once published in their bucket,
+ * they are never removed nor freed, unsetting only marks them UNSET.
+ * The count of rules is bounded by the count of api/verb configured.
+ */
+struct rule
+{
+	/** next rule of the bucket */
+	struct rule *next;
+	/** the priority or UNSET */
+	int priority;
+	/** the verb name (follows the api name) or NULL for the api */
+	const char *verb;
+	/** the api name */
+	char api[];
+};
+
+/** count of rules set */
+static int count;
+
+/** the rules by bucket */
+static struct rule *buckets[BUCKET_COUNT];
+
+/** mutex for modifying rules */
+static x_mutex_t mutex = X_MUTEX_INITIALIZER;
+
+/******************************************************************************/
+
+/* compute the bucket of api/verb */
+static struct rule **bucket(const char *api, const char *verb)
+{
+	unsigned hash = 0;
+
+	while (*api)
+		hash = hash * 31 + (unsigned char)namefoldc(*api++);
+	if (verb != NULL)
+		while (*verb)
+			hash = hash * 31 + (unsigned char)namefoldc(*verb++);
+	return &buckets[hash & (BUCKET_COUNT - 1)];
+}
+
+/* search the rule of api/verb */
+static struct rule *search_rule(const char *api, const char *verb)
+{
+	struct rule *rule;
+
+	rule = __atomic_load_n(bucket(api, verb), __ATOMIC_ACQUIRE);
+	while (rule != NULL
+	    && (namecmp(rule->api, api)
+	     || (verb == NULL ? rule->verb != NULL : rule->verb == NULL || namecmp(rule->verb, verb))))
+		rule = __atomic_load_n(&rule->next, __ATOMIC_ACQUIRE);
+	return rule;
+}
+
+/* get the priority of the rule of api/verb or UNSET */
+static int get_priority(const char *api, const char *verb)
+{
+	struct rule *rule = search_rule(api, verb);
+	return rule == NULL ? UNSET : __atomic_load_n(&rule->priority, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************/
+
+int afb_req_prio_set(const char *api, const char *verb, enum afb_jobs_priority priority)
+{
+	struct rule *rule, **head;
+	size_t lenapi, lenverb;
+	int rc = 0;
+
+	x_mutex_lock(&mutex);
+	rule = search_rule(api, verb);
+	if (rule == NULL) {
+		lenapi = strlen(api) + 1;
+		lenverb = verb == NULL ? 0 : strlen(verb) + 1;
+		rule = malloc(sizeof *rule + lenapi + lenverb);
+		if (rule == NULL)
+			rc = X_ENOMEM;
+		else {
+			memcpy(rule->api, api, lenapi);
+			rule->verb = verb == NULL ? NULL : memcpy(&rule->api[lenapi], verb, lenverb);
+			rule->priority = UNSET;
+			head = bucket(api, verb);
+			rule->next = *head;
+			__atomic_store_n(head, rule, __ATOMIC_RELEASE);
+		}
+	}
+	if (rule != NULL) {
+		if (rule->priority == UNSET)
+			__atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&rule->priority, (int)priority, __ATOMIC_RELAXED);
+	}
+	x_mutex_unlock(&mutex);
+	return rc;
+}
+
+void afb_req_prio_unset(const char *api, const char *verb)
+{
+	struct rule *rule;
+
+	x_mutex_lock(&mutex);
+	rule = search_rule(api, verb);
+	if (rule != NULL && rule->priority != UNSET) {
+		__atomic_store_n(&rule->priority, UNSET, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&count, 1, __ATOMIC_RELAXED);
+	}
+	x_mutex_unlock(&mutex);
+}
+
+enum afb_jobs_priority afb_req_prio_get(const char *api, const char *verb)
+{
+	int priority;
+
+	/* fast path without rules */
+	if (__atomic_load_n(&count, __ATOMIC_RELAXED) == 0)
+		return Afb_Jobs_Priority_Normal;
+
+	/* lockless search of the verb then of the api */
+	priority = verb == NULL ? UNSET : get_priority(api, verb);
+	if (priority == UNSET)
+		priority = get_priority(api, NULL);
+	return priority == UNSET ? Afb_Jobs_Priority_Normal : (enum afb_jobs_priority)priority;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#include "afb-jobs.h"
+
+/**
+ * Priorities of requests
+ * ----------------------
+ *
+ * The jobs processing requests are posted with the priority recorded
+ * for their verb or, when none is recorded for the verb, with the
+ * priority recorded for their api. Otherwise, the priority is normal.
+ */
+
+/**
+ * Record the priority of the requests to api/verb
+ *
+ * @param api      name of the api
+ * @param verb     name of the verb or NULL for any verb of api
+ * @param priority the priority to set
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_req_prio_set(const char *api, const char *verb, enum afb_jobs_priority priority);
+
+/**
+ * Forget the priority recorded for api/verb
+ *
+ * @param api      name of the api
+ * @param verb     name of the verb or NULL for any verb of api
+ */
+extern void afb_req_prio_unset(const char *api, const char *verb);
+
+/**
+ * Get the priority of the requests to api/verb
+ *
+ * @param api      name of the api
+ * @param verb     name of the verb
+ *
+ * @return the priority of the requests
+ */
+extern enum afb_jobs_priority afb_req_prio_get(const char *api, const char *verb);
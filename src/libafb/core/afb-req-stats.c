@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "../libafb-config.h"
+
+#if WITH_AFB_REQ_STATS
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "core/afb-req-stats.h"
+#include "core/afb-req-common.h"
+#include "core/afb-data.h"
+#include "sys/x-mutex.h"
+#include "sys/x-thread.h"
+#include "sys/x-errno.h"
+
+/** count of hash heads, must be a power of 2 */
+#define HEADS_COUNT 256
+
+/** statistics of one api/verb */
+struct entry
+{
+	/** next entry of same hash */
+	struct entry *next;
+	/** hash of the api/verb */
+	uint32_t hash;
+	/** the verb name (follows the api name) */
+	const char *verb;
+	/** the values */
+	struct afb_req_stats_values values;
+	/** the api name */
+	char api[];
+};
+
+/** table of statistics of a thread */
+struct table
+{
+	/** next table */
+	struct table *next;
+	/** is the table used by a thread? */
+	int used;
+	/** generation of the values */
+	unsigned generation;
+	/** the entries */
+	struct entry *heads[HEADS_COUNT];
+};
+
+/** is recording enabled? */
+static int enabled = 1;
+
+/** current generation, incremented on reset */
+static unsigned generation;
+
+/** list of the tables */
+static struct table *tables;
+
+/** mutex protecting the list of tables */
+static x_mutex_t mutex = X_MUTEX_INITIALIZER;
+
+/** key for releasing tables of terminated threads */
+static pthread_key_t key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+/** table of the current thread */
+X_TLS(struct table,stats_table)
+
+/******************************************************************************/
+
+/* hash of api/verb */
+static uint32_t hash_of(const char *api, const char *verb)
+{
+	uint32_t hash = 2166136261u;
+	while (*api)
+		hash = (hash ^ (unsigned char)*api++) * 16777619u;
+	hash = (hash ^ '/') * 16777619u;
+	while (*verb)
+		hash = (hash ^ (unsigned char)*verb++) * 16777619u;
+	return hash;
+}
+
+/* index of the bucket of the value */
+static unsigned bucket_of(uint32_t value)
+{
+	unsigned msb;
+
+	if (value < (1u << AFB_REQ_STATS_SUBBITS))
+		return value;
+	msb = 31 - (unsigned)__builtin_clz(value);
+	return ((msb - AFB_REQ_STATS_SUBBITS + 1) << AFB_REQ_STATS_SUBBITS)
+		+ ((value >> (msb - AFB_REQ_STATS_SUBBITS)) & ((1u << AFB_REQ_STATS_SUBBITS) - 1));
+}
+
+/* highest value of the bucket of index */
+static uint32_t highest_of(unsigned index)
+{
+	unsigned shift;
+	uint64_t low;
+
+	if (index < (1u << AFB_REQ_STATS_SUBBITS))
+		return index;
+	shift = (index >> AFB_REQ_STATS_SUBBITS) - 1;
+	low = (uint64_t)((1u << AFB_REQ_STATS_SUBBITS) | (index & ((1u << AFB_REQ_STATS_SUBBITS) - 1))) << shift;
+	return (uint32_t)(low + ((uint64_t)1 << shift) - 1);
+}
+
+/* add the value to the histogram */
+static void histo_add(struct afb_req_stats_histo *histo, uint64_t value)
+{
+	uint32_t val = value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+
+	if (histo->count == 0 || val < histo->min)
+		histo->min = val;
+	if (val > histo->max)
+		histo->max = val;
+	histo->count++;
+	histo->sum += val;
+	histo->buckets[bucket_of(val)]++;
+}
+
+/* merge the histogram from in the histogram to */
+static void histo_merge(struct afb_req_stats_histo *to, const struct afb_req_stats_histo *from)
+{
+	unsigned idx;
+
+	if (from->count) {
+		if (to->count == 0 || from->min < to->min)
+			to->min = from->min;
+		if (from->max > to->max)
+			to->max = from->max;
+		to->count += from->count;
+		to->sum += from->sum;
+		for (idx = 0 ; idx < AFB_REQ_STATS_BUCKETS ; idx++)
+			to->buckets[idx] += from->buckets[idx];
+	}
+}
+
+/* merge the values from in the values to */
+static void values_merge(struct afb_req_stats_values *to, const struct afb_req_stats_values *from)
+{
+	to->count += from->count;
+	to->errors += from->errors;
+	histo_merge(&to->wait, &from->wait);
+	histo_merge(&to->exec, &from->exec);
+	histo_merge(&to->size, &from->size);
+}
+
+/* search the entry of api/verb in the heads */
+static struct entry *search(struct entry **heads, uint32_t hash, const char *api, const char *verb)
+{
+	struct entry *entry;
+
+	entry = __atomic_load_n(&heads[hash & (HEADS_COUNT - 1)], __ATOMIC_ACQUIRE);
+	while (entry && (entry->hash != hash || strcmp(entry->api, api) || strcmp(entry->verb, verb)))
+		entry = entry->next;
+	return entry;
+}
+
+/* create the entry of api/verb in the heads */
+static struct entry *create(struct entry **heads, uint32_t hash, const char *api, const char *verb)
+{
+	struct entry *entry, **head;
+	size_t lapi, lverb;
+
+	lapi = strlen(api) + 1;
+	lverb = strlen(verb) + 1;
+	entry = calloc(1, sizeof *entry + lapi + lverb);
+	if (entry) {
+		memcpy(entry->api, api, lapi);
+		memcpy(&entry->api[lapi], verb, lverb);
+		entry->verb = &entry->api[lapi];
+		entry->hash = hash;
+		head = &heads[hash & (HEADS_COUNT - 1)];
+		entry->next = *head;
+		/* publish the entry to readers */
+		__atomic_store_n(head, entry, __ATOMIC_RELEASE);
+	}
+	return entry;
+}
+
+/* free the entries of the heads */
+static void destroy(struct entry **heads)
+{
+	struct entry *entry;
+	unsigned idx;
+
+	for (idx = 0 ; idx < HEADS_COUNT ; idx++) {
+		while ((entry = heads[idx])) {
+			heads[idx] = entry->next;
+			free(entry);
+		}
+	}
+}
+
+/******************************************************************************/
+
+/* release the table of a terminating thread */
+static void release_table(void *arg)
+{
+	struct table *table = arg;
+	__atomic_store_n(&table->used, 0, __ATOMIC_RELEASE);
+}
+
+/* create the key */
+static void create_key(void)
+{
+	pthread_key_create(&key, release_table);
+}
+
+/* get the table of the current thread */
+static struct table *get_table(void)
+{
+	struct table *table;
+	int zero;
+
+	table = x_tls_get_stats_table();
+	if (table == NULL) {
+		pthread_once(&key_once, create_key);
+		x_mutex_lock(&mutex);
+		/* reuse a table of a terminated thread */
+		for (table = tables ; table ; table = table->next) {
+			zero = 0;
+			if (__atomic_compare_exchange_n(&table->used, &zero, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				break;
+		}
+		if (table == NULL) {
+			table = calloc(1, sizeof *table);
+			if (table != NULL) {
+				table->used = 1;
+				table->generation = generation;
+				table->next = tables;
+				__atomic_store_n(&tables, table, __ATOMIC_RELEASE);
+			}
+		}
+		x_mutex_unlock(&mutex);
+		if (table != NULL) {
+			pthread_setspecific(key, table);
+			x_tls_set_stats_table(table);
+		}
+	}
+	return table;
+}
+
+/* reset the values of the table if its generation is obsolete */
+static void check_generation(struct table *table)
+{
+	unsigned gen, idx;
+	struct entry *entry;
+
+	gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+	if (table->generation != gen) {
+		for (idx = 0 ; idx < HEADS_COUNT ; idx++)
+			for (entry = table->heads[idx] ; entry ; entry = entry->next)
+				memset(&entry->values, 0, sizeof entry->values);
+		__atomic_store_n(&table->generation, gen, __ATOMIC_RELEASE);
+	}
+}
+
+/******************************************************************************/
+
+void afb_req_stats_enable(int enable)
+{
+	__atomic_store_n(&enabled, !!enable, __ATOMIC_RELAXED);
+}
+
+int afb_req_stats_is_enabled(void)
+{
+	return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+uint64_t afb_req_stats_now(void)
+{
+	struct timespec ts;
+
+	if (!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000 + 1;
+}
+
+void afb_req_stats_record(
+	struct afb_req_common *req,
+	int status,
+	unsigned nreplies,
+	struct afb_data * const replies[]
+) {
+	struct table *table;
+	struct entry *entry;
+	uint64_t now, size;
+	uint32_t hash;
+	const char *api, *verb;
+
+	now = afb_req_stats_now();
+	if (now == 0 || req->statstimes[1] == 0)
+		return;
+
+	table = get_table();
+	if (table == NULL)
+		return;
+	check_generation(table);
+
+	/* get the entry */
+	api = req->apiname ?: "";
+	verb = req->verbname ?: "";
+	hash = hash_of(api, verb);
+	entry = search(table->heads, hash, api, verb);
+	if (entry == NULL) {
+		entry = create(table->heads, hash, api, verb);
+		if (entry == NULL)
+			return;
+	}
+
+	/* record the values */
+	size = 0;
+	while (nreplies)
+		size += afb_data_size(replies[--nreplies]);
+	entry->values.count++;
+	if (status < 0)
+		entry->values.errors++;
+	histo_add(&entry->values.wait, req->statstimes[1] - req->statstimes[0]);
+	histo_add(&entry->values.exec, now - req->statstimes[1]);
+	histo_add(&entry->values.size, size);
+}
+
+int afb_req_stats_snapshot(afb_req_stats_cb_t callback, void *closure)
+{
+	struct entry *heads[HEADS_COUNT];
+	struct table *table;
+	struct entry *entry, *merged;
+	unsigned idx, gen;
+	int rc;
+
+	rc = 0;
+	memset(heads, 0, sizeof heads);
+	gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+
+	/* merge the values of the tables of current generation */
+	for (table = __atomic_load_n(&tables, __ATOMIC_ACQUIRE) ; table && rc == 0 ; table = table->next) {
+		if (__atomic_load_n(&table->generation, __ATOMIC_ACQUIRE) != gen)
+			continue;
+		for (idx = 0 ; idx < HEADS_COUNT && rc == 0 ; idx++) {
+			entry = __atomic_load_n(&table->heads[idx], __ATOMIC_ACQUIRE);
+			for ( ; entry && rc == 0 ; entry = entry->next) {
+				merged = search(heads, entry->hash, entry->api, entry->verb);
+				if (merged == NULL)
+					merged = create(heads, entry->hash, entry->api, entry->verb);
+				if (merged == NULL)
+					rc = X_ENOMEM;
+				else
+					values_merge(&merged->values, &entry->values);
+			}
+		}
+	}
+
+	/* report the merged values */
+	for (idx = 0 ; idx < HEADS_COUNT && rc == 0 ; idx++)
+		for (entry = heads[idx] ; entry ; entry = entry->next)
+			if (entry->values.count)
+				callback(closure, entry->api, entry->verb, &entry->values);
+
+	destroy(heads);
+	return rc;
+}
+
+void afb_req_stats_reset(void)
+{
+	__atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+}
+
+uint32_t afb_req_stats_quantile(const struct afb_req_stats_histo *histo, double quantile)
+{
+	uint64_t rank, acc;
+	unsigned idx;
+	uint32_t value;
+
+	if (histo->count == 0)
+		return 0;
+	if (quantile <= 0)
+		return histo->min;
+	if (quantile >= 1)
+		return histo->max;
+
+	rank = (uint64_t)(quantile * (double)histo->count);
+	if (rank >= histo->count)
+		rank = histo->count - 1;
+	for (acc = 0, idx = 0 ; idx < AFB_REQ_STATS_BUCKETS ; idx++) {
+		acc += histo->buckets[idx];
+		if (acc > rank)
+			break;
+	}
+	value = highest_of(idx);
+	return value < histo->min ? histo->min : value > histo->max ? histo->max : value;
+}
+
+#endif
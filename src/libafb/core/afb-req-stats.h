@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#if WITH_AFB_REQ_STATS
+
+#include <stdint.h>
+
+struct afb_req_common;
+struct afb_data;
+
+/**
+ * Statistics of requests
+ * ----------------------
+ *
+ * For each api/verb, the count of replied requests, the count of
+ * replies with an error status and three histograms are recorded:
+ *
+ *  - wait: time in microseconds between the enqueuing of the request
+ *          and the start of its processing
+ *  - exec: time in microseconds between the start of the processing
+ *          and the reply
+ *  - size: cumulated size in bytes of the data of the reply
+ *
+ * Histograms are log-linear (HDR like): values below 2^SUBBITS are
+ * exact, greater values are counted in 2^SUBBITS buckets per power of
+ * two, giving a relative error lower than 2^-SUBBITS.
+ *
+ * Each thread records in its own tables, without lock. Snapshots
+ * merge the tables of all threads.
+ */
+
+/** count of bits of precision of histograms */
+#define AFB_REQ_STATS_SUBBITS	3
+
+/** count of buckets of histograms (values are clamped to 32 bits) */
+#define AFB_REQ_STATS_BUCKETS	((33 - AFB_REQ_STATS_SUBBITS) << AFB_REQ_STATS_SUBBITS)
+
+/** histogram of values */
+struct afb_req_stats_histo
+{
+	/** count of values */
+	uint64_t count;
+	/** sum of the values */
+	uint64_t sum;
+	/** minimal value */
+	uint32_t min;
+	/** maximal value */
+	uint32_t max;
+	/** the buckets */
+	uint32_t buckets[AFB_REQ_STATS_BUCKETS];
+};
+
+/** statistics of one api/verb */
+struct afb_req_stats_values
+{
+	/** count of replied requests */
+	uint64_t count;
+	/** count of replies with a negative status */
+	uint64_t errors;
+	/** histogram of waiting times in microseconds */
+	struct afb_req_stats_histo wait;
+	/** histogram of execution times in microseconds */
+	struct afb_req_stats_histo exec;
+	/** histogram of sizes of replies in bytes */
+	struct afb_req_stats_histo size;
+};
+
+/**
+ * Callback receiving merged statistics
+ *
+ * @param closure the closure
+ * @param api     the name of the api
+ * @param verb    the name of the verb
+ * @param values  the merged values for api/verb
+ */
+typedef void (*afb_req_stats_cb_t)(
+		void *closure,
+		const char *api,
+		const char *verb,
+		const struct afb_req_stats_values *values);
+
+/**
+ * Enable or disable recording of statistics
+ *
+ * @param enable boolean telling if enabled or not
+ */
+extern void afb_req_stats_enable(int enable);
+
+/**
+ * Is recording of statistics enabled?
+ *
+ * @return 1 if enabled or 0 otherwise
+ */
+extern int afb_req_stats_is_enabled(void);
+
+/**
+ * Get the current time for statistics or zero if not enabled.
+ *
+ * @return the time in microseconds or zero
+ */
+extern uint64_t afb_req_stats_now(void);
+
+/**
+ * Record the statistics of the reply of the request
+ *
+ * @param req      the replied request
+ * @param status   the status of the reply
+ * @param nreplies count of replied data
+ * @param replies  the replied data
+ */
+extern void afb_req_stats_record(
+		struct afb_req_common *req,
+		int status,
+		unsigned nreplies,
+		struct afb_data * const replies[]);
+
+/**
+ * Merge the statistics of all threads and call the callback
+ * for each api/verb.
+ *
+ * @param callback the callback to call
+ * @param closure  closure of the callback
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_req_stats_snapshot(afb_req_stats_cb_t callback, void *closure);
+
+/**
+ * Reset the statistics
+ */
+extern void afb_req_stats_reset(void);
+
+/**
+ * Get the value at the given quantile of the histogram. The
+ * returned value is the highest value equivalent to the bucket
+ * of the quantile.
+ *
+ * @param histo    the histogram
+ * @param quantile the quantile, from 0 to 1 (ex: 0.99 for p99)
+ *
+ * @return the value at the given quantile
+ */
+extern uint32_t afb_req_stats_quantile(const struct afb_req_stats_histo *histo, double quantile);
+
+#endif
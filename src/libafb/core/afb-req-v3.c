@@ -50,6 +50,7 @@
 #include "core/afb-hook.h"
 #include "core/afb-json-legacy.h"
 #include "core/afb-req-common.h"
+#include "core/afb-req-cache.h"
 #include "core/afb-req-v3.h"
 #include "core/afb-error-text.h"
 #include "core/afb-sched.h"
@@ -539,6 +540,11 @@ static void call_checked_v3(void *closure, int status)
 	struct afb_req_v3 *req = closure;
 	const struct afb_verb_v3 *verb;
 
+#if WITH_AFB_REQ_CACHE
+	/* reply from the cache only when the checks succeeded */
+	if (status > 0 && afb_req_cache_process(req->comreq))
+		status = 0;
+#endif
 	if (status > 0) {
 		verb = (const struct afb_verb_v3*)req->x2.vcbdata;
 		req->x2.vcbdata = verb->vcbdata;
@@ -44,6 +44,7 @@
 #include "core/afb-cred.h"
 #include "core/afb-hook.h"
 #include "core/afb-req-common.h"
+#include "core/afb-req-cache.h"
 #include "core/afb-req-v4.h"
 #include "core/afb-sched.h"
 
@@ -510,6 +511,11 @@ static void call_checked_v4(void *closure, int status)
 {
 	struct afb_req_v4 *reqv4 = closure;
 
+#if WITH_AFB_REQ_CACHE
+	/* reply from the cache only when the checks succeeded */
+	if (status > 0 && afb_req_cache_process(reqv4->comreq))
+		status = 0;
+#endif
 	if (status > 0)
 		reqv4->verb->callback(
 			reqv4,
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <signal.h>
 
 #include <rp-utils/rp-verbose.h>
 
@@ -43,6 +44,7 @@
 #include "core/afb-ev-mgr.h"
 #include "sys/ev-mgr.h"
 #include "core/afb-sig-monitor.h"
+#include "core/afb-fibers.h"
 
 #define AFB_SCHED_WAIT_IDLE_MINIMAL_EXPIRATION	 30 /* thirty seconds */
 #define AFB_SCHED_EXITING_EXPIRATION	         2 //10 /* ten seconds */
@@ -75,6 +77,17 @@ struct sync_job
 
 	/** the argument of the job's callback */
 	void *arg;
+
+#if WITH_SCHED_FIBERS
+	/** the suspended fiber waiting the leave */
+	struct afb_fiber *fiber;
+
+	/** the timeout in seconds */
+	int timeout;
+
+	/** id of the job handling the timeout */
+	int timeoutjob;
+#endif
 };
 
 /* synchronisation of threads */
@@ -99,6 +112,38 @@ static struct exiting *pexiting = 0;
 #define ACTIVE_EVMGR 2
 static int8_t activity = 0;
 
+/* waiting time in ms of jobs that grows the threads, 0 if not adaptive */
+static int grow_wait_ms = 0;
+
+#if WITH_SCHED_FIBERS
+/* are jobs run in fibers? */
+static int8_t fibers = 0;
+
+/* size of the set of kinds of jobs that synchronize, a power of 2 */
+#if !defined(AFB_SCHED_SYNCING_COUNT)
+#  define AFB_SCHED_SYNCING_COUNT 256
+#endif
+
+/* maximum count of callbacks having their own kinds of jobs */
+#if !defined(AFB_SCHED_KINDS_COUNT)
+#  define AFB_SCHED_KINDS_COUNT 4
+#endif
+
+/* kinds of the jobs known to call 'afb_sched_sync' */
+static const void *syncing[AFB_SCHED_SYNCING_COUNT];
+
+/* callbacks whose jobs have a kind computed from their arguments */
+static struct {
+	const void *callback;
+	const void *(*kind)(void *arg1, void *arg2);
+} kinds[AFB_SCHED_KINDS_COUNT];
+static int kinds_count = 0;
+static x_mutex_t kinds_mutex = X_MUTEX_INITIALIZER;
+
+/* kind of the job run by the thread outside of a fiber */
+X_TLS(const void,running)
+#endif
+
 /**
  * run the event loop
  */
@@ -114,15 +159,92 @@ static void evloop_sig_run(int signum, void *closure)
 	}
 }
 
+#if WITH_SCHED_FIBERS
+/**
+ * Search the kind in the set of syncing kinds,
+ * add it if 'add' is not zero
+ *
+ * @return 1 if the kind is in the set or 0 otherwise
+ */
+static int syncing_search(const void *kind, int add)
+{
+	unsigned idx, count;
+	const void *cur;
+
+	idx = (unsigned)((uintptr_t)kind >> 4) * 2654435761u;
+	for (count = AFB_SCHED_SYNCING_COUNT ; count ; count--, idx++) {
+		cur = __atomic_load_n(&syncing[idx % AFB_SCHED_SYNCING_COUNT], __ATOMIC_RELAXED);
+		if (cur == kind)
+			return 1;
+		if (cur == NULL) {
+			if (!add)
+				return 0;
+			if (__atomic_compare_exchange_n(&syncing[idx % AFB_SCHED_SYNCING_COUNT],
+					&cur, kind, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+			 || cur == kind)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Get the kind of the job: the kind computed from its arguments
+ * when recorded for its callback, or its callback otherwise
+ */
+static const void *job_kind(struct afb_job *job)
+{
+	const void *callback = afb_jobs_get_callback(job);
+	void *arg1, *arg2;
+	int idx;
+
+	idx = __atomic_load_n(&kinds_count, __ATOMIC_ACQUIRE);
+	while (idx > 0)
+		if (kinds[--idx].callback == callback) {
+			afb_jobs_get_args(job, &arg1, &arg2);
+			return kinds[idx].kind(arg1, arg2);
+		}
+	return callback;
+}
+
+static void run_job_in_fiber(void *arg)
+{
+	afb_jobs_run(arg);
+}
+
+/**
+ * Run the job in a fiber if its kind is known to synchronize.
+ * Otherwise, run it on the thread, switching stacks being useless.
+ */
+static void run_job_fibers(struct afb_job *job)
+{
+	const void *kind, *previous;
+
+	kind = job_kind(job);
+	if (!syncing_search(kind, 0) || afb_fiber_start(run_job_in_fiber, job) < 0) {
+		previous = x_tls_get_running();
+		x_tls_set_running(kind);
+		afb_jobs_run(job);
+		x_tls_set_running(previous);
+	}
+}
+#endif
+
 static void run_one_job(void *arg, x_thread_t tid)
 {
 	struct afb_job *job = arg;
-	afb_jobs_run(job);
+#if WITH_SCHED_FIBERS
+	if (fibers)
+		run_job_fibers(job);
+	else
+#endif
+		afb_jobs_run(job);
 	afb_ev_mgr_release(tid);
 }
 
 static void run_ev_loop(void *arg, x_thread_t tid)
 {
+	afb_threads_elect_evloop();
 	afb_sig_monitor_run(0, evloop_sig_run, arg);
 }
 
@@ -162,8 +284,13 @@ static int get_job_cb(void *closure, afb_threads_job_desc_t *desc, x_thread_t ti
  */
 static void adapt(enum afb_sched_mode mode)
 {
-	if (activity & ACTIVE_JOBS)
-		afb_threads_start_cond(mode == Afb_Sched_Mode_Start);
+	if (activity & ACTIVE_JOBS) {
+		if (grow_wait_ms > 0 && mode != Afb_Sched_Mode_Start
+		 && afb_jobs_get_oldest_wait() >= grow_wait_ms)
+			afb_threads_grow();
+		else
+			afb_threads_start_cond(mode == Afb_Sched_Mode_Start);
+	}
 }
 
 /* Schedule the given job */
@@ -205,6 +332,27 @@ int afb_sched_post_job2(
 	return rc;
 }
 
+/* Schedule the given job */
+int afb_sched_post_job_priority(
+	const void *group,
+	long delayms,
+	int timeout,
+	enum afb_jobs_priority priority,
+	void (*callback)(int, void*, void*),
+	void *arg1,
+	void *arg2,
+	enum afb_sched_mode mode
+) {
+	int rc;
+	rc = afb_jobs_post_priority(group, delayms, timeout, priority, callback, arg1, arg2);
+	if (rc >= 0) {
+		adapt(mode);
+		if (delayms)
+			afb_ev_mgr_wakeup();
+	}
+	return rc;
+}
+
 /* Schedule the given job */
 int afb_sched_abort_job(int jobid)
 {
@@ -226,6 +374,75 @@ static struct sync_job *get_sync_job(uintptr_t id)
 	return sync;
 }
 
+#if WITH_SCHED_FIBERS
+/**
+ * Job resuming the fiber given by 'closure'
+ */
+static void resume_cb(int signum, void *closure)
+{
+	if (signum == 0)
+		afb_fiber_resume(closure);
+}
+
+/**
+ * Resume the fiber in a new job or, if not possible, immediately
+ */
+static void resume(struct afb_fiber *fiber)
+{
+	if (afb_sched_post_job(NULL, 0, 0, resume_cb, fiber, Afb_Sched_Mode_Normal) < 0)
+		afb_fiber_resume(fiber);
+}
+
+/**
+ * Job expiring the synchronous job of id given by 'closure'
+ */
+static void sync_timeout_cb(int signum, void *closure)
+{
+	struct sync_job *sync;
+	struct afb_fiber *fiber = NULL;
+
+	x_mutex_lock(&sync_jobs_mutex);
+	sync = get_sync_job((uintptr_t)closure);
+	if (sync == NULL)
+		x_mutex_unlock(&sync_jobs_mutex);
+	else {
+		x_mutex_lock(&sync->mutex);
+		x_mutex_unlock(&sync_jobs_mutex);
+		if (sync->done == 0 && sync->signum == 0 && sync->fiber != NULL) {
+			sync->signum = SIGALRM;
+			fiber = sync->fiber;
+			sync->fiber = NULL;
+		}
+		x_mutex_unlock(&sync->mutex);
+		if (fiber != NULL)
+			afb_fiber_resume(fiber);
+	}
+}
+
+/**
+ * Records the fiber suspended by 'sync_cb'. Called by the thread
+ * that ran the fiber, after its suspension.
+ */
+static void sync_parked(struct afb_fiber *fiber, void *closure)
+{
+	struct sync_job *sync = closure;
+
+	x_mutex_lock(&sync->mutex);
+	if (sync->done != 0) {
+		/* left during the suspension */
+		x_mutex_unlock(&sync->mutex);
+		resume(fiber);
+	}
+	else {
+		sync->fiber = fiber;
+		if (sync->timeout > 0)
+			sync->timeoutjob = afb_sched_post_job(NULL, sync->timeout * 1000L, 0,
+					sync_timeout_cb, (void*)sync->id, Afb_Sched_Mode_Normal);
+		x_mutex_unlock(&sync->mutex);
+	}
+}
+#endif
+
 /**
  * Internal helper function for 'afb_sched_sync'.
  * @see afb_sched_sync, afb_sched_leave
@@ -240,6 +457,19 @@ static void sync_cb(int signum, void *closure)
 		x_mutex_lock(&sync->mutex);
 		if (sync->done == 0) {
 			afb_ev_mgr_release_for_me();
+#if WITH_SCHED_FIBERS
+			if (afb_fiber_current() != NULL) {
+				/* give the thread back, waiting in the fiber */
+				x_mutex_unlock(&sync->mutex);
+				afb_fiber_suspend(sync_parked, sync);
+				if (sync->signum != 0)
+					sync->enter(sync->signum, sync->arg, (struct afb_sched_lock*)sync->id);
+				return;
+			}
+			/* next jobs of that kind will be run in fibers */
+			if (fibers && x_tls_get_running() != NULL)
+				syncing_search(x_tls_get_running(), 1);
+#endif
 			adapt(Afb_Sched_Mode_Start);
 			x_cond_wait(&sync->condsync, &sync->mutex);
 		}
@@ -277,6 +507,11 @@ int afb_sched_sync(
 	sync.done = 0;
 	sync.condsync = (x_cond_t) X_COND_INITIALIZER;
 	sync.mutex = (x_mutex_t) X_MUTEX_INITIALIZER;
+#if WITH_SCHED_FIBERS
+	sync.fiber = NULL;
+	sync.timeout = timeout;
+	sync.timeoutjob = 0;
+#endif
 
 	/* link the structure */
 	x_mutex_lock(&sync_jobs_mutex);
@@ -295,6 +530,17 @@ int afb_sched_sync(
 	*itsync = sync.next;
 	x_mutex_unlock(&sync_jobs_mutex);
 
+	/* wait that threads having found the structure before its
+	 * unlinking, as the resumer of the fiber, release it */
+	x_mutex_lock(&sync.mutex);
+	x_mutex_unlock(&sync.mutex);
+
+#if WITH_SCHED_FIBERS
+	/* cancel the expiration job */
+	if (sync.timeoutjob > 0)
+		afb_jobs_abort(sync.timeoutjob);
+#endif
+
 	/* release the sync data */
 	if (x_cond_destroy(&sync.condsync) != 0)
 		RP_CRITICAL("failed to destroy condition");
@@ -313,6 +559,9 @@ int afb_sched_leave(struct afb_sched_lock *lock)
 {
 	int rc;
 	struct sync_job *sync;
+#if WITH_SCHED_FIBERS
+	struct afb_fiber *fiber = NULL;
+#endif
 
 	x_mutex_lock(&sync_jobs_mutex);
 	sync = get_sync_job((uintptr_t)lock);
@@ -331,10 +580,18 @@ int afb_sched_leave(struct afb_sched_lock *lock)
 			rc = X_EEXIST;
 		else {
 			sync->done = 1;
+#if WITH_SCHED_FIBERS
+			fiber = sync->fiber;
+			sync->fiber = NULL;
+#endif
 			x_cond_signal(&sync->condsync);
 			rc = 0;
 		}
 		x_mutex_unlock(&sync->mutex);
+#if WITH_SCHED_FIBERS
+		if (fiber != NULL)
+			resume(fiber);
+#endif
 	}
 
 	return rc;
@@ -375,6 +632,51 @@ int afb_sched_enter(
 }
 #endif
 
+#if WITH_SCHED_FIBERS
+/* set the fiber mode */
+int afb_sched_set_fibers(size_t stacksize)
+{
+	int rc = 0;
+
+	if (stacksize > 0)
+		rc = afb_fibers_setup(stacksize);
+	if (rc >= 0)
+		fibers = stacksize > 0;
+	return rc;
+}
+#endif
+
+#if WITH_SCHED_FIBERS
+/* set the function computing the kind of the jobs of callback */
+int afb_sched_set_job_kind(const void *callback, const void *(*kind)(void *arg1, void *arg2))
+{
+	int idx, rc;
+
+	x_mutex_lock(&kinds_mutex);
+	for (idx = 0 ; idx < kinds_count && kinds[idx].callback != callback ; idx++);
+	if (idx < kinds_count)
+		rc = 0;
+	else if (kinds_count >= AFB_SCHED_KINDS_COUNT)
+		rc = X_EOVERFLOW;
+	else {
+		kinds[idx].callback = callback;
+		kinds[idx].kind = kind;
+		__atomic_store_n(&kinds_count, idx + 1, __ATOMIC_RELEASE);
+		rc = 0;
+	}
+	x_mutex_unlock(&kinds_mutex);
+	return rc;
+}
+#endif
+
+/* set the adaptive sizing of threads */
+void afb_sched_set_adaptive(int ceiling, int grow_wait, int linger)
+{
+	afb_threads_setup_adaptive(ceiling, linger);
+	if (grow_wait >= 0)
+		grow_wait_ms = grow_wait;
+}
+
 static int wait_no_job_cb(void *closure)
 {
 	if (afb_jobs_get_pending_count() > 0)
@@ -25,6 +25,8 @@
 
 #include "../libafb-config.h"
 
+#include "afb-jobs.h"
+
 struct afb_sched_lock;
 struct ev_mgr;
 
@@ -189,6 +191,37 @@ extern int afb_sched_post_job2(
 		void *arg2,
 		enum afb_sched_mode mode);
 
+/**
+ * Schedule a new asynchronous job like @ref afb_sched_post_job2
+ * but with the given priority.
+ *
+ * Jobs of higher priority are started first and then, for a same
+ * priority, jobs of earliest deadline, the deadline being the time
+ * of posting plus the timeout.
+ *
+ * @param group    The group of the job or NULL when no group.
+ * @param delayms  minimal time in ms to wait before starting the job
+ * @param timeout  The maximum execution time in seconds of the job
+ *                 or 0 for unlimited time.
+ * @param priority The priority of the job
+ * @param callback The function to execute for achieving the job.
+ * @param arg1     The second argument for 'callback'
+ * @param arg2     The third argument for 'callback'
+ * @param mode     The mode
+ *
+ * @return the job id on success (greater than 0) or
+ *         in case of error a negative number in -errno like form
+ */
+extern int afb_sched_post_job_priority(
+		const void *group,
+		long delayms,
+		int timeout,
+		enum afb_jobs_priority priority,
+		void (*callback)(int, void*, void*),
+		void *arg1,
+		void *arg2,
+		enum afb_sched_mode mode);
+
 /**
  * Aborts the job of given id, if not started, the job receives SIGABORT
  *
@@ -219,3 +252,57 @@ extern int afb_sched_abort_job(int jobid);
  * @return -1 if timeout or the count of pending jobs
  */
 extern int afb_sched_wait_idle(int wait_jobs, int timeout);
+
+/**
+ * Set the adaptive sizing of the pool of threads. When it is set,
+ * posting a job while the oldest runnable job waits for 'grow_wait'
+ * milliseconds or more starts a new thread until 'ceiling' threads
+ * are running. The threads above the normal count stop after
+ * lingering idle 'linger' milliseconds.
+ *
+ * If any of the given value is negative, the recorded value is unchanged.
+ *
+ * @param ceiling   maximum count of threads, not less than the normal count
+ * @param grow_wait waiting time in ms of jobs triggering growth, 0 disables it
+ * @param linger    idle time in ms before stopping extra threads
+ */
+extern void afb_sched_set_adaptive(int ceiling, int grow_wait, int linger);
+
+#if WITH_SCHED_FIBERS
+#include <stddef.h>
+/**
+ * Set the fiber mode. In fiber mode, jobs whose kind is known
+ * to wait in 'afb_sched_sync' run in a fiber having its own stack.
+ * When such a job waits in 'afb_sched_sync', its fiber is suspended
+ * and the thread runs other jobs instead of blocking. The fiber is
+ * resumed by a job posted when 'afb_sched_leave' is called or when
+ * the timeout expires. A kind becomes known the first time one
+ * of its jobs waits, that job blocking its thread as without fibers.
+ * The kind of a job is its callback unless set by 'afb_sched_set_job_kind'.
+ *
+ * The resuming job can run on any thread: after 'afb_sched_sync',
+ * a job running in a fiber may continue on an other thread than the
+ * one that started it. Fiber mode must not be enabled when bindings
+ * rely on the identity of their thread, as when using thread local
+ * storage or libraries bound to the thread that called them.
+ *
+ * @param stacksize size of the stacks of fibers or 0 to disable fiber mode
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_sched_set_fibers(size_t stacksize);
+
+/**
+ * Set the function computing the kind of the jobs of 'callback'
+ * from their arguments. Jobs of a kind known to wait in
+ * 'afb_sched_sync' are run in fibers. It allows callbacks that
+ * dispatch various processings to not have all their jobs run
+ * in fibers because one of the processings waits.
+ *
+ * @param callback the callback of the jobs
+ * @param kind     the function returning the kind of a job of callback
+ *
+ * @return 0 on success or X_EOVERFLOW if too many callbacks are recorded
+ */
+extern int afb_sched_set_job_kind(const void *callback, const void *(*kind)(void *arg1, void *arg2));
+#endif
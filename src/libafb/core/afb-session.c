@@ -36,6 +36,7 @@
 
 #include "core/afb-session.h"
 #include "core/afb-hook.h"
+#include "core/afb-perm-cache.h"
 #include "sys/x-mutex.h"
 #include "sys/x-errno.h"
 
@@ -225,6 +226,9 @@ static void session_close(struct afb_session *session)
 		afb_hook_session_close(session);
 #endif
 
+		/* forget the permissions granted to the session */
+		afb_perm_cache_drop_session(session->uuid);
+
 		/* release cookies */
 		for (idx = 0 ; idx < COOKIECOUNT ; idx++) {
 			while ((cookie = session->cookies[idx])) {
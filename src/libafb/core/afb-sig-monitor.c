@@ -26,6 +26,7 @@
 /******************************************************************************/
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -88,8 +89,19 @@ static void dumpstack(int crop, int signum)
 #include <signal.h>
 
 #define SIG_FOR_TIMER   SIGVTALRM
-#define CLOCK_FOR_TIMER CLOCK_REALTIME
 
+/* deadlines are absolute, the clock must not follow changes of the date */
+#define CLOCK_FOR_TIMER CLOCK_MONOTONIC
+
+/* current time in milliseconds */
+static uint64_t now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_FOR_TIMER, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+#if !WITH_SIG_MONITOR_WATCHDOG
 /* local per thread timers */
 X_TLS(void,timerid)
 
@@ -155,6 +167,27 @@ static inline int timeout_arm(int timeout)
 	return rc;
 }
 
+/*
+ * Arms the alarm at the deadline in milliseconds for the current thread
+ */
+static inline int timeout_arm_at(uint64_t deadline)
+{
+	int rc;
+	struct itimerspec its;
+	timer_t timerid;
+
+	rc = timeout_get(&timerid);
+	if (rc == 0) {
+		its.it_interval.tv_sec = 0;
+		its.it_interval.tv_nsec = 0;
+		its.it_value.tv_sec = (time_t)(deadline / 1000);
+		its.it_value.tv_nsec = (long)(deadline % 1000) * 1000000;
+		rc = timer_settime(timerid, TIMER_ABSTIME, &its, NULL);
+	}
+
+	return rc;
+}
+
 /*
  * Disarms the current alarm
  */
@@ -174,6 +207,255 @@ static inline void timeout_delete()
 		set_timerid(0);
 	}
 }
+
+/*
+ * Timers are always accurate
+ */
+static inline int timeout_expired()
+{
+	return 1;
+}
+
+#else /* WITH_SIG_MONITOR_WATCHDOG */
+
+/*
+ * Instead of one timer per thread, that implementation uses one
+ * watchdog thread. Each thread publishes the deadline of its current
+ * job in a slot. The watchdog scans the slots when the earliest
+ * deadline is reached and signals the threads whose deadline expired.
+ * Arming and disarming are then simple atomic stores.
+ */
+
+#include <stdint.h>
+
+#include "sys/x-mutex.h"
+#include "sys/x-cond.h"
+#include "sys/x-errno.h"
+
+/* value of deadline of expired slots */
+#define EXPIRED 1
+
+/* slot of deadline of a thread */
+struct watched
+{
+	/* next slot */
+	struct watched *next;
+	/* the thread */
+	x_thread_t tid;
+	/* deadline in milliseconds, 0 if none, EXPIRED when expired */
+	uint64_t deadline;
+	/* is the slot used? */
+	int used;
+};
+
+/* list of the slots */
+static struct watched *watched_list;
+
+/* synchronisation of the watchdog */
+static x_mutex_t watchdog_mutex = X_MUTEX_INITIALIZER;
+static x_cond_t watchdog_cond; /* initialized when starting */
+
+/* is the watchdog started? */
+static int watchdog_started;
+
+/* time of the next wake up of the watchdog */
+static uint64_t watchdog_wakeup = UINT64_MAX;
+
+/* slot of the current thread */
+X_TLS(struct watched,watched)
+
+/* main of the watchdog thread */
+static void *watchdog_main(void *arg)
+{
+	struct watched *iter;
+	struct timespec ts;
+	uint64_t now, next, deadline;
+
+	x_mutex_lock(&watchdog_mutex);
+	for (;;) {
+		/* during the scan, any arming wakes up the watchdog */
+		__atomic_store_n(&watchdog_wakeup, UINT64_MAX, __ATOMIC_SEQ_CST);
+		x_mutex_unlock(&watchdog_mutex);
+
+		/* scan the deadlines */
+		now = now_ms();
+		next = UINT64_MAX;
+		for (iter = __atomic_load_n(&watched_list, __ATOMIC_ACQUIRE) ; iter ; iter = iter->next) {
+			deadline = __atomic_load_n(&iter->deadline, __ATOMIC_SEQ_CST);
+			if (deadline <= EXPIRED)
+				continue;
+			if (deadline > now) {
+				if (deadline < next)
+					next = deadline;
+				continue;
+			}
+			/* expired, signal the thread if still running the job */
+			x_mutex_lock(&watchdog_mutex);
+			if (__atomic_compare_exchange_n(&iter->deadline, &deadline, EXPIRED,
+					0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+				x_thread_kill(iter->tid, SIG_FOR_TIMER);
+			x_mutex_unlock(&watchdog_mutex);
+		}
+
+		/* wait the next deadline */
+		x_mutex_lock(&watchdog_mutex);
+		if (next < watchdog_wakeup)
+			__atomic_store_n(&watchdog_wakeup, next, __ATOMIC_SEQ_CST);
+		if (watchdog_wakeup == UINT64_MAX)
+			x_cond_wait(&watchdog_cond, &watchdog_mutex);
+		else {
+			ts.tv_sec = (time_t)(watchdog_wakeup / 1000);
+			ts.tv_nsec = (long)(watchdog_wakeup % 1000) * 1000000;
+			x_cond_timedwait(&watchdog_cond, &watchdog_mutex, &ts);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Starts the watchdog, its condition waiting on the clock of deadlines
+ */
+static int watchdog_start()
+{
+	int rc;
+	x_thread_t tid;
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_FOR_TIMER);
+	rc = pthread_cond_init(&watchdog_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	if (rc == 0) {
+		rc = x_thread_create(&tid, watchdog_main, NULL, 1);
+		if (rc != 0)
+			x_cond_destroy(&watchdog_cond);
+	}
+	return rc;
+}
+
+/*
+ * Wakes up the watchdog for the given deadline
+ */
+static int watchdog_awake(uint64_t deadline)
+{
+	int rc = 0;
+
+	x_mutex_lock(&watchdog_mutex);
+	if (!watchdog_started) {
+		rc = watchdog_start();
+		watchdog_started = rc == 0;
+	}
+	if (watchdog_started && deadline < watchdog_wakeup) {
+		__atomic_store_n(&watchdog_wakeup, deadline, __ATOMIC_SEQ_CST);
+		x_cond_signal(&watchdog_cond);
+	}
+	x_mutex_unlock(&watchdog_mutex);
+	return rc;
+}
+
+/*
+ * Get the slot of the current thread
+ */
+static struct watched *watched_get()
+{
+	struct watched *result;
+
+	result = x_tls_get_watched();
+	if (result == NULL) {
+		x_mutex_lock(&watchdog_mutex);
+		/* reuse a slot of a terminated thread */
+		for (result = watched_list ; result && result->used ; result = result->next);
+		if (result == NULL) {
+			result = calloc(1, sizeof *result);
+			if (result != NULL) {
+				result->next = watched_list;
+				__atomic_store_n(&watched_list, result, __ATOMIC_RELEASE);
+			}
+		}
+		if (result != NULL) {
+			result->tid = x_thread_self();
+			result->used = 1;
+			x_tls_set_watched(result);
+		}
+		x_mutex_unlock(&watchdog_mutex);
+	}
+	return result;
+}
+
+/*
+ * Creates the slot for the current thread
+ *
+ * Returns 0 in case of success
+ */
+static inline int timeout_create()
+{
+	return watched_get() ? 0 : X_ENOMEM;
+}
+
+/*
+ * Arms the alarm at the deadline in milliseconds for the current thread
+ */
+static inline int timeout_arm_at(uint64_t deadline)
+{
+	struct watched *watched;
+
+	watched = watched_get();
+	if (watched == NULL)
+		return X_ENOMEM;
+
+	if (deadline <= EXPIRED)
+		deadline = EXPIRED + 1;
+	__atomic_store_n(&watched->deadline, deadline, __ATOMIC_SEQ_CST);
+	if (deadline < __atomic_load_n(&watchdog_wakeup, __ATOMIC_SEQ_CST))
+		return watchdog_awake(deadline);
+	return 0;
+}
+
+/*
+ * Arms the alarm in timeout seconds for the current thread
+ */
+static inline int timeout_arm(int timeout)
+{
+	return timeout_arm_at(now_ms() + (uint64_t)timeout * 1000);
+}
+
+/*
+ * Disarms the current alarm
+ */
+static inline void timeout_disarm()
+{
+	struct watched *watched = x_tls_get_watched();
+	if (watched)
+		__atomic_store_n(&watched->deadline, 0, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Destroy any alarm resource for the current thread
+ */
+static inline void timeout_delete()
+{
+	struct watched *watched = x_tls_get_watched();
+	if (watched) {
+		x_mutex_lock(&watchdog_mutex);
+		__atomic_store_n(&watched->deadline, 0, __ATOMIC_SEQ_CST);
+		watched->used = 0;
+		x_mutex_unlock(&watchdog_mutex);
+		x_tls_set_watched(NULL);
+	}
+}
+
+/*
+ * Checks if the timer signal received is for the current job
+ * (the signal might be received after the end of the job)
+ */
+static inline int timeout_expired()
+{
+	uint64_t expired = EXPIRED;
+	struct watched *watched = x_tls_get_watched();
+	return watched && __atomic_compare_exchange_n(&watched->deadline, &expired, 0,
+					0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+#endif
 #endif
 /******************************************************************************/
 #if !WITH_SIG_MONITOR_FOR_CALL
@@ -199,12 +481,28 @@ struct recovery
 {
 	struct undoer *undoers;
 	int prevsig;
+#if WITH_SIG_MONITOR_TIMERS
+	uint64_t deadline; /* deadline in ms of the monitored run, 0 if none */
+#endif
 	sigjmp_buf jmpbuf;
 };
 
 /* local handler */
 X_TLS(struct recovery, error_handler);
 
+#if WITH_SCHED_FIBERS
+/* fibers can continue on an other thread: avoid reuse of thread local addresses */
+__attribute__((noinline))
+#endif
+static void monitor_leave(int timeout, struct recovery *older)
+{
+#if WITH_SIG_MONITOR_TIMERS
+	if (timeout > 0)
+		timeout_disarm();
+#endif
+	x_tls_set_error_handler(older);
+}
+
 static void monitor_run(int timeout, void (*function)(int sig, void*), void *arg)
 {
 	int signum;
@@ -213,23 +511,24 @@ static void monitor_run(int timeout, void (*function)(int sig, void*), void *arg
 	older = x_tls_get_error_handler();
 	recovery.undoers = NULL;
 	recovery.prevsig = 0;
+#if WITH_SIG_MONITOR_TIMERS
+	/* the deadline is kept for being rearmed after switching stacks */
+	recovery.deadline = timeout > 0 ? now_ms() + (uint64_t)timeout * 1000
+				: older != NULL ? older->deadline : 0;
+#endif
 	signum = sigsetjmp(recovery.jmpbuf, 1);
 	if (signum == 0) {
 		x_tls_set_error_handler(&recovery);
 #if WITH_SIG_MONITOR_TIMERS
 		if (timeout > 0)
-			timeout_arm(timeout);
+			timeout_arm_at(recovery.deadline);
 #endif
 		function(0, arg);
 	} else if (recovery.prevsig == 0) {
 		recovery.prevsig = signum;
 		function(signum, arg);
 	}
-#if WITH_SIG_MONITOR_TIMERS
-	if (timeout > 0)
-		timeout_disarm();
-#endif
-	x_tls_set_error_handler(older);
+	monitor_leave(timeout, older);
 }
 
 static inline void monitor_raise(int signo)
@@ -408,6 +707,11 @@ static void on_signal_terminate (int signum)
 /* Handles monitored signals that can be continued */
 static void on_signal_error(int signum)
 {
+#if WITH_SIG_MONITOR_TIMERS
+	/* ignore late timer signals */
+	if (signum == SIG_FOR_TIMER && !timeout_expired())
+		return;
+#endif
 #if WITH_SIG_MONITOR_DUMPSTACK
 	if (!is_in_safe_dumpstack()) {
 		RP_ERROR("ALERT! signal %d received: %s", signum, strsignal(signum));
@@ -485,6 +789,20 @@ void afb_sig_monitor_do_run(int timeout, void (*function)(int sig, void*), void
 	else
 		function(0, arg);
 }
+
+void *afb_sig_monitor_switch(void *context)
+{
+	struct recovery *older = x_tls_get_error_handler();
+#if WITH_SIG_MONITOR_TIMERS
+	struct recovery *recovery = context;
+	if (recovery != NULL && recovery->deadline > now_ms())
+		timeout_arm_at(recovery->deadline);
+	else
+		timeout_disarm();
+#endif
+	x_tls_set_error_handler(context);
+	return older;
+}
 #endif
 
 
@@ -93,6 +93,18 @@ extern void afb_sig_monitor_do(void (*function)(int sig, void*), void *arg);
  * @param arg       the arguments to pass to the job
  */
 extern void afb_sig_monitor_do_run(int timeout, void (*function)(int sig, void*), void *arg);
+
+/**
+ * Replace the recovery context of the current thread by 'context'
+ * and return the replaced one. It is intended for switching stacks
+ * (fibers). The timeout of the current thread is set to the remaining
+ * time of the monitored run of 'context', or disarmed if none remains.
+ *
+ * @param context   the recovery context to set (NULL at start of a stack)
+ *
+ * @return the replaced recovery context
+ */
+extern void *afb_sig_monitor_switch(void *context);
 #endif
 
 
@@ -120,6 +132,7 @@ static inline int afb_sig_monitor_init_timeouts() { return 0; }
 static inline void afb_sig_monitor_run(int timeout, void (*function)(int sig, void*), void *arg) { function(0, arg); }
 static inline void afb_sig_monitor_do(void (*function)(int sig, void*), void *arg) { function(0, arg); }
 static inline void afb_sig_monitor_do_run(int timeout, void (*function)(int sig, void*), void *arg) { function(0, arg); }
+static inline void *afb_sig_monitor_switch(void *context) { return NULL; }
 #endif
 #if !WITH_SIG_MONITOR_DUMPSTACK
 static inline void afb_sig_monitor_dumpstack() {}
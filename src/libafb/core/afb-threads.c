@@ -21,9 +21,21 @@
  * $RP_END_LICENSE$
  */
 
+#define _GNU_SOURCE
+
+#include "../libafb-config.h"
+
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+
+#if WITH_THREADS_AFFINITY
+#include <stdio.h>
+#include <sched.h>
+#include <dirent.h>
+#endif
 
 #include <rp-utils/rp-verbose.h>
 
@@ -62,6 +74,9 @@ struct thread
 	/** stop request */
 	unsigned char stopped;
 
+	/** started by growth */
+	unsigned char grown;
+
 	/** next waiter of the waiter list */
 	struct thread *next_asleep;
 
@@ -88,6 +103,27 @@ static struct thread *threads = 0;
 /** count of active threads */
 static int active_count = 0;
 
+/***********************************************************************
+* adaptive sizing: threads can be added above the normal count until
+* the ceiling when jobs wait too much and these extra threads stop
+* after lingering idle for some time.
+*/
+
+/** maximum count of threads when growing, 0 when not adaptive */
+static int adaptive_ceiling = 0;
+
+/** time in ms that an extra thread lingers idle before stopping */
+static int linger_ms = 0;
+
+/** count of threads being started by growth */
+static int growing_count = 0;
+
+/** count of threads started by growth */
+static unsigned grow_count = 0;
+
+/** count of extra threads stopped */
+static unsigned shrink_count = 0;
+
 /***********************************************************************
 * asleep threads will wait for being woken up
 */
@@ -119,6 +155,43 @@ static struct thread *reserve_head = 0;
 /** lock for managing reserve of threads */
 static x_mutex_t reserve_lock = X_MUTEX_INITIALIZER;
 
+/***********************************************************************
+* Placement of threads on CPUs: threads running jobs are placed on
+* the CPUs of workers and the thread running the event loop on the
+* CPUs of the event loop. The placement of a thread is recorded in
+* its local storage with the generation of the setting, so it is
+* only changed when needed. The first thread running the event loop
+* of the scheduler is elected and placed once on the CPUs of the
+* event loop, other threads running it occasionally are not moved.
+*/
+#if WITH_THREADS_AFFINITY
+
+#define PLACE_WORKER  1
+#define PLACE_EVLOOP  2
+
+/** CPUs of threads running jobs */
+static cpu_set_t worker_cpus;
+
+/** CPUs of the threads running the event loop */
+static cpu_set_t evloop_cpus;
+
+/** generation of the setting, 0 when no placement */
+static uintptr_t place_generation = 0;
+
+/** generation of the setting of the elected thread, 0 if none */
+static uintptr_t evloop_generation = 0;
+
+/** count of NUMA nodes, 0 if not detected yet */
+static int numa_count = 0;
+
+/** NUMA node of each CPU */
+static uint16_t cpu_nodes[CPU_SETSIZE];
+
+/** placement of the current thread */
+X_TLS(void,placement)
+
+#endif
+
 /***********************************************************************/
 
 static afb_threads_job_getter_t getjob = NULL;
@@ -167,6 +240,129 @@ PRINT("++++++++++++ A-TWU -> %d\n", result);
 	return result;
 }
 
+/**
+ * Makes the extra thread 'me' asleep for at most linger_ms.
+ * The mutex @ref run_lock must be held when this function is called
+ * and is held again when it returns.
+ *
+ * @return 1 when woken up or 0 when expired
+ */
+static int linger(struct thread *me)
+{
+	struct timespec expire;
+	struct thread **prv;
+	int woken;
+
+	clock_gettime(CLOCK_REALTIME, &expire);
+	expire.tv_sec += linger_ms / 1000;
+	expire.tv_nsec += (linger_ms % 1000) * 1000000L;
+	if (expire.tv_nsec >= 1000000000L) {
+		expire.tv_nsec -= 1000000000L;
+		expire.tv_sec++;
+	}
+
+	x_mutex_lock(&asleep_lock);
+	me->next_asleep = asleep_threads;
+	asleep_threads = me;
+	asleep_count++;
+	x_mutex_unlock(&run_lock);
+	if (asleep_waiter_cond != NULL)
+		x_cond_signal(asleep_waiter_cond);
+	x_cond_timedwait(&me->cond, &asleep_lock, &expire);
+	/* still in the list of asleep threads if not woken up */
+	for (prv = &asleep_threads ; *prv != NULL && *prv != me ; prv = &(*prv)->next_asleep);
+	woken = *prv == NULL;
+	if (!woken) {
+		*prv = me->next_asleep;
+		asleep_count--;
+	}
+	x_mutex_unlock(&asleep_lock);
+	x_mutex_lock(&run_lock);
+	return woken;
+}
+
+#if WITH_THREADS_AFFINITY
+/**
+ * Places the current thread on the CPUs of 'placement'
+ */
+static void place(uintptr_t placement)
+{
+	uintptr_t generation = __atomic_load_n(&place_generation, __ATOMIC_ACQUIRE);
+	uintptr_t current = (uintptr_t)x_tls_get_placement();
+	cpu_set_t set;
+
+	if (generation != 0 && current != ((generation << 2) | placement)) {
+		x_tls_set_placement((void*)((generation << 2) | placement));
+		x_mutex_lock(&run_lock);
+		set = placement == PLACE_EVLOOP ? evloop_cpus : worker_cpus;
+		x_mutex_unlock(&run_lock);
+		sched_setaffinity(0, sizeof set, &set);
+	}
+}
+
+/**
+ * Keeps the current thread placed as it is when the setting changes
+ */
+static void replace()
+{
+	uintptr_t generation = __atomic_load_n(&place_generation, __ATOMIC_RELAXED);
+	uintptr_t current = (uintptr_t)x_tls_get_placement();
+
+	if (generation != 0 && (current >> 2) != generation)
+		place(PLACE_WORKER);
+}
+
+/**
+ * Unelects the current thread if it was elected for the event loop
+ */
+static void unelect()
+{
+	uintptr_t current = (uintptr_t)x_tls_get_placement();
+	uintptr_t generation = current >> 2;
+
+	if ((current & 3) == PLACE_EVLOOP)
+		__atomic_compare_exchange_n(&evloop_generation, &generation, 0,
+				0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/**
+ * Reads in 'set' the list of CPUs, numbers or ranges separated by commas
+ *
+ * @return 0 on success or X_EINVAL
+ */
+static int parse_cpus(const char *list, cpu_set_t *set)
+{
+	char *end;
+	unsigned long lo, hi;
+
+	CPU_ZERO(set);
+	while (*list) {
+		/* strtoul accepts spaces and signs, only digits are valid */
+		if (*list < '0' || *list > '9')
+			return X_EINVAL;
+		lo = hi = strtoul(list, &end, 10);
+		if (*end == '-') {
+			list = end + 1;
+			if (*list < '0' || *list > '9')
+				return X_EINVAL;
+			hi = strtoul(list, &end, 10);
+			if (hi < lo)
+				return X_EINVAL;
+		}
+		if (hi >= CPU_SETSIZE)
+			return X_EINVAL;
+		for ( ; lo <= hi ; lo++)
+			CPU_SET(lo, set);
+		if (*end == ',' && end[1])
+			end++;
+		else if (*end)
+			return X_EINVAL;
+		list = end;
+	}
+	return CPU_COUNT(set) ? 0 : X_EINVAL;
+}
+#endif
+
 static void thread_run(struct thread *me, afb_threads_job_getter_t mainjob)
 {
 	int status;
@@ -176,10 +372,18 @@ IFDBG(static unsigned id = 0; me->id = ++id;)
 
 PRINT("++++++++++++ START[%u] %p\n",me->id,me);
 
+#if WITH_THREADS_AFFINITY
+	place(PLACE_WORKER);
+#endif
+
 	x_mutex_lock(&run_lock);
 	me->next = threads;
 	threads = me;
 	active_count++;
+	if (me->grown) {
+		me->grown = 0;
+		growing_count--;
+	}
 	if (mainjob) {
 		getjob = mainjob;
 		while (wakeup_one());
@@ -196,6 +400,9 @@ PRINT("++++++++++++ START[%u] %p\n",me->id,me);
 			/* execute the retrieved job */
 PRINT("++++++++++++ TR run B[%u]%p\n",me->id,me);
 			x_mutex_unlock(&run_lock);
+#if WITH_THREADS_AFFINITY
+			replace();
+#endif
 			jobdesc.run(jobdesc.job, me->tid);
 			x_mutex_lock(&run_lock);
 PRINT("++++++++++++ TR run A[%u]%p\n",me->id,me);
@@ -203,8 +410,12 @@ PRINT("++++++++++++ TR run A[%u]%p\n",me->id,me);
 
 		case AFB_THREADS_IDLE:
 			/* enter idle */
-			if (!mainjob && active_count > normal_count)
+			if (!mainjob && active_count > normal_count) {
+				if (linger_ms > 0 && linger(me))
+					break;
+				shrink_count++;
 				goto stopme;
+			}
 PRINT("++++++++++++ TRwB[%u]%p\n",me->id,me);
 			x_mutex_lock(&asleep_lock);
 			me->next_asleep = asleep_threads;
@@ -239,6 +450,9 @@ PRINT("++++++++++++ TR stop B[%u]%p\n",me->id,me);
 	x_mutex_unlock(&asleep_lock);
 
 	afb_ev_mgr_try_recover_for_me();
+#if WITH_THREADS_AFFINITY
+	unelect();
+#endif
 
 	/* terminate */
 
@@ -286,7 +500,7 @@ void afb_threads_setup_counts(int normal, int reserve)
 
 /***********************************************************************/
 
-int afb_threads_start()
+static int start(int grown)
 {
 	int rc;
 	struct thread *thr;
@@ -295,6 +509,7 @@ int afb_threads_start()
 	thr = reserve_head;
 	if (thr != NULL) {
 
+		thr->grown = (unsigned char)grown;
 		reserve_head = thr->next;
 		current_reserve_count--;
 		x_cond_signal(&thr->cond);
@@ -311,6 +526,7 @@ int afb_threads_start()
 	/* init it */
 	thr->next = 0;
 	thr->stopped = 0;
+	thr->grown = (unsigned char)grown;
 	thr->cond = (x_cond_t)X_COND_INITIALIZER;
 
 	rc = x_thread_create(&thr->tid, thread_main, thr, 1);
@@ -324,6 +540,11 @@ int afb_threads_start()
 	return rc;
 }
 
+int afb_threads_start()
+{
+	return start(0);
+}
+
 int afb_threads_enter(afb_threads_job_getter_t jobget, void *closure)
 {
 	struct thread me;
@@ -334,6 +555,7 @@ int afb_threads_enter(afb_threads_job_getter_t jobget, void *closure)
 	/* setup the structure for me */
 	me.next = 0;
 	me.stopped = 0;
+	me.grown = 0;
 	me.tid = x_thread_self();
 	me.cond = (x_cond_t)X_COND_INITIALIZER;
 
@@ -370,6 +592,50 @@ PRINT("++++++++++++ A-TSC -> %d\n", result);
 	return result;
 }
 
+void afb_threads_setup_adaptive(int ceiling, int lingerms)
+{
+	x_mutex_lock(&run_lock);
+	if (ceiling >= 0)
+		adaptive_ceiling = ceiling;
+	if (lingerms >= 0)
+		linger_ms = lingerms;
+	x_mutex_unlock(&run_lock);
+}
+
+int afb_threads_grow()
+{
+	int result = 0, grow, ceiling;
+
+	x_mutex_lock(&run_lock);
+	ceiling = adaptive_ceiling > normal_count ? adaptive_ceiling : normal_count;
+	grow = !wakeup_one() && active_count + growing_count < ceiling;
+	if (grow) {
+		growing_count++;
+		grow_count++;
+	}
+	x_mutex_unlock(&run_lock);
+	if (grow) {
+		result = start(1);
+		if (result < 0) {
+			x_mutex_lock(&run_lock);
+			growing_count--;
+			grow_count--;
+			x_mutex_unlock(&run_lock);
+		}
+	}
+	return result;
+}
+
+void afb_threads_adaptive_counts(unsigned *grows, unsigned *shrinks)
+{
+	x_mutex_lock(&run_lock);
+	if (grows)
+		*grows = grow_count;
+	if (shrinks)
+		*shrinks = shrink_count;
+	x_mutex_unlock(&run_lock);
+}
+
 static int has_me()
 {
 	int resu = 0;
@@ -453,6 +719,150 @@ int afb_threads_wait_idle(struct timespec *expire)
 	return afb_threads_wait_until(is_idle, (void*)(intptr_t)hasme, expire);
 }
 
+#if WITH_THREADS_AFFINITY
+int afb_threads_set_cpus(const char *workers, const char *evloop)
+{
+	cpu_set_t wset, eset;
+	uintptr_t generation;
+	int rc;
+
+	if (workers == NULL && evloop == NULL) {
+		/* no placement, threads stay where they are */
+		__atomic_store_n(&place_generation, 0, __ATOMIC_RELEASE);
+		return 0;
+	}
+	if (workers != NULL)
+		rc = parse_cpus(workers, &wset);
+	else
+		rc = sched_getaffinity(0, sizeof wset, &wset) < 0 ? -errno : 0;
+	if (rc == 0) {
+		if (evloop != NULL)
+			rc = parse_cpus(evloop, &eset);
+		else
+			eset = wset;
+	}
+	if (rc == 0) {
+		x_mutex_lock(&run_lock);
+		worker_cpus = wset;
+		evloop_cpus = eset;
+		generation = (place_generation + 1) & (UINTPTR_MAX >> 2);
+		__atomic_store_n(&place_generation, generation ?: 1, __ATOMIC_RELEASE);
+		x_mutex_unlock(&run_lock);
+	}
+	return rc;
+}
+
+void afb_threads_place_evloop(int evloop)
+{
+	place(evloop ? PLACE_EVLOOP : PLACE_WORKER);
+}
+
+int afb_threads_elect_evloop()
+{
+	uintptr_t generation = __atomic_load_n(&place_generation, __ATOMIC_ACQUIRE);
+	uintptr_t current = (uintptr_t)x_tls_get_placement();
+	uintptr_t elected;
+
+	if (generation == 0)
+		return 0;
+	if (current == ((generation << 2) | PLACE_EVLOOP))
+		return 1;
+	elected = __atomic_load_n(&evloop_generation, __ATOMIC_RELAXED);
+	if (elected == generation
+	 || !__atomic_compare_exchange_n(&evloop_generation, &elected, generation,
+				0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return 0;
+	place(PLACE_EVLOOP);
+	return 1;
+}
+
+/**
+ * Reads the CPUs of the NUMA node of 'name' and records them in cpu_nodes
+ */
+static void read_node_cpus(const char *name)
+{
+	char path[64], list[1024];
+	unsigned long node;
+	cpu_set_t set;
+	char *end;
+	FILE *file;
+	unsigned cpu;
+
+	node = strtoul(&name[4], &end, 10);
+	if (*end || node > UINT16_MAX)
+		return;
+	snprintf(path, sizeof path, "/sys/devices/system/node/%s/cpulist", name);
+	file = fopen(path, "r");
+	if (file == NULL)
+		return;
+	if (fgets(list, (int)sizeof list, file) != NULL) {
+		list[strcspn(list, "\n")] = 0;
+		if (parse_cpus(list, &set) == 0)
+			for (cpu = 0 ; cpu < CPU_SETSIZE ; cpu++)
+				if (CPU_ISSET(cpu, &set))
+					cpu_nodes[cpu] = (uint16_t)node;
+	}
+	fclose(file);
+}
+
+int afb_threads_numa_count()
+{
+	DIR *dir;
+	struct dirent *ent;
+	int count = __atomic_load_n(&numa_count, __ATOMIC_ACQUIRE);
+
+	if (count == 0) {
+		dir = opendir("/sys/devices/system/node");
+		if (dir != NULL) {
+			while ((ent = readdir(dir)) != NULL)
+				if (!strncmp(ent->d_name, "node", 4)
+				 && ent->d_name[4] >= '0' && ent->d_name[4] <= '9') {
+					read_node_cpus(ent->d_name);
+					count++;
+				}
+			closedir(dir);
+		}
+		count = count ?: 1;
+		__atomic_store_n(&numa_count, count, __ATOMIC_RELEASE);
+	}
+	return count;
+}
+
+int afb_threads_numa_node()
+{
+	int cpu;
+
+	/* sched_getcpu is served by the vDSO, no system call */
+	if (afb_threads_numa_count() <= 1 || (cpu = sched_getcpu()) < 0 || cpu >= CPU_SETSIZE)
+		return 0;
+	return cpu_nodes[cpu];
+}
+#else
+int afb_threads_set_cpus(const char *workers, const char *evloop)
+{
+	return workers == NULL && evloop == NULL ? 0 : X_ENOTSUP;
+}
+
+void afb_threads_place_evloop(int evloop)
+{
+}
+
+int afb_threads_elect_evloop()
+{
+	return 0;
+}
+
+int afb_threads_numa_count()
+{
+	return 1;
+}
+
+int afb_threads_numa_node()
+{
+	return 0;
+}
+#endif
+
 int afb_threads_active_count()
 {
        return active_count;
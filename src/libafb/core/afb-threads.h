@@ -109,6 +109,16 @@ typedef int (*afb_threads_job_getter_t)(void *closure, afb_threads_job_desc_t *d
  */
 extern void afb_threads_setup_counts(int normal, int reserve);
 
+/**
+ * Setup the adaptive sizing of the count of threads.
+ *
+ * If any of the given value is negative, the recorded value is unchanged.
+ *
+ * @param ceiling maximum count of threads that growing can reach
+ * @param lingerms time in ms that threads above normal count wait idle before stopping
+ */
+extern void afb_threads_setup_adaptive(int ceiling, int lingerms);
+
 /**
  * start a thread
  *
@@ -126,6 +136,23 @@ extern int afb_threads_start();
  */
 extern int afb_threads_start_cond(int force);
 
+/**
+ * wake up an asleep thread or start a new one if the ceiling
+ * of adaptive sizing is not reached
+ *
+ * @return 0 on succes or a negative error code
+ */
+extern int afb_threads_grow();
+
+/**
+ * Get the counts of threads started by growth and of
+ * threads stopped when above the normal count.
+ *
+ * @param grows   where to store the count of grows if not NULL
+ * @param shrinks where to store the count of shrinks if not NULL
+ */
+extern void afb_threads_adaptive_counts(unsigned *grows, unsigned *shrinks);
+
 /**
  * enter thread dispatch of jobs
  *
@@ -170,6 +197,53 @@ extern int afb_threads_wait_until(int (*test)(void *clo), void *closure, struct
  */
 extern int afb_threads_wait_idle(struct timespec *expire);
 
+/**
+ * Set the CPUs where threads run. The CPUs are given as lists of
+ * numbers or ranges separated by commas, like "0-3,8". Threads running
+ * jobs are placed on 'workers' and the thread running the event loop on
+ * 'evloop'. When 'workers' is NULL, the CPUs of the calling thread are
+ * used. When 'evloop' is NULL, 'workers' is used. When both are NULL,
+ * threads are no more placed. Threads are placed once: a thread of
+ * workers running the event loop occasionally is not moved.
+ *
+ * @param workers CPUs of threads running jobs or NULL
+ * @param evloop  CPUs of the thread running the event loop or NULL
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_threads_set_cpus(const char *workers, const char *evloop);
+
+/**
+ * Place the calling thread on the CPUs set by @ref afb_threads_set_cpus
+ *
+ * @param evloop not zero if the thread runs the event loop, zero if it runs jobs
+ */
+extern void afb_threads_place_evloop(int evloop);
+
+/**
+ * Elect the calling thread for running the event loop of the scheduler
+ * if no other thread is elected. The elected thread is placed once on
+ * the CPUs of the event loop set by @ref afb_threads_set_cpus and
+ * stays elected until it stops or the setting changes.
+ *
+ * @return 1 if the calling thread is elected, 0 otherwise
+ */
+extern int afb_threads_elect_evloop();
+
+/**
+ * Get the count of NUMA nodes of the host
+ *
+ * @return the count of nodes, 1 if not detected
+ */
+extern int afb_threads_numa_count();
+
+/**
+ * Get the NUMA node of the CPU running the calling thread
+ *
+ * @return the node, 0 if not detected
+ */
+extern int afb_threads_numa_node();
+
 /**
  * deprecated, get current active count
  */
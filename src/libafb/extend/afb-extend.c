@@ -43,6 +43,7 @@
 
 #if WITH_DIRENT
 #include <rp-utils/rp-path-search.h>
+#include "misc/afb-so-probe.h"
 #endif
 
 #define MANIFEST	"AfbExtensionManifest"
@@ -230,29 +231,79 @@ static void load_extension_cb(void *closure, struct json_object *value)
 #endif
 
 #if WITH_DIRENT
+/**
+ * found files
+ */
+struct found
+{
+	/** count of found files */
+	int count;
+	/** allocated count of paths */
+	int alloc;
+	/** paths of the found files */
+	char **paths;
+	/** status */
+	int status;
+};
+
 /**
  * callback of files
  */
 static int try_extension(void *closure, const rp_path_search_entry_t *item)
 {
 	static char extension[] = ".so";
-	int rc, *ret = closure;
+	struct found *found = closure;
+	char **paths, *path;
 
 	/* only try files having ".so" extension */
 	if (item->namelen < (short)(sizeof extension - 1)
 	 || memcmp(&item->name[item->namelen - (short)(sizeof extension - 1)], extension, sizeof extension))
 		return 0;
 
-	/* try to get it as a binding */
-	rc = load_extension(item->path, 0, NULL, NULL);
-	if (rc >= 0)
-		return 0; /* got it */
+	/* record it for loading it later */
+	if (found->count == found->alloc) {
+		paths = realloc(found->paths, (size_t)(found->alloc + 16) * sizeof *paths);
+		if (paths == NULL)
+			goto oom;
+		found->paths = paths;
+		found->alloc += 16;
+	}
+	path = strdup(item->path);
+	if (path == NULL)
+		goto oom;
+	found->paths[found->count++] = path;
+	return 0;
 
+oom:
 	/* report the error and tell to stop exploration of files */
-	*ret = rc;
+	found->status = X_ENOMEM;
 	return 1;
 }
 
+/**
+ * load the found files that are extensions
+ */
+static int load_found(struct found *found)
+{
+	int i, rc, *kinds;
+
+	/* get the kinds of the files in parallel */
+	kinds = malloc((size_t)found->count * sizeof *kinds);
+	if (kinds == NULL)
+		return X_ENOMEM;
+	afb_so_probe(found->count, (const char * const *)found->paths, kinds, AFB_SO_PROBE_EXTENSION);
+
+	/* load the extensions in order */
+	for (rc = i = 0 ; rc >= 0 && i < found->count ; i++) {
+		if (kinds[i] >= 0 && !(kinds[i] & AFB_SO_PROBE_EXTENSION))
+			RP_DEBUG("Not an extension %s", found->paths[i]);
+		else
+			rc = load_extension(found->paths[i], 0, NULL, NULL);
+	}
+	free(kinds);
+	return rc < 0 ? rc : 0;
+}
+
 /**
  * function to filter out the directories that must not be entered
  */
@@ -266,14 +317,22 @@ static int filterdirs(void *closure, const rp_path_search_entry_t *item)
 
 static int load_extpath(const char *value)
 {
-	int rc;
+	int rc, i;
 	rp_path_search_t *ps;
+	struct found found = { .count = 0, .alloc = 0, .paths = NULL, .status = 0 };
 
 	rc = rp_path_search_make_dirs(&ps, value);
 	if (rc >= 0) {
 		rp_path_search_filter(ps, RP_PATH_SEARCH_FILE|RP_PATH_SEARCH_RECURSIVE|RP_PATH_SEARCH_FLEXIBLE,
-			try_extension, &rc, filterdirs, NULL);
+			try_extension, &found, filterdirs, NULL);
 		rp_path_search_unref(ps);
+		if (found.status == 0 && found.count > 0)
+			found.status = load_found(&found);
+		if (found.status < 0)
+			rc = found.status;
+		for (i = 0 ; i < found.count ; i++)
+			free(found.paths[i]);
+		free(found.paths);
 	}
 	return rc;
 }
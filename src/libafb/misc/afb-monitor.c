@@ -47,6 +47,9 @@
 #if WITH_AFB_TRACE
 #include "misc/afb-trace.h"
 #endif
+#if WITH_AFB_REQ_STATS
+#include "core/afb-req-stats.h"
+#endif
 #include "core/afb-type-predefined.h"
 #include "sys/x-errno.h"
 
@@ -74,6 +77,7 @@ static const char _get_[] = "get";
 static const char _monitor_[] = "monitor";
 static const char _session_[] = "session";
 static const char _set_[] = "set";
+static const char _stats_[] = "stats";
 static const char _subscribe_[] = "subscribe";
 static const char _trace_[] = "trace";
 static const char _unsubscribe_[] = "unsubscribe";
@@ -571,10 +575,17 @@ static void f_trace_cb(void *closure, struct json_object *args)
 	int rc;
 	struct json_object *add = NULL;
 	struct json_object *drop = NULL;
+	struct json_object *ring = NULL;
+	int dump = 0;
 	struct afb_trace *trace;
 
 	afb_session_cookie_getinit(req->session, _monitor_, (void**)&trace, context_create, req);
-	rp_jsonc_unpack(args, "{s?o s?o}", "add", &add, "drop", &drop);
+	rp_jsonc_unpack(args, "{s?o s?o s?o s?b}", "ring", &ring, "add", &add, "drop", &drop, "dump", &dump);
+	if (ring) {
+		rc = afb_trace_setup(req, ring);
+		if (rc)
+			goto end;
+	}
 	if (add) {
 		rc = afb_trace_add(req, add, trace);
 		if (rc)
@@ -585,7 +596,10 @@ static void f_trace_cb(void *closure, struct json_object *args)
 		if (rc)
 			goto end;
 	}
-	afb_req_common_reply_hookable(req, 0, 0, NULL);
+	if (dump)
+		afb_trace_dump(req);
+	else
+		afb_req_common_reply_hookable(req, 0, 0, NULL);
 end:
 	afb_apiset_update_hooks(monitor_api->call_set, NULL);
 	afb_evt_update_hooks();
@@ -603,6 +617,92 @@ static void f_trace(struct afb_req_common *req)
 }
 #endif
 
+/*** STATS *******************************************************************/
+#if WITH_AFB_REQ_STATS && !WITHOUT_JSON_C
+struct stats_filter
+{
+	const char *api;
+	struct json_object *result;
+};
+
+static struct json_object *stats_histo(const struct afb_req_stats_histo *histo)
+{
+	struct json_object *r = NULL;
+
+	rp_jsonc_pack(&r, "{sI sI sI sI sI sI sI sI}",
+		"count", (int64_t)histo->count,
+		"min", (int64_t)histo->min,
+		"max", (int64_t)histo->max,
+		"mean", (int64_t)(histo->count ? histo->sum / histo->count : 0),
+		"p50", (int64_t)afb_req_stats_quantile(histo, 0.5),
+		"p90", (int64_t)afb_req_stats_quantile(histo, 0.9),
+		"p99", (int64_t)afb_req_stats_quantile(histo, 0.99),
+		"p999", (int64_t)afb_req_stats_quantile(histo, 0.999));
+	return r;
+}
+
+static void f_stats_add_cb(void *closure, const char *api, const char *verb, const struct afb_req_stats_values *values)
+{
+	struct stats_filter *filter = closure;
+	struct json_object *verbs, *r = NULL;
+
+	if (filter->api && strcmp(filter->api, api))
+		return;
+
+	if (!json_object_object_get_ex(filter->result, api, &verbs)) {
+		verbs = json_object_new_object();
+		json_object_object_add(filter->result, api, verbs);
+	}
+	rp_jsonc_pack(&r, "{sI sI so so so}",
+		"count", (int64_t)values->count,
+		"errors", (int64_t)values->errors,
+		"wait", stats_histo(&values->wait),
+		"exec", stats_histo(&values->exec),
+		"size", stats_histo(&values->size));
+	json_object_object_add(verbs, verb, r);
+}
+
+static void f_stats_cb(void *closure, struct json_object *args)
+{
+	struct afb_req_common *req = closure;
+	struct stats_filter filter;
+	struct afb_data *data;
+	int reset = 0, enable = -1, rc;
+
+	filter.api = NULL;
+	rp_jsonc_unpack(args, "{s?s s?b s?b}", "api", &filter.api, "reset", &reset, "enable", &enable);
+	if (enable >= 0)
+		afb_req_stats_enable(enable);
+
+	filter.result = json_object_new_object();
+	if (!filter.result) {
+		afb_req_common_reply_out_of_memory_error_hookable(req);
+		return;
+	}
+	rc = afb_req_stats_snapshot(f_stats_add_cb, &filter);
+	if (reset)
+		afb_req_stats_reset();
+	if (rc < 0) {
+		json_object_put(filter.result);
+		afb_req_common_reply_internal_error_hookable(req, rc);
+	}
+	else {
+		afb_json_legacy_make_data_json_c(&data, filter.result);
+		afb_req_common_reply_hookable(req, 0, 1, &data);
+	}
+}
+
+static void f_stats(struct afb_req_common *req)
+{
+	afb_json_legacy_do_single_json_c(req->params.ndata, req->params.data, f_stats_cb, req);
+}
+#else
+static void f_stats(struct afb_req_common *req)
+{
+	afb_req_common_reply_unavailable_error_hookable(req);
+}
+#endif
+
 /*** INFO ****************************************************************/
 
 static void f_info(struct afb_req_common *req)
@@ -624,6 +724,9 @@ static void f_info(struct afb_req_common *req)
 #endif
 #if WITH_AFB_TRACE
 		afb_info_add_verb(&info, _trace_, "Trace internal activity", 0, NULL, 0);
+#endif
+#if WITH_AFB_REQ_STATS && !WITHOUT_JSON_C
+		afb_info_add_verb(&info, _stats_, "Get statistics of requests", 0, NULL, 0);
 #endif
 		rc = afb_info_end(&info, &data);
 	} while(rc > 0);
@@ -664,6 +767,8 @@ static void monitor_process(void *closure, struct afb_req_common *req)
 			fun = f_set;
 		else if (0 == strcmp(req->verbname, _session_))
 			fun = f_session;
+		else if (0 == strcmp(req->verbname, _stats_))
+			fun = f_stats;
 		else if (0 == strcmp(req->verbname, _subscribe_))
 			fun = f_subscribe;
 		break;
@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#define _GNU_SOURCE /* for secure_getenv */
+
+#include "../libafb-config.h"
+
+#if WITH_DYNAMIC_BINDING || WITH_EXTENSION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <rp-utils/rp-verbose.h>
+
+#include "misc/afb-so-probe.h"
+#include "sys/x-dynlib.h"
+#include "sys/x-thread.h"
+#include "sys/x-errno.h"
+
+/* maximum count of threads probing in parallel */
+#ifndef AFB_SO_PROBE_THREADS
+#  define AFB_SO_PROBE_THREADS	4
+#endif
+
+/* name of the environment variable giving the cache file */
+#define CACHE_ENV	"AFB_SO_PROBE_CACHE"
+
+/* first line of the cache file */
+#define CACHE_MAGIC	"afb-so-probe 1"
+
+/* the probed symbols, the index being the bit of the probe mask */
+static const char * const symbols[] = {
+	"afbBindingV4",
+	"afbBindingV4entry",
+	"afbBindingV3",
+	"afbBindingV3entry",
+	"AfbExtensionManifest"
+};
+
+/* entry of the cache */
+struct entry
+{
+	int kind;		/**< the recorded kind */
+	int used;		/**< was used during this run */
+	int64_t size;		/**< size of the file */
+	int64_t sec;		/**< time of modification, seconds */
+	long nsec;		/**< time of modification, nanoseconds */
+	char path[];		/**< path of the file */
+};
+
+/* the cache */
+static struct {
+	int configured;		/**< path was set */
+	int loaded;		/**< was loaded */
+	int dirty;		/**< must be saved */
+	int count;		/**< count of entries */
+	char *path;		/**< path of the cache file or NULL */
+	struct entry **entries;	/**< entries sorted by path */
+} cache;
+
+/* state of a parallel probe */
+struct probe
+{
+	int count;			/**< count of paths */
+	int next;			/**< next path to probe */
+	int readahead;			/**< kinds to read ahead */
+	const char * const *paths;	/**< the paths */
+	int *kinds;			/**< the found kinds */
+	struct stat *stats;		/**< stats of the files */
+	struct entry **hits;		/**< the hits in the cache */
+};
+
+/*****************************************************************************/
+/* cache                                                                     */
+/*****************************************************************************/
+
+static int cmpentries(const void *a, const void *b)
+{
+	return strcmp((*(struct entry * const *)a)->path, (*(struct entry * const *)b)->path);
+}
+
+static int cmpkey(const void *key, const void *b)
+{
+	return strcmp((const char*)key, (*(struct entry * const *)b)->path);
+}
+
+/* search the entry of path */
+static struct entry *cache_search(const char *path)
+{
+	struct entry **found;
+
+	if (cache.count == 0)
+		return NULL;
+	found = bsearch(path, cache.entries, (size_t)cache.count, sizeof *cache.entries, cmpkey);
+	return found ? *found : NULL;
+}
+
+/* check if the entry matches the stat */
+static int cache_match(const struct entry *entry, const struct stat *st)
+{
+	return entry->size == (int64_t)st->st_size
+		&& entry->sec == (int64_t)st->st_mtim.tv_sec
+		&& entry->nsec == (long)st->st_mtim.tv_nsec;
+}
+
+/* set the entry of path, returns 0 or X_ENOMEM */
+static int cache_set(const char *path, const struct stat *st, int kind)
+{
+	struct entry *entry, **entries;
+	size_t len;
+
+	entry = cache_search(path);
+	if (entry == NULL) {
+		len = strlen(path);
+		entry = malloc(sizeof *entry + len + 1);
+		entries = realloc(cache.entries, (size_t)(cache.count + 1) * sizeof *entries);
+		if (entries != NULL)
+			cache.entries = entries;
+		if (entry == NULL || entries == NULL) {
+			free(entry);
+			return X_ENOMEM;
+		}
+		memcpy(entry->path, path, len + 1);
+		cache.entries[cache.count++] = entry;
+		qsort(cache.entries, (size_t)cache.count, sizeof *cache.entries, cmpentries);
+	}
+	entry->kind = kind;
+	entry->used = 1;
+	entry->size = (int64_t)st->st_size;
+	entry->sec = (int64_t)st->st_mtim.tv_sec;
+	entry->nsec = (long)st->st_mtim.tv_nsec;
+	cache.dirty = 1;
+	return 0;
+}
+
+/* load the cache file */
+static void cache_load()
+{
+	FILE *file;
+	char line[PATH_MAX + 100];
+	char *path, *nl;
+	int kind, n;
+	long long size, sec;
+	long nsec;
+	struct stat st;
+
+	cache.loaded = 1;
+	if (!cache.configured) {
+		path = secure_getenv(CACHE_ENV);
+		if (path == NULL || *path == 0 || (cache.path = strdup(path)) == NULL)
+			return;
+	}
+	if (cache.path == NULL)
+		return;
+
+	file = fopen(cache.path, "r");
+	if (file == NULL) {
+		if (errno != ENOENT)
+			RP_WARNING("can't read cache of shared objects %s: %s", cache.path, strerror(errno));
+		return;
+	}
+	if (fgets(line, (int)sizeof line, file) == NULL || strcmp(line, CACHE_MAGIC "\n") != 0)
+		RP_WARNING("ignoring invalid cache of shared objects %s", cache.path);
+	else {
+		while (fgets(line, (int)sizeof line, file) != NULL) {
+			nl = strchr(line, '\n');
+			if (nl == NULL)
+				break;
+			*nl = 0;
+			if (sscanf(line, "%d %lld %lld %ld %n", &kind, &size, &sec, &nsec, &n) != 4)
+				break;
+			st.st_size = (off_t)size;
+			st.st_mtim.tv_sec = (time_t)sec;
+			st.st_mtim.tv_nsec = nsec;
+			if (cache_set(&line[n], &st, kind) < 0)
+				break;
+			cache_search(&line[n])->used = 0;
+		}
+	}
+	fclose(file);
+	cache.dirty = 0;
+}
+
+/* save the cache file */
+static void cache_save()
+{
+	FILE *file;
+	char *tmp;
+	int i;
+	struct entry *entry;
+	struct stat st;
+
+	if (cache.path == NULL || !cache.dirty)
+		return;
+
+	if (asprintf(&tmp, "%s.tmp", cache.path) < 0)
+		return;
+	file = fopen(tmp, "w");
+	if (file == NULL)
+		RP_WARNING("can't write cache of shared objects %s: %s", tmp, strerror(errno));
+	else {
+		fprintf(file, "%s\n", CACHE_MAGIC);
+		for (i = 0 ; i < cache.count ; i++) {
+			entry = cache.entries[i];
+			/* drop the entries of removed files */
+			if ((entry->used || stat(entry->path, &st) == 0)
+			 && strchr(entry->path, '\n') == NULL)
+				fprintf(file, "%d %lld %lld %ld %s\n", entry->kind,
+					(long long)entry->size, (long long)entry->sec,
+					entry->nsec, entry->path);
+		}
+		if (fclose(file) != 0 || rename(tmp, cache.path) != 0) {
+			RP_WARNING("can't write cache of shared objects %s: %s", cache.path, strerror(errno));
+			unlink(tmp);
+		}
+		else
+			cache.dirty = 0;
+	}
+	free(tmp);
+}
+
+/* set the cache file */
+int afb_so_probe_set_cache(const char *path)
+{
+	char *dup;
+	int i;
+
+	dup = NULL;
+	if (path != NULL && (dup = strdup(path)) == NULL)
+		return X_ENOMEM;
+	free(cache.path);
+	cache.path = dup;
+	for (i = 0 ; i < cache.count ; i++)
+		free(cache.entries[i]);
+	free(cache.entries);
+	cache.entries = NULL;
+	cache.count = 0;
+	cache.dirty = 0;
+	cache.loaded = 0;
+	cache.configured = 1;
+	return 0;
+}
+
+/*****************************************************************************/
+/* probing                                                                   */
+/*****************************************************************************/
+
+/* probe the item of index i */
+static void probe_one(struct probe *probe, int i)
+{
+	struct entry *entry;
+	const char *path = probe->paths[i];
+	int kind, mask, fd;
+
+	/* search in the cache */
+	if (stat(path, &probe->stats[i]) < 0)
+		kind = -errno;
+	else {
+		entry = cache_search(path);
+		if (entry != NULL && cache_match(entry, &probe->stats[i])) {
+			probe->hits[i] = entry;
+			kind = entry->kind;
+		}
+		else {
+			/* inspect the file */
+			mask = x_dynlib_probe(path, symbols, (int)(sizeof symbols / sizeof *symbols));
+			if (mask < 0)
+				kind = mask;
+			else {
+				kind = 0;
+				if (mask & 3)
+					kind |= AFB_SO_PROBE_BINDING_V4;
+				if (mask & 12)
+					kind |= AFB_SO_PROBE_BINDING_V3;
+				if (mask & 16)
+					kind |= AFB_SO_PROBE_EXTENSION;
+			}
+		}
+	}
+	probe->kinds[i] = kind;
+
+	/* prefetch the file that will be loaded */
+	if (kind < 0 || (kind & probe->readahead)) {
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd >= 0) {
+			posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+			close(fd);
+		}
+	}
+}
+
+/* probe the items until none remains */
+static void *probe_run(void *closure)
+{
+	struct probe *probe = closure;
+	int i;
+
+	while ((i = __atomic_fetch_add(&probe->next, 1, __ATOMIC_RELAXED)) < probe->count)
+		probe_one(probe, i);
+	return NULL;
+}
+
+/* probe the kinds of the shared objects */
+void afb_so_probe(int count, const char * const paths[], int kinds[], int readahead)
+{
+	struct probe probe;
+	x_thread_t tids[AFB_SO_PROBE_THREADS];
+	int i, nthr;
+
+	if (count <= 0)
+		return;
+	if (!cache.loaded)
+		cache_load();
+
+	probe.count = count;
+	probe.next = 0;
+	probe.readahead = readahead;
+	probe.paths = paths;
+	probe.kinds = kinds;
+	probe.stats = calloc((size_t)count, sizeof *probe.stats);
+	probe.hits = calloc((size_t)count, sizeof *probe.hits);
+	if (probe.stats == NULL || probe.hits == NULL) {
+		/* unknown kinds */
+		for (i = 0 ; i < count ; i++)
+			kinds[i] = X_ENOMEM;
+	}
+	else {
+		/* probe in parallel */
+		for (nthr = 0 ; nthr < AFB_SO_PROBE_THREADS - 1 && nthr < count - 1 ; nthr++)
+			if (x_thread_create(&tids[nthr], probe_run, &probe, 0) < 0)
+				break;
+		probe_run(&probe);
+		while (nthr)
+			x_thread_join(tids[--nthr], NULL);
+
+		/* update the cache */
+		for (i = 0 ; i < count ; i++) {
+			if (probe.hits[i] != NULL)
+				probe.hits[i]->used = 1;
+			else if (kinds[i] >= 0 && cache.path != NULL)
+				cache_set(paths[i], &probe.stats[i], kinds[i]);
+		}
+		cache_save();
+	}
+	free(probe.stats);
+	free(probe.hits);
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#if WITH_DYNAMIC_BINDING || WITH_EXTENSION
+
+/*
+ * Probing of shared objects
+ * -------------------------
+ *
+ * Before loading the shared objects found when scanning directories,
+ * their table of exported symbols is inspected without loading them.
+ * This avoids the cost of loading (and relocating) shared objects that
+ * are neither bindings nor extensions. The inspection is made in
+ * parallel and shared objects of interest are read ahead, so that
+ * their loading, that remains sequential, doesn't wait the storage.
+ *
+ * The found kinds can be recorded in a cache file, keyed by path,
+ * size and time of modification, so that next starts don't inspect
+ * unchanged files again.
+ */
+
+/** kind of a shared object exporting afbBindingV4 or afbBindingV4entry */
+#define AFB_SO_PROBE_BINDING_V4		1
+
+/** kind of a shared object exporting afbBindingV3 or afbBindingV3entry */
+#define AFB_SO_PROBE_BINDING_V3		2
+
+/** kind of a shared object exporting AfbExtensionManifest */
+#define AFB_SO_PROBE_EXTENSION		4
+
+/** any kind of binding */
+#define AFB_SO_PROBE_BINDING		(AFB_SO_PROBE_BINDING_V4 | AFB_SO_PROBE_BINDING_V3)
+
+/**
+ * Set the path of the file caching the kinds of the probed shared objects.
+ * When not set, the value of the environment variable AFB_SO_PROBE_CACHE
+ * is used if defined.
+ *
+ * @param path the path of the cache file or NULL to disable the cache
+ *
+ * @return 0 on success or X_ENOMEM
+ */
+extern int afb_so_probe_set_cache(const char *path);
+
+/**
+ * Get the kinds of the shared objects of 'paths'.
+ *
+ * @param count     count of shared objects
+ * @param paths     paths of the shared objects
+ * @param kinds     where to store the kinds: the kind of paths[i] is
+ *                  stored in kinds[i], it is a combination of
+ *                  AFB_SO_PROBE_* or a negative value when the kind
+ *                  can't be known without loading the shared object
+ * @param readahead kinds of shared objects to read ahead
+ */
+extern void afb_so_probe(int count, const char * const paths[], int kinds[], int readahead);
+
+#endif
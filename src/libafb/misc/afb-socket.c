@@ -44,7 +44,14 @@
 #include "sys/x-alloca.h"
 
 /******************************************************************************/
+#if __ZEPHYR__
 #define BACKLOG  5
+#else
+#define BACKLOG  SOMAXCONN
+#endif
+
+/* count of listening sockets opened by servers */
+static unsigned listeners_count = 1;
 
 /******************************************************************************/
 
@@ -180,10 +187,12 @@ static int open_unix(const char *spec, int server)
  *
  * @param spec the specification of the host:port/...
  * @param server 0 for client, server otherwise
+ * @param reuseaddr for servers, set SO_REUSEADDR if not zero
+ * @param reuseport for servers, set SO_REUSEPORT if not zero
  *
  * @return the file descriptor number of the socket or -1 in case of error
  */
-static int open_tcp(const char *spec, int server, int reuseaddr)
+static int open_tcp(const char *spec, int server, int reuseaddr, int reuseport)
 {
 	int rc, fd, isport;
 	unsigned len;
@@ -266,6 +275,12 @@ static int open_tcp(const char *spec, int server, int reuseaddr)
 					rc = 1;
 					setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &rc, sizeof rc);
 				}
+#if defined(SO_REUSEPORT)
+				if (reuseport) {
+					rc = 1;
+					setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &rc, sizeof rc);
+				}
+#endif
 				rc = bind(fd, iai->ai_addr, iai->ai_addrlen);
 			} else {
 				rc = 1;
@@ -437,10 +452,11 @@ end:
  * @param uri the specification of the socket
  * @param server 0 for client, server otherwise
  * @param scheme the default scheme to use if none is set in uri (can be NULL)
+ * @param reuseport for TCP servers, set SO_REUSEPORT if not zero
  *
  * @return the file descriptor number of the socket or -1 in case of error
  */
-static int open_uri(const char *uri, int server, const char *scheme)
+static int open_uri(const char *uri, int server, const char *scheme, int reuseport)
 {
 	int fd, offset, rc;
 	struct entry *e;
@@ -469,7 +485,7 @@ static int open_uri(const char *uri, int server, const char *scheme)
 #endif
 #if WITH_TCP_SOCKET
 	case Type_Inet:
-		fd = open_tcp(uri, server, !e->noreuseaddr);
+		fd = open_tcp(uri, server, !e->noreuseaddr, reuseport);
 		break;
 #endif
 #if WITH_SYSD_SOCKET
@@ -521,12 +537,109 @@ static int open_uri(const char *uri, int server, const char *scheme)
  */
 int afb_socket_open_scheme(const char *uri, int server, const char *scheme)
 {
-	int fd = open_uri(uri, server, scheme);
+	int fd = open_uri(uri, server, scheme, 0);
 	if (fd < 0)
 		RP_ERROR("can't open %s socket for %s: %s", server ? "server" : "client", uri, strerror(-fd));
 	return fd;
 }
 
+/**
+ * open listening sockets for a server
+ *
+ * When 'count' is greater than one and the uri is a TCP one, opens
+ * up to 'count' sockets bound to the same address with SO_REUSEPORT,
+ * letting the kernel share incoming connections between them.
+ * Otherwise, opens only one socket.
+ *
+ * @param uri the specification of the socket
+ * @param fds array receiving the opened file descriptors
+ * @param count count of sockets to open (size of fds)
+ *
+ * @return the count of sockets opened or a negative error code
+ */
+int afb_socket_open_listeners(const char *uri, int fds[], unsigned count)
+{
+	int fd, offset;
+	unsigned n;
+	struct entry *e;
+
+	e = get_entry(uri, &offset, NULL);
+#if defined(SO_REUSEPORT)
+	if (count > 1 && e->type == Type_Inet) {
+		for (n = 0 ; n < count ; n++) {
+			fd = open_uri(uri, 1, NULL, 1);
+			if (fd < 0) {
+				if (n)
+					break;
+				RP_ERROR("can't open server socket for %s: %s", uri, strerror(-fd));
+				return fd;
+			}
+			fds[n] = fd;
+		}
+		return (int)n;
+	}
+#endif
+	fd = afb_socket_open(uri, 1);
+	if (fd < 0)
+		return fd;
+	fds[0] = fd;
+	return 1;
+}
+
+/**
+ * Set the count of listening sockets that servers should open
+ * when possible (see afb_socket_open_listeners)
+ *
+ * @param count the count, clipped to 1..AFB_SOCKET_LISTENERS_MAX
+ */
+void afb_socket_set_listeners_count(unsigned count)
+{
+	listeners_count = count < 1 ? 1 : count > AFB_SOCKET_LISTENERS_MAX ? AFB_SOCKET_LISTENERS_MAX : count;
+}
+
+/**
+ * Get the count of listening sockets that servers should open
+ *
+ * @return the count set by afb_socket_set_listeners_count (default is 1)
+ */
+unsigned afb_socket_get_listeners_count()
+{
+	return listeners_count;
+}
+
+/**
+ * accept a connection on a listening socket
+ *
+ * The accepted socket is close-on-exec and has TCP_NODELAY set
+ * when applicable.
+ *
+ * @param fd the listening socket
+ * @param nonblock if not zero, the accepted socket is made non blocking
+ *
+ * @return the accepted socket or a negative error code,
+ * X_EAGAIN when no more connection is pending
+ */
+int afb_socket_accept(int fd, int nonblock)
+{
+	int fdc, opt;
+	struct sockaddr addr;
+	socklen_t lenaddr;
+
+	lenaddr = (socklen_t)sizeof addr;
+#if __ZEPHYR__
+	fdc = accept(fd, &addr, &lenaddr);
+	if (fdc >= 0 && nonblock)
+		fcntl(fdc, F_SETFL, O_NONBLOCK);
+#else
+	fdc = accept4(fd, &addr, &lenaddr, SOCK_CLOEXEC | (nonblock ? SOCK_NONBLOCK : 0));
+#endif
+	if (fdc < 0)
+		return errno == EWOULDBLOCK ? X_EAGAIN : -errno;
+	opt = 1;
+	setsockopt(fdc, IPPROTO_TCP, TCP_NODELAY, &opt, (socklen_t)sizeof opt);
+	return fdc;
+}
+
 /**
  * Get the api name of the uri
  *
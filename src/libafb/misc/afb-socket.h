@@ -25,8 +25,22 @@
 
 #include "../libafb-config.h"
 
+/** maximum count of listening sockets of a server */
+#define AFB_SOCKET_LISTENERS_MAX 16
+
+/** maximum count of connections accepted at once */
+#define AFB_SOCKET_ACCEPT_BATCH 64
+
 extern int afb_socket_open_scheme(const char *uri, int server, const char *scheme);
 
+extern int afb_socket_open_listeners(const char *uri, int fds[], unsigned count);
+
+extern void afb_socket_set_listeners_count(unsigned count);
+
+extern unsigned afb_socket_get_listeners_count();
+
+extern int afb_socket_accept(int fd, int nonblock);
+
 extern const char *afb_socket_api(const char *uri);
 
 static inline int afb_socket_open(const char *uri, int server)
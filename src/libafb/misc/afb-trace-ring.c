@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#define _GNU_SOURCE /* for secure_getenv */
+
+#include "../libafb-config.h"
+
+#if WITH_AFB_HOOK && WITH_AFB_TRACE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "misc/afb-trace-ring.h"
+
+#include "sys/x-mutex.h"
+#include "sys/x-thread.h"
+#include "sys/x-errno.h"
+
+/* name of the environment variable giving the file to map */
+#define FILE_ENV	"AFB_TRACE_RING_FILE"
+
+/* the binary trace */
+static struct afb_trace_ring_header *trace;
+
+/* mutex for setup */
+static x_mutex_t mutex = X_MUTEX_INITIALIZER;
+
+/* thread counter */
+static uint32_t thread_counter;
+
+/* number of the thread plus one */
+X_TLS(void,thread_number)
+
+/* round to power of 2 */
+static uint32_t pow2(uint32_t value)
+{
+	uint32_t result = 1;
+	while (result < value && result < 0x80000000u)
+		result <<= 1;
+	return result;
+}
+
+/* allocates the trace */
+static int setup_locked(const char *path, unsigned ring_count, unsigned ring_length)
+{
+	struct afb_trace_ring_header header;
+	size_t size;
+	void *area;
+	int fd;
+
+	if (trace != NULL)
+		return X_EBUSY;
+	if (path == NULL) {
+		path = secure_getenv(FILE_ENV);
+		if (path != NULL && *path == 0)
+			path = NULL;
+	}
+
+	size = afb_trace_ring_layout(&header,
+			ring_count ? (uint32_t)ring_count : AFB_TRACE_RING_DEFAULT_COUNT,
+			pow2(ring_length ? (uint32_t)ring_length : AFB_TRACE_RING_DEFAULT_LENGTH),
+			pow2(AFB_TRACE_RING_NAME_COUNT),
+			AFB_TRACE_RING_STRINGS_SIZE);
+
+	if (path == NULL)
+		area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	else {
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+		if (fd < 0)
+			return -errno;
+		if (ftruncate(fd, (off_t)size) < 0) {
+			close(fd);
+			return -errno;
+		}
+		area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+	}
+	if (area == MAP_FAILED)
+		return X_ENOMEM;
+
+	/* the mapping is zeroed */
+	memcpy(area, &header, sizeof header);
+	__atomic_store_n(&trace, (struct afb_trace_ring_header*)area, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* get the trace, creating it with default values if needed */
+static struct afb_trace_ring_header *get_trace()
+{
+	struct afb_trace_ring_header *result;
+
+	result = __atomic_load_n(&trace, __ATOMIC_ACQUIRE);
+	if (result == NULL) {
+		x_mutex_lock(&mutex);
+		if (trace == NULL)
+			setup_locked(NULL, 0, 0);
+		result = trace;
+		x_mutex_unlock(&mutex);
+	}
+	return result;
+}
+
+/* setup of the trace */
+int afb_trace_ring_setup(const char *path, unsigned ring_count, unsigned ring_length)
+{
+	int rc;
+
+	x_mutex_lock(&mutex);
+	rc = setup_locked(path, ring_count, ring_length);
+	x_mutex_unlock(&mutex);
+	return rc;
+}
+
+/* check if the entry of hash matching records the name of length */
+static int name_is(struct afb_trace_ring_header *hdr, struct afb_trace_ring_name *entry, const char *name, uint32_t len)
+{
+	uint32_t off;
+
+	/* wait the string, recorded just after the hash */
+	while ((off = __atomic_load_n(&entry->offset, __ATOMIC_ACQUIRE)) == 0);
+
+	/* without string, the hash has to be trusted */
+	return off == AFB_TRACE_RING_NO_STRING
+		|| (entry->length == len && !memcmp((char*)hdr + hdr->strings_offset + off, name, len));
+}
+
+/* get the index of the name */
+uint32_t afb_trace_ring_name(const char *name)
+{
+	struct afb_trace_ring_header *hdr;
+	struct afb_trace_ring_name *names, *entry;
+	uint64_t hash, cur;
+	uint32_t mask, idx, len, off, count;
+	const unsigned char *iter;
+
+	hdr = get_trace();
+	if (name == NULL || hdr == NULL)
+		return 0;
+
+	/* compute the hash (FNV-1a) and the length */
+	hash = 0xcbf29ce484222325ull;
+	for (iter = (const unsigned char*)name ; *iter ; iter++)
+		hash = (hash ^ *iter) * 0x100000001b3ull;
+	hash |= 1; /* never zero */
+	len = (uint32_t)(iter - (const unsigned char*)name);
+
+	/* search or add in the table */
+	names = afb_trace_ring_names(hdr);
+	mask = hdr->name_count - 1;
+	idx = (uint32_t)hash & mask;
+	for (count = hdr->name_count ; count ; count--, idx = (idx + 1) & mask) {
+		entry = &names[idx];
+		cur = __atomic_load_n(&entry->hash, __ATOMIC_ACQUIRE);
+		if (cur == 0
+		 && __atomic_compare_exchange_n(&entry->hash, &cur, hash, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			/* new entry, record its string if possible */
+			off = __atomic_fetch_add(&hdr->strings_used, len + 1, __ATOMIC_RELAXED);
+			if (off >= hdr->strings_size || len + 1 > hdr->strings_size - off)
+				off = AFB_TRACE_RING_NO_STRING;
+			else {
+				memcpy((char*)hdr + hdr->strings_offset + off, name, len + 1);
+				entry->length = len;
+			}
+			__atomic_store_n(&entry->offset, off, __ATOMIC_RELEASE);
+			return idx + 1;
+		}
+		/* an other name of same hash is in a next entry */
+		if (cur == hash && name_is(hdr, entry, name, len))
+			return idx + 1;
+	}
+	return 0;
+}
+
+/* put a record */
+void afb_trace_ring_put(struct afb_trace_ring_record *record)
+{
+	struct afb_trace_ring_header *hdr;
+	struct afb_trace_ring *ring;
+	struct afb_trace_ring_record *dest;
+	uint64_t pos, cur;
+	uintptr_t num;
+
+	hdr = get_trace();
+	if (hdr == NULL)
+		return;
+
+	/* get the number of the thread */
+	num = (uintptr_t)x_tls_get_thread_number();
+	if (num == 0) {
+		num = (uintptr_t)__atomic_add_fetch(&thread_counter, 1, __ATOMIC_RELAXED);
+		x_tls_set_thread_number((void*)num);
+	}
+	record->thread = (uint32_t)num;
+
+	/* reserve a place in the ring of the thread */
+	ring = afb_trace_ring_get(hdr, (uint32_t)((num - 1) % hdr->ring_count));
+	pos = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+	dest = &afb_trace_ring_records(ring)[pos & (hdr->ring_length - 1)];
+
+	/* claim the record, that a thread sharing the ring may be writing */
+	cur = __atomic_load_n(&dest->seq, __ATOMIC_RELAXED);
+	do {
+		if ((cur & AFB_TRACE_RING_SEQ_BUSY) || cur > pos) {
+			__atomic_add_fetch(&ring->lost, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&dest->seq, &cur, AFB_TRACE_RING_SEQ_BUSY | (pos + 1),
+						0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+	/* write the record, seq being busy during writing */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	record->seq = AFB_TRACE_RING_SEQ_BUSY | (pos + 1);
+	memcpy(dest, record, sizeof *dest);
+	__atomic_store_n(&dest->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* get a snapshot of the trace */
+int afb_trace_ring_snapshot(void **buffer, size_t *size)
+{
+	struct afb_trace_ring_header *hdr, *snap;
+	struct afb_trace_ring *ring, *sring;
+	struct afb_trace_ring_record *recs, *srecs;
+	uint64_t seq;
+	uint32_t iring, irec;
+
+	hdr = get_trace();
+	if (hdr == NULL)
+		return X_ENOMEM;
+
+	snap = malloc((size_t)hdr->total_size);
+	if (snap == NULL)
+		return X_ENOMEM;
+
+	/* copy the header, the names and the strings */
+	memcpy(snap, hdr, hdr->rings_offset);
+
+	/* copy the rings, avoiding records being written */
+	for (iring = 0 ; iring < hdr->ring_count ; iring++) {
+		ring = afb_trace_ring_get(hdr, iring);
+		sring = afb_trace_ring_get(snap, iring);
+		sring->head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		sring->lost = __atomic_load_n(&ring->lost, __ATOMIC_RELAXED);
+		memset(sring->pad, 0, sizeof sring->pad);
+		recs = afb_trace_ring_records(ring);
+		srecs = afb_trace_ring_records(sring);
+		for (irec = 0 ; irec < hdr->ring_length ; irec++) {
+			seq = __atomic_load_n(&recs[irec].seq, __ATOMIC_ACQUIRE);
+			memcpy(&srecs[irec], &recs[irec], sizeof *srecs);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (seq == 0 || (seq & AFB_TRACE_RING_SEQ_BUSY)
+			 || seq != __atomic_load_n(&recs[irec].seq, __ATOMIC_RELAXED))
+				memset(&srecs[irec], 0, sizeof *srecs);
+			else
+				srecs[irec].seq = seq;
+		}
+	}
+	*buffer = snap;
+	*size = (size_t)hdr->total_size;
+	return 0;
+}
+
+#endif
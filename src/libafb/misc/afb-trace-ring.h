@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Binary trace rings
+ * ------------------
+ *
+ * The binary trace is a memory area, possibly mapped on a file,
+ * made of:
+ *
+ *  - a header (struct afb_trace_ring_header)
+ *  - a table of names (struct afb_trace_ring_name[name_count])
+ *  - an area of strings (char[strings_size])
+ *  - the rings (struct afb_trace_ring[ring_count]), each ring
+ *    being followed by its records (struct afb_trace_ring_record[ring_length])
+ *
+ * Each thread writes its records in the ring attached to it, threads
+ * sharing rings when there are more threads than rings. The records
+ * are written without lock. Each record has a sequence number, zero
+ * when never written, set to 1 + position of the record in the ring
+ * when the record is complete. A writer first claims its record by
+ * setting the bit AFB_TRACE_RING_SEQ_BUSY in the sequence number, so
+ * that two threads sharing a ring never write the same record at the
+ * same time: a writer that can't claim its record, because the record
+ * is being written or already holds a newer record, drops its record
+ * and counts it as lost.
+ *
+ * Names (api, verb, event, tag) are recorded once in the table of names
+ * and records refer to it by index (0 meaning no name).
+ */
+
+/** magic number of binary traces */
+#define AFB_TRACE_RING_MAGIC		0x52546641u
+
+/** version of the layout */
+#define AFB_TRACE_RING_VERSION		2
+
+/** bit of the sequence number of records being written */
+#define AFB_TRACE_RING_SEQ_BUSY		((uint64_t)1 << 63)
+
+/** offset of names whose string could not be recorded */
+#define AFB_TRACE_RING_NO_STRING	UINT32_MAX
+
+/** kind of records */
+#define AFB_TRACE_RING_KIND_REQUEST	1
+#define AFB_TRACE_RING_KIND_EVENT	2
+
+/** actions of records of kind request */
+#define AFB_TRACE_RING_REQ_BEGIN		1
+#define AFB_TRACE_RING_REQ_END			2
+#define AFB_TRACE_RING_REQ_REPLY		3
+#define AFB_TRACE_RING_REQ_SUBCALL		4
+#define AFB_TRACE_RING_REQ_SUBCALL_RESULT	5
+#define AFB_TRACE_RING_REQ_SUBCALLSYNC		6
+#define AFB_TRACE_RING_REQ_SUBCALLSYNC_RESULT	7
+#define AFB_TRACE_RING_REQ_SUBSCRIBE		8
+#define AFB_TRACE_RING_REQ_UNSUBSCRIBE		9
+
+/** actions of records of kind event */
+#define AFB_TRACE_RING_EVT_CREATE		1
+#define AFB_TRACE_RING_EVT_PUSH_BEFORE		2
+#define AFB_TRACE_RING_EVT_PUSH_AFTER		3
+#define AFB_TRACE_RING_EVT_BROADCAST_BEFORE	4
+#define AFB_TRACE_RING_EVT_BROADCAST_AFTER	5
+
+/** header of the binary trace */
+struct afb_trace_ring_header
+{
+	uint32_t magic;		/**< AFB_TRACE_RING_MAGIC */
+	uint16_t version;	/**< AFB_TRACE_RING_VERSION */
+	uint16_t record_size;	/**< size of records */
+	uint32_t ring_count;	/**< count of rings */
+	uint32_t ring_length;	/**< count of records per ring (power of 2) */
+	uint32_t name_count;	/**< count of names (power of 2) */
+	uint32_t strings_size;	/**< size of the string area */
+	uint32_t strings_used;	/**< used size of the string area */
+	uint32_t names_offset;	/**< offset of the names */
+	uint32_t strings_offset;/**< offset of the strings */
+	uint32_t rings_offset;	/**< offset of the rings */
+	uint64_t total_size;	/**< total size of the binary trace */
+};
+
+/** entry of the table of names */
+struct afb_trace_ring_name
+{
+	uint64_t hash;		/**< hash of the name, 0 if free */
+	uint32_t offset;	/**< offset in the string area, 0 if not set */
+	uint32_t length;	/**< length of the name */
+};
+
+/** record of one hook (64 bytes) */
+struct afb_trace_ring_record
+{
+	uint64_t seq;		/**< 1 + position in the ring, 0 if never written */
+	uint64_t time;		/**< time in nanoseconds (CLOCK_REALTIME) */
+	uint32_t hookid;	/**< id of the hook */
+	uint16_t kind;		/**< kind of the record */
+	uint16_t action;	/**< action of the record */
+	uint32_t tag;		/**< name index of the tag */
+	uint32_t index;		/**< index of the request or id of the event */
+	uint32_t api;		/**< name index of the api (request) or of the event */
+	uint32_t verb;		/**< name index of the verb (request) */
+	int32_t status;		/**< status or result */
+	uint32_t count;		/**< count of data */
+	uint32_t size;		/**< cumulated size of data */
+	uint32_t thread;	/**< number of the thread */
+	uint32_t arg1;		/**< extra argument, depends on action */
+	uint32_t arg2;		/**< extra argument, depends on action */
+};
+
+/** header of a ring, followed by its records */
+struct afb_trace_ring
+{
+	uint64_t head;		/**< count of records ever written */
+	uint64_t lost;		/**< count of records lost */
+	uint64_t pad[6];	/**< avoid false sharing */
+};
+
+/* compute the layout for the given values */
+static inline size_t afb_trace_ring_layout(
+			struct afb_trace_ring_header *header,
+			uint32_t ring_count,
+			uint32_t ring_length,
+			uint32_t name_count,
+			uint32_t strings_size
+) {
+	size_t off;
+
+	header->magic = AFB_TRACE_RING_MAGIC;
+	header->version = AFB_TRACE_RING_VERSION;
+	header->record_size = (uint16_t)sizeof(struct afb_trace_ring_record);
+	header->ring_count = ring_count;
+	header->ring_length = ring_length;
+	header->name_count = name_count;
+	header->strings_size = strings_size;
+	header->strings_used = 1; /* offset 0 means unset */
+	off = sizeof *header;
+	header->names_offset = (uint32_t)off;
+	off += name_count * sizeof(struct afb_trace_ring_name);
+	header->strings_offset = (uint32_t)off;
+	off += strings_size;
+	off = (off + 63) & ~(size_t)63;
+	header->rings_offset = (uint32_t)off;
+	off += ring_count * (sizeof(struct afb_trace_ring)
+			+ ring_length * sizeof(struct afb_trace_ring_record));
+	header->total_size = (uint64_t)off;
+	return off;
+}
+
+/* get the names of the trace */
+static inline struct afb_trace_ring_name *afb_trace_ring_names(const struct afb_trace_ring_header *header)
+{
+	return (struct afb_trace_ring_name*)((char*)header + header->names_offset);
+}
+
+/* get the string of the name of index (or NULL) */
+static inline const char *afb_trace_ring_name_string(const struct afb_trace_ring_header *header, uint32_t index)
+{
+	struct afb_trace_ring_name *name;
+
+	if (index == 0 || index > header->name_count)
+		return NULL;
+	name = &afb_trace_ring_names(header)[index - 1];
+	if (name->offset == 0 || name->offset >= header->strings_size
+	 || name->length >= header->strings_size - name->offset)
+		return NULL;
+	return (const char*)header + header->strings_offset + name->offset;
+}
+
+/* get the ring of index */
+static inline struct afb_trace_ring *afb_trace_ring_get(const struct afb_trace_ring_header *header, uint32_t index)
+{
+	return (struct afb_trace_ring*)((char*)header + header->rings_offset
+		+ index * (sizeof(struct afb_trace_ring)
+			+ header->ring_length * sizeof(struct afb_trace_ring_record)));
+}
+
+/* get the records of the ring */
+static inline struct afb_trace_ring_record *afb_trace_ring_records(struct afb_trace_ring *ring)
+{
+	return (struct afb_trace_ring_record*)&ring[1];
+}
+
+/*******************************************************************************/
+
+#include "../libafb-config.h"
+
+#if WITH_AFB_TRACE
+
+/* default count of rings */
+#ifndef AFB_TRACE_RING_DEFAULT_COUNT
+#  define AFB_TRACE_RING_DEFAULT_COUNT	16
+#endif
+
+/* default length of rings */
+#ifndef AFB_TRACE_RING_DEFAULT_LENGTH
+#  define AFB_TRACE_RING_DEFAULT_LENGTH	4096
+#endif
+
+/* default count of names */
+#ifndef AFB_TRACE_RING_NAME_COUNT
+#  define AFB_TRACE_RING_NAME_COUNT	1024
+#endif
+
+/* default size of strings */
+#ifndef AFB_TRACE_RING_STRINGS_SIZE
+#  define AFB_TRACE_RING_STRINGS_SIZE	32768
+#endif
+
+/**
+ * Setup the binary trace. Must be called before any binary trace is
+ * recorded. When not called, the binary trace is allocated in memory
+ * with default values on first use.
+ *
+ * @param path the file to map, or NULL for the file given by the
+ *             environment variable AFB_TRACE_RING_FILE or, when it
+ *             is not set, for anonymous memory
+ * @param ring_count the count of rings (0 for default)
+ * @param ring_length the count of records per ring, rounded up to a
+ *                    power of 2 (0 for default)
+ *
+ * @return 0 on success or a negative error code (X_EBUSY when already setup)
+ */
+extern int afb_trace_ring_setup(const char *path, unsigned ring_count, unsigned ring_length);
+
+/**
+ * Get the index of the given name, recording it if needed.
+ *
+ * @param name the name
+ *
+ * @return the index of the name or 0 if not available
+ */
+extern uint32_t afb_trace_ring_name(const char *name);
+
+/**
+ * Put a record in the ring of the current thread. The fields seq
+ * and thread are set by the function.
+ *
+ * @param record the record to put
+ */
+extern void afb_trace_ring_put(struct afb_trace_ring_record *record);
+
+/**
+ * Get a consistent snapshot of the binary trace. The snapshot has
+ * the same layout than the mapped file and should be released using
+ * free.
+ *
+ * @param buffer where to store the allocated snapshot
+ * @param size where to store the size of the snapshot
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int afb_trace_ring_snapshot(void **buffer, size_t *size);
+
+#endif
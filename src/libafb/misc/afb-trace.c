@@ -53,6 +53,7 @@
 #include "core/afb-api-common.h"
 #include "core/afb-evt.h"
 #include "misc/afb-trace.h"
+#include "misc/afb-trace-ring.h"
 
 #include "sys/x-mutex.h"
 #include "sys/x-errno.h"
@@ -68,6 +69,14 @@
 #  define DEFAULT_TAG_NAME "trace"
 #endif
 
+/* limits of the setup of binary traces */
+#if !defined(TRACE_RING_COUNT_MAX)
+#  define TRACE_RING_COUNT_MAX 1024
+#endif
+#if !defined(TRACE_RING_LENGTH_MAX)
+#  define TRACE_RING_LENGTH_MAX 1048576
+#endif
+
 /*******************************************************************************/
 /*****  types                                                              *****/
 /*******************************************************************************/
@@ -97,6 +106,7 @@ struct hook {
 	struct event *event;		/* the associated event */
 	struct tag *tag;		/* the associated tag */
 	struct afb_session *session;	/* the associated session */
+	uint32_t tagid;			/* index of the tag in binary traces */
 };
 
 /* types of hooks */
@@ -948,6 +958,157 @@ static struct afb_hook_evt_itf hook_evt_itf = {
 	.hook_evt_unref = hook_evt_unref
 };
 
+/*******************************************************************************/
+/*****  binary trace of requests and events                                *****/
+/*******************************************************************************/
+
+/* cumulated size of the data */
+static uint32_t ring_size_of_dataset(unsigned count, struct afb_data * const dataset[])
+{
+	size_t size = 0;
+	while (count)
+		size += afb_data_size(dataset[--count]);
+	return size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+}
+
+/* put a record for a request */
+static void ring_req(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, uint16_t action, int status, unsigned count, struct afb_data * const dataset[], uint32_t arg1, uint32_t arg2)
+{
+	struct hook *hook = closure;
+	struct afb_trace_ring_record record;
+
+	record.time = (uint64_t)hookid->time.tv_sec * 1000000000 + (uint64_t)hookid->time.tv_nsec;
+	record.hookid = hookid->id;
+	record.kind = AFB_TRACE_RING_KIND_REQUEST;
+	record.action = action;
+	record.tag = hook->tagid;
+	record.index = req->hookindex;
+	record.api = afb_trace_ring_name(req->apiname);
+	record.verb = afb_trace_ring_name(req->verbname);
+	record.status = status;
+	record.count = count;
+	record.size = ring_size_of_dataset(count, dataset);
+	record.arg1 = arg1;
+	record.arg2 = arg2;
+	afb_trace_ring_put(&record);
+}
+
+static void ring_req_begin(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req)
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_BEGIN, 0, req->params.ndata, req->params.data, 0, 0);
+}
+
+static void ring_req_end(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req)
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_END, 0, 0, NULL, 0, 0);
+}
+
+static void ring_req_reply(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, int status, unsigned nparams, struct afb_data * const params[])
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_REPLY, status, nparams, params, 0, 0);
+}
+
+static void ring_req_subscribe(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, struct afb_evt *event, int result)
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_SUBSCRIBE, result, 0, NULL,
+			afb_trace_ring_name(afb_evt_fullname(event)), (uint32_t)afb_evt_id(event));
+}
+
+static void ring_req_unsubscribe(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, struct afb_evt *event, int result)
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_UNSUBSCRIBE, result, 0, NULL,
+			afb_trace_ring_name(afb_evt_fullname(event)), (uint32_t)afb_evt_id(event));
+}
+
+static void ring_req_subcall(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, const char *api, const char *verb, unsigned nparams, struct afb_data * const params[])
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_SUBCALL, 0, nparams, params,
+			afb_trace_ring_name(api), afb_trace_ring_name(verb));
+}
+
+static void ring_req_subcall_result(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, int status, unsigned nreplies, struct afb_data * const replies[])
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_SUBCALL_RESULT, status, nreplies, replies, 0, 0);
+}
+
+static void ring_req_subcallsync(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, const char *api, const char *verb, unsigned nparams, struct afb_data * const params[])
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_SUBCALLSYNC, 0, nparams, params,
+			afb_trace_ring_name(api), afb_trace_ring_name(verb));
+}
+
+static void ring_req_subcallsync_result(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req, int result, int *status, unsigned *nreplies, struct afb_data * const replies[])
+{
+	ring_req(closure, hookid, req, AFB_TRACE_RING_REQ_SUBCALLSYNC_RESULT, *status, *nreplies, replies, (uint32_t)result, 0);
+}
+
+static struct afb_hook_req_itf ring_req_itf = {
+	.hook_req_begin = ring_req_begin,
+	.hook_req_end = ring_req_end,
+	.hook_req_reply = ring_req_reply,
+	.hook_req_subscribe = ring_req_subscribe,
+	.hook_req_unsubscribe = ring_req_unsubscribe,
+	.hook_req_subcall = ring_req_subcall,
+	.hook_req_subcall_result = ring_req_subcall_result,
+	.hook_req_subcallsync = ring_req_subcallsync,
+	.hook_req_subcallsync_result = ring_req_subcallsync_result
+};
+
+/* put a record for an event */
+static void ring_evt(void *closure, const struct afb_hookid *hookid, const char *evt, int id, uint16_t action, int status, unsigned count, struct afb_data * const dataset[])
+{
+	struct hook *hook = closure;
+	struct afb_trace_ring_record record;
+
+	record.time = (uint64_t)hookid->time.tv_sec * 1000000000 + (uint64_t)hookid->time.tv_nsec;
+	record.hookid = hookid->id;
+	record.kind = AFB_TRACE_RING_KIND_EVENT;
+	record.action = action;
+	record.tag = hook->tagid;
+	record.index = (uint32_t)id;
+	record.api = afb_trace_ring_name(evt);
+	record.verb = 0;
+	record.status = status;
+	record.count = count;
+	record.size = ring_size_of_dataset(count, dataset);
+	record.arg1 = 0;
+	record.arg2 = 0;
+	afb_trace_ring_put(&record);
+}
+
+static void ring_evt_create(void *closure, const struct afb_hookid *hookid, const char *evt, int id)
+{
+	ring_evt(closure, hookid, evt, id, AFB_TRACE_RING_EVT_CREATE, 0, 0, NULL);
+}
+
+static void ring_evt_push_before(void *closure, const struct afb_hookid *hookid, const char *evt, int id, unsigned nparams, struct afb_data * const params[])
+{
+	ring_evt(closure, hookid, evt, id, AFB_TRACE_RING_EVT_PUSH_BEFORE, 0, nparams, params);
+}
+
+static void ring_evt_push_after(void *closure, const struct afb_hookid *hookid, const char *evt, int id, unsigned nparams, struct afb_data * const params[], int result)
+{
+	ring_evt(closure, hookid, evt, id, AFB_TRACE_RING_EVT_PUSH_AFTER, result, nparams, params);
+}
+
+static void ring_evt_broadcast_before(void *closure, const struct afb_hookid *hookid, const char *evt, int id, unsigned nparams, struct afb_data * const params[])
+{
+	ring_evt(closure, hookid, evt, id, AFB_TRACE_RING_EVT_BROADCAST_BEFORE, 0, nparams, params);
+}
+
+static void ring_evt_broadcast_after(void *closure, const struct afb_hookid *hookid, const char *evt, int id, unsigned nparams, struct afb_data * const params[], int result)
+{
+	ring_evt(closure, hookid, evt, id, AFB_TRACE_RING_EVT_BROADCAST_AFTER, result, nparams, params);
+}
+
+static struct afb_hook_evt_itf ring_evt_itf = {
+	.hook_evt_create = ring_evt_create,
+	.hook_evt_push_before = ring_evt_push_before,
+	.hook_evt_push_after = ring_evt_push_after,
+	.hook_evt_broadcast_before = ring_evt_broadcast_before,
+	.hook_evt_broadcast_after = ring_evt_broadcast_after
+};
+
 /*******************************************************************************/
 /*****  trace the sessions                                                 *****/
 /*******************************************************************************/
@@ -1254,7 +1415,7 @@ static struct afb_session *trace_get_session_by_uuid(struct afb_trace *trace, co
 	return cookie.session;
 }
 
-static struct hook *trace_make_detached_hook(struct afb_trace *trace, const char *event, const char *tag)
+static struct hook *trace_make_detached_hook(struct afb_trace *trace, const char *event, const char *tag, int binary)
 {
 	struct hook *hook;
 
@@ -1263,9 +1424,10 @@ static struct hook *trace_make_detached_hook(struct afb_trace *trace, const char
 	hook = malloc(sizeof *hook);
 	if (hook) {
 		hook->tag = trace_get_tag(trace, tag, 1);
-		hook->event = trace_get_event(trace, event, 1);
+		hook->event = binary ? NULL : trace_get_event(trace, event, 1);
 		hook->session = NULL;
 		hook->handler = NULL;
+		hook->tagid = binary ? afb_trace_ring_name(tag) : 0;
 	}
 	return hook;
 }
@@ -1296,6 +1458,7 @@ struct desc
 	const char *apiname;
 	const char *verbname;
 	const char *pattern;
+	int binary;
 	unsigned flags[Trace_Type_Count];
 };
 
@@ -1319,8 +1482,14 @@ static void addhook(struct desc *desc, enum trace_type type)
 		}
 	}
 
+	/* check binary traces */
+	if (desc->binary && type != Trace_Type_Req && type != Trace_Type_Evt) {
+		ctxt_error(&desc->context->errors, "binary tracing of %s is not available", abstracting[type].name);
+		return;
+	}
+
 	/* allocate the hook */
-	hook = trace_make_detached_hook(trace, desc->name, desc->tag);
+	hook = trace_make_detached_hook(trace, desc->name, desc->tag, desc->binary);
 	if (!hook) {
 		ctxt_error(&desc->context->errors, "allocation of hook failed");
 		return;
@@ -1340,14 +1509,15 @@ static void addhook(struct desc *desc, enum trace_type type)
 			}
 		}
 		hook->handler = afb_hook_create_req(desc->apiname, desc->verbname, session,
-				desc->flags[type], &hook_req_itf, hook);
+				desc->flags[type], desc->binary ? &ring_req_itf : &hook_req_itf, hook);
 		afb_session_unref(session);
 		break;
 	case Trace_Type_Api:
 		hook->handler = afb_hook_create_api(desc->apiname, desc->flags[type], &hook_api_itf, hook);
 		break;
 	case Trace_Type_Evt:
-		hook->handler = afb_hook_create_evt(desc->pattern, desc->flags[type], &hook_evt_itf, hook);
+		hook->handler = afb_hook_create_evt(desc->pattern, desc->flags[type],
+				desc->binary ? &ring_evt_itf : &hook_evt_itf, hook);
 		break;
 	case Trace_Type_Session:
 		hook->handler = afb_hook_create_session(desc->uuid, desc->flags[type], &hook_session_itf, hook);
@@ -1365,7 +1535,8 @@ static void addhook(struct desc *desc, enum trace_type type)
 	}
 
 	/* attach and activate the hook */
-	afb_req_common_subscribe(desc->context->req, hook->event->evt);
+	if (hook->event)
+		afb_req_common_subscribe(desc->context->req, hook->event->evt);
 	trace_attach_hook(trace, hook, type);
 }
 
@@ -1431,13 +1602,16 @@ static void add(void *closure, struct json_object *object)
 {
 	int rc;
 	struct desc desc;
+	const char *format;
 	struct json_object *request, *event, *sub, *global, *session, *api;
 
 	memcpy (&desc, closure, sizeof desc);
 	request = event = sub = global = session = api = NULL;
+	format = NULL;
 
-	rc = rp_jsonc_unpack(object, "{s?s s?s s?s s?s s?s s?s s?o s?o s?o s?o s?o s?o}",
+	rc = rp_jsonc_unpack(object, "{s?s s?s s?s s?s s?s s?s s?s s?o s?o s?o s?o s?o s?o}",
 			"name", &desc.name,
+			"format", &format,
 			"tag", &desc.tag,
 			"apiname", &desc.apiname,
 			"verbname", &desc.verbname,
@@ -1461,6 +1635,16 @@ static void add(void *closure, struct json_object *object)
 		if (desc.uuid && desc.uuid[0] == '*' && !desc.uuid[1])
 			desc.uuid = NULL;
 
+		/* get the format */
+		if (format) {
+			if (!strcmp(format, "binary"))
+				desc.binary = 1;
+			else if (!strcmp(format, "json"))
+				desc.binary = 0;
+			else
+				ctxt_error(&desc.context->errors, "unknown format %s", format);
+		}
+
 		/* get what is expected */
 		if (request)
 			rp_jsonc_optarray_for_all(request, add_req_flags, &desc);
@@ -1615,6 +1799,46 @@ int afb_trace_add(struct afb_req_common *req, struct json_object *args, struct a
 	return -1;
 }
 
+/* setup the binary traces */
+int afb_trace_setup(struct afb_req_common *req, struct json_object *args)
+{
+	int rc, count = 0, length = 0;
+	const char *error;
+
+	if (rp_jsonc_unpack(args, "{s?i s?i}", "count", &count, "length", &length)
+	 || count < 0 || count > TRACE_RING_COUNT_MAX
+	 || length < 0 || length > TRACE_RING_LENGTH_MAX)
+		error = "invalid ring setup";
+	else {
+		rc = afb_trace_ring_setup(NULL, (unsigned)count, (unsigned)length);
+		if (rc >= 0)
+			return 0;
+		error = rc == X_EBUSY ? "ring already setup" : "ring setup failed";
+	}
+	afb_json_legacy_req_reply_hookable(req, NULL, "error-detected", error);
+	return -1;
+}
+
+/* dump the binary traces */
+int afb_trace_dump(struct afb_req_common *req)
+{
+	int rc;
+	void *buffer;
+	size_t size;
+	struct afb_data *data;
+
+	rc = afb_trace_ring_snapshot(&buffer, &size);
+	if (rc >= 0) {
+		rc = afb_data_create_raw(&data, &afb_type_predefined_bytearray, buffer, size, free, buffer);
+		if (rc >= 0) {
+			afb_req_common_reply_hookable(req, 0, 1, &data);
+			return 0;
+		}
+	}
+	afb_req_common_reply_internal_error_hookable(req, rc);
+	return -1;
+}
+
 /* drop traces */
 int afb_trace_drop(struct afb_req_common *req, struct json_object *args, struct afb_trace *trace)
 {
@@ -41,5 +41,11 @@ extern void afb_trace_unref(struct afb_trace *trace);
 extern int afb_trace_add(struct afb_req_common *req, struct json_object *args, struct afb_trace *trace);
 extern int afb_trace_drop(struct afb_req_common *req, struct json_object *args, struct afb_trace *trace);
 
+/* setup the binary traces as described by args */
+extern int afb_trace_setup(struct afb_req_common *req, struct json_object *args);
+
+/* reply to req the snapshot of binary traces */
+extern int afb_trace_dump(struct afb_req_common *req);
+
 #endif
 
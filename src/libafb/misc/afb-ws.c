@@ -41,6 +41,13 @@
 #include "sys/x-errno.h"
 #include "sys/x-alloca.h"
 
+/*
+ * size of the input buffer of websockets, 0 for unbuffered input
+ */
+#if !defined(AFB_WS_INPUT_BUFFER_SIZE)
+#  define AFB_WS_INPUT_BUFFER_SIZE 16384
+#endif
+
 /*
  * declaration of the websock interface for afb-ws
  */
@@ -106,6 +113,8 @@ struct afb_ws
 	size_t reading_length;	/* when state reading, remaining length */
 	int reading_last;	/* when state reading, is last? */
 	uint16_t closing_code;	/* when state closing, the code */
+	unsigned dispatching: 1;/* is dispatching input? */
+	unsigned destroyed: 1;	/* was destroyed while dispatching? */
 };
 
 /*
@@ -183,8 +192,11 @@ struct afb_ws *afb_ws_create(int fd, int autoclose, const struct afb_ws_itf *itf
 	result->closure = closure;
 	result->buffer.buffer = NULL;
 	result->buffer.size = 0;
+	result->reading_length = 0;
+	result->dispatching = 0;
+	result->destroyed = 0;
 
-	rc = afb_ev_mgr_add_fd(&result->efd, fd, EV_FD_IN, evfdcb, result, 0, autoclose);
+	rc = afb_ev_mgr_add_fd_sharded(&result->efd, fd, EV_FD_IN, evfdcb, result, 0, autoclose);
 	if (rc < 0)
 		goto error2;
 
@@ -192,6 +204,10 @@ struct afb_ws *afb_ws_create(int fd, int autoclose, const struct afb_ws_itf *itf
 	result->ws = websock_create_v13(&aws_itf, result);
 	if (result->ws == NULL)
 		goto error3;
+#if AFB_WS_INPUT_BUFFER_SIZE
+	/* on failure, input is simply not buffered */
+	websock_set_input_buffer(result->ws, AFB_WS_INPUT_BUFFER_SIZE);
+#endif
 
 	/* finalize */
 	return result;
@@ -224,7 +240,10 @@ void afb_ws_set_max_length(struct afb_ws *ws, size_t maxlen)
 void afb_ws_destroy(struct afb_ws *ws)
 {
 	aws_disconnect(ws, 0);
-	free(ws);
+	if (ws->dispatching)
+		ws->destroyed = 1;
+	else
+		free(ws);
 }
 
 /*
@@ -376,7 +395,7 @@ static ssize_t aws_writev(struct afb_ws *ws, const struct iovec *iov, int iovcnt
 	iov2 = (struct iovec*)iov;
 	sz = dsz;
 	for (;;) {
-		rc = writev(ws->fd, iov2, iovcnt);
+		rc = writev(ws->fd, iov2, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
 		if (rc < 0) {
 			if (errno == EINTR)
 				continue;
@@ -513,14 +532,30 @@ static int aws_read_async_start(struct afb_ws *ws, size_t size)
 
 /*
  * callback on incoming data
+ * The data already buffered are all processed because the socket
+ * will not be signaled readable for them.
  */
 static void aws_on_readable(struct afb_ws *ws)
 {
 	int rc;
+	size_t pending, previous;
 
 	assert(ws->ws != NULL);
-	rc = ws->state == waiting? websock_dispatch(ws->ws, 0) : aws_read_async(ws);
-	if (rc == X_EPIPE)
+	ws->dispatching = 1;
+	pending = 0;
+	do {
+		previous = pending;
+		/* after a fragment, the continuation frame is expected */
+		rc = ws->state == waiting || ws->reading_length == 0
+			? websock_dispatch(ws->ws, 0) : aws_read_async(ws);
+		if (rc < 0 || ws->ws == NULL)
+			break;
+		pending = websock_pending_input(ws->ws);
+	} while (pending != 0 && (previous == 0 || pending < previous));
+	ws->dispatching = 0;
+	if (ws->destroyed)
+		free(ws);
+	else if (rc == X_EPIPE)
 		afb_ws_hangup(ws);
 }
 
@@ -32,16 +32,68 @@
 * manage output
 *************************************************************************************/
 
+/* mark of dispose records having only one argument
+ * (records can move when spilling to heap, so they can not mark themselves) */
+static const char args1_mark;
+#define ARGS1_MARK ((void*)&args1_mark)
+
 /* initialize the coder object */
 void afb_rpc_coder_init(afb_rpc_coder_t *coder)
 {
 	coder->dispose_count = 0;
+	coder->dispose_alloc = AFB_RPC_OUTPUT_DISPOSE_COUNT_INLINE;
+	coder->disposes = coder->inline_disposes;
 	coder->buffer_count = 0;
+	coder->buffer_alloc = AFB_RPC_OUTPUT_BUFFER_COUNT_INLINE;
+	coder->buffers = coder->inline_buffers;
 	coder->inline_remain = 0;
 	coder->pos = 0;
 	coder->size = 0;
 }
 
+/* grow the array *parray of *palloc items of size 'size', inline array is 'inl' */
+static int grow(void **parray, uint32_t *palloc, uint32_t count, void *inl, size_t size, uint32_t max)
+{
+	void *array;
+	uint32_t alloc = *palloc;
+
+	if (alloc >= max)
+		return X_ENOSPC;
+	alloc = alloc > max / 2 ? max : alloc * 2;
+	if (*parray != inl)
+		array = realloc(*parray, alloc * size);
+	else {
+		array = malloc(alloc * size);
+		if (array != NULL)
+			memcpy(array, inl, count * size);
+	}
+	if (array == NULL)
+		return X_ENOMEM;
+	*parray = array;
+	*palloc = alloc;
+	return 0;
+}
+
+/* ensure that one more buffer can be added */
+static inline int reserve_buffer(afb_rpc_coder_t *coder)
+{
+	if (coder->buffer_count < coder->buffer_alloc)
+		return 0;
+	return grow((void**)&coder->buffers, &coder->buffer_alloc, coder->buffer_count,
+			coder->inline_buffers, sizeof *coder->buffers,
+			AFB_RPC_OUTPUT_BUFFER_COUNT_MAX);
+}
+
+/* ensure that one more dispose can be added */
+static inline int reserve_dispose(afb_rpc_coder_t *coder)
+{
+	if (coder->dispose_count < coder->dispose_alloc)
+		return 0;
+	return grow((void**)&coder->disposes, &coder->dispose_alloc, coder->dispose_count,
+			coder->inline_disposes, sizeof *coder->disposes,
+			AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX);
+}
+
 /* Get the output sizes */
 int afb_rpc_coder_output_sizes(afb_rpc_coder_t *coder, uint32_t *size)
 {
@@ -118,11 +170,21 @@ void afb_rpc_coder_output_dispose(afb_rpc_coder_t *coder)
 
 	while (coder->dispose_count) {
 		disp = &coder->disposes[--coder->dispose_count];
-		if (disp->arg == disp)
+		if (disp->arg == ARGS1_MARK)
 			disp->dispose.args1(disp->closure);
 		else
 			disp->dispose.args2(disp->closure, disp->arg);
 	}
+	if (coder->disposes != coder->inline_disposes) {
+		free(coder->disposes);
+		coder->disposes = coder->inline_disposes;
+		coder->dispose_alloc = AFB_RPC_OUTPUT_DISPOSE_COUNT_INLINE;
+	}
+	if (coder->buffers != coder->inline_buffers) {
+		free(coder->buffers);
+		coder->buffers = coder->inline_buffers;
+		coder->buffer_alloc = AFB_RPC_OUTPUT_BUFFER_COUNT_INLINE;
+	}
 	coder->buffer_count = 0;
 	coder->inline_remain = 0;
 	coder->pos = 0;
@@ -133,9 +195,11 @@ void afb_rpc_coder_output_dispose(afb_rpc_coder_t *coder)
 int afb_rpc_coder_on_dispose2_output(afb_rpc_coder_t *coder, void (*dispose)(void*,void*), void *closure, void *arg)
 {
 	afb_rpc_coder_dispose_t *disp;
+	int rc;
 
-	if (coder->dispose_count >= AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX)
-		return X_ENOSPC;
+	rc = reserve_dispose(coder);
+	if (rc < 0)
+		return rc;
 
 	disp = &coder->disposes[coder->dispose_count++];
 	disp->dispose.args2 = dispose;
@@ -148,14 +212,16 @@ int afb_rpc_coder_on_dispose2_output(afb_rpc_coder_t *coder, void (*dispose)(voi
 int afb_rpc_coder_on_dispose_output(afb_rpc_coder_t *coder, void (*dispose)(void*), void *closure)
 {
 	afb_rpc_coder_dispose_t *disp;
+	int rc;
 
-	if (coder->dispose_count >= AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX)
-		return X_ENOSPC;
+	rc = reserve_dispose(coder);
+	if (rc < 0)
+		return rc;
 
 	disp = &coder->disposes[coder->dispose_count++];
 	disp->dispose.args1 = dispose;
 	disp->closure = closure;
-	disp->arg = disp;
+	disp->arg = ARGS1_MARK;
 	return 0;
 }
 
@@ -163,6 +229,7 @@ static int write_at_end(afb_rpc_coder_t *coder, const void *data, uint32_t size)
 {
 	afb_rpc_coder_iovec_t *buf;
 	uint32_t rem;
+	int rc;
 
 	if (size <= AFB_RPC_OUTPUT_INLINE_SIZE) {
 		rem = (uint32_t)coder->inline_remain;
@@ -174,8 +241,9 @@ static int write_at_end(afb_rpc_coder_t *coder, const void *data, uint32_t size)
 			buf->size += size;
 		}
 		else {
-			if (coder->buffer_count >= AFB_RPC_OUTPUT_BUFFER_COUNT_MAX)
-				return X_ENOSPC;
+			rc = reserve_buffer(coder);
+			if (rc < 0)
+				return rc;
 			if (rem) {
 				/* append in last inline buffer */
 				buf = &coder->buffers[coder->buffer_count - 1];
@@ -192,8 +260,8 @@ static int write_at_end(afb_rpc_coder_t *coder, const void *data, uint32_t size)
 			buf->size = size;
 		}
 	}
-	else if (coder->buffer_count >= AFB_RPC_OUTPUT_BUFFER_COUNT_MAX)
-		return X_ENOSPC;
+	else if ((rc = reserve_buffer(coder)) < 0)
+		return rc;
 	else {
 		/* record the buffer */
 		buf = &coder->buffers[coder->buffer_count++];
@@ -405,6 +473,25 @@ int afb_rpc_coder_output_get_subiovec(afb_rpc_coder_t *coder, struct iovec *iov,
 	return (int)(ariovs[0] - iov);
 }
 
+/**
+ * Get the output as a iovec from the buffer of given index
+ */
+int afb_rpc_coder_output_get_iovec_at(afb_rpc_coder_t *coder, struct iovec *iov, int iovcnt, uint32_t *index)
+{
+	afb_rpc_coder_iovec_t *buf;
+	uint32_t idx = *index;
+	int cnt = 0;
+
+	while (cnt < iovcnt && idx < coder->buffer_count) {
+		buf = &coder->buffers[idx++];
+		iov[cnt].iov_base = buf->size > AFB_RPC_OUTPUT_INLINE_SIZE ? buf->data.pointer : buf->data.inl;
+		iov[cnt].iov_len = buf->size;
+		cnt++;
+	}
+	*index = idx;
+	return cnt;
+}
+
 /**
  * Get the output as a iovec
  */
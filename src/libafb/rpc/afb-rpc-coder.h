@@ -70,14 +70,29 @@
 # define AFB_RPC_OUTPUT_INLINE_SIZE        (3*sizeof(uint32_t))
 #endif
 
+/* number of output buffers stored inline before spilling to heap */
+#ifndef AFB_RPC_OUTPUT_BUFFER_COUNT_INLINE
+# define AFB_RPC_OUTPUT_BUFFER_COUNT_INLINE   32
+#endif
+
+/* number of output disposers stored inline before spilling to heap */
+#ifndef AFB_RPC_OUTPUT_DISPOSE_COUNT_INLINE
+# define AFB_RPC_OUTPUT_DISPOSE_COUNT_INLINE  32
+#endif
+
 /* maximum number of output buffers */
 #ifndef AFB_RPC_OUTPUT_BUFFER_COUNT_MAX
-# define AFB_RPC_OUTPUT_BUFFER_COUNT_MAX   32
+# define AFB_RPC_OUTPUT_BUFFER_COUNT_MAX   65536
 #endif
 
 /* maximum number of output disposers */
 #ifndef AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX
-# define AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX  32
+# define AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX  65536
+#endif
+
+/* count of iovec to get at once for emitting (should be lower than IOV_MAX) */
+#ifndef AFB_RPC_OUTPUT_IOVEC_COUNT
+# define AFB_RPC_OUTPUT_IOVEC_COUNT        64
 #endif
 
 /******************* declaration of types ***********************/
@@ -123,14 +138,20 @@ struct afb_rpc_coder_dispose
 
 struct afb_rpc_coder
 {
+	/* output tiny size */
+	uint8_t inline_remain;
+
 	/* output buffer count */
-	uint8_t buffer_count;
+	uint32_t buffer_count;
+
+	/* output buffer allocated count */
+	uint32_t buffer_alloc;
 
 	/* output dispose count */
-	uint8_t dispose_count;
+	uint32_t dispose_count;
 
-	/* output tiny size */
-	uint8_t inline_remain;
+	/* output dispose allocated count */
+	uint32_t dispose_alloc;
 
 	/* write position */
 	uint32_t pos;
@@ -138,11 +159,17 @@ struct afb_rpc_coder
 	/* size of the output buffer */
 	uint32_t size;
 
-	/* output buffers */
-	afb_rpc_coder_iovec_t buffers[AFB_RPC_OUTPUT_BUFFER_COUNT_MAX];
+	/* output buffers (either inline_buffers or allocated) */
+	afb_rpc_coder_iovec_t *buffers;
 
-	/* output dispose */
-	afb_rpc_coder_dispose_t disposes[AFB_RPC_OUTPUT_DISPOSE_COUNT_MAX];
+	/* output dispose (either inline_disposes or allocated) */
+	afb_rpc_coder_dispose_t *disposes;
+
+	/* inline output buffers */
+	afb_rpc_coder_iovec_t inline_buffers[AFB_RPC_OUTPUT_BUFFER_COUNT_INLINE];
+
+	/* inline output dispose */
+	afb_rpc_coder_dispose_t inline_disposes[AFB_RPC_OUTPUT_DISPOSE_COUNT_INLINE];
 };
 
 /*************************************************************************************
@@ -192,8 +219,8 @@ extern uint32_t afb_rpc_coder_output_get_subbuffer(afb_rpc_coder_t *coder, void
 extern uint32_t afb_rpc_coder_output_get_buffer(afb_rpc_coder_t *coder, void *buffer, uint32_t size);
 
 /**
- * Release the begin of the output, call dispose on need.
- * The released output matches the minimum of the two given values
+ * Release the output, call dispose on need and free
+ * the memory allocated for buffers and disposers
  *
  * @param coder the coder object
  */
@@ -243,6 +270,25 @@ struct iovec;
  */
 extern int afb_rpc_coder_output_get_iovec(afb_rpc_coder_t *coder, struct iovec *iov, int iovcnt);
 
+/**
+ * Get the output as iovec starting at the buffer of given index.
+ * This allows to emit the output by batches of iovec, for example
+ * when the count of buffers exceeds IOV_MAX. Typical use is:
+ *
+ *    uint32_t index = 0;
+ *    while ((n = afb_rpc_coder_output_get_iovec_at(coder, iov, cnt, &index)) > 0)
+ *        writev(fd, iov, n);
+ *
+ * @param coder the coder object
+ * @param iov the array of iovec to set
+ * @param iovcnt the count of iovec available
+ * @param index pointer to the index of the first buffer to get,
+ *              updated on return to the index of the next buffer
+ *
+ * @return the count of iovec initialized, 0 at end
+ */
+extern int afb_rpc_coder_output_get_iovec_at(afb_rpc_coder_t *coder, struct iovec *iov, int iovcnt, uint32_t *index);
+
 extern int afb_rpc_coder_output_get_subiovec(afb_rpc_coder_t *coder, struct iovec *iov, int iovcnt, uint32_t size, uint32_t offset);
 
 extern int afb_rpc_coder_write_iovec(afb_rpc_coder_t *coder, const struct iovec *iov, int iovcnt);
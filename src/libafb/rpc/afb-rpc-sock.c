@@ -22,17 +22,39 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "afb-rpc-coder.h"
 #include "afb-rpc-decoder.h"
+#include "afb-rpc-sock.h"
+#include "sys/x-errno.h"
+#include "sys/ev-mgr.h"
 
 #if __ZEPHYR__
 #  define MSG_CMSG_CLOEXEC 0
 #endif
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
+
+/** unsent bytes of a message */
+struct afb_rpc_sock_chunk
+{
+	/** next chunk */
+	struct afb_rpc_sock_chunk *next;
+	/** size of data */
+	size_t size;
+	/** offset of the first unsent byte */
+	size_t offset;
+	/** the data */
+	char data[];
+};
 
 /** receive as much as data as possible */
 int afb_rpc_sock_recv_decoder(int sockfd, afb_rpc_decoder_t *decoder)
@@ -61,34 +83,211 @@ int afb_rpc_sock_recv_decoder(int sockfd, afb_rpc_decoder_t *decoder)
 	return (int)ssz;
 }
 
-/** put the received buffers in rpc */
-int afb_rpc_sock_send_coder(int sockfd, afb_rpc_coder_t *coder)
+/**
+ * write without blocking the 'nio' iovecs of 'iov' to 'fd'
+ * using writev when 'fd' is not a socket
+ *
+ * @return the count of bytes written, 0 if the write would block,
+ * or a negative error code
+ */
+static ssize_t write_iovecs(int fd, struct iovec *iov, int nio, uint8_t *notsock)
 {
 	ssize_t ssz;
-	int nio;
 	struct msghdr msghdr;
-	struct iovec iovecs[AFB_RPC_OUTPUT_BUFFER_COUNT_MAX];
-
-	/* get buffers to send */
-	nio = afb_rpc_coder_output_get_iovec(coder, iovecs, AFB_RPC_OUTPUT_BUFFER_COUNT_MAX);
-	if (nio <= 0)
-		return nio;
 
-	/* prepare message header */
-	msghdr.msg_iov = iovecs;
 	msghdr.msg_name = 0;
 	msghdr.msg_namelen = 0;
+	msghdr.msg_iov = iov;
 	msghdr.msg_iovlen = (size_t)nio;
 	msghdr.msg_control = 0;
 	msghdr.msg_controllen = 0;
 	msghdr.msg_flags = 0;
+	for (;;) {
+		if (*notsock)
+			ssz = writev(fd, iov, nio);
+		else {
+			ssz = sendmsg(fd, &msghdr, MSG_DONTWAIT|MSG_NOSIGNAL);
+			if (ssz < 0 && errno == ENOTSOCK) {
+				*notsock = 1;
+				continue;
+			}
+		}
+		if (ssz >= 0)
+			return ssz;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		if (errno != EINTR)
+			return -errno;
+	}
+}
 
-	/* send data */
-	ssz = sendmsg(sockfd, &msghdr, MSG_DONTWAIT);
-	if (ssz < 0)
-		return -1;
+/** write the batches of iovecs of the coder, returns the count of bytes written */
+static ssize_t write_coder(int fd, afb_rpc_coder_t *coder, uint8_t *notsock)
+{
+	int nio;
+	uint32_t index;
+	size_t total;
+	ssize_t ssz;
+	struct iovec iovecs[AFB_RPC_OUTPUT_IOVEC_COUNT], *iov;
+
+	index = 0;
+	total = 0;
+	while ((nio = afb_rpc_coder_output_get_iovec_at(coder, iovecs, AFB_RPC_OUTPUT_IOVEC_COUNT, &index)) > 0) {
+		iov = iovecs;
+		while (nio > 0) {
+			ssz = write_iovecs(fd, iov, nio, notsock);
+			if (ssz <= 0)
+				return ssz < 0 ? ssz : (ssize_t)total;
+			total += (size_t)ssz;
+			/* skip the data written */
+			while (nio > 0 && (size_t)ssz >= iov->iov_len) {
+				ssz -= (ssize_t)iov->iov_len;
+				iov++;
+				nio--;
+			}
+			if (nio > 0) {
+				iov->iov_base = (char*)iov->iov_base + ssz;
+				iov->iov_len -= (size_t)ssz;
+			}
+		}
+	}
+	return nio < 0 ? nio : (ssize_t)total;
+}
 
+/** put the received buffers in rpc */
+int afb_rpc_sock_send_coder(int sockfd, afb_rpc_coder_t *coder)
+{
+	uint8_t notsock = 0;
+	uint32_t length;
+	ssize_t ssz;
+
+	afb_rpc_coder_output_sizes(coder, &length);
+	ssz = write_coder(sockfd, coder, &notsock);
 	afb_rpc_coder_output_dispose(coder);
-	return 0;
+	if (ssz < 0)
+		return (int)ssz;
+	return (size_t)ssz == length ? 0 : ssz == 0 ? X_EAGAIN : X_EPIPE;
+}
+
+/* watch or not the output of efd */
+static void watch_output(struct ev_fd *efd, int watch)
+{
+	uint32_t events = ev_fd_events(efd);
+
+	if (watch)
+		events |= EV_FD_OUT;
+	else
+		events &= ~(uint32_t)EV_FD_OUT;
+	ev_fd_set_events(efd, events);
+}
+
+/* free the chunks of the queue */
+static void free_chunks(struct afb_rpc_sock_queue *queue)
+{
+	struct afb_rpc_sock_chunk *chunk;
+
+	while ((chunk = queue->head) != NULL) {
+		queue->head = chunk->next;
+		free(chunk);
+	}
+}
+
+void afb_rpc_sock_queue_init(struct afb_rpc_sock_queue *queue)
+{
+	x_mutex_init(&queue->mutex);
+	queue->head = NULL;
+	queue->tail = NULL;
+	queue->notsock = 0;
+}
+
+void afb_rpc_sock_queue_release(struct afb_rpc_sock_queue *queue)
+{
+	free_chunks(queue);
+	x_mutex_destroy(&queue->mutex);
+}
+
+void afb_rpc_sock_queue_reset(struct afb_rpc_sock_queue *queue)
+{
+	x_mutex_lock(&queue->mutex);
+	free_chunks(queue);
+	queue->tail = NULL;
+	queue->notsock = 0;
+	x_mutex_unlock(&queue->mutex);
 }
 
+int afb_rpc_sock_queue_send_coder(struct afb_rpc_sock_queue *queue, struct ev_fd *efd, afb_rpc_coder_t *coder)
+{
+	struct afb_rpc_sock_chunk *chunk;
+	uint32_t length;
+	ssize_t ssz;
+	int rc;
+
+	afb_rpc_coder_output_sizes(coder, &length);
+	x_mutex_lock(&queue->mutex);
+
+	/* write directly when nothing is waiting */
+	ssz = queue->head != NULL ? 0 : write_coder(ev_fd_fd(efd), coder, &queue->notsock);
+	if (ssz < 0)
+		rc = (int)ssz;
+	else if ((size_t)ssz == length)
+		rc = 0;
+	else {
+		/* queue the unsent bytes and wait the output */
+		chunk = malloc(sizeof *chunk + length - (size_t)ssz);
+		if (chunk == NULL)
+			rc = ssz ? X_EPIPE : X_ENOMEM;
+		else {
+			chunk->next = NULL;
+			chunk->offset = 0;
+			chunk->size = afb_rpc_coder_output_get_subbuffer(coder,
+					chunk->data, length - (uint32_t)ssz, (uint32_t)ssz);
+			if (queue->head == NULL) {
+				queue->head = chunk;
+				watch_output(efd, 1);
+			}
+			else
+				queue->tail->next = chunk;
+			queue->tail = chunk;
+			rc = 0;
+		}
+	}
+
+	x_mutex_unlock(&queue->mutex);
+	return rc;
+}
+
+int afb_rpc_sock_queue_flush(struct afb_rpc_sock_queue *queue, struct ev_fd *efd)
+{
+	struct afb_rpc_sock_chunk *chunk;
+	struct iovec iovecs[AFB_RPC_OUTPUT_IOVEC_COUNT];
+	ssize_t ssz;
+	int nio, rc;
+
+	x_mutex_lock(&queue->mutex);
+	for (rc = 0 ; rc == 0 && queue->head != NULL ; ) {
+		/* write a batch of chunks */
+		for (nio = 0, chunk = queue->head ; nio < AFB_RPC_OUTPUT_IOVEC_COUNT && chunk ; nio++, chunk = chunk->next) {
+			iovecs[nio].iov_base = &chunk->data[chunk->offset];
+			iovecs[nio].iov_len = chunk->size - chunk->offset;
+		}
+		ssz = write_iovecs(ev_fd_fd(efd), iovecs, nio, &queue->notsock);
+		if (ssz <= 0)
+			rc = ssz < 0 ? (int)ssz : 1;
+		else {
+			/* release the chunks written */
+			while ((chunk = queue->head) != NULL && (size_t)ssz >= chunk->size - chunk->offset) {
+				ssz -= (ssize_t)(chunk->size - chunk->offset);
+				queue->head = chunk->next;
+				free(chunk);
+			}
+			if (chunk != NULL)
+				chunk->offset += (size_t)ssz;
+		}
+	}
+	if (queue->head == NULL) {
+		queue->tail = NULL;
+		watch_output(efd, 0);
+	}
+	x_mutex_unlock(&queue->mutex);
+	return rc;
+}
@@ -26,9 +26,31 @@
 
 #include "../libafb-config.h"
 
+#include <stdint.h>
+
+#include "../sys/x-mutex.h"
+
 typedef struct afb_rpc_coder afb_rpc_coder_t;
 typedef struct afb_rpc_decoder afb_rpc_decoder_t;
 
+struct ev_fd;
+struct afb_rpc_sock_chunk;
+
+/**
+ * Queue of the bytes not yet sent on a connection
+ */
+struct afb_rpc_sock_queue
+{
+	/** protects the queue and the order of messages */
+	x_mutex_t mutex;
+	/** first chunk to send or NULL */
+	struct afb_rpc_sock_chunk *head;
+	/** last chunk to send */
+	struct afb_rpc_sock_chunk *tail;
+	/** is the file not a socket? */
+	uint8_t notsock;
+};
+
 /**
  * Receive as much as data as possible
  *
@@ -40,11 +62,61 @@ typedef struct afb_rpc_decoder afb_rpc_decoder_t;
 extern int afb_rpc_sock_recv_decoder(int sockfd, afb_rpc_decoder_t *decoder);
 
 /**
- * Send the coded buffers to the socket
+ * Send the coded buffers to the socket without blocking and dispose
+ * the coder. No byte is kept: use @ref afb_rpc_sock_queue_send_coder
+ * for connections whose socket can be full.
  *
  * @param sockfd the i/o socket
  * @param coder the coder object to send
  *
- * @return 0 success or a negative error code
+ * @return 0 success, X_EAGAIN if nothing could be sent, X_EPIPE if
+ * the message was partly sent or a negative error code
  */
 extern int afb_rpc_sock_send_coder(int sockfd, afb_rpc_coder_t *coder);
+
+/**
+ * Initialize the output queue of a connection
+ *
+ * @param queue the queue to initialize
+ */
+extern void afb_rpc_sock_queue_init(struct afb_rpc_sock_queue *queue);
+
+/**
+ * Release the memory of the output queue of a connection
+ *
+ * @param queue the queue to release
+ */
+extern void afb_rpc_sock_queue_release(struct afb_rpc_sock_queue *queue);
+
+/**
+ * Drop the bytes waiting in the output queue, when the connection closes
+ *
+ * @param queue the queue to empty
+ */
+extern void afb_rpc_sock_queue_reset(struct afb_rpc_sock_queue *queue);
+
+/**
+ * Send the coded buffers to the file of 'efd' without blocking. The bytes
+ * that can't be sent are copied in the queue and the output of 'efd' is
+ * watched: the handler of 'efd' must then call @ref afb_rpc_sock_queue_flush
+ * when it receives EV_FD_OUT. Messages are never interleaved.
+ * The coder is not disposed.
+ *
+ * @param queue the output queue of the connection
+ * @param efd the watcher of the file of the connection
+ * @param coder the coder object to send
+ *
+ * @return 0 success or a negative error code
+ */
+extern int afb_rpc_sock_queue_send_coder(struct afb_rpc_sock_queue *queue, struct ev_fd *efd, afb_rpc_coder_t *coder);
+
+/**
+ * Send without blocking the bytes of the queue. The output of 'efd'
+ * is no more watched when the queue is empty.
+ *
+ * @param queue the output queue of the connection
+ * @param efd the watcher of the file of the connection
+ *
+ * @return 0 when the queue is empty, 1 when bytes remain or a negative error code
+ */
+extern int afb_rpc_sock_queue_flush(struct afb_rpc_sock_queue *queue, struct ev_fd *efd);
@@ -883,6 +883,7 @@ static int send_call_request_v3(
 	const char *apiname,
 	const char *verbname,
 	const char *usrcreds,
+	int timeout,
 	unsigned nparams,
 	struct afb_data * const params[])
 {
@@ -903,6 +904,7 @@ static int send_call_request_v3(
 		request.session.id = sessionid;
 		request.token.id = tokenid;
 		request.creds.length = usrcreds ? (uint16_t)(1 + strlen(usrcreds)) : 0;
+		request.timeout = (uint32_t)timeout;
 		rc = afb_rpc_v3_code_call_request(&stub->coder, &request, &valarr);
 		if (rc >= 0) {
 			afb_data_array_addref(nparams, params);
@@ -1111,6 +1113,7 @@ static int send_call_request(
 	const char *apiname,
 	const char *verbname,
 	const char *usrcreds,
+	int timeout,
 	unsigned nparams,
 	struct afb_data * const params[])
 {
@@ -1120,10 +1123,10 @@ static int send_call_request(
 	switch (stub->version) {
 #if WITH_RPC_V3
 	case AFBRPC_PROTO_VERSION_3:
-		return send_call_request_v3(stub, callid, sessionid, tokenid, apiname, verbname, usrcreds, nparams, params);
+		return send_call_request_v3(stub, callid, sessionid, tokenid, apiname, verbname, usrcreds, timeout, nparams, params);
 #endif
 	case AFBRPC_PROTO_VERSION_UNSET:
-		return wait_version(stub) ?: send_call_request(stub, callid, sessionid, tokenid, apiname, verbname, usrcreds, nparams, params);
+		return wait_version(stub) ?: send_call_request(stub, callid, sessionid, tokenid, apiname, verbname, usrcreds, timeout, nparams, params);
 	default:
 		return X_ENOTSUP;
 	}
@@ -1223,6 +1226,7 @@ static int ensure_listener(struct afb_stub_rpc *stub)
 		stub->listener = afb_evt_listener_create(&server_event_itf, stub, stub);
 		if (stub->listener == NULL)
 			return X_ENOMEM;
+		afb_evt_listener_set_remote_policy(stub->listener);
 	}
 	return 0;
 }
@@ -1252,17 +1256,35 @@ static void incall_reply_cb(struct afb_req_common *comreq, int status, unsigned
 	emit(stub);
 }
 
+struct retained_push {
+	struct afb_stub_rpc *stub;
+	uint16_t eventid;
+};
+
+static void incall_push_retained_cb(void *closure, unsigned nparams, struct afb_data * const params[])
+{
+	struct retained_push *rp = closure;
+	send_event_push(rp->stub, rp->eventid, nparams, params);
+}
+
 static int incall_subscribe_cb(struct afb_req_common *comreq, struct afb_evt *evt)
 {
 	struct incall *req = containerof(struct incall, comreq, comreq);
 	struct afb_stub_rpc *stub = req->stub;
+	struct retained_push rp = { .stub = stub, .eventid = afb_evt_id(evt) };
+	int added = 0;
 	int rc = ensure_listener(stub);
 	if (rc >= 0)
 		rc = afb_evt_listener_add(stub->listener, evt, 0);
-	if (rc > 0)
+	if (rc > 0) {
+		added = 1;
 		rc = add_event(stub, afb_evt_fullname(evt), afb_evt_id(evt));
+	}
 	if (rc >= 0)
 		rc = send_event_subscribe(stub, req->callid, afb_evt_id(evt));
+	/* the retained value is sent after the subscription for being accepted */
+	if (rc >= 0 && added)
+		afb_evt_retained_apply(evt, incall_push_retained_cb, &rp);
 	if (rc >= 0)
 		rc = emit(stub);
 	if (rc < 0)
@@ -1382,6 +1404,7 @@ static void api_process_cb(void * closure, struct afb_req_common *comreq)
 			ucreds = afb_req_common_on_behalf_cred_export(comreq);
 			rc = send_call_request(stub, call->id, sessionid, tokenid,
 					apiname, comreq->verbname, ucreds,
+					afb_req_common_get_timeout(comreq),
 					comreq->params.ndata, comreq->params.data);
 			if (rc >= 0)
 				rc = emit(stub);
@@ -1432,7 +1455,8 @@ static int receive_call_request(
 	struct afb_data *data[],
 	uint16_t sessionid,
 	uint16_t tokenid,
-	const char *user_creds
+	const char *user_creds,
+	int timeout
 ) {
 	struct incall *incall;
 	struct afb_session *session;
@@ -1490,6 +1514,7 @@ static int receive_call_request(
 	afb_req_common_init(&incall->comreq, &incall_common_itf, apiname, verb, ndata, data, stub);
 	afb_req_common_set_session(&incall->comreq, session);
 	afb_req_common_set_token(&incall->comreq, token);
+	afb_req_common_set_timeout(&incall->comreq, timeout);
 #if WITH_CRED
 	afb_req_common_set_cred(&incall->comreq, stub->cred);
 #endif
@@ -1983,7 +2008,7 @@ static int decode_call_request_v3(struct afb_stub_rpc *stub, afb_rpc_v3_msg_call
 		/* normal case */
 		rc = value_array_to_data_array_v3(stub, count, values->values, datas);
 		if (rc >= 0)
-			rc = receive_call_request(stub, msg->callid, api, verb, count, datas, msg->session.id, msg->token.id, msg->creds.data);
+			rc = receive_call_request(stub, msg->callid, api, verb, count, datas, msg->session.id, msg->token.id, msg->creds.data, (int)msg->timeout);
 	}
 	return rc;
 }
@@ -2543,6 +2568,7 @@ void afb_stub_rpc_unref(struct afb_stub_rpc *stub)
 		}
 		afb_apiset_unref(stub->call_set);
 		afb_rpc_spec_unref(stub->spec);
+		afb_rpc_coder_output_dispose(&stub->coder);
 #if RPC_POOL
 		while ((iblk = stub->receive.pool) != NULL) {
 			stub->receive.pool = iblk->data;
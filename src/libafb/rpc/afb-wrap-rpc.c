@@ -40,6 +40,7 @@
 #include "misc/afb-ws.h"
 #include "misc/afb-vcomm.h"
 #include "rpc/afb-rpc-coder.h"
+#include "rpc/afb-rpc-sock.h"
 #include "rpc/afb-rpc-spec.h"
 #include "core/afb-ev-mgr.h"
 #include "core/afb-cred.h"
@@ -72,6 +73,9 @@
 #if QUERY_RCV_SIZE
 #  include <sys/ioctl.h>
 #endif
+#if !__ZEPHYR__
+#  include <fcntl.h>
+#endif
 #if USE_SND_RCV
 # include <sys/socket.h>
 #endif
@@ -89,6 +93,9 @@ struct afb_wrap_rpc
 
 	/** the FD event handler or NULL */
 	struct ev_fd *efd;
+
+	/** the bytes waiting the output of efd */
+	struct afb_rpc_sock_queue outq;
 #if WITH_VCOMM
 	/** the COM handler or NULL */
 	struct afb_vcomm *vcomm;
@@ -146,6 +153,7 @@ static void disconnect(struct afb_wrap_rpc *wrap)
 	}
 #endif
 	if (wrap->efd != NULL) {
+		afb_rpc_sock_queue_reset(&wrap->outq);
 		ev_fd_unref(wrap->efd);
 		wrap->efd = NULL;
 		was_connected = true;
@@ -176,6 +184,7 @@ static void destroy(struct afb_wrap_rpc *wrap)
 	free(wrap->host);
 #endif
 	free(wrap->mem.buffer);
+	afb_rpc_sock_queue_release(&wrap->outq);
 	free(wrap);
 }
 
@@ -203,6 +212,12 @@ static void onevent_fd(struct ev_fd *efd, int fd, uint32_t revents, void *closur
 		return;
 	}
 
+	/* can send the waiting bytes? */
+	if ((revents & EV_FD_OUT) && afb_rpc_sock_queue_flush(&wrap->outq, efd) < 0) {
+		hangup(wrap);
+		return;
+	}
+
 	/* something to read? */
 	if ((revents & EV_FD_IN) == 0)
 		return; /* no */
@@ -330,41 +345,16 @@ static void onevent_fd(struct ev_fd *efd, int fd, uint32_t revents, void *closur
 
 static int notify_fd(void *closure, struct afb_rpc_coder *coder)
 {
-	ssize_t ssz;
-	struct iovec iovs[AFB_RPC_OUTPUT_BUFFER_COUNT_MAX];
 	struct afb_wrap_rpc *wrap = closure;
 	int rc = 0;
 
 	if (wrap->efd == NULL)
 		rc = reconnect(wrap);
 	if (rc >= 0) {
-		rc = afb_rpc_coder_output_get_iovec(coder, iovs, AFB_RPC_OUTPUT_BUFFER_COUNT_MAX);
-		if (rc > 0) {
-			int fd = ev_fd_fd(wrap->efd);
-#if USE_SND_RCV
-			struct msghdr msg = {
-				.msg_name       = NULL,
-				.msg_namelen    = 0,
-				.msg_iov        = iovs,
-				.msg_iovlen     = (unsigned)rc,
-				.msg_control    = NULL,
-				.msg_controllen = 0,
-				.msg_flags      = 0
-			};
-			do {
-				ssz = sendmsg(fd, &msg, 0);
-			} while (ssz < 0 && errno == EINTR);
-#else
-			do {
-				ssz = writev(fd, iovs, rc);
-			} while (ssz < 0 && errno == EINTR);
-#endif
-			if (ssz < 0) {
-				if (errno == EPIPE)
-					hangup(wrap);
-				rc = X_EPIPE;
-			}
-		}
+		/* never blocks, bytes not sent are sent on EV_FD_OUT */
+		rc = afb_rpc_sock_queue_send_coder(&wrap->outq, wrap->efd, coder);
+		if (rc == X_EPIPE)
+			hangup(wrap);
 	}
 	return rc;
 }
@@ -441,14 +431,28 @@ static void disposews(void *closure, void *buffer, size_t size)
 static int notify_ws(void *closure, struct afb_rpc_coder *coder)
 {
 	int rc;
+	uint32_t index;
 	struct afb_wrap_rpc *wrap = closure;
+	struct iovec stkiovs[AFB_RPC_OUTPUT_IOVEC_COUNT], *iovs;
+
 	if (wrap->ws == NULL)
 		rc = X_ECONNABORTED;
 	else {
-		struct iovec iovs[AFB_RPC_OUTPUT_BUFFER_COUNT_MAX];
-		rc = afb_rpc_coder_output_get_iovec(coder, iovs, AFB_RPC_OUTPUT_BUFFER_COUNT_MAX);
+		/* the message is sent in one frame so all iovecs are needed */
+		rc = afb_rpc_coder_output_sizes(coder, NULL);
+		if (rc <= AFB_RPC_OUTPUT_IOVEC_COUNT)
+			iovs = stkiovs;
+		else {
+			iovs = malloc((unsigned)rc * sizeof *iovs);
+			if (iovs == NULL)
+				return X_ENOMEM;
+		}
+		index = 0;
+		rc = afb_rpc_coder_output_get_iovec_at(coder, iovs, rc, &index);
 		if (rc > 0)
 			afb_ws_binary_v(wrap->ws, iovs, rc);
+		if (iovs != stkiovs)
+			free(iovs);
 	}
 	return rc;
 }
@@ -516,8 +520,12 @@ static int init_fd(
 	wrap->efd = NULL;
 	if (fd < 0) /* case of lazy init */
 		return 0;
-	return afb_ev_mgr_add_fd(&wrap->efd, fd, EV_FD_IN,
-	                         onevent_fd, wrap, 0, autoclose);
+#if !__ZEPHYR__
+	/* writes of files that are not sockets must not block */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+	return afb_ev_mgr_add_fd_sharded(&wrap->efd, fd, EV_FD_IN,
+	                                 onevent_fd, wrap, 0, autoclose);
 }
 
 #if WITH_TLS
@@ -695,6 +703,7 @@ int afb_wrap_rpc_create_fd(
 		rc = X_ENOMEM;
 	}
 	else {
+		afb_rpc_sock_queue_init(&wrap->outq);
 		rc = afb_stub_rpc_create(&wrap->stub, spec, callset);
 		if (rc < 0) {
 			if (autoclose)
@@ -709,6 +718,7 @@ int afb_wrap_rpc_create_fd(
 			}
 			afb_stub_rpc_unref(wrap->stub);
 		}
+		afb_rpc_sock_queue_release(&wrap->outq);
 		free(wrap);
 	}
 	*result = NULL;
@@ -921,8 +931,10 @@ int afb_wrap_rpc_create_vcomm(
 	if (*wrap == NULL)
 		rc = X_ENOMEM;
 	else {
+		afb_rpc_sock_queue_init(&(*wrap)->outq);
 		rc = init_vcomm(*wrap, vcomm, 0, spec, callset);
 		if (rc < 0) {
+			afb_rpc_sock_queue_release(&(*wrap)->outq);
 			free(*wrap);
 			*wrap = NULL;
 		}
@@ -30,6 +30,10 @@
 #if !defined(WITH_TIMERFD)
 #  define WITH_TIMERFD 1
 #endif
+#if !WITH_EPOLL || !WITH_TIMERFD
+#  undef WITH_IOURING
+#  define WITH_IOURING 0
+#endif
 
 
 #include <stdlib.h>
@@ -45,6 +49,11 @@
 #include "sys/x-errno.h"
 #include "sys/x-poll.h"
 #include "sys/x-epoll.h"
+#if WITH_IOURING
+#  include <errno.h>
+#  include "sys/x-uring.h"
+#  include "sys/x-spin.h"
+#endif
 
 #include "sys/ev-mgr.h"
 
@@ -114,6 +123,16 @@
 #  endif
 #endif
 
+/******************************************************************************/
+#if WITH_IOURING
+/** count of submission entries of rings */
+#  define URING_ENTRIES 256
+/** user data of the removal requests whose completion is ignored */
+#  define URING_IGNORE  1
+/** tells whether the manager uses a ring or epoll */
+#  define USE_URING(mgr) ((mgr)->uring.fd >= 0)
+#endif
+
 /******************************************************************************/
 
 /** for times in nano seconds (685 years since 1970 -> 2655) */
@@ -198,10 +217,15 @@ struct ev_fd
 	uint16_t is_active: 1;
 
 #if WITH_EPOLL
-	/** is set in epoll ? */
+	/** is set in epoll ? or with io_uring, is a poll pending ? */
 	uint16_t is_set: 1;
 #endif
 
+#if WITH_IOURING
+	/** is the removal of the pending poll requested ? */
+	uint16_t is_canceling: 1;
+#endif
+
 	/** has changed since set ? */
 	uint16_t has_changed: 1;
 
@@ -328,6 +352,20 @@ struct ev_mgr
 	struct pollfd *pollfds;
 #endif
 
+#if WITH_IOURING
+	/** the ring when used instead of epoll, its fd is -1 otherwise */
+	struct x_uring uring;
+
+	/** lock of submissions to the ring */
+	x_spin_t uring_lock;
+
+	/** count of requests pushed to the ring but not submitted */
+	unsigned uring_pending;
+
+	/** is the fd of the ring polled by an other loop ? */
+	uint8_t uring_exported;
+#endif
+
 #if WAKEUP_TGKILL
 	/** last known awaiting thread id */
 	pid_t tid;
@@ -353,14 +391,16 @@ struct ev_mgr
 	/** reference count */
 	uint16_t refcount;
 
-	/** current state */
-	uint16_t state: 3;
+	/** boolean flag indicating if efds list has changed,
+	 * not a bit field because it can be set by other threads */
+	uint8_t efds_changed;
 
-	/** boolean flag indicating if efds list has changed */
-	uint16_t efds_changed: 1;
+	/** flag indicating that a cleanup of efds is needed,
+	 * not a bit field because it can be set by other threads */
+	uint8_t efds_cleanup;
 
-	/** flag indicating that a cleanup of efds is needed */
-	uint16_t efds_cleanup: 1;
+	/** current state */
+	uint16_t state: 3;
 
 	/** flag indicating that a cleanup of preparers is needed */
 	uint16_t preparers_cleanup: 1;
@@ -424,6 +464,215 @@ inline uint32_t ev_fd_to_epoll(uint32_t events)
 }
 #endif
 
+#if WITH_IOURING
+/******************************************************************************/
+/******************************************************************************/
+/** SECTION io_uring                                                         **/
+/******************************************************************************/
+/******************************************************************************/
+
+/* Experimental, see sys/x-uring.h: rings replace epoll for polling files,
+ * their reads and writes are not made through the ring. */
+
+static time_unit_t now_ut();
+
+/**
+ * Submits the pending requests, the lock being held
+ */
+static void uring_submit(struct ev_mgr *mgr)
+{
+	int rc;
+
+	if (mgr->uring_pending) {
+		rc = x_uring_enter(&mgr->uring, mgr->uring_pending, 0, 0);
+		if (rc > 0)
+			mgr->uring_pending -= (unsigned)rc;
+	}
+}
+
+/**
+ * Pushes a request to the ring, the lock being held. The requests are
+ * submitted in batch when waiting except if an other thread is waiting.
+ */
+static int uring_push(struct ev_mgr *mgr, uint8_t opcode, int fd, uint32_t events, void *addr, void *data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = x_uring_get_sqe(&mgr->uring);
+	if (sqe == NULL) {
+		uring_submit(mgr);
+		sqe = x_uring_get_sqe(&mgr->uring);
+		if (sqe == NULL)
+			return X_EBUSY;
+	}
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	/* the kernel reads the 32 bits of events as two halves */
+	events = (events << 16) | (events >> 16);
+#endif
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	sqe->addr = (uint64_t)(uintptr_t)addr;
+	sqe->user_data = (uint64_t)(uintptr_t)data;
+	x_uring_push_sqe(&mgr->uring);
+	mgr->uring_pending++;
+	if (mgr->state == Waiting)
+		uring_submit(mgr);
+	return 0;
+}
+
+/**
+ * Starts polling efd if needed, the lock being held
+ */
+static int uring_arm(struct ev_mgr *mgr, struct ev_fd *efd)
+{
+	int rc = 0;
+
+	if (!efd->is_set && efd->is_active && !efd->is_deleted && efd->events && efd->fd >= 0) {
+		rc = uring_push(mgr, IORING_OP_POLL_ADD, efd->fd, ev_fd_to_epoll(efd->events), NULL, efd);
+		if (rc == 0)
+			efd->is_set = 1;
+	}
+	return rc;
+}
+
+/**
+ * Requests removal of the pending poll of efd, the lock being held
+ */
+static int uring_cancel(struct ev_mgr *mgr, struct ev_fd *efd)
+{
+	int rc = 0;
+
+	if (efd->is_set && !efd->is_canceling) {
+		rc = uring_push(mgr, IORING_OP_POLL_REMOVE, -1, 0, efd, (void*)URING_IGNORE);
+		if (rc == 0)
+			efd->is_canceling = 1;
+	}
+	return rc;
+}
+
+/**
+ * Wait for an event using the ring. The completions are consumed
+ * one by one and the kernel is entered, for submitting pending
+ * requests and waiting, only when no completion remains.
+ */
+static int uring_wait(struct ev_mgr *mgr, int timeout_ms)
+{
+	struct io_uring_cqe *cqe;
+	struct ev_fd *efd;
+	void *data;
+	int32_t res;
+	uint32_t events;
+	unsigned count, submitted;
+	time_unit_t end = timeout_ms > 0 ? now_ut() + MS2UT(timeout_ms) : 0;
+	int rc;
+
+	/* requests pushed while consuming are submitted later */
+	mgr->state = Pending;
+	for (;;) {
+		cqe = x_uring_peek_cqe(&mgr->uring);
+		if (cqe == NULL) {
+			/* no completion, submit and wait */
+			if (end) {
+				timeout_ms = (int)UT2MS(end - now_ut());
+				if (timeout_ms < 0)
+					timeout_ms = 0;
+			}
+			mgr->state = Waiting;
+			x_spin_lock(&mgr->uring_lock);
+			count = mgr->uring_pending;
+			mgr->uring_pending = 0;
+			x_spin_unlock(&mgr->uring_lock);
+			rc = x_uring_enter(&mgr->uring, count, 1, timeout_ms);
+			mgr->state = Pending;
+			submitted = rc > 0 ? (unsigned)rc : 0;
+			if (submitted < count) {
+				x_spin_lock(&mgr->uring_lock);
+				mgr->uring_pending += count - submitted;
+				x_spin_unlock(&mgr->uring_lock);
+			}
+			if (rc == X_ETIMEDOUT)
+				break;
+			if (rc < 0 && rc != X_EBUSY && rc != X_EAGAIN) {
+				mgr->event.events = 0;
+				mgr->state = Idle;
+				return rc;
+			}
+			continue;
+		}
+
+		/* consume the completion */
+		data = (void*)(uintptr_t)cqe->user_data;
+		res = cqe->res;
+		x_uring_seen_cqe(&mgr->uring);
+
+		if (data == (void*)URING_IGNORE)
+			continue;
+
+		if (data == mgr) {
+			/* wakeup */
+#if WAKEUP_EVENTFD
+			uint64_t x;
+			read(mgr->eventfd, &x, sizeof x);
+			x_spin_lock(&mgr->uring_lock);
+			uring_push(mgr, IORING_OP_POLL_ADD, mgr->eventfd, EPOLLIN, NULL, mgr);
+#else
+			char x;
+			read(mgr->pipefds[0], &x, sizeof x);
+			x_spin_lock(&mgr->uring_lock);
+			uring_push(mgr, IORING_OP_POLL_ADD, mgr->pipefds[0], EPOLLIN, NULL, mgr);
+#endif
+			x_spin_unlock(&mgr->uring_lock);
+			mgr->event.events = 0;
+			mgr->state = Idle;
+			return X_EINTR;
+		}
+
+		if (data == NULL) {
+			/* timer */
+			x_spin_lock(&mgr->uring_lock);
+			uring_push(mgr, IORING_OP_POLL_ADD, mgr->timerfd, EPOLLIN, NULL, NULL);
+			x_spin_unlock(&mgr->uring_lock);
+			mgr->event.data.ptr = NULL;
+			mgr->event.events = EPOLLIN;
+			mgr->state = Pending;
+			return 1;
+		}
+
+		/* event of a file */
+		efd = data;
+		x_spin_lock(&mgr->uring_lock);
+		efd->is_set = 0;
+		efd->is_canceling = 0;
+		if (efd->is_deleted) {
+			mgr->efds_cleanup = 1;
+			events = 0;
+		}
+		else if (res < 0) {
+			/* canceled for changing events or not pollable */
+			if (res == -ECANCELED)
+				uring_arm(mgr, efd);
+			events = 0;
+		}
+		else {
+			events = (uint32_t)res & (ev_fd_to_epoll(efd->events) | EPOLLERR | EPOLLHUP);
+			if (events == 0)
+				uring_arm(mgr, efd);
+		}
+		x_spin_unlock(&mgr->uring_lock);
+		if (events) {
+			mgr->event.data.ptr = efd;
+			mgr->event.events = events;
+			mgr->state = Pending;
+			return 1;
+		}
+	}
+	mgr->event.events = 0;
+	mgr->state = Idle;
+	return 0;
+}
+#endif
+
 /******************************************************************************/
 /******************************************************************************/
 /** SECTION ev_fd                                                            **/
@@ -455,6 +704,9 @@ int ev_mgr_add_fd(
 		efd->is_active = 1;
 #if WITH_EPOLL
 		efd->is_set = 0;
+#endif
+#if WITH_IOURING
+		efd->is_canceling = 0;
 #endif
 	        efd->has_changed = 0;
 	        efd->auto_close = !!autoclose;
@@ -480,8 +732,16 @@ struct ev_fd *ev_fd_addref(struct ev_fd *efd)
 void ev_fd_unref(struct ev_fd *efd)
 {
 	if (efd && !__atomic_sub_fetch(&efd->refcount, 1, __ATOMIC_RELAXED)) {
+#if WITH_IOURING
+		if (efd->mgr && USE_URING(efd->mgr)) {
+			x_spin_lock(&efd->mgr->uring_lock);
+			uring_cancel(efd->mgr, efd);
+			x_spin_unlock(&efd->mgr->uring_lock);
+		}
+		else
+#endif
 #if WITH_EPOLL
-		if (efd->is_active && efd->is_set) {
+		if (efd->is_active && efd->is_set && efd->mgr) {
 			int rc = epoll_ctl(efd->mgr->epollfd, EPOLL_CTL_DEL, efd->fd, 0);
 			if (rc == 0)
 				efd->is_set = 0;
@@ -511,6 +771,19 @@ uint32_t ev_fd_events(struct ev_fd *efd)
 
 void ev_fd_set_events(struct ev_fd *efd, uint32_t events)
 {
+#if WITH_IOURING
+	if (efd->events != events && efd->mgr && USE_URING(efd->mgr)) {
+		/* a pending poll is removed and then armed again with the new events */
+		x_spin_lock(&efd->mgr->uring_lock);
+		efd->events = ev_fd_to_epoll(events);
+		if (efd->is_set)
+			uring_cancel(efd->mgr, efd);
+		else
+			uring_arm(efd->mgr, efd);
+		x_spin_unlock(&efd->mgr->uring_lock);
+		return;
+	}
+#endif
 #if WITH_EPOLL
 	if (efd->events != events) {
 		int rc = 0;
@@ -555,6 +828,14 @@ static void fd_dispatch(struct ev_fd *efd, uint32_t events)
 		efd->handler(efd, efd->fd, events, efd->closure);
 	if (events & EV_FD_HUP) {
 		if (efd->fd >= 0) {
+#if WITH_IOURING
+			if (efd->mgr && USE_URING(efd->mgr)) {
+				/* the poll is complete, avoid arming it again */
+				if (efd->auto_close || efd->auto_unref)
+					efd->is_active = 0;
+			}
+			else
+#endif
 #if WITH_EPOLL
 			if (efd->is_set && (efd->auto_close || efd->auto_unref)) {
 				efd->is_set = 0;
@@ -585,6 +866,18 @@ static int efds_prepare(struct ev_mgr *mgr)
 	mgr->efds_changed = 0;
 	rc = 0;
 	efd = mgr->efds;
+#if WITH_IOURING
+	if (USE_URING(mgr)) {
+		x_spin_lock(&mgr->uring_lock);
+		for ( ; efd ; efd = efd->next) {
+			efd->has_changed = 0;
+			s = efd->is_active ? uring_arm(mgr, efd) : uring_cancel(mgr, efd);
+			if (s < 0)
+				rc = s;
+		}
+		x_spin_unlock(&mgr->uring_lock);
+	}
+#endif
 	while (efd) {
 #if WITH_EPOLL
 		if (efd->is_active) {
@@ -632,6 +925,17 @@ static void efds_cleanup(struct ev_mgr *mgr)
 		pefd = &mgr->efds;
 		efd = *pefd;
 		while (efd) {
+#if WITH_IOURING
+			if (efd->is_deleted && efd->is_set && USE_URING(mgr)) {
+				/* freed when the removal of its poll completes */
+				x_spin_lock(&mgr->uring_lock);
+				uring_cancel(mgr, efd);
+				x_spin_unlock(&mgr->uring_lock);
+				pefd = &efd->next;
+				efd = efd->next;
+			}
+			else
+#endif
 			if (efd->is_deleted) {
 #if WITH_EPOLL
 				if (efd->is_set)
@@ -1011,6 +1315,14 @@ static int do_prepare(struct ev_mgr *mgr, time_unit_t wakeup_ms)
 #endif
 			rc = efds_prepare(mgr);
 		}
+#if WITH_IOURING
+		if (USE_URING(mgr) && mgr->uring_exported) {
+			/* an other loop polls the ring, requests must be submitted */
+			x_spin_lock(&mgr->uring_lock);
+			uring_submit(mgr);
+			x_spin_unlock(&mgr->uring_lock);
+		}
+#endif
 		mgr->state = Ready;
 	}
 	return rc;
@@ -1047,6 +1359,10 @@ static int do_wait(struct ev_mgr *mgr, int timeout_ms)
 #endif
 		if (timeout_ms < 0)
 			timeout_ms = -1;
+#if WITH_IOURING
+		if (USE_URING(mgr))
+			return uring_wait(mgr, timeout_ms);
+#endif
 #if WITH_EPOLL
 		rc = epoll_wait(mgr->epollfd, &mgr->event, 1, timeout_ms);
 #else
@@ -1125,8 +1441,17 @@ static void do_dispatch(struct ev_mgr *mgr)
 #endif
 #if WITH_EPOLL
 		efd = mgr->event.data.ptr;
-		if (efd)
+		if (efd) {
 			fd_dispatch(efd, ev_fd_from_epoll(mgr->event.events));
+#if WITH_IOURING
+			if (USE_URING(mgr)) {
+				/* polls are one shot */
+				x_spin_lock(&mgr->uring_lock);
+				uring_arm(mgr, efd);
+				x_spin_unlock(&mgr->uring_lock);
+			}
+#endif
+		}
 #if WITH_TIMERFD
 		else
 			timer_event(mgr);
@@ -1256,6 +1581,12 @@ void ev_mgr_recover_run(struct ev_mgr *mgr)
 /* pollable file descriptor */
 int ev_mgr_get_fd(struct ev_mgr *mgr)
 {
+#if WITH_IOURING
+	if (USE_URING(mgr)) {
+		mgr->uring_exported = 1;
+		return mgr->uring.fd;
+	}
+#endif
 #if WITH_EPOLL
 	return mgr->epollfd;
 #else
@@ -1287,6 +1618,10 @@ int ev_mgr_create(struct ev_mgr **result)
 #if WITH_EPOLL
 	mgr->epollfd = -1;
 #endif
+#if WITH_IOURING
+	mgr->uring.fd = -1;
+	x_spin_init(&mgr->uring_lock);
+#endif
 #if WAKEUP_EVENTFD
 	mgr->eventfd = -1;
 #elif WAKEUP_PIPE
@@ -1298,13 +1633,24 @@ int ev_mgr_create(struct ev_mgr **result)
 #endif
 
 	/* create the event loop */
-#if WITH_EPOLL
-	mgr->epollfd = epoll_create1(EPOLL_CLOEXEC);
-	if (mgr->epollfd < 0) {
-		rc = -errno;
-		RP_ERROR("can't make new epollfd");
+#if WITH_IOURING
+	/* use io_uring if the kernel allows it, or fallback to epoll */
+	rc = x_uring_init(&mgr->uring, URING_ENTRIES);
+	if (rc < 0 && rc != X_ENOTSUP) {
+		RP_ERROR("can't make new io_uring");
 		goto error2;
 	}
+	if (!USE_URING(mgr))
+#endif
+#if WITH_EPOLL
+	{
+		mgr->epollfd = epoll_create1(EPOLL_CLOEXEC);
+		if (mgr->epollfd < 0) {
+			rc = -errno;
+			RP_ERROR("can't make new epollfd");
+			goto error2;
+		}
+	}
 #endif
 
 #if WAKEUP_EVENTFD
@@ -1317,9 +1663,16 @@ int ev_mgr_create(struct ev_mgr **result)
 	}
 
 #if WITH_EPOLL
-	ee.events = EPOLLIN;
-	ee.data.ptr = mgr;
-	rc = epoll_ctl(mgr->epollfd, EPOLL_CTL_ADD, mgr->eventfd, &ee);
+#if WITH_IOURING
+	if (USE_URING(mgr))
+		rc = uring_push(mgr, IORING_OP_POLL_ADD, mgr->eventfd, EPOLLIN, NULL, mgr);
+	else
+#endif
+	{
+		ee.events = EPOLLIN;
+		ee.data.ptr = mgr;
+		rc = epoll_ctl(mgr->epollfd, EPOLL_CTL_ADD, mgr->eventfd, &ee);
+	}
 #else
 	rc = add_poll(mgr, mgr->eventfd, POLLIN);
 #endif
@@ -1337,9 +1690,16 @@ int ev_mgr_create(struct ev_mgr **result)
 	}
 
 #if WITH_EPOLL
-	ee.events = EPOLLIN;
-	ee.data.ptr = mgr;
-	rc = epoll_ctl(mgr->epollfd, EPOLL_CTL_ADD, mgr->pipefds[0], &ee);
+#if WITH_IOURING
+	if (USE_URING(mgr))
+		rc = uring_push(mgr, IORING_OP_POLL_ADD, mgr->pipefds[0], EPOLLIN, NULL, mgr);
+	else
+#endif
+	{
+		ee.events = EPOLLIN;
+		ee.data.ptr = mgr;
+		rc = epoll_ctl(mgr->epollfd, EPOLL_CTL_ADD, mgr->pipefds[0], &ee);
+	}
 #else
 	rc = add_poll(mgr, mgr->pipefds[0], POLLIN);
 #endif
@@ -1361,9 +1721,16 @@ int ev_mgr_create(struct ev_mgr **result)
 
 	/* add the timer to the polls */
 #if WITH_EPOLL
-	ee.events = EPOLLIN;
-	ee.data.ptr = 0;
-	rc = epoll_ctl(mgr->epollfd, EPOLL_CTL_ADD, mgr->timerfd, &ee);
+#if WITH_IOURING
+	if (USE_URING(mgr))
+		rc = uring_push(mgr, IORING_OP_POLL_ADD, mgr->timerfd, EPOLLIN, NULL, NULL);
+	else
+#endif
+	{
+		ee.events = EPOLLIN;
+		ee.data.ptr = 0;
+		rc = epoll_ctl(mgr->epollfd, EPOLL_CTL_ADD, mgr->timerfd, &ee);
+	}
 #else
 	rc = add_poll(mgr, mgr->timerfd, POLLIN);
 #endif
@@ -1407,6 +1774,17 @@ void ev_mgr_unref(struct ev_mgr *mgr)
 				prep->mgr = 0;
 			for (timer = mgr->timers ; timer ; timer = timer->next)
 				timer->mgr = 0;
+#if WITH_IOURING
+			if (USE_URING(mgr)) {
+				/* closing the ring ends its polls */
+				x_uring_exit(&mgr->uring);
+				for (efd = mgr->efds ; efd ; efd = efd->next)
+					efd->is_set = 0;
+				mgr->efds_cleanup = 1;
+				efds_cleanup(mgr);
+			}
+			x_spin_destroy(&mgr->uring_lock);
+#endif
 			for (efd = mgr->efds ; efd ; efd = efd->next)
 				efd->mgr = 0;
 #if WITH_EPOLL
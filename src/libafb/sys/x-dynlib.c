@@ -28,7 +28,14 @@
 #if WITH_EXTENSION || WITH_DYNAMIC_BINDING
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <dlfcn.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "x-dynlib.h"
 #include "x-errno.h"
@@ -69,6 +76,115 @@ const char* x_dynlib_error(const x_dynlib_t *dynlib)
 	return dlerror();
 }
 
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define NATIVE_ELFDATA ELFDATA2LSB
+#else
+#  define NATIVE_ELFDATA ELFDATA2MSB
+#endif
+
+/*
+ * Search the symbols in the table of dynamic symbols (section SHT_DYNSYM)
+ * of the mapped ELF image. Defines the functions probe_elf32 and probe_elf64.
+ */
+#define PROBE_ELF(bits) \
+static int probe_elf##bits(const char *map, size_t size, const char * const names[], int count) \
+{ \
+	const Elf##bits##_Ehdr *ehdr = (const Elf##bits##_Ehdr*)map; \
+	const Elf##bits##_Shdr *shdr, *symsh, *strsh; \
+	const Elf##bits##_Sym *syms, *sym; \
+	const char *strs, *name; \
+	size_t i, nsyms, nstrs; \
+	int j, result; \
+ \
+	/* check the section headers */ \
+	if (size < sizeof *ehdr || ehdr->e_type != ET_DYN \
+	 || ehdr->e_shoff == 0 || ehdr->e_shnum == 0 \
+	 || ehdr->e_shentsize != sizeof *shdr \
+	 || ehdr->e_shoff > size \
+	 || (size - ehdr->e_shoff) / sizeof *shdr < ehdr->e_shnum) \
+		return X_ENOTSUP; \
+	shdr = (const Elf##bits##_Shdr*)&map[ehdr->e_shoff]; \
+ \
+	/* search the dynamic symbols and their strings */ \
+	for (i = 0 ; i < ehdr->e_shnum && shdr[i].sh_type != SHT_DYNSYM ; i++); \
+	if (i == ehdr->e_shnum) \
+		return X_ENOTSUP; \
+	symsh = &shdr[i]; \
+	if (symsh->sh_link >= ehdr->e_shnum || symsh->sh_entsize != sizeof *syms \
+	 || symsh->sh_offset > size || size - symsh->sh_offset < symsh->sh_size) \
+		return X_ENOTSUP; \
+	strsh = &shdr[symsh->sh_link]; \
+	if (strsh->sh_offset > size || size - strsh->sh_offset < strsh->sh_size \
+	 || strsh->sh_size == 0 || map[strsh->sh_offset + strsh->sh_size - 1] != 0) \
+		return X_ENOTSUP; \
+	syms = (const Elf##bits##_Sym*)&map[symsh->sh_offset]; \
+	nsyms = (size_t)(symsh->sh_size / sizeof *syms); \
+	strs = &map[strsh->sh_offset]; \
+	nstrs = (size_t)strsh->sh_size; \
+ \
+	/* check the defined global symbols */ \
+	result = 0; \
+	for (i = 1 ; i < nsyms ; i++) { \
+		sym = &syms[i]; \
+		if (sym->st_shndx == SHN_UNDEF || sym->st_name >= nstrs \
+		 || (ELF##bits##_ST_BIND(sym->st_info) != STB_GLOBAL \
+		  && ELF##bits##_ST_BIND(sym->st_info) != STB_WEAK)) \
+			continue; \
+		name = &strs[sym->st_name]; \
+		for (j = 0 ; j < count ; j++) \
+			if (strcmp(name, names[j]) == 0) \
+				result |= 1 << j; \
+	} \
+	return result; \
+}
+
+PROBE_ELF(32)
+PROBE_ELF(64)
+
+int x_dynlib_probe(const char *filename, const char * const names[], int count)
+{
+	const unsigned char *ident;
+	struct stat st;
+	void *map;
+	size_t size;
+	int fd, rc;
+
+	if (count < 0 || count > 31)
+		return X_EINVAL;
+
+	/* map the file */
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	if (st.st_size < EI_NIDENT) {
+		close(fd);
+		return X_ENOTSUP;
+	}
+	size = (size_t)st.st_size;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	/* inspect the file if it is an ELF shared object of the machine */
+	ident = map;
+	if (memcmp(ident, ELFMAG, SELFMAG) != 0 || ident[EI_DATA] != NATIVE_ELFDATA)
+		rc = X_ENOTSUP;
+	else if (ident[EI_CLASS] == ELFCLASS64 && sizeof(void*) == 8)
+		rc = probe_elf64(map, size, names, count);
+	else if (ident[EI_CLASS] == ELFCLASS32 && sizeof(void*) == 4)
+		rc = probe_elf32(map, size, names, count);
+	else
+		rc = X_ENOTSUP;
+	munmap(map, size);
+	return rc;
+}
+
 #endif
 #if WITH_ZEPHYR_LLEXT
 
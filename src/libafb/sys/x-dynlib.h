@@ -38,6 +38,21 @@ extern int x_dynlib_symbol(x_dynlib_t *dynlib, const char* name, void** ptr);
 
 extern const char* x_dynlib_error(const x_dynlib_t *dynlib);
 
+/**
+ * Check, without loading it, which of the given symbols are defined
+ * and exported by the dynamic library of 'filename'.
+ *
+ * @param filename path of the dynamic library
+ * @param names    names of the symbols to check
+ * @param count    count of names (at most 31)
+ *
+ * @return a mask whose bit i is set when names[i] is exported or
+ *         a negative error code, X_ENOTSUP when the file can't be
+ *         inspected (not an ELF file of the running machine, no
+ *         section headers, ...)
+ */
+extern int x_dynlib_probe(const char *filename, const char * const names[], int count);
+
 #endif
 #if WITH_ZEPHYR_LLEXT
 
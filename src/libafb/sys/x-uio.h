@@ -52,3 +52,8 @@ extern ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
 extern ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
 
 #endif
+
+#include <limits.h>
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include "../libafb-config.h"
+
+#if WITH_IOURING
+
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "sys/x-errno.h"
+#include "sys/x-uring.h"
+
+/* io_uring has no wrapper in the libc */
+static int uring_setup(unsigned entries, struct io_uring_params *params)
+{
+	return (int)syscall(SYS_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+	return (int)syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+int x_uring_init(struct x_uring *ring, unsigned entries)
+{
+	struct io_uring_params params;
+	unsigned *array, idx;
+	char *sq;
+	int fd;
+
+	memset(ring, 0, sizeof *ring);
+	ring->fd = -1;
+
+	/* create the ring, cooperative task running if available */
+	memset(&params, 0, sizeof params);
+	params.flags = IORING_SETUP_CLAMP | IORING_SETUP_COOP_TASKRUN;
+	fd = uring_setup(entries, &params);
+	if (fd < 0 && errno == EINVAL) {
+		memset(&params, 0, sizeof params);
+		params.flags = IORING_SETUP_CLAMP;
+		fd = uring_setup(entries, &params);
+	}
+	/* before linux 5.12, rings are charged on RLIMIT_MEMLOCK and fail
+	 * with ENOMEM when it is low: let epoll be used instead */
+	if (fd < 0)
+		return errno == EMFILE || errno == ENFILE ? -errno : X_ENOTSUP;
+
+	/* timeouts of waits and no lost completion are required */
+	if ((params.features & (IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP))
+			!= (IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP)) {
+		close(fd);
+		return X_ENOTSUP;
+	}
+	ring->fd = fd;
+
+	/* map the rings */
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = 0;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto error;
+	if (ring->cq_ring_size) {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			ring->cq_ring = NULL;
+			goto error;
+		}
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto error;
+	}
+
+	/* record the shared values */
+	sq = ring->sq_ring;
+	ring->sq_entries = params.sq_entries;
+	ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+	ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+	ring->sq_local_tail = *ring->sq_tail;
+	sq = ring->cq_ring ?: ring->sq_ring;
+	ring->cq_mask = *(unsigned*)(sq + params.cq_off.ring_mask);
+	ring->cq_head = (unsigned*)(sq + params.cq_off.head);
+	ring->cq_tail = (unsigned*)(sq + params.cq_off.tail);
+	ring->cqes = (struct io_uring_cqe*)(sq + params.cq_off.cqes);
+
+	/* entries of the submission queue are used in order */
+	array = (unsigned*)((char*)ring->sq_ring + params.sq_off.array);
+	for (idx = 0 ; idx < params.sq_entries ; idx++)
+		array[idx] = idx;
+	return 0;
+
+error:
+	/* mapping can also fail on RLIMIT_MEMLOCK, use epoll */
+	x_uring_exit(ring);
+	return X_ENOTSUP;
+}
+
+void x_uring_exit(struct x_uring *ring)
+{
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != NULL)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	memset(ring, 0, sizeof *ring);
+	ring->fd = -1;
+}
+
+struct io_uring_sqe *x_uring_get_sqe(struct x_uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+	if (ring->sq_local_tail - head >= ring->sq_entries)
+		return NULL;
+	sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+	memset(sqe, 0, sizeof *sqe);
+	return sqe;
+}
+
+void x_uring_push_sqe(struct x_uring *ring)
+{
+	__atomic_store_n(ring->sq_tail, ++ring->sq_local_tail, __ATOMIC_RELEASE);
+}
+
+int x_uring_enter(struct x_uring *ring, unsigned to_submit, int wait, int timeout_ms)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned flags = 0;
+	int rc;
+
+	memset(&arg, 0, sizeof arg);
+	if (wait) {
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		arg.sigmask_sz = _NSIG / 8;
+		if (timeout_ms >= 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+			arg.ts = (uint64_t)(uintptr_t)&ts;
+		}
+	}
+	rc = uring_enter(ring->fd, to_submit, !!wait, flags, wait ? &arg : NULL, wait ? sizeof arg : 0);
+	return rc >= 0 ? rc : errno == ETIME ? X_ETIMEDOUT : -errno;
+}
+
+struct io_uring_cqe *x_uring_peek_cqe(struct x_uring *ring)
+{
+	unsigned head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+	return &ring->cqes[head & ring->cq_mask];
+}
+
+void x_uring_seen_cqe(struct x_uring *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#pragma once
+
+#include "../libafb-config.h"
+
+#if WITH_IOURING
+
+/*
+ * EXPERIMENTAL: io_uring is only used by ev_mgr for polling files, in
+ * place of epoll. Files are still read and written by their handlers
+ * with the usual system calls: completion-based receive in provided
+ * buffers and batched sends, which would need afb-ws and the RPC layers
+ * to be driven by completions, are not implemented. The gain is then
+ * limited to fewer wait system calls when many files are ready.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/**
+ * An io_uring instance with its mapped rings
+ */
+struct x_uring
+{
+	/** file descriptor of the ring or -1 */
+	int fd;
+
+	/** count of entries of the submission queue */
+	unsigned sq_entries;
+
+	/** mask of indexes of the submission queue */
+	unsigned sq_mask;
+
+	/** local value of the tail of the submission queue */
+	unsigned sq_local_tail;
+
+	/** head of the submission queue (shared with the kernel) */
+	unsigned *sq_head;
+
+	/** tail of the submission queue (shared with the kernel) */
+	unsigned *sq_tail;
+
+	/** entries of the submission queue */
+	struct io_uring_sqe *sqes;
+
+	/** mask of indexes of the completion queue */
+	unsigned cq_mask;
+
+	/** head of the completion queue (shared with the kernel) */
+	unsigned *cq_head;
+
+	/** tail of the completion queue (shared with the kernel) */
+	unsigned *cq_tail;
+
+	/** entries of the completion queue */
+	struct io_uring_cqe *cqes;
+
+	/** mapped area of the submission ring */
+	void *sq_ring;
+
+	/** size of the mapped area of the submission ring */
+	size_t sq_ring_size;
+
+	/** mapped area of the completion ring or NULL if shared with sq_ring */
+	void *cq_ring;
+
+	/** size of the mapped area of the completion ring */
+	size_t cq_ring_size;
+
+	/** size of the mapped area of sqes */
+	size_t sqes_size;
+};
+
+/**
+ * Creates an io_uring of 'entries' submission entries. Fails with X_ENOTSUP
+ * if the kernel lacks io_uring or the features needed, or if the memory of
+ * the rings can't be locked.
+ *
+ * @param ring    the ring to initialize
+ * @param entries the count of submission entries
+ *
+ * @return 0 on success or a negative error code
+ */
+extern int x_uring_init(struct x_uring *ring, unsigned entries);
+
+/**
+ * Releases the ring
+ *
+ * @param ring the ring to release
+ */
+extern void x_uring_exit(struct x_uring *ring);
+
+/**
+ * Get a cleared submission entry
+ *
+ * @param ring the ring
+ *
+ * @return the entry or NULL if the submission queue is full
+ */
+extern struct io_uring_sqe *x_uring_get_sqe(struct x_uring *ring);
+
+/**
+ * Makes the entry got with @ref x_uring_get_sqe visible to the kernel
+ *
+ * @param ring the ring
+ */
+extern void x_uring_push_sqe(struct x_uring *ring);
+
+/**
+ * Submits 'to_submit' entries and, if 'wait' isn't zero, waits
+ * at most 'timeout_ms' milliseconds (forever if negative) for
+ * a completion
+ *
+ * @param ring      the ring
+ * @param to_submit count of entries to submit
+ * @param wait      zero for not waiting completions
+ * @param timeout_ms the timeout in milliseconds if waiting
+ *
+ * @return the count of submitted entries or a negative error code,
+ * X_ETIMEDOUT when the timeout expired
+ */
+extern int x_uring_enter(struct x_uring *ring, unsigned to_submit, int wait, int timeout_ms);
+
+/**
+ * Get the next completion entry without consuming it
+ *
+ * @param ring the ring
+ *
+ * @return the entry or NULL if there is no completion
+ */
+extern struct io_uring_cqe *x_uring_peek_cqe(struct x_uring *ring);
+
+/**
+ * Consumes the completion entry got with @ref x_uring_peek_cqe
+ *
+ * @param ring the ring
+ */
+extern void x_uring_seen_cqe(struct x_uring *ring);
+
+#endif
@@ -23,6 +23,7 @@
 
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <alloca.h>
 
@@ -30,6 +31,7 @@
 #include "utils/globmatch.h"
 #include "sys/x-errno.h"
 #include "sys/x-alloca.h"
+#include "sys/x-mutex.h"
 
 /*************************************************************************
  * internal types
@@ -46,10 +48,77 @@ struct pathndl
 	/* the hash value for the pattern */
 	size_t hash;
 
+	/* the score of glob patterns */
+	unsigned score;
+
 	/* the handler */
 	struct globset_handler handler;
 };
 
+/**
+ * Maximum count of states of a compiled automaton. When the
+ * automaton of a group of glob patterns would require more states,
+ * a new group is started. Must be a power of 2.
+ */
+#if !defined(GLOBSET_DFA_MAX_STATES)
+#define GLOBSET_DFA_MAX_STATES 1024
+#endif
+
+/**
+ * Count of states allocated when starting the build of an automaton,
+ * that count is doubled as needed up to GLOBSET_DFA_MAX_STATES.
+ * Must be a power of 2.
+ */
+#if !defined(GLOBSET_DFA_MIN_STATES)
+#define GLOBSET_DFA_MIN_STATES 16
+#endif
+
+/**
+ * Deterministic automaton compiled from the glob patterns.
+ * It gives the best matching handler in one pass over the text.
+ */
+struct globdfa
+{
+	/** count of states, the state 0 is the dead state */
+	unsigned nstates;
+
+	/** count of classes of characters */
+	unsigned nclasses;
+
+	/** the start state */
+	unsigned start;
+
+	/** class of each character */
+	unsigned char classes[256];
+
+	/** best handler of each state (NULL if not accepting) */
+	struct pathndl **accepts;
+
+	/** transitions: trans[state * nclasses + class] */
+	uint16_t *trans;
+};
+
+/**
+ * Group of consecutive glob patterns of the list compiled together
+ */
+struct globgroup
+{
+	/** next group */
+	struct globgroup *next;
+
+	/** first pattern of the group */
+	struct pathndl *first;
+
+	/** count of patterns of the group */
+	unsigned count;
+
+	/** is the automaton to be compiled again? */
+	unsigned dirty;
+
+	/** the automaton or NULL if the patterns are matched one by one */
+	struct globdfa *dfa;
+};
+
 /**
  * Structure that handles a set of global pattern handlers
  */
@@ -58,6 +127,9 @@ struct globset
 	/** linked list of global patterns */
 	struct pathndl *globs;
 
+	/** groups of compiled glob patterns */
+	struct globgroup *groups;
+
 	/** hash dictionary of exact matches */
 	struct pathndl **exacts;
 
@@ -66,6 +138,12 @@ struct globset
 
 	/** count of handlers stored in the dictionary of exact matches */
 	unsigned count;
+
+	/** is there groups to compile? */
+	unsigned pending;
+
+	/** mutex for compiling pending groups */
+	x_mutex_t mutex;
 };
 
 /**
@@ -198,6 +276,527 @@ static struct pathndl *search(
 	return ph;
 }
 
+/*************************************************************************
+ * compilation of glob patterns
+ ************************************************************************/
+
+/** kinds of states of the non deterministic automaton */
+#define NFA_CHAR   0	/* matches one given character */
+#define NFA_GLOB   1	/* matches any sequence of characters */
+#define NFA_FINAL  2	/* end of a pattern */
+
+/**
+ * Non deterministic automaton of the patterns, each pattern
+ * being a sequence of states ending with a final state.
+ */
+struct globnfa
+{
+	/** count of states */
+	unsigned count;
+	/** count of 64 bits words of sets of states */
+	unsigned nwords;
+	/** kind of the states */
+	unsigned char *kinds;
+	/** character of the states of kind NFA_CHAR */
+	unsigned char *chars;
+	/** pattern of the states of kind NFA_FINAL */
+	struct pathndl **finals;
+};
+
+/**
+ * Computes the score that globmatch returns for the pattern when
+ * matching (that score doesn't depend on the matched text).
+ *
+ * @param pat the glob pattern
+ * @return the score of the pattern
+ */
+static unsigned score_of(const char *pat)
+{
+	unsigned r = 1;
+	char c;
+
+	while ((c = *pat++) != GLOB) {
+		if (!c)
+			return r;
+		r++;
+	}
+	c = *pat++;
+	return c ? r + score_of(pat) : r;
+}
+
+/**
+ * Adds the state and its closure to the set of states
+ */
+static void nfa_add(const struct globnfa *nfa, uint64_t *set, unsigned state)
+{
+	set[state >> 6] |= (uint64_t)1 << (state & 63);
+	/* a glob can match an empty string, the state following a glob is never a glob */
+	if (nfa->kinds[state] == NFA_GLOB) {
+		state++;
+		set[state >> 6] |= (uint64_t)1 << (state & 63);
+	}
+}
+
+/**
+ * Computes in 'to' the set of states reached from 'from' when reading
+ * the character 'chr', -1 standing for any character not in patterns.
+ */
+static void nfa_step(const struct globnfa *nfa, const uint64_t *from, uint64_t *to, int chr)
+{
+	unsigned iw, state;
+	uint64_t word;
+
+	memset(to, 0, nfa->nwords * sizeof *to);
+	for (iw = 0 ; iw < nfa->nwords ; iw++) {
+		for (word = from[iw] ; word ; word &= word - 1) {
+			state = (iw << 6) + (unsigned)__builtin_ctzll(word);
+			switch (nfa->kinds[state]) {
+			case NFA_CHAR:
+				if (nfa->chars[state] == chr)
+					nfa_add(nfa, to, state + 1);
+				break;
+			case NFA_GLOB:
+				nfa_add(nfa, to, state);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * Get the best handler of the set of states: the one with the highest
+ * score and, for equal scores, the first of the list of globs
+ */
+static struct pathndl *nfa_best(const struct globnfa *nfa, const uint64_t *set)
+{
+	unsigned iw, state, score;
+	uint64_t word;
+	struct pathndl *best;
+
+	best = NULL;
+	score = 0;
+	for (iw = 0 ; iw < nfa->nwords ; iw++) {
+		for (word = set[iw] ; word ; word &= word - 1) {
+			state = (iw << 6) + (unsigned)__builtin_ctzll(word);
+			/* states are in the order of the list of globs */
+			if (nfa->kinds[state] == NFA_FINAL && nfa->finals[state]->score > score) {
+				score = nfa->finals[state]->score;
+				best = nfa->finals[state];
+			}
+		}
+	}
+	return best;
+}
+
+/**
+ * Hash of a set of states
+ */
+static unsigned set_hash(const uint64_t *set, unsigned nwords)
+{
+	uint64_t h = 0;
+	while (nwords)
+		h = (h ^ set[--nwords]) * 0x100000001b3ull;
+	return (unsigned)(h ^ (h >> 29));
+}
+
+/**
+ * Structure used for building the automaton
+ */
+struct builder
+{
+	/** the non deterministic automaton */
+	struct globnfa nfa;
+	/** the automaton to build */
+	struct globdfa *dfa;
+	/** sets of states of the states of the automaton */
+	uint64_t *sets;
+	/** hashed index of the sets */
+	uint16_t *index;
+	/** count of states allocated */
+	unsigned size;
+};
+
+/**
+ * Index the set of the state in the hashed index of the sets
+ */
+static void index_set(struct builder *builder, unsigned state)
+{
+	unsigned nwords = builder->nfa.nwords;
+	unsigned imask = 2 * builder->size - 1;
+	unsigned h;
+
+	for (h = set_hash(&builder->sets[state * nwords], nwords) & imask ;
+			builder->index[h] ; h = (h + 1) & imask);
+	builder->index[h] = (uint16_t)state;
+}
+
+/**
+ * Allocates the states of the automaton to be built, doubling
+ * the current count of states or starting with GLOBSET_DFA_MIN_STATES
+ *
+ * @param builder the builder
+ * @return 0 on success or X_ENOMEM
+ */
+static int enlarge(struct builder *builder)
+{
+	struct globdfa *dfa = builder->dfa;
+	unsigned nwords = builder->nfa.nwords;
+	unsigned size = builder->size ? 2 * builder->size : GLOBSET_DFA_MIN_STATES;
+	struct pathndl **accepts;
+	uint16_t *trans, *index;
+	uint64_t *sets;
+	unsigned state;
+
+	/* the extra set is where sets are computed before being interned */
+	accepts = realloc(dfa->accepts, size * sizeof *accepts);
+	if (accepts == NULL)
+		return X_ENOMEM;
+	dfa->accepts = accepts;
+	trans = realloc(dfa->trans, (size_t)size * dfa->nclasses * sizeof *trans);
+	if (trans == NULL)
+		return X_ENOMEM;
+	dfa->trans = trans;
+	sets = realloc(builder->sets, (size_t)(size + 1) * nwords * sizeof *sets);
+	if (sets == NULL)
+		return X_ENOMEM;
+	builder->sets = sets;
+	index = calloc(2 * size, sizeof *index);
+	if (index == NULL)
+		return X_ENOMEM;
+	free(builder->index);
+	builder->index = index;
+	builder->size = size;
+
+	/* the dead state, the first state, has no set */
+	for (state = 1 ; state < dfa->nstates ; state++)
+		index_set(builder, state);
+	return 0;
+}
+
+/**
+ * Get the state of the automaton for the set of states of the nfa
+ * that is stored at the index 'nstates' of the sets, creating it if needed.
+ *
+ * @param builder the builder
+ * @return the state or -1 if too many states
+ */
+static int intern(struct builder *builder)
+{
+	struct globdfa *dfa = builder->dfa;
+	unsigned nwords = builder->nfa.nwords;
+	unsigned imask = 2 * builder->size - 1;
+	uint64_t *set = &builder->sets[dfa->nstates * nwords];
+	unsigned h, found, iw;
+
+	/* search the set */
+	for (h = set_hash(set, nwords) & imask ; (found = builder->index[h]) ; h = (h + 1) & imask)
+		if (!memcmp(&builder->sets[found * nwords], set, nwords * sizeof *set))
+			return (int)found;
+
+	/* the empty set is the dead state */
+	for (iw = 0 ; iw < nwords && !set[iw] ; iw++);
+	if (iw == nwords)
+		return 0;
+
+	/* create a new state */
+	if (dfa->nstates == builder->size) {
+		if (builder->size == GLOBSET_DFA_MAX_STATES || enlarge(builder) < 0)
+			return -1;
+		set = &builder->sets[dfa->nstates * nwords];
+	}
+	found = dfa->nstates++;
+	index_set(builder, found);
+	dfa->accepts[found] = nfa_best(&builder->nfa, set);
+	return (int)found;
+}
+
+/**
+ * Builds the automaton for 'count' glob patterns starting at 'first'
+ *
+ * @param first the first glob pattern to compile
+ * @param count count of patterns to compile
+ * @return the automaton or NULL when not possible
+ */
+static struct globdfa *compile(struct pathndl *first, unsigned count)
+{
+	struct builder builder;
+	struct globnfa *nfa = &builder.nfa;
+	struct globdfa *dfa;
+	struct pathndl *ph;
+	int reps[256], rc;
+	struct pathndl **accepts;
+	uint16_t *trans;
+	unsigned nfacount, state, cls, nclasses, idx;
+	const char *pat;
+	char c;
+
+	memset(&builder, 0, sizeof builder);
+	dfa = builder.dfa = calloc(1, sizeof *dfa);
+	if (dfa == NULL)
+		return NULL;
+
+	/* count the states of the nfa and the classes of characters */
+	nfacount = 0;
+	nclasses = 1; /* class 0: characters not in patterns */
+	reps[0] = -1;
+	for (ph = first, idx = 0 ; idx < count ; ph = ph->next, idx++) {
+		for (pat = ph->handler.pattern ; (c = *pat) ; pat++) {
+			if (c == GLOB) {
+				nfacount++;
+				if (!(c = *++pat))
+					break;
+			}
+			nfacount++;
+			if (dfa->classes[(unsigned char)c] == 0) {
+				dfa->classes[(unsigned char)c] = (unsigned char)nclasses;
+				reps[nclasses++] = (unsigned char)c;
+			}
+		}
+		nfacount++; /* final state */
+	}
+
+	/* build the nfa, states of a pattern are followed by the states of the next pattern */
+	nfa->nwords = (nfacount + 63) >> 6;
+	nfa->finals = malloc(nfacount * (sizeof *nfa->finals + sizeof *nfa->kinds + sizeof *nfa->chars));
+	if (nfa->finals == NULL)
+		goto error;
+	nfa->kinds = (unsigned char*)&nfa->finals[nfacount];
+	nfa->chars = &nfa->kinds[nfacount];
+	for (ph = first, idx = 0 ; idx < count ; ph = ph->next, idx++) {
+		for (pat = ph->handler.pattern ; (c = *pat) ; pat++) {
+			if (c == GLOB) {
+				nfa->kinds[nfa->count++] = NFA_GLOB;
+				if (!(c = *++pat))
+					break;
+			}
+			nfa->chars[nfa->count] = (unsigned char)c;
+			nfa->kinds[nfa->count++] = NFA_CHAR;
+		}
+		nfa->finals[nfa->count] = ph;
+		nfa->kinds[nfa->count++] = NFA_FINAL;
+	}
+
+	/* allocates the dfa */
+	dfa->nclasses = nclasses;
+	if (enlarge(&builder) < 0)
+		goto error;
+
+	/* state 0 is the dead state, compute the start state */
+	dfa->nstates = 1;
+	dfa->accepts[0] = NULL;
+	memset(dfa->trans, 0, nclasses * sizeof *dfa->trans);
+	memset(&builder.sets[nfa->nwords], 0, nfa->nwords * sizeof *builder.sets);
+	for (state = 0 ; state < nfa->count ; state++)
+		if (state == 0 || nfa->kinds[state - 1] == NFA_FINAL)
+			nfa_add(nfa, &builder.sets[nfa->nwords], state);
+	rc = intern(&builder);
+	if (rc < 0)
+		goto error;
+	dfa->start = (unsigned)rc;
+
+	/* subset construction */
+	for (state = 1 ; state < dfa->nstates ; state++) {
+		for (cls = 0 ; cls < nclasses ; cls++) {
+			nfa_step(nfa, &builder.sets[state * nfa->nwords],
+					&builder.sets[dfa->nstates * nfa->nwords], reps[cls]);
+			rc = intern(&builder);
+			if (rc < 0)
+				goto error;
+			dfa->trans[state * nclasses + cls] = (uint16_t)rc;
+		}
+	}
+
+	/* give back the states not used */
+	accepts = realloc(dfa->accepts, dfa->nstates * sizeof *accepts);
+	if (accepts != NULL)
+		dfa->accepts = accepts;
+	trans = realloc(dfa->trans, (size_t)dfa->nstates * nclasses * sizeof *trans);
+	if (trans != NULL)
+		dfa->trans = trans;
+	goto end;
+
+error:
+	free(dfa->accepts);
+	free(dfa->trans);
+	free(dfa);
+	dfa = NULL;
+end:
+	free(builder.index);
+	free(builder.sets);
+	free(nfa->finals);
+	return dfa;
+}
+
+/**
+ * Release the automaton
+ */
+static void release(struct globdfa *dfa)
+{
+	if (dfa) {
+		free(dfa->accepts);
+		free(dfa->trans);
+		free(dfa);
+	}
+}
+
+/**
+ * Compiles the patterns of the group. When the automaton of all the
+ * patterns would be too big, the group is split after its longest
+ * prefix that can be compiled, searched by dichotomy, and the remaining
+ * patterns are put in a new dirty group that follows it.
+ *
+ * @param group the group to compile
+ */
+static void group_compile(struct globgroup *group)
+{
+	struct globgroup *next;
+	struct globdfa *dfa, *best;
+	struct pathndl *ph;
+	unsigned lo, hi, mid, idx;
+
+	release(group->dfa);
+	group->dirty = 0;
+	group->dfa = compile(group->first, group->count);
+	if (group->dfa || group->count == 1)
+		return;
+
+	/* search the count 'lo' of patterns that can be compiled */
+	best = NULL;
+	lo = 0;
+	hi = group->count;
+	while (hi - lo > 1) {
+		mid = (lo + hi) >> 1;
+		dfa = compile(group->first, mid);
+		if (dfa == NULL)
+			hi = mid;
+		else {
+			release(best);
+			best = dfa;
+			lo = mid;
+		}
+	}
+	if (lo == 0)
+		lo = 1; /* a single pattern matched one by one */
+
+	/* put the remaining patterns in a new group */
+	next = malloc(sizeof *next);
+	if (next == NULL) {
+		/* match all the patterns one by one */
+		release(best);
+		return;
+	}
+	for (ph = group->first, idx = 0 ; idx < lo ; ph = ph->next, idx++);
+	next->next = group->next;
+	next->first = ph;
+	next->count = group->count - lo;
+	next->dirty = 1;
+	next->dfa = NULL;
+	group->next = next;
+	group->count = lo;
+	group->dfa = best;
+}
+
+/**
+ * Compiles the groups of the set that are dirty
+ *
+ * @param set the set
+ */
+static void compile_pending(struct globset *set)
+{
+	struct globgroup *group;
+
+	x_mutex_lock(&set->mutex);
+	if (set->pending) {
+		for (group = set->groups ; group ; group = group->next)
+			if (group->dirty)
+				group_compile(group);
+		__atomic_store_n(&set->pending, 0, __ATOMIC_RELEASE);
+	}
+	x_mutex_unlock(&set->mutex);
+}
+
+/**
+ * Adds the glob pattern 'ph', last of the list, to the groups of the set.
+ * The group is compiled later, when matching, so that adding a batch of
+ * patterns only compiles them once.
+ *
+ * @param set the set
+ * @param ph the added pattern
+ * @return 0 on success or X_ENOMEM
+ */
+static int group_add(struct globset *set, struct pathndl *ph)
+{
+	struct globgroup *group, **prev;
+
+	/* get the last group */
+	for (prev = &set->groups ; (group = *prev) && group->next ; prev = &group->next);
+
+	/* add the pattern to the last group if it is compiled or to be */
+	if (group && (group->dfa || group->dirty))
+		group->count++;
+	else {
+		/* start a new group */
+		group = malloc(sizeof *group);
+		if (group == NULL)
+			return X_ENOMEM;
+		group->next = NULL;
+		group->first = ph;
+		group->count = 1;
+		group->dfa = NULL;
+		if (*prev)
+			prev = &(*prev)->next;
+		*prev = group;
+	}
+	group->dirty = 1;
+	set->pending = 1;
+	return 0;
+}
+
+/**
+ * Removes the glob pattern 'ph' from the list of glob patterns
+ * and from its group
+ *
+ * @param set the set
+ * @param ph the removed pattern
+ * @param pph the pointer pointing to the removed pattern
+ */
+static void group_del(struct globset *set, struct pathndl *ph, struct pathndl **pph)
+{
+	struct globgroup *group, **prev;
+	struct pathndl *iph;
+	unsigned idx;
+
+	/* search the group of the pattern */
+	for (prev = &set->groups ; (group = *prev) ; prev = &group->next) {
+		for (iph = group->first, idx = 0 ; idx < group->count && iph != ph ; iph = iph->next, idx++);
+		if (idx < group->count)
+			break;
+	}
+
+	/* unlink the pattern */
+	*pph = ph->next;
+	if (group == NULL)
+		return;
+
+	/* remove the pattern from the group */
+	if (--group->count == 0) {
+		*prev = group->next;
+		release(group->dfa);
+		free(group);
+	}
+	else {
+		if (group->first == ph)
+			group->first = ph->next;
+		/* the automaton refers the removed pattern */
+		release(group->dfa);
+		group->dfa = NULL;
+		group->dirty = 1;
+		set->pending = 1;
+	}
+}
+
 /**
  * Allocates a new set of handlers
  *
@@ -205,7 +804,10 @@ static struct pathndl *search(
  */
 struct globset *globset_create()
 {
-	return calloc(1, sizeof(struct globset));
+	struct globset *set = calloc(1, sizeof *set);
+	if (set)
+		x_mutex_init(&set->mutex);
+	return set;
 }
 
 /**
@@ -216,6 +818,7 @@ void globset_destroy(struct globset *set)
 {
 	unsigned i;
 	struct pathndl *ph, *next_ph;
+	struct globgroup *group;
 
 	/* free exact pattern handlers */
 	if (set->gmask) {
@@ -230,6 +833,13 @@ void globset_destroy(struct globset *set)
 		free(set->exacts);
 	}
 
+	/* free groups */
+	while ((group = set->groups)) {
+		set->groups = group->next;
+		release(group->dfa);
+		free(group);
+	}
+
 	/* free global pattern handlers */
 	ph = set->globs;
 	while (ph) {
@@ -239,6 +849,7 @@ void globset_destroy(struct globset *set)
 	}
 
 	/* free the set */
+	x_mutex_destroy(&set->mutex);
 	free(set);
 }
 
@@ -290,6 +901,14 @@ int globset_add(
 	*pph = ph;
 	if (hash)
 		set->count++;
+	else {
+		ph->score = score_of(pat);
+		if (group_add(set, ph) < 0) {
+			*pph = NULL;
+			free(ph);
+			return X_ENOMEM;
+		}
+	}
 	return 0;
 }
 
@@ -320,9 +939,12 @@ int globset_del(
 		return X_ENOENT;
 
 	/* found, remove it */
-	if (hash)
+	if (!hash)
+		group_del(set, ph, pph);
+	else {
+		*pph = ph->next;
 		set->count--;
-	*pph = ph->next;
+	}
 
 	/* store the closure back */
 	if (closure)
@@ -366,8 +988,11 @@ const struct globset_handler *globset_match(
 			struct globset *set,
 			const char *text)
 {
-	struct pathndl *ph, *iph;
-	unsigned hash, g, s;
+	struct pathndl *ph, *iph, *best;
+	const struct globgroup *group;
+	const struct globdfa *dfa;
+	const unsigned char *iter;
+	unsigned hash, g, s, idx, state;
 	char *txt;
 
 	/* local normalization */
@@ -382,18 +1007,34 @@ const struct globset_handler *globset_match(
 			ph = ph->next;
 	}
 
-	/* then if not found */
+	/* then if not found, look in glob patterns for the best match */
 	if (ph == NULL) {
-		/* look in glob patterns for the best match */
+		if (__atomic_load_n(&set->pending, __ATOMIC_ACQUIRE))
+			compile_pending(set);
 		s = 0;
-		iph = set->globs;
-		while(iph) {
-			g = globmatch(iph->handler.pattern, txt);
-			if (g > s) {
-				s = g;
-				ph = iph;
+		for (group = set->groups ; group ; group = group->next) {
+			if ((dfa = group->dfa) != NULL) {
+				/* single pass on the text */
+				iter = (const unsigned char*)txt;
+				state = dfa->start;
+				while (*iter && state)
+					state = dfa->trans[state * dfa->nclasses + dfa->classes[*iter++]];
+				best = dfa->accepts[state];
+				if (best && best->score > s) {
+					s = best->score;
+					ph = best;
+				}
+			}
+			else {
+				/* match patterns of the group one by one */
+				for (iph = group->first, idx = 0 ; idx < group->count ; iph = iph->next, idx++) {
+					g = globmatch(iph->handler.pattern, txt);
+					if (g > s) {
+						s = g;
+						ph = iph;
+					}
+				}
 			}
-			iph = iph->next;
 		}
 	}
 	return ph ? &ph->handler : NULL;
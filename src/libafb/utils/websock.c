@@ -80,6 +80,10 @@ struct websock {
 	unsigned char header[HEADER_MAX_SIZE];
 	const struct websock_itf *itf;
 	void *closure;
+	unsigned char *inbuf;	/* input buffer or NULL when unbuffered */
+	size_t insize;		/* size of the input buffer */
+	size_t inpos;		/* read position in the input buffer */
+	size_t inlen;		/* count of bytes in the input buffer */
 };
 
 static uint32_t domask(uint32_t mask, const void *inbuf, void *outbuf, size_t count)
@@ -162,8 +166,10 @@ static ssize_t ws_writev_masked(struct websock *ws, const struct iovec *iov, int
 			iptr = ((char*)iov[idx].iov_base) + off;
 			avail = iov[idx].iov_len - off;
 			/* masked size */
-			if (remain < avail)
+			if (remain < avail) {
 				sz = remain;
+				off += sz;
+			}
 			else {
 				sz = avail;
 				/* and shift to next iov */
@@ -195,15 +201,40 @@ static ssize_t ws_readv(struct websock *ws, const struct iovec *iov, int iovcnt)
 
 static ssize_t ws_read(struct websock *ws, void *buffer, size_t buffer_size)
 {
-	struct iovec iov;
-	iov.iov_base = buffer;
-	iov.iov_len = buffer_size;
-	return ws_readv(ws, &iov, 1);
+	struct iovec iov[2];
+	ssize_t rc;
+	size_t avail;
+
+	iov[0].iov_base = buffer;
+	iov[0].iov_len = buffer_size;
+	if (ws->inbuf == NULL)
+		return ws_readv(ws, iov, 1);
+
+	/* serve from the input buffer when not empty */
+	avail = ws->inlen - ws->inpos;
+	if (avail != 0) {
+		if (buffer_size > avail)
+			buffer_size = avail;
+		memcpy(buffer, &ws->inbuf[ws->inpos], buffer_size);
+		ws->inpos += buffer_size;
+		return (ssize_t)buffer_size;
+	}
+
+	/* read the expected data directly and what follows in the input buffer */
+	ws->inpos = ws->inlen = 0;
+	iov[1].iov_base = ws->inbuf;
+	iov[1].iov_len = ws->insize;
+	rc = ws_readv(ws, iov, 2);
+	if (rc > 0 && (size_t)rc > buffer_size) {
+		ws->inlen = (size_t)rc - buffer_size;
+		rc = (ssize_t)buffer_size;
+	}
+	return rc;
 }
 
 static int websock_send_internal_v(struct websock *ws, unsigned char first, const struct iovec *iovec, int count)
 {
-	struct iovec iov[32];
+	struct iovec stkiov[32], *iov;
 	int i, j;
 	size_t pos, size, len;
 	ssize_t rc;
@@ -211,8 +242,15 @@ static int websock_send_internal_v(struct websock *ws, unsigned char first, cons
 	unsigned char header[HEADER_MAX_SIZE];
 
 	/* checks count */
-	if (count < 0 || (count + 1) > (int)(sizeof iov / sizeof * iov))
+	if (count < 0)
 		return X_EINVAL;
+	if ((count + 1) <= (int)(sizeof stkiov / sizeof * stkiov))
+		iov = stkiov;
+	else {
+		iov = malloc((unsigned)(count + 1) * sizeof *iov);
+		if (iov == NULL)
+			return X_ENOMEM;
+	}
 
 	/* computes the size */
 	size = 0;
@@ -264,7 +302,10 @@ static int websock_send_internal_v(struct websock *ws, unsigned char first, cons
 
 	/* write it now */
 	rc = (masked ? ws_writev_masked : ws_writev)(ws, iov, i);
-	return rc < 0 ? -errno : 0;
+	rc = rc < 0 ? -errno : 0;
+	if (iov != stkiov)
+		free(iov);
+	return (int)rc;
 }
 
 static int websock_send_internal(struct websock *ws, unsigned char first, const void *buffer, size_t size)
@@ -715,6 +756,7 @@ struct websock *websock_create_v13(const struct websock_itf *itf, void *closure)
 void websock_destroy(struct websock *ws)
 {
 	websock_close_empty(ws);
+	free(ws->inbuf);
 	free(ws);
 }
 
@@ -733,6 +775,31 @@ void websock_set_masking(struct websock *ws, int onoff)
 	ws->outmask = onoff ? (uint32_t)rand() : 0;
 }
 
+int websock_set_input_buffer(struct websock *ws, size_t size)
+{
+	unsigned char *inbuf;
+
+	if (ws->inpos != ws->inlen)
+		return X_EBUSY;
+	if (size == 0)
+		inbuf = NULL;
+	else {
+		inbuf = malloc(size);
+		if (inbuf == NULL)
+			return X_ENOMEM;
+	}
+	free(ws->inbuf);
+	ws->inbuf = inbuf;
+	ws->insize = size;
+	ws->inpos = ws->inlen = 0;
+	return 0;
+}
+
+size_t websock_pending_input(struct websock *ws)
+{
+	return ws->inlen - ws->inpos;
+}
+
 const char *websocket_explain_error(uint16_t code)
 {
 	static const char *msgs[] = {
@@ -93,4 +93,14 @@ extern void websock_set_default_max_length(size_t maxlen);
 extern void websock_set_max_length(struct websock *ws, size_t maxlen);
 extern void websock_set_masking(struct websock *ws, int onoff);
 
+/*
+ * With an input buffer of 'size' bytes, the data are read by big chunks
+ * and many frames can be parsed after a single read. The data still in
+ * the buffer are counted by 'websock_pending_input' and must be dispatched
+ * without waiting the transport to become readable again.
+ * A 'size' of zero removes the input buffer.
+ */
+extern int websock_set_input_buffer(struct websock *ws, size_t size);
+extern size_t websock_pending_input(struct websock *ws);
+
 extern const char *websocket_explain_error(uint16_t code);
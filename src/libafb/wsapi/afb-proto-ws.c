@@ -197,16 +197,27 @@ struct afb_proto_ws
 
 /******************* streaming objects **********************************/
 
-#define WRITEBUF_COUNT_MAX	32
-#define WRITEBUF_BUFSZ		(WRITEBUF_COUNT_MAX * sizeof(uint32_t))
+#define WRITEBUF_COUNT_INLINE	32
+#define WRITEBUF_BUFSZ		(WRITEBUF_COUNT_INLINE * sizeof(uint32_t))
 
-struct writebuf
+/* extra buffer for scalar values when inline buffer is full */
+struct writebuf_extra
 {
-	int iovcount, bufcount;
-	struct iovec iovec[WRITEBUF_COUNT_MAX];
+	struct writebuf_extra *next;
 	char buf[WRITEBUF_BUFSZ];
 };
 
+/* writing buffer, iovec and scalar storage spill to heap on need */
+struct writebuf
+{
+	int iovcount, iovalloc, bufcount;
+	char *buf;
+	struct iovec *iovec;
+	struct writebuf_extra *extras;
+	struct iovec iovecs[WRITEBUF_COUNT_INLINE];
+	char inlbuf[WRITEBUF_BUFSZ];
+};
+
 struct readbuf
 {
 	char *base, *head, *end;
@@ -310,10 +321,51 @@ static int readbuf_object(struct readbuf *rb, struct json_object **object)
 	return rc;
 }
 
+static void writebuf_init(struct writebuf *wb)
+{
+	wb->iovcount = 0;
+	wb->iovalloc = WRITEBUF_COUNT_INLINE;
+	wb->bufcount = 0;
+	wb->buf = wb->inlbuf;
+	wb->iovec = wb->iovecs;
+	wb->extras = NULL;
+}
+
+static void writebuf_release(struct writebuf *wb)
+{
+	struct writebuf_extra *extra;
+
+	while ((extra = wb->extras) != NULL) {
+		wb->extras = extra->next;
+		free(extra);
+	}
+	if (wb->iovec != wb->iovecs)
+		free(wb->iovec);
+}
+
+static int writebuf_grow(struct writebuf *wb)
+{
+	struct iovec *iovec;
+	int alloc = wb->iovalloc * 2;
+
+	if (wb->iovec != wb->iovecs)
+		iovec = realloc(wb->iovec, (unsigned)alloc * sizeof *iovec);
+	else {
+		iovec = malloc((unsigned)alloc * sizeof *iovec);
+		if (iovec != NULL)
+			memcpy(iovec, wb->iovecs, sizeof wb->iovecs);
+	}
+	if (iovec == NULL)
+		return 0;
+	wb->iovec = iovec;
+	wb->iovalloc = alloc;
+	return 1;
+}
+
 static int writebuf_put(struct writebuf *wb, const void *value, size_t length)
 {
 	int i = wb->iovcount;
-	if (i == WRITEBUF_COUNT_MAX)
+	if (i == wb->iovalloc && !writebuf_grow(wb))
 		return 0;
 	wb->iovec[i].iov_base = (void*)value;
 	wb->iovec[i].iov_len = length;
@@ -324,19 +376,31 @@ static int writebuf_put(struct writebuf *wb, const void *value, size_t length)
 static int writebuf_putbuf(struct writebuf *wb, const void *value, int length)
 {
 	char *p;
+	struct writebuf_extra *extra;
 	int i = wb->iovcount, n = wb->bufcount, nafter;
 
 	/* check enough length */
 	nafter = n + length;
-	if (nafter > (int)WRITEBUF_BUFSZ)
-		return 0;
+	if (nafter > (int)WRITEBUF_BUFSZ) {
+		/* switch to an extra buffer */
+		if (length > (int)WRITEBUF_BUFSZ)
+			return 0;
+		extra = malloc(sizeof *extra);
+		if (extra == NULL)
+			return 0;
+		extra->next = wb->extras;
+		wb->extras = extra;
+		wb->buf = extra->buf;
+		n = 0;
+		nafter = length;
+	}
 
 	/* get where to store */
 	p = &wb->buf[n];
 	if (i && p == (((char*)wb->iovec[i - 1].iov_base) + wb->iovec[i - 1].iov_len))
 		/* increase previous iovec */
 		wb->iovec[i - 1].iov_len += (size_t)length;
-	else if (i == WRITEBUF_COUNT_MAX)
+	else if (i == wb->iovalloc && !writebuf_grow(wb))
 		/* no more iovec */
 		return 0;
 	else {
@@ -448,24 +512,28 @@ static int proto_write(struct afb_proto_ws *protows, struct writebuf *wb)
 static int send_version_offer_1(struct afb_proto_ws *protows, uint8_t version)
 {
 	int rc = -1;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_VERSION_OFFER)
 	 && writebuf_uint32(&wb, WSAPI_IDENTIFIER)
 	 && writebuf_uint8(&wb, 1) /* offer one version */
 	 && writebuf_uint8(&wb, version))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
 static int send_version_set(struct afb_proto_ws *protows, uint8_t version)
 {
 	int rc = -1;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_VERSION_SET)
 	 && writebuf_uint8(&wb, version))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
@@ -489,41 +557,47 @@ void afb_proto_ws_call_unref(struct afb_proto_ws_call *call)
 int afb_proto_ws_call_reply(struct afb_proto_ws_call *call, struct json_object *obj, const char *error, const char *info)
 {
 	int rc = -1;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	struct afb_proto_ws *protows = call->protows;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_REPLY)
 	 && writebuf_uint16(&wb, call->callid)
 	 && writebuf_nullstring(&wb, error)
 	 && writebuf_nullstring(&wb, info)
 	 && writebuf_object(&wb, obj))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
 int afb_proto_ws_call_subscribe(struct afb_proto_ws_call *call, uint16_t event_id)
 {
 	int rc = -1;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	struct afb_proto_ws *protows = call->protows;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_EVT_SUBSCRIBE)
 	 && writebuf_uint16(&wb, call->callid)
 	 && writebuf_uint16(&wb, event_id))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
 int afb_proto_ws_call_unsubscribe(struct afb_proto_ws_call *call, uint16_t event_id)
 {
 	int rc = -1;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	struct afb_proto_ws *protows = call->protows;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_EVT_UNSUBSCRIBE)
 	 && writebuf_uint16(&wb, call->callid)
 	 && writebuf_uint16(&wb, event_id))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
@@ -775,13 +849,15 @@ static void client_on_binary(void *closure, char *data, size_t size)
 
 static int client_send_cmd_id16_optstr(struct afb_proto_ws *protows, char order, uint16_t id, const char *value)
 {
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	int rc = -1;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, order)
 	 && writebuf_uint16(&wb, id)
 	 && (!value || writebuf_string(&wb, value)))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
@@ -823,7 +899,7 @@ int afb_proto_ws_client_call(
 {
 	int rc = -1;
 	struct client_call *call;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	uint16_t id;
 
 	/* allocate call data */
@@ -849,6 +925,7 @@ int afb_proto_ws_client_call(
 	x_mutex_unlock(&protows->mutex);
 
 	/* creates the call message */
+	writebuf_init(&wb);
 	if (!writebuf_char(&wb, CHAR_FOR_CALL)
 	 || !writebuf_uint16(&wb, call->callid)
 	 || !writebuf_string(&wb, verb)
@@ -856,12 +933,14 @@ int afb_proto_ws_client_call(
 	 || !writebuf_uint16(&wb, tokenid)
 	 || !writebuf_object(&wb, args)
 	 || !writebuf_nullstring(&wb, user_creds)) {
+		writebuf_release(&wb);
 		rc = X_EINVAL;
 		goto clean;
 	}
 
 	/* send */
 	rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	if (!rc)
 		goto end;
 
@@ -875,7 +954,7 @@ end:
 int afb_proto_ws_client_describe(struct afb_proto_ws *protows, void (*callback)(void*, struct json_object*), void *closure)
 {
 	struct client_describe *desc, *d;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	uint16_t id;
 	int rc;
 
@@ -909,12 +988,13 @@ int afb_proto_ws_client_describe(struct afb_proto_ws *protows, void (*callback)(
 
 	/* send */
 	rc = X_EINVAL;
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_DESCRIBE)
-	 && writebuf_uint16(&wb, desc->descid)) {
+	 && writebuf_uint16(&wb, desc->descid))
 		rc = proto_write(protows, &wb);
-		if (rc >= 0)
-			return 0;
-	}
+	writebuf_release(&wb);
+	if (rc >= 0)
+		return 0;
 
 	x_mutex_lock(&protows->mutex);
 	d = protows->describes;
@@ -980,12 +1060,14 @@ overflow:
 static int server_send_description(struct afb_proto_ws *protows, uint16_t descid, struct json_object *descobj)
 {
 	int rc = -1;
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_DESCRIPTION)
 	 && writebuf_uint16(&wb, descid)
 	 && writebuf_object(&wb, descobj))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
@@ -1146,14 +1228,16 @@ static void server_on_binary(void *closure, char *data, size_t size)
 
 static int server_event_send(struct afb_proto_ws *protows, char order, uint16_t event_id, const char *event_name, struct json_object *data)
 {
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	int rc = -1;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, order)
 	 && writebuf_uint16(&wb, event_id)
 	 && (order != CHAR_FOR_EVT_ADD || writebuf_string(&wb, event_name))
 	 && (order != CHAR_FOR_EVT_PUSH || writebuf_object(&wb, data)))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
@@ -1174,18 +1258,20 @@ int afb_proto_ws_server_event_push(struct afb_proto_ws *protows, uint16_t event_
 
 int afb_proto_ws_server_event_broadcast(struct afb_proto_ws *protows, const char *event_name, struct json_object *data, const unsigned char uuid[16], uint8_t hop)
 {
-	struct writebuf wb = { .iovcount = 0, .bufcount = 0 };
+	struct writebuf wb;
 	int rc = -1;
 
 	if (!hop)
 		return 0;
 
+	writebuf_init(&wb);
 	if (writebuf_char(&wb, CHAR_FOR_EVT_BROADCAST)
 	 && writebuf_string(&wb, event_name)
 	 && writebuf_object(&wb, data)
 	 && writebuf_put(&wb, uuid, 16)
 	 && writebuf_uint8(&wb, (uint8_t)(hop - 1)))
 		rc = proto_write(protows, &wb);
+	writebuf_release(&wb);
 	return rc;
 }
 
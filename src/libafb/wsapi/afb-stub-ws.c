@@ -805,8 +805,10 @@ struct afb_stub_ws *afb_stub_ws_create_server(int fd, int autoclose, const char
 #endif
 		/* add event listener for propagating events */
 		stubws->listener = afb_evt_listener_create(&server_event_itf, stubws, stubws);
-		if (stubws->listener != NULL)
+		if (stubws->listener != NULL) {
+			afb_evt_listener_set_remote_policy(stubws->listener);
 			return stubws; /* success! */
+		}
 		afb_stub_ws_unref(stubws);
 	}
 	return NULL;
@@ -152,6 +152,7 @@ afb_ws_json1_create(
 	result->listener = afb_evt_listener_create(&evt_itf, result, result);
 	if (result->listener == NULL)
 		goto error4;
+	afb_evt_listener_set_remote_policy(result->listener);
 
 #if WITH_CRED
 	afb_cred_create_for_socket(&result->cred, fd);
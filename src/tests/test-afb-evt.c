@@ -319,6 +319,256 @@ START_TEST (test_functional)
 }
 END_TEST
 
+void count_retained_cb(void *closure, unsigned nparams, struct afb_data * const params[])
+{
+    int *count = closure;
+    *count += 1 + (int)nparams;
+}
+
+void do_test_retain(int, void*)
+{
+    struct afb_evt_itf ev_itf = {
+        .push = test_ev_itf_push_cb,
+        .add = test_ev_itf_add_cb,
+        .remove = test_ev_itf_remove_cb
+    };
+    struct afb_evt_listener * ev_listener[NB_LISTENER];
+    struct afb_evt * evt;
+    int cb_closure[NB_LISTENER] = {0}, rc, count;
+
+    fprintf(stderr, "\n******** test_retain *******\n");
+
+    rc = afb_evt_create(&evt, NAME);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_int_eq(afb_evt_is_retaining(evt), 0);
+    afb_evt_set_retain(evt, 1);
+    ck_assert_int_ne(afb_evt_is_retaining(evt), 0);
+
+    fprintf(stderr, "\n## nothing retained before push...\n");
+    count = 0;
+    rc = afb_evt_retained_apply(evt, count_retained_cb, &count);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_int_eq(count, 0);
+    ev_listener[0] = afb_evt_listener_create(&ev_itf, &cb_closure[0], NULL);
+    ck_assert_ptr_ne(ev_listener[0], NULL);
+    rc = afb_evt_listener_watch_evt(ev_listener[0], evt);
+    ck_assert_int_eq(rc, 0);
+    wait_job_completion(1);
+    ck_assert_int_eq(cb_closure[0], add_mask);
+    cb_closure[0] = 0;
+
+    fprintf(stderr, "\n## push retains the value...\n");
+    rc = afb_evt_push(evt, 0, NULL);
+    ck_assert_int_eq(rc, 1);
+    wait_job_completion(1);
+    ck_assert_int_eq(cb_closure[0], push_mask);
+    cb_closure[0] = 0;
+    rc = afb_evt_retained_apply(evt, count_retained_cb, &count);
+    ck_assert_int_eq(rc, 1);
+    ck_assert_int_eq(count, 1);
+
+    fprintf(stderr, "\n## new listener receives the retained value...\n");
+    ev_listener[1] = afb_evt_listener_create(&ev_itf, &cb_closure[1], NULL);
+    ck_assert_ptr_ne(ev_listener[1], NULL);
+    rc = afb_evt_listener_watch_evt(ev_listener[1], evt);
+    ck_assert_int_eq(rc, 0);
+    wait_job_completion(1);
+    ck_assert_int_eq(cb_closure[0], 0);
+    ck_assert_int_eq(cb_closure[1], add_mask | push_mask);
+    cb_closure[1] = 0;
+
+    fprintf(stderr, "\n## watching again doesn't push...\n");
+    rc = afb_evt_listener_watch_evt(ev_listener[1], evt);
+    ck_assert_int_eq(rc, 0);
+    wait_job_completion(1);
+    ck_assert_int_eq(cb_closure[1], 0);
+
+    fprintf(stderr, "\n## stopping to retain drops the value...\n");
+    afb_evt_set_retain(evt, 0);
+    count = 0;
+    rc = afb_evt_retained_apply(evt, count_retained_cb, &count);
+    ck_assert_int_eq(rc, 0);
+    ck_assert_int_eq(count, 0);
+    ev_listener[2] = afb_evt_listener_create(&ev_itf, &cb_closure[2], NULL);
+    ck_assert_ptr_ne(ev_listener[2], NULL);
+    rc = afb_evt_listener_watch_evt(ev_listener[2], evt);
+    ck_assert_int_eq(rc, 0);
+    wait_job_completion(1);
+    ck_assert_int_eq(cb_closure[2], add_mask);
+
+    fprintf(stderr, "\n## retained value is released with the event...\n");
+    afb_evt_set_retain(evt, 1);
+    rc = afb_evt_push(evt, 0, NULL);
+    ck_assert_int_eq(rc, NB_LISTENER);
+    wait_job_completion(1);
+    afb_evt_unref(evt);
+    wait_job_completion(1);
+
+    afb_evt_listener_unref(ev_listener[0]);
+    afb_evt_listener_unref(ev_listener[1]);
+    afb_evt_listener_unref(ev_listener[2]);
+    afb_sched_exit(0, NULL, NULL, 0);
+}
+
+START_TEST (test_retain)
+{
+    afb_sched_start(1, 1, 100, do_test_retain, NULL);
+}
+END_TEST
+
+int push_count;
+
+void count_push_cb(void *closure, const struct afb_evt_pushed *event){
+    push_count++;
+}
+
+void do_test_policy(int, void*)
+{
+    struct afb_evt_itf ev_itf = {
+        .push = count_push_cb
+    };
+    struct afb_evt_listener * ev_listener;
+    struct afb_evt * evt;
+    int rc, i;
+
+    fprintf(stderr, "\n******** test_policy *******\n");
+
+    rc = afb_evt_create(&evt, NAME);
+    ck_assert_int_eq(rc, 0);
+    ev_listener = afb_evt_listener_create(&ev_itf, &push_count, &push_count);
+    ck_assert_ptr_ne(ev_listener, NULL);
+
+    fprintf(stderr, "\n## invalid policies...\n");
+    rc = afb_evt_listener_set_policy(ev_listener, Afb_Evt_Policy_Drop_Oldest, 0);
+    ck_assert_int_eq(rc, X_EINVAL);
+    rc = afb_evt_listener_set_policy(ev_listener, Afb_Evt_Policy_Conflate, 100000);
+    ck_assert_int_eq(rc, X_EINVAL);
+
+    rc = afb_evt_listener_watch_evt(ev_listener, evt);
+    ck_assert_int_eq(rc, 0);
+
+    fprintf(stderr, "\n## unbounded...\n");
+    push_count = 0;
+    for (i = 0 ; i < 10 ; i++)
+        afb_evt_push(evt, 0, NULL);
+    wait_job_completion(1);
+    ck_assert_int_eq(push_count, 10);
+    ck_assert_uint_eq(afb_evt_listener_dropped(ev_listener), 0);
+
+    fprintf(stderr, "\n## conflate...\n");
+    rc = afb_evt_listener_set_policy(ev_listener, Afb_Evt_Policy_Conflate, 0);
+    ck_assert_int_eq(rc, 0);
+    push_count = 0;
+    for (i = 0 ; i < 10 ; i++)
+        afb_evt_push(evt, 0, NULL);
+    wait_job_completion(1);
+    ck_assert_int_eq(push_count, 1);
+    ck_assert_uint_eq(afb_evt_listener_dropped(ev_listener), 9);
+
+    fprintf(stderr, "\n## drop oldest...\n");
+    rc = afb_evt_listener_set_policy(ev_listener, Afb_Evt_Policy_Drop_Oldest, 3);
+    ck_assert_int_eq(rc, 0);
+    push_count = 0;
+    for (i = 0 ; i < 10 ; i++)
+        afb_evt_push(evt, 0, NULL);
+    wait_job_completion(1);
+    ck_assert_int_eq(push_count, 3);
+    ck_assert_uint_eq(afb_evt_listener_dropped(ev_listener), 16);
+
+    fprintf(stderr, "\n## pending pushs released with the listener...\n");
+    for (i = 0 ; i < 10 ; i++)
+        afb_evt_push(evt, 0, NULL);
+    afb_evt_listener_unref(ev_listener);
+    wait_job_completion(1);
+    afb_evt_unref(evt);
+    afb_sched_exit(0, NULL, NULL, 0);
+}
+
+START_TEST (test_policy)
+{
+    afb_sched_start(1, 1, 100, do_test_policy, NULL);
+}
+END_TEST
+
+#define NB_REGISTRY 3000
+
+int remove_count;
+
+void count_remove_cb(void *closure, const char *event, uint16_t evtid){
+    remove_count++;
+}
+
+void do_test_registry(int, void*)
+{
+    struct afb_evt_itf ev_itf = {
+        .push = count_push_cb,
+        .remove = count_remove_cb
+    };
+    struct afb_evt_listener * ev_listener[2];
+    static struct afb_evt * evt[NB_REGISTRY];
+    int rc, i;
+
+    fprintf(stderr, "\n******** test_registry *******\n");
+
+    ev_listener[0] = afb_evt_listener_create(&ev_itf, &ev_listener[0], NULL);
+    ck_assert_ptr_ne(ev_listener[0], NULL);
+    ev_listener[1] = afb_evt_listener_create(&ev_itf, &ev_listener[1], NULL);
+    ck_assert_ptr_ne(ev_listener[1], NULL);
+
+    fprintf(stderr, "\n## watch many events...\n");
+    for (i = 0 ; i < NB_REGISTRY ; i++) {
+        rc = afb_evt_create(&evt[i], NAME);
+        ck_assert_int_eq(rc, 0);
+        rc = afb_evt_listener_add(ev_listener[0], evt[i], 0);
+        ck_assert_int_eq(rc, 1);
+        rc = afb_evt_listener_add(ev_listener[1], evt[i], 0);
+        ck_assert_int_eq(rc, 1);
+    }
+    for (i = 0 ; i < NB_REGISTRY ; i++) {
+        rc = afb_evt_listener_add(ev_listener[0], evt[i], 0);
+        ck_assert_int_eq(rc, 0);
+    }
+
+    fprintf(stderr, "\n## unwatch by id and by event...\n");
+    for (i = 0 ; i < NB_REGISTRY ; i += 2) {
+        rc = afb_evt_listener_remove(ev_listener[0], NULL, afb_evt_id(evt[i]), 0);
+        ck_assert_int_eq(rc, 1);
+        rc = afb_evt_listener_remove(ev_listener[0], evt[i], 0, 0);
+        ck_assert_int_eq(rc, 0);
+    }
+    for (i = 1 ; i < NB_REGISTRY ; i += 2) {
+        rc = afb_evt_listener_remove(ev_listener[1], evt[i], 0, 0);
+        ck_assert_int_eq(rc, 1);
+    }
+
+    fprintf(stderr, "\n## destroy watched events...\n");
+    remove_count = 0;
+    for (i = 0 ; i < NB_REGISTRY / 2 ; i++)
+        afb_evt_unref(evt[i]);
+    ck_assert_int_eq(remove_count, NB_REGISTRY / 2);
+
+    fprintf(stderr, "\n## unwatch all...\n");
+    afb_evt_listener_unwatch_all(ev_listener[0], 0);
+    afb_evt_listener_unwatch_all(ev_listener[1], 0);
+    remove_count = 0;
+    for (i = NB_REGISTRY / 2 ; i < NB_REGISTRY ; i++) {
+        rc = afb_evt_listener_remove(ev_listener[0], evt[i], 0, 0);
+        ck_assert_int_eq(rc, 0);
+        afb_evt_unref(evt[i]);
+    }
+    ck_assert_int_eq(remove_count, 0);
+
+    afb_evt_listener_unref(ev_listener[0]);
+    afb_evt_listener_unref(ev_listener[1]);
+    afb_sched_exit(0, NULL, NULL, 0);
+}
+
+START_TEST (test_registry)
+{
+    afb_sched_start(1, 1, 100, do_test_registry, NULL);
+}
+END_TEST
+
 void do_test_afb_event_x2(int, void*)
 {
     struct afb_evt * evt;
@@ -414,6 +664,38 @@ START_TEST (test_afb_event_x2)
 }
 END_TEST
 
+START_TEST (test_id_exhaustion)
+{
+    struct afb_evt **evts, *evt;
+    uint16_t id;
+    int i, n;
+
+    evts = calloc(UINT16_MAX + 1, sizeof *evts);
+    ck_assert_ptr_ne(NULL, evts);
+
+    // create events until ids are exhausted
+    for (n = 0 ; n <= UINT16_MAX && afb_evt_create(&evts[n], NAME) == 0 ; n++)
+        ck_assert_uint_ne(0, afb_evt_id(evts[n]));
+    ck_assert_int_gt(n, 0);
+    ck_assert_int_le(n, UINT16_MAX);
+    ck_assert_int_eq(X_ECANCELED, afb_evt_create(&evt, NAME));
+
+    // the only free id is found whatever the last id given
+    i = n / 2;
+    id = afb_evt_id(evts[i]);
+    afb_evt_unref(evts[i]);
+    ck_assert_int_eq(0, afb_evt_create(&evts[i], NAME));
+    ck_assert_uint_eq(id, afb_evt_id(evts[i]));
+    ck_assert_int_eq(X_ECANCELED, afb_evt_create(&evt, NAME));
+
+    for (i = 0 ; i < n ; i++)
+        afb_evt_unref(evts[i]);
+    free(evts);
+    ck_assert_int_eq(0, afb_evt_create(&evt, NAME));
+    afb_evt_unref(evt);
+}
+END_TEST
+
 #if TEST_EVT_MAX_COUNT
 START_TEST (test_afb_maxcount)
 {
@@ -456,7 +738,11 @@ int main(int ac, char **av)
         addtcase("afb-jobs");
             addtest(test_init);
             addtest(test_functional);
+            addtest(test_retain);
+            addtest(test_policy);
+            addtest(test_registry);
             addtest(test_afb_event_x2);
+            addtest(test_id_exhaustion);
 #if TEST_EVT_MAX_COUNT
             addtest(test_afb_maxcount);
 #endif
@@ -250,6 +250,189 @@ START_TEST(job_delayed)
 }
 END_TEST
 
+void prio_test_job(int sig, void *arg1, void *arg2){
+	gval = gval * 10 + p2i(arg1);
+}
+
+START_TEST(job_priority)
+{
+	fprintf(stderr, "\n*********************** job_priority ***********************\n");
+
+	int r, i, id;
+	long delay;
+	struct afb_job *job, *jobs[2];
+
+	afb_jobs_set_max_count(NB_TEST_JOBS);
+	ck_assert_int_eq(afb_jobs_get_pending_count(), 0);
+
+	/* by priority */
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Background, prio_test_job, i2p(3), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Normal, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 123);
+
+	/* by deadline then by arrival */
+	r = afb_jobs_post_priority(NULL, 0, 20, Afb_Jobs_Priority_Normal, prio_test_job, i2p(3), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 10, Afb_Jobs_Priority_Normal, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 10, Afb_Jobs_Priority_Normal, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 123);
+
+	/* jobs without timeout keep arrival order and aren't overtaken */
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Normal, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 10, Afb_Jobs_Priority_Normal, prio_test_job, i2p(3), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Normal, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 123);
+
+	/* a queued low priority job doesn't disorder other levels */
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Background, prio_test_job, i2p(4), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Normal, prio_test_job, i2p(3), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 1234);
+
+	/* groups keep arrival order */
+	r = afb_jobs_post_priority(TEST_GROUPE, 0, 0, Afb_Jobs_Priority_Background, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(TEST_GROUPE, 0, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 12);
+
+	/* a pending delayed job doesn't disorder ready jobs */
+	id = afb_jobs_post_priority(NULL, 100 * DELAY, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(9), NULL);
+	ck_assert_int_gt(id, 0);
+	r = afb_jobs_post_priority(NULL, 0, 20, Afb_Jobs_Priority_Normal, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 10, Afb_Jobs_Priority_Normal, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 12);
+	ck_assert_int_eq(afb_jobs_get_pending_count(), 1);
+
+	/* multiple dequeue keeps the order */
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Background, prio_test_job, i2p(3), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Normal, prio_test_job, i2p(2), NULL);
+	ck_assert_int_gt(r, 0);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	gval = 0;
+	ck_assert_int_eq(afb_jobs_dequeue_multiple(jobs, 2, &delay), 3);
+	ck_assert_int_gt(delay, 0);
+	afb_jobs_run(jobs[0]);
+	afb_jobs_run(jobs[1]);
+	ck_assert_int_eq(afb_jobs_dequeue_multiple(jobs, 2, &delay), 1);
+	afb_jobs_run(jobs[0]);
+	ck_assert_int_eq(gval, 123);
+	ck_assert_int_eq(afb_jobs_abort(id), 0);
+	ck_assert_int_eq(afb_jobs_get_pending_count(), 0);
+
+	/* waiting raises the priority */
+	afb_jobs_set_starvation_delay(DELAY);
+	ck_assert_int_eq(afb_jobs_get_starvation_delay(), DELAY);
+	r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_Background, prio_test_job, i2p(1), NULL);
+	ck_assert_int_gt(r, 0);
+	nsleep(3 * DELAY * 1000);
+	for (i = 2 ; i <= 3 ; i++) {
+		r = afb_jobs_post_priority(NULL, 0, 0, Afb_Jobs_Priority_High, prio_test_job, i2p(i), NULL);
+		ck_assert_int_gt(r, 0);
+	}
+	gval = 0;
+	while ((job = afb_jobs_dequeue(0)))
+		afb_jobs_run(job);
+	ck_assert_int_eq(gval, 123);
+	afb_jobs_set_starvation_delay(0);
+	ck_assert_int_eq(afb_jobs_get_starvation_delay(), 0);
+}
+END_TEST
+
+START_TEST(job_oldest_wait)
+{
+	fprintf(stderr, "\n*********************** job_oldest_wait ***********************\n");
+
+	int r, w;
+	struct afb_job *job, *job2;
+
+	afb_jobs_set_max_count(NB_TEST_JOBS);
+	ck_assert_int_eq(afb_jobs_get_pending_count(), 0);
+	ck_assert_int_eq(afb_jobs_get_oldest_wait(), 0);
+
+	/* delayed jobs wait from their ready time */
+	r = afb_jobs_post(NULL, 2 * DELAY, 0, test_job, NULL);
+	ck_assert_int_gt(r, 0);
+	ck_assert_int_eq(afb_jobs_get_oldest_wait(), 0);
+	nsleep(4 * DELAY * 1000);
+	w = afb_jobs_get_oldest_wait();
+	ck_assert_int_ge(w, DELAY);
+	job = afb_jobs_dequeue(0);
+	ck_assert_ptr_ne(job, NULL);
+	afb_jobs_run(job);
+	ck_assert_int_eq(afb_jobs_get_oldest_wait(), 0);
+
+	/* the first of a group waits, the second is blocked */
+	r = afb_jobs_post(TEST_GROUPE, 0, 0, test_job, NULL);
+	ck_assert_int_gt(r, 0);
+	nsleep(20 * DELAY * 1000);
+	r = afb_jobs_post(TEST_GROUPE, 0, 0, test_job, NULL);
+	ck_assert_int_gt(r, 0);
+	w = afb_jobs_get_oldest_wait();
+	ck_assert_int_ge(w, 20 * DELAY);
+
+	/* when the first runs, the second waits from its post */
+	job = afb_jobs_dequeue(0);
+	ck_assert_ptr_ne(job, NULL);
+	ck_assert_int_eq(afb_jobs_get_oldest_wait(), 0);
+	nsleep(2 * DELAY * 1000);
+	afb_jobs_run(job);
+	w = afb_jobs_get_oldest_wait();
+	ck_assert_int_ge(w, 2 * DELAY);
+	ck_assert_int_lt(w, 20 * DELAY);
+
+	/* an other job doesn't change the oldest */
+	r = afb_jobs_post(NULL, 0, 0, test_job, NULL);
+	ck_assert_int_gt(r, 0);
+	ck_assert_int_ge(afb_jobs_get_oldest_wait(), w);
+
+	job = afb_jobs_dequeue(0);
+	ck_assert_ptr_ne(job, NULL);
+	job2 = afb_jobs_dequeue(0);
+	ck_assert_ptr_ne(job2, NULL);
+	ck_assert_int_eq(afb_jobs_get_oldest_wait(), 0);
+	afb_jobs_run(job);
+	afb_jobs_run(job2);
+	ck_assert_int_eq(afb_jobs_get_pending_count(), 0);
+}
+END_TEST
+
 
 /*********************************************************************/
 
@@ -277,5 +460,7 @@ int main(int ac, char **av)
 			addtest(max_count);
 			addtest(job_aborting);
 			addtest(job_delayed);
+			addtest(job_priority);
+			addtest(job_oldest_wait);
 	return !!srun();
 }
@@ -0,0 +1,194 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <check.h>
+
+#include "libafb-config.h"
+#include "core/afb-perm-cache.h"
+#include "sys/x-errno.h"
+
+/*********************************************************************/
+
+static void msleep(long ms)
+{
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000 };
+	nanosleep(&ts, NULL);
+}
+
+START_TEST (check_get_put)
+{
+	struct afb_perm_cache_stats stats;
+	unsigned gen;
+
+	afb_perm_cache_setup(10000, 100);
+	afb_perm_cache_stats(&stats);
+	ck_assert_uint_eq(0, stats.count);
+
+	/* miss then hit */
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "perm", &gen));
+	afb_perm_cache_put("client", "user", "session", "perm", 1, gen);
+	ck_assert_int_eq(1, afb_perm_cache_get("client", "user", "session", "perm", NULL));
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "other", &gen));
+	afb_perm_cache_put("client", "user", "session", "other", 0, gen);
+	ck_assert_int_eq(0, afb_perm_cache_get("client", "user", "session", "other", NULL));
+
+	/* fields are not mixed */
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("clientuser", "", "session", "perm", NULL));
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", NULL, "perm", NULL));
+
+	/* errors are not recorded */
+	afb_perm_cache_get("client", "user", "session", "error", &gen);
+	afb_perm_cache_put("client", "user", "session", "error", -1, gen);
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "error", NULL));
+
+	afb_perm_cache_stats(&stats);
+	ck_assert_uint_eq(2, stats.count);
+	ck_assert_uint_ge(stats.hits, 2);
+	ck_assert_uint_ge(stats.misses, 5);
+
+	/* decisions got before clearing are not recorded */
+	afb_perm_cache_get("client", "user", "session", "late", &gen);
+	afb_perm_cache_clear();
+	afb_perm_cache_put("client", "user", "session", "late", 1, gen);
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "late", NULL));
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "perm", NULL));
+}
+END_TEST
+
+START_TEST (check_session)
+{
+	unsigned gen;
+
+	afb_perm_cache_setup(10000, 100);
+	afb_perm_cache_get("client", "user", "s1", "perm", &gen);
+	afb_perm_cache_put("client", "user", "s1", "perm", 1, gen);
+	afb_perm_cache_put("client", "user", "s2", "perm", 1, gen);
+	ck_assert_int_eq(1, afb_perm_cache_get("client", "user", "s1", "perm", NULL));
+	ck_assert_int_eq(1, afb_perm_cache_get("client", "user", "s2", "perm", NULL));
+
+	afb_perm_cache_drop_session("s1");
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "s1", "perm", NULL));
+	ck_assert_int_eq(1, afb_perm_cache_get("client", "user", "s2", "perm", NULL));
+}
+END_TEST
+
+START_TEST (check_expire)
+{
+	unsigned gen;
+
+	afb_perm_cache_setup(10, 100);
+	afb_perm_cache_get("client", "user", "session", "perm", &gen);
+	afb_perm_cache_put("client", "user", "session", "perm", 1, gen);
+	ck_assert_int_eq(1, afb_perm_cache_get("client", "user", "session", "perm", NULL));
+	msleep(20);
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "perm", NULL));
+
+	/* disabled */
+	afb_perm_cache_setup(0, 100);
+	afb_perm_cache_get("client", "user", "session", "perm", &gen);
+	afb_perm_cache_put("client", "user", "session", "perm", 1, gen);
+	ck_assert_int_eq(X_ENOENT, afb_perm_cache_get("client", "user", "session", "perm", NULL));
+}
+END_TEST
+
+static void *filler(void *arg)
+{
+	char perm[40];
+	unsigned gen;
+	int i;
+
+	for (i = 0 ; i < 1000 ; i++) {
+		snprintf(perm, sizeof perm, "perm-%d-%d", (int)(intptr_t)arg, i);
+		afb_perm_cache_get("client", "user", "session", perm, &gen);
+		afb_perm_cache_put("client", "user", "session", perm, i & 1, gen);
+	}
+	return NULL;
+}
+
+START_TEST (check_bounded)
+{
+	struct afb_perm_cache_stats stats;
+	pthread_t tids[4];
+	unsigned gen;
+	int i;
+
+	afb_perm_cache_setup(10000, 256);
+	for (i = 0 ; i < 4 ; i++)
+		ck_assert_int_eq(0, pthread_create(&tids[i], NULL, filler, (void*)(intptr_t)i));
+	for (i = 0 ; i < 4 ; i++)
+		pthread_join(tids[i], NULL);
+
+	afb_perm_cache_stats(&stats);
+	ck_assert_uint_gt(stats.count, 0);
+	ck_assert_uint_le(stats.count, 256);
+
+	/* the most recent is kept */
+	afb_perm_cache_get("client", "user", "session", "last", &gen);
+	afb_perm_cache_put("client", "user", "session", "last", 1, gen);
+	ck_assert_int_eq(1, afb_perm_cache_get("client", "user", "session", "last", NULL));
+	afb_perm_cache_stats(&stats);
+	ck_assert_uint_le(stats.count, 256);
+	afb_perm_cache_clear();
+	afb_perm_cache_stats(&stats);
+	ck_assert_uint_eq(0, stats.count);
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); tcase_set_timeout(tcase, 120); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("afb-perm-cache");
+		addtcase("afb-perm-cache");
+			addtest(check_get_put);
+			addtest(check_session);
+			addtest(check_expire);
+			addtest(check_bounded);
+	return !!srun();
+}
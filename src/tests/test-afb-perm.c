@@ -40,6 +40,7 @@
 
 #include "afb/afb-auth.h"
 #include "core/afb-perm.h"
+#include "core/afb-perm-cache.h"
 #include "core/afb-jobs.h"
 #include "core/afb-req-common.h"
 #include "core/afb-cred.h"
@@ -269,8 +270,11 @@ START_TEST (test)
 	uid_t uid = 1;
 	gid_t gid = 1;
 	pid_t pid = 1;
+	struct afb_perm_cache_stats stats;
+	uint64_t hits;
 
 	preparDemonCynagora();
+	afb_perm_cache_setup(60000, AFB_PERM_CACHE_SIZE);
 
 	ck_assert_int_eq(afb_cred_create(&req.credentials, uid, gid, pid, gpath), 0);
 
@@ -304,6 +308,28 @@ START_TEST (test)
 	fprintf(stderr, "\n#### stoping cynagora server ####\n");
 	stopDemonCynagora();
 
+	// check that decisions are cached
+	fprintf(stderr, "\n****** test of cached decisions ******\n");
+	afb_perm_cache_stats(&stats);
+	done = 0;
+	afb_perm_check_req_async(&req, "perm", testCB, NULL);
+	waiteForCB();
+	ck_assert_int_eq(val, 1);
+	done = 0;
+	afb_perm_check_req_async(&req, "toto", testCB, NULL);
+	waiteForCB();
+	ck_assert_int_eq(val, 0);
+	hits = stats.hits;
+	afb_perm_cache_stats(&stats);
+	ck_assert_uint_eq(stats.hits, hits + 2);
+
+	// check that cleared decisions are asked again
+	afb_perm_cache_clear();
+	done = 0;
+	afb_perm_check_req_async(&req, "perm", testCB, NULL);
+	waiteForCB();
+	ck_assert_int_le(val, 0);
+
 #endif
 
 }
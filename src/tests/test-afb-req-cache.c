@@ -0,0 +1,271 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <check.h>
+
+#if !defined(ck_assert_ptr_null)
+# define ck_assert_ptr_null(X)      ck_assert_ptr_eq(X, NULL)
+# define ck_assert_ptr_nonnull(X)   ck_assert_ptr_ne(X, NULL)
+#endif
+
+#include "libafb-config.h"
+#include "core/afb-req-common.h"
+#include "core/afb-req-cache.h"
+#include "core/afb-data.h"
+#include "core/afb-type.h"
+#include "core/afb-sched.h"
+#include "core/afb-session.h"
+
+/*********************************************************************/
+
+static int replied;
+static int reply_status;
+static unsigned reply_count;
+static struct afb_data *reply_data;
+
+static void test_reply(struct afb_req_common *req, int status, unsigned nreplies, struct afb_data *const replies[])
+{
+	replied++;
+	reply_status = status;
+	reply_count = nreplies;
+	reply_data = nreplies ? replies[0] : NULL;
+}
+
+static void test_unref(struct afb_req_common *req)
+{
+	afb_req_common_cleanup(req);
+	free(req);
+}
+
+static struct afb_req_common_query_itf test_queryitf =
+{
+	.reply = test_reply,
+	.unref = test_unref
+};
+
+static void sched_jobs_start(int sig, void *arg)
+{
+	afb_sched_exit(0, NULL, NULL, 0);
+}
+
+/* deliver the pending replies */
+static void flush()
+{
+	ck_assert_int_eq(0, afb_sched_start(1, 1, 100, sched_jobs_start, NULL));
+}
+
+static struct afb_type *type;
+
+static struct afb_data *mkdata(const char *value)
+{
+	struct afb_data *data;
+	ck_assert_int_eq(0, afb_data_create_copy(&data, type, value, strlen(value) + 1));
+	return data;
+}
+
+/* key of the LOA of the api */
+static const struct afb_api_item *apikey = (const struct afb_api_item *)&apikey;
+
+/*
+ * call api/verb with param in session at loa, replying value with status
+ * if not cached
+ * returns 1 if replied from the cache, 0 otherwise
+ */
+static int call_loa(struct afb_session *session, int loa, const char *verb, const char *param, const char *value, int status)
+{
+	struct afb_req_common *req;
+	struct afb_data *data;
+	int rc;
+
+	req = malloc(sizeof *req);
+	ck_assert_ptr_nonnull(req);
+	data = mkdata(param);
+	afb_req_common_init(req, &test_queryitf, "api", verb, 1, &data, NULL);
+	req->api = apikey;
+	if (session != NULL) {
+		afb_req_common_set_session(req, session);
+		ck_assert_int_eq(loa, afb_session_set_loa(session, apikey, loa));
+	}
+
+	replied = 0;
+	reply_data = NULL;
+	rc = afb_req_cache_process(req);
+	if (!rc) {
+		data = mkdata(value);
+		afb_req_common_reply_hookable(req, status, 1, &data);
+		ck_assert_ptr_null(req->cachekey);
+	}
+	afb_req_common_unref(req);
+
+	flush();
+	ck_assert_int_eq(1, replied);
+	return rc;
+}
+
+/*
+ * call api/verb with param, replying value with status if not cached
+ * returns 1 if replied from the cache, 0 otherwise
+ */
+static int call(const char *verb, const char *param, const char *value, int status)
+{
+	return call_loa(NULL, 0, verb, param, value, status);
+}
+
+static int replied_value(const char *value)
+{
+	return reply_count == 1 && reply_data != NULL
+		&& !strcmp(value, afb_data_ro_pointer(reply_data));
+}
+
+static void msleep(long ms)
+{
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000 };
+	nanosleep(&ts, NULL);
+}
+
+/*********************************************************************/
+
+START_TEST (check_cache)
+{
+	if (type == NULL)
+		ck_assert_int_eq(0, afb_type_register(&type, "cache-test", 1, 0, 0));
+
+	/* not cacheable */
+	ck_assert_int_eq(0, call("verb", "a", "A", 0));
+	ck_assert_int_eq(0, call("verb", "a", "A", 0));
+
+	/* cacheable */
+	ck_assert_int_eq(0, afb_req_cache_enable("api", "verb", 10000, 2, 0));
+	ck_assert_int_eq(0, call("verb", "a", "A", 0));
+	ck_assert_int_eq(1, call("verb", "a", "X", 0));
+	ck_assert(replied_value("A"));
+	ck_assert_int_eq(0, reply_status);
+
+	/* other parameters or verbs */
+	ck_assert_int_eq(0, call("verb", "b", "B", 0));
+	ck_assert_int_eq(1, call("verb", "b", "X", 0));
+	ck_assert(replied_value("B"));
+	ck_assert_int_eq(0, call("other", "a", "O", 0));
+	ck_assert_int_eq(0, call("other", "a", "O", 0));
+
+	/* errors are not recorded */
+	ck_assert_int_eq(0, call("verb", "e", "E", -1));
+	ck_assert_int_eq(0, call("verb", "e", "E", 0));
+
+	/* the oldest is dropped when full */
+	ck_assert_int_eq(0, call("verb", "a", "A", 0));
+
+	/* invalidation */
+	afb_req_cache_invalidate("api", NULL);
+	ck_assert_int_eq(0, call("verb", "b", "B", 0));
+	ck_assert_int_eq(1, call("verb", "b", "X", 0));
+
+	/* invalidation by event */
+	ck_assert_int_eq(0, afb_req_cache_invalidate_on_event("api", "verb", "api/changed"));
+	afb_req_cache_event("api/other");
+	ck_assert_int_eq(1, call("verb", "b", "X", 0));
+	afb_req_cache_event("api/changed");
+	ck_assert_int_eq(0, call("verb", "b", "B", 0));
+
+	/* expiration */
+	ck_assert_int_eq(0, afb_req_cache_enable("api", "verb", 10, 0, 0));
+	ck_assert_int_eq(0, call("verb", "c", "C", 0));
+	ck_assert_int_eq(1, call("verb", "c", "X", 0));
+	msleep(20);
+	ck_assert_int_eq(0, call("verb", "c", "C", 0));
+
+	/* disabled */
+	afb_req_cache_disable("api", "verb");
+	ck_assert_int_eq(0, call("verb", "c", "C", 0));
+	ck_assert_int_eq(0, call("verb", "c", "C", 0));
+}
+END_TEST
+
+START_TEST (check_session)
+{
+	struct afb_session *s1, *s2;
+
+	if (type == NULL)
+		ck_assert_int_eq(0, afb_type_register(&type, "cache-test", 1, 0, 0));
+	ck_assert_int_eq(0, afb_session_init(10, 3600));
+	ck_assert_int_eq(0, afb_session_create(&s1, 3600));
+	ck_assert_int_eq(0, afb_session_create(&s2, 3600));
+
+	ck_assert_int_eq(0, afb_req_cache_enable("api", "sverb", 10000, 0, AFB_REQ_CACHE_SESSION));
+
+	/* replies are recorded per session */
+	ck_assert_int_eq(0, call_loa(s1, 0, "sverb", "a", "S1", 0));
+	ck_assert_int_eq(1, call_loa(s1, 0, "sverb", "a", "X", 0));
+	ck_assert(replied_value("S1"));
+	ck_assert_int_eq(0, call_loa(s2, 0, "sverb", "a", "S2", 0));
+	ck_assert_int_eq(1, call_loa(s2, 0, "sverb", "a", "X", 0));
+	ck_assert(replied_value("S2"));
+
+	/* and per LOA */
+	ck_assert_int_eq(0, call_loa(s1, 1, "sverb", "a", "L1", 0));
+	ck_assert_int_eq(1, call_loa(s1, 1, "sverb", "a", "X", 0));
+	ck_assert(replied_value("L1"));
+	ck_assert_int_eq(1, call_loa(s1, 0, "sverb", "a", "X", 0));
+	ck_assert(replied_value("S1"));
+
+	afb_req_cache_disable("api", "sverb");
+	afb_session_unref(s1);
+	afb_session_unref(s2);
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); tcase_set_timeout(tcase, 120); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("afb-req-cache");
+		addtcase("afb-req-cache");
+			addtest(check_cache);
+			addtest(check_session);
+	return !!srun();
+}
@@ -0,0 +1,164 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <check.h>
+
+#include "libafb-config.h"
+#include "core/afb-req-common.h"
+#include "core/afb-req-stats.h"
+
+/*********************************************************************/
+
+START_TEST (check_quantile)
+{
+	struct afb_req_stats_histo histo;
+	memset(&histo, 0, sizeof histo);
+	ck_assert_uint_eq(0, afb_req_stats_quantile(&histo, 0.5));
+
+	/* exact for small values */
+	memset(&histo, 0, sizeof histo);
+	histo.count = 1;
+	histo.min = histo.max = 5;
+	histo.buckets[5] = 1;
+	ck_assert_uint_eq(5, afb_req_stats_quantile(&histo, 0.5));
+}
+END_TEST
+
+/*********************************************************************/
+
+struct result
+{
+	int found;
+	struct afb_req_stats_values values;
+};
+
+static void getcb(void *closure, const char *api, const char *verb, const struct afb_req_stats_values *values)
+{
+	struct result *result = closure;
+	if (!strcmp(api, "api") && !strcmp(verb, "verb")) {
+		result->found++;
+		result->values = *values;
+	}
+}
+
+static void record(uint64_t wait, uint64_t exec, int status)
+{
+	struct afb_req_common req;
+	uint64_t now;
+
+	memset(&req, 0, sizeof req);
+	req.apiname = "api";
+	req.verbname = "verb";
+	now = afb_req_stats_now();
+	req.statstimes[0] = now - wait - exec;
+	req.statstimes[1] = now - exec;
+	afb_req_stats_record(&req, status, 0, NULL);
+}
+
+static void *recorder(void *arg)
+{
+	int i;
+	for (i = 0 ; i < 1000 ; i++)
+		record(10, 1000, 0);
+	return NULL;
+}
+
+START_TEST (check_record)
+{
+	struct result result;
+	pthread_t tids[4];
+	int i;
+
+	ck_assert(afb_req_stats_is_enabled());
+
+	/* record from many threads */
+	for (i = 0 ; i < 4 ; i++)
+		ck_assert_int_eq(0, pthread_create(&tids[i], NULL, recorder, NULL));
+	for (i = 0 ; i < 4 ; i++)
+		pthread_join(tids[i], NULL);
+	record(100000, 20, -1);
+
+	memset(&result, 0, sizeof result);
+	ck_assert_int_eq(0, afb_req_stats_snapshot(getcb, &result));
+	ck_assert_int_eq(1, result.found);
+	ck_assert_uint_eq(4001, result.values.count);
+	ck_assert_uint_eq(1, result.values.errors);
+	ck_assert_uint_eq(4001, result.values.exec.count);
+	ck_assert_uint_eq(20, result.values.exec.min);
+	ck_assert_uint_ge(result.values.exec.max, 1000);
+	ck_assert_uint_ge(afb_req_stats_quantile(&result.values.exec, 0.5), 1000);
+	ck_assert_uint_le(afb_req_stats_quantile(&result.values.exec, 0.5), 1000 + 1000 / 8);
+	ck_assert_uint_ge(afb_req_stats_quantile(&result.values.wait, 0.9999), 100000);
+	ck_assert_uint_eq(0, result.values.size.max);
+
+	/* reset */
+	afb_req_stats_reset();
+	memset(&result, 0, sizeof result);
+	ck_assert_int_eq(0, afb_req_stats_snapshot(getcb, &result));
+	ck_assert_int_eq(0, result.found);
+	record(1, 1, 0);
+	ck_assert_int_eq(0, afb_req_stats_snapshot(getcb, &result));
+	ck_assert_int_eq(1, result.found);
+	ck_assert_uint_eq(1, result.values.count);
+
+	/* disabled */
+	afb_req_stats_enable(0);
+	ck_assert_uint_eq(0, afb_req_stats_now());
+	afb_req_stats_enable(1);
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); tcase_set_timeout(tcase, 120); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("afb-req-stats");
+		addtcase("afb-req-stats");
+			addtest(check_quantile);
+			addtest(check_record);
+	return !!srun();
+}
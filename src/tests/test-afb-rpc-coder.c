@@ -47,7 +47,7 @@ static char ref_int[] __attribute__((aligned(4))) = {
 /*************************** Helpers Functions ***************************/
 
 static int disp2_nr = 0;
-static void *disp2_val[10][2];
+static void *disp2_val[64][2];
 
 static void disp2(void *clo, void *arg)
 {
@@ -167,6 +167,57 @@ END_TEST START_TEST(test_output_bufs)
 
 }
 
+END_TEST START_TEST(test_output_many)
+{
+	int rc, i, n;
+	afb_rpc_coder_t rpc_coder;
+	uint32_t sz, index;
+	static const char ref[] = "abcdefghijklmnopqrstuvwxyz";
+	struct iovec iovecs[16];
+
+	disp2_nr = 0;
+
+	afb_rpc_coder_init(&rpc_coder);
+
+	/* more buffers than inline ones */
+	for (i = 0 ; i < 100 ; i++) {
+		rc = afb_rpc_coder_write(&rpc_coder, &ref[i % 8], 16);
+		ck_assert_int_eq(rc, 0);
+	}
+	/* more disposes than inline ones */
+	for (i = 0 ; i < 40 ; i++) {
+		rc = afb_rpc_coder_on_dispose2_output(&rpc_coder, disp2, (void *)ref,
+					(void *)ref + 1);
+		ck_assert_int_eq(rc, 0);
+	}
+
+	rc = afb_rpc_coder_output_sizes(&rpc_coder, &sz);
+	ck_assert_int_eq(rc, 100);
+	ck_assert_int_eq(sz, 1600);
+
+	/* get by batches */
+	index = 0;
+	i = 0;
+	while ((n = afb_rpc_coder_output_get_iovec_at(&rpc_coder, iovecs, 16, &index)) > 0) {
+		ck_assert_int_le(n, 16);
+		while (n) {
+			n--;
+			ck_assert_ptr_eq(iovecs[n].iov_base, &ref[(i + n) % 8]);
+			ck_assert_int_eq(iovecs[n].iov_len, 16);
+		}
+		i = (int)index;
+	}
+	ck_assert_int_eq(i, 100);
+
+	afb_rpc_coder_output_dispose(&rpc_coder);
+	ck_assert_int_eq(disp2_nr, 40);
+	disp2_nr = 0;
+
+	rc = afb_rpc_coder_output_sizes(&rpc_coder, &sz);
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_eq(sz, 0);
+}
+
 END_TEST
 /******************************** Tests ********************************/
 static Suite *suite;
@@ -200,5 +251,6 @@ int main(int ac, char **av)
 	addtcase("output");
 	addtest(test_output_int);
 	addtest(test_output_bufs);
+	addtest(test_output_many);
 	return !!srun();
 }
@@ -0,0 +1,144 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: Johann Gautier <johann.gautier@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <check.h>
+
+#include "rpc/afb-rpc-coder.h"
+#include "rpc/afb-rpc-sock.h"
+#include "sys/ev-mgr.h"
+
+#define MSG_SIZE   4000
+#define MSG_COUNT  200
+
+/*************************** Helpers Functions ***************************/
+
+static struct afb_rpc_sock_queue queue;
+static int flushes;
+
+static void onout(struct ev_fd *efd, int fd, uint32_t revents, void *closure)
+{
+	if (revents & EV_FD_OUT) {
+		flushes++;
+		ck_assert_int_ge(afb_rpc_sock_queue_flush(&queue, efd), 0);
+	}
+}
+
+static void fill(char *buffer, int num)
+{
+	int i;
+	for (i = 0 ; i < MSG_SIZE ; i++)
+		buffer[i] = (char)(num + i);
+}
+
+/******************************** Test queue ********************************/
+
+START_TEST(test_queue)
+{
+	static char msg[MSG_COUNT][MSG_SIZE];
+	char buffer[MSG_SIZE];
+	struct ev_mgr *mgr;
+	struct ev_fd *efd;
+	afb_rpc_coder_t coder;
+	int sv[2], i, num;
+	ssize_t ssz;
+	size_t off;
+
+	ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+	ck_assert_int_eq(ev_mgr_create(&mgr), 0);
+	ck_assert_int_eq(ev_mgr_add_fd(mgr, &efd, sv[0], EV_FD_IN, onout, NULL, 0, 1), 0);
+	afb_rpc_sock_queue_init(&queue);
+
+	/* send more than the socket can hold: never blocks */
+	for (i = 0 ; i < MSG_COUNT ; i++) {
+		fill(msg[i], i);
+		afb_rpc_coder_init(&coder);
+		ck_assert_int_eq(afb_rpc_coder_write(&coder, msg[i], MSG_SIZE / 2), 0);
+		ck_assert_int_eq(afb_rpc_coder_write(&coder, &msg[i][MSG_SIZE / 2], MSG_SIZE / 2), 0);
+		ck_assert_int_eq(afb_rpc_sock_queue_send_coder(&queue, efd, &coder), 0);
+		afb_rpc_coder_output_dispose(&coder);
+	}
+	ck_assert_ptr_ne(queue.head, NULL);
+	ck_assert_uint_ne(ev_fd_events(efd) & EV_FD_OUT, 0);
+
+	/* receive the messages in order, the queue being flushed on output */
+	for (num = 0 ; num < MSG_COUNT ; num++) {
+		fill(buffer, num);
+		for (off = 0 ; off < MSG_SIZE ; off += (size_t)ssz) {
+			ssz = recv(sv[1], &msg[num][off], MSG_SIZE - off, MSG_DONTWAIT);
+			if (ssz < 0) {
+				ev_mgr_run(mgr, 100);
+				ssz = 0;
+			}
+		}
+		ck_assert(memcmp(buffer, msg[num], MSG_SIZE) == 0);
+	}
+	ck_assert_int_gt(flushes, 0);
+	ck_assert_ptr_eq(queue.head, NULL);
+	ck_assert_uint_eq(ev_fd_events(efd) & EV_FD_OUT, 0);
+
+	/* errors are reported */
+	close(sv[1]);
+	afb_rpc_coder_init(&coder);
+	ck_assert_int_eq(afb_rpc_coder_write(&coder, msg[0], MSG_SIZE), 0);
+	ck_assert_int_lt(afb_rpc_sock_queue_send_coder(&queue, efd, &coder), 0);
+	afb_rpc_coder_output_dispose(&coder);
+
+	afb_rpc_sock_queue_release(&queue);
+	ev_fd_unref(efd);
+	ev_mgr_unref(mgr);
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("afb-rpc-sock");
+		addtcase("afb-rpc-sock");
+			addtest(test_queue);
+	return !!srun();
+}
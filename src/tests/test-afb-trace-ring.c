@@ -0,0 +1,204 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <check.h>
+
+#include "libafb-config.h"
+#include "misc/afb-trace-ring.h"
+#include "sys/x-errno.h"
+
+/*********************************************************************/
+
+#define NTHREADS 4
+#define NRECORDS 1000
+
+static void *writer(void *closure)
+{
+	struct afb_trace_ring_record record;
+	uint32_t i;
+
+	memset(&record, 0, sizeof record);
+	record.kind = AFB_TRACE_RING_KIND_REQUEST;
+	record.action = AFB_TRACE_RING_REQ_BEGIN;
+	record.api = afb_trace_ring_name("api");
+	record.index = (uint32_t)(uintptr_t)closure;
+	for (i = 0 ; i < NRECORDS ; i++) {
+		record.time = i;
+		record.verb = afb_trace_ring_name((i & 1) ? "odd" : "even");
+		afb_trace_ring_put(&record);
+	}
+	return NULL;
+}
+
+START_TEST (check_ring)
+{
+	pthread_t tids[NTHREADS];
+	struct afb_trace_ring_header *hdr;
+	struct afb_trace_ring *ring;
+	struct afb_trace_ring_record *recs;
+	void *buffer;
+	size_t size;
+	uintptr_t i;
+	uint32_t iring, irec, count;
+
+	ck_assert_int_eq(0, afb_trace_ring_setup(NULL, 2, 1500));
+	ck_assert_int_eq(X_EBUSY, afb_trace_ring_setup(NULL, 0, 0));
+
+	/* names */
+	ck_assert_uint_eq(0, afb_trace_ring_name(NULL));
+	ck_assert_uint_ne(0, afb_trace_ring_name("api"));
+	ck_assert_uint_eq(afb_trace_ring_name("api"), afb_trace_ring_name("api"));
+	ck_assert_uint_ne(afb_trace_ring_name("api"), afb_trace_ring_name("verb"));
+
+	/* concurrent writers */
+	for (i = 0 ; i < NTHREADS ; i++)
+		ck_assert_int_eq(0, pthread_create(&tids[i], NULL, writer, (void*)i));
+	for (i = 0 ; i < NTHREADS ; i++)
+		pthread_join(tids[i], NULL);
+
+	/* snapshot */
+	ck_assert_int_eq(0, afb_trace_ring_snapshot(&buffer, &size));
+	hdr = buffer;
+	ck_assert_uint_eq(size, hdr->total_size);
+	ck_assert_uint_eq(AFB_TRACE_RING_MAGIC, hdr->magic);
+	ck_assert_uint_eq(2, hdr->ring_count);
+	ck_assert_uint_eq(2048, hdr->ring_length);
+	ck_assert_str_eq("api", afb_trace_ring_name_string(hdr, afb_trace_ring_name("api")));
+	ck_assert_str_eq("odd", afb_trace_ring_name_string(hdr, afb_trace_ring_name("odd")));
+
+	count = 0;
+	for (iring = 0 ; iring < hdr->ring_count ; iring++) {
+		ring = afb_trace_ring_get(hdr, iring);
+		recs = afb_trace_ring_records(ring);
+		for (irec = 0 ; irec < hdr->ring_length ; irec++) {
+			if (recs[irec].seq) {
+				count++;
+				ck_assert_uint_eq(irec, (recs[irec].seq - 1) & (hdr->ring_length - 1));
+				ck_assert_uint_eq(recs[irec].api, afb_trace_ring_name("api"));
+				ck_assert_uint_ne(0, recs[irec].thread);
+			}
+		}
+	}
+	ck_assert_uint_eq(count, NTHREADS * NRECORDS);
+	free(buffer);
+}
+END_TEST
+
+#define NSHARING 40
+#define NSHARED 20000
+
+static void *sharing_writer(void *closure)
+{
+	struct afb_trace_ring_record record;
+	uint32_t i;
+
+	memset(&record, 0, sizeof record);
+	record.kind = AFB_TRACE_RING_KIND_EVENT;
+	record.index = (uint32_t)(uintptr_t)closure;
+	for (i = 0 ; i < NSHARED ; i++) {
+		record.time = i;
+		record.arg1 = i ^ record.index;
+		record.arg2 = ~record.arg1;
+		afb_trace_ring_put(&record);
+	}
+	return NULL;
+}
+
+START_TEST (check_shared)
+{
+	pthread_t tids[NSHARING];
+	struct afb_trace_ring_header *hdr;
+	struct afb_trace_ring *ring;
+	struct afb_trace_ring_record *recs;
+	void *buffer;
+	size_t size;
+	uintptr_t i;
+	uint32_t iring, irec;
+	uint64_t count, written;
+
+	/* more threads than rings, writing more records than rings hold */
+	for (i = 0 ; i < NSHARING ; i++)
+		ck_assert_int_eq(0, pthread_create(&tids[i], NULL, sharing_writer, (void*)i));
+	for (i = 0 ; i < NSHARING ; i++)
+		pthread_join(tids[i], NULL);
+
+	/* records are never mixed */
+	ck_assert_int_eq(0, afb_trace_ring_snapshot(&buffer, &size));
+	hdr = buffer;
+	written = 0;
+	for (iring = 0 ; iring < hdr->ring_count ; iring++) {
+		ring = afb_trace_ring_get(hdr, iring);
+		recs = afb_trace_ring_records(ring);
+		ck_assert_uint_le(ring->lost, ring->head);
+		written += ring->head;
+		count = 0;
+		for (irec = 0 ; irec < hdr->ring_length ; irec++) {
+			if (recs[irec].seq && recs[irec].kind == AFB_TRACE_RING_KIND_EVENT) {
+				count++;
+				ck_assert_uint_eq(0, recs[irec].seq & AFB_TRACE_RING_SEQ_BUSY);
+				ck_assert_uint_eq(irec, (recs[irec].seq - 1) & (hdr->ring_length - 1));
+				ck_assert_uint_eq(recs[irec].arg1, (uint32_t)recs[irec].time ^ recs[irec].index);
+				ck_assert_uint_eq(recs[irec].arg2, ~recs[irec].arg1);
+			}
+		}
+		ck_assert_uint_le(count, hdr->ring_length);
+	}
+	ck_assert_uint_ge(written, NSHARING * NSHARED);
+	free(buffer);
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); tcase_set_timeout(tcase, 120); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("afb-trace-ring");
+		addtcase("afb-trace-ring");
+			addtest(check_ring);
+			addtest(check_shared);
+	return !!srun();
+}
@@ -0,0 +1,293 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+#include "libafb-config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <check.h>
+
+#include <afb/afb-errno.h>
+
+#include "sys/x-errno.h"
+#include "core/afb-apiset.h"
+#include "core/afb-req-common.h"
+#include "core/afb-sched.h"
+#include "apis/afb-api-lazy.h"
+
+#define PATH_BUF_SIZE 200
+#define TEST_LIB_PATH "libhello.so"
+#define TEST_MANIFEST "test-api-lazy.manifest"
+#define TEST_BAD_PATH "no-such-binding.so"
+#define NREQS 7
+
+/*********************************************************************/
+
+void nsleep(long usec) /* like nsleep */
+{
+	struct timespec ts = { .tv_sec = (usec / 1000000), .tv_nsec = (usec % 1000000) * 1000 };
+	nanosleep(&ts, NULL);
+}
+
+int getpath(char buffer[PATH_BUF_SIZE], const char *base)
+{
+	static const char *paths[] = { "test-bindings/", "tests/", "src/", "build/", NULL };
+
+	int rc;
+	int len;
+	int lenp;
+	const char **pp = paths;
+
+	len = snprintf(buffer, PATH_BUF_SIZE, "%s", base);
+	ck_assert_int_ge(len, 0);
+	rc = access(buffer, F_OK);
+	while (rc < 0 && *pp) {
+		lenp = (int)strlen(*pp);
+		if (lenp + len + 1 > PATH_BUF_SIZE)
+			break;
+		memmove(buffer + lenp, buffer, (size_t)len + 1);
+		memcpy(buffer, *pp, (size_t)lenp);
+		pp++;
+		len += lenp;
+		rc = access(buffer, F_OK);
+	}
+	return rc;
+}
+
+void write_manifest(const char *content)
+{
+	FILE *file = fopen(TEST_MANIFEST, "w");
+	ck_assert_ptr_ne(file, NULL);
+	fputs(content, file);
+	fclose(file);
+}
+
+/*********************************************************************/
+/* afb_req_common requirement */
+
+struct test_req
+{
+	struct afb_req_common comreq;
+	int status;
+	int replied;
+};
+
+struct test_req reqs[NREQS];
+int replied_count;
+
+void test_reply(struct afb_req_common *req, int status, unsigned nreplies, struct afb_data *const replies[])
+{
+	struct test_req *treq = (struct test_req*)req;
+
+	treq->status = status;
+	treq->replied++;
+	__atomic_add_fetch(&replied_count, 1, __ATOMIC_RELEASE);
+}
+
+void test_unref(struct afb_req_common *req)
+{
+	afb_req_common_cleanup(req);
+}
+
+struct afb_req_common_query_itf test_queryitf =
+{
+	.reply = test_reply,
+	.unref = test_unref,
+	.subscribe = NULL,
+	.unsubscribe = NULL,
+	.interface = NULL
+};
+
+void call(struct afb_apiset *set, int idx, const char *api, const char *verb)
+{
+	reqs[idx].status = 0;
+	reqs[idx].replied = 0;
+	afb_req_common_init(&reqs[idx].comreq, &test_queryitf, api, verb, 0, NULL, NULL);
+	afb_req_common_process(&reqs[idx].comreq, set);
+}
+
+void wait_replies(int count)
+{
+	int n;
+
+	for (n = 0 ; n < 5000 && __atomic_load_n(&replied_count, __ATOMIC_ACQUIRE) < count ; n++)
+		nsleep(1000);
+}
+
+/*********************************************************************/
+/* Test the parsing of manifests */
+START_TEST (manifest)
+{
+#if WITH_DYNAMIC_BINDING
+	struct afb_apiset *declare_set, *call_set;
+	const struct afb_api_item *item;
+	char path[PATH_BUF_SIZE], content[4 * PATH_BUF_SIZE];
+
+	ck_assert_int_eq(getpath(path, TEST_LIB_PATH), 0);
+
+	declare_set = afb_apiset_create("declare", 1);
+	call_set = afb_apiset_create("call", 1);
+
+	// comments and empty lines are ignored, fields are optional
+	snprintf(content, sizeof content,
+		"# lazy bindings\n"
+		"\n"
+		"%s hello verbs=call,hello provide=greeter,salute\n"
+		"  %s hi\n"
+		TEST_BAD_PATH " nowhere require=greeter\n",
+		path, path);
+	write_manifest(content);
+	ck_assert_int_eq(afb_api_lazy_add_manifest(TEST_MANIFEST, declare_set, call_set), 3);
+
+	// the APIs are declared but not started
+	ck_assert_int_eq(afb_apiset_get_api(declare_set, "hello", 0, 0, &item), 0);
+	ck_assert_int_eq(afb_apiset_get_api(declare_set, "hi", 0, 0, &item), 0);
+	ck_assert_int_eq(afb_apiset_get_api(declare_set, "nowhere", 0, 0, &item), 0);
+
+	// a line without API name is rejected
+	write_manifest(TEST_LIB_PATH "\n");
+	ck_assert_int_eq(afb_api_lazy_add_manifest(TEST_MANIFEST, declare_set, call_set), X_EINVAL);
+
+	// an unknown field is rejected
+	write_manifest(TEST_LIB_PATH " other unknown=field\n");
+	ck_assert_int_eq(afb_api_lazy_add_manifest(TEST_MANIFEST, declare_set, call_set), X_EINVAL);
+	ck_assert_int_eq(afb_apiset_get_api(declare_set, "other", 0, 0, &item), X_ENOENT);
+
+	// an invalid API name is rejected
+	write_manifest(TEST_LIB_PATH " bad/name\n");
+	ck_assert_int_eq(afb_api_lazy_add_manifest(TEST_MANIFEST, declare_set, call_set), X_EINVAL);
+
+	// a declared API can't be declared again
+	write_manifest(TEST_LIB_PATH " hello\n");
+	ck_assert_int_lt(afb_api_lazy_add_manifest(TEST_MANIFEST, declare_set, call_set), 0);
+
+	unlink(TEST_MANIFEST);
+	ck_assert_int_eq(afb_api_lazy_add_manifest(TEST_MANIFEST, declare_set, call_set), X_ENOENT);
+
+	afb_apiset_unref(declare_set);
+	afb_apiset_unref(call_set);
+#endif
+}
+END_TEST
+
+/*********************************************************************/
+/* Test the loading on first call and the queuing of requests */
+
+#if WITH_DYNAMIC_BINDING
+static void load_start(int signum, void *arg)
+{
+	struct afb_apiset *set = arg;
+
+	if (signum == 0) {
+		// first calls start the loading, requests are queued until loaded
+		call(set, 0, "hello", "call");
+		call(set, 1, "hello", "call");
+
+		// verbs not declared are rejected without loading
+		call(set, 2, "hello", "evpush");
+
+		// requests queued on a failing loading are replied unavailable
+		call(set, 3, "nowhere", "call");
+		call(set, 4, "nowhere", "call");
+		wait_replies(5);
+
+		// after the loading, requests are processed directly
+		call(set, 5, "hello", "call");
+		call(set, 6, "nowhere", "call");
+		wait_replies(7);
+	}
+	afb_sched_exit(0, NULL, NULL, 0);
+}
+#endif
+
+START_TEST (load)
+{
+#if WITH_DYNAMIC_BINDING
+	struct afb_apiset *declare_set, *call_set;
+	char path[PATH_BUF_SIZE];
+	int i;
+
+	ck_assert_int_eq(getpath(path, TEST_LIB_PATH), 0);
+
+	declare_set = afb_apiset_create("declare", 1);
+	call_set = afb_apiset_create("call", 1);
+
+	ck_assert_int_eq(afb_api_lazy_add(path, "hello", "call,hello", declare_set, call_set, 0), 0);
+	ck_assert_int_eq(afb_api_lazy_add(TEST_BAD_PATH, "nowhere", NULL, declare_set, call_set, 0), 0);
+
+	replied_count = 0;
+	ck_assert_int_eq(afb_sched_start(4, 1, 100, load_start, declare_set), 0);
+
+	// each request got exactly one reply
+	ck_assert_int_eq(replied_count, NREQS);
+	for (i = 0 ; i < NREQS ; i++)
+		ck_assert_int_eq(reqs[i].replied, 1);
+
+	// the loaded binding processed the requests
+	ck_assert_int_eq(reqs[0].status, 0);
+	ck_assert_int_eq(reqs[1].status, 0);
+	ck_assert_int_eq(reqs[5].status, 0);
+
+	// other requests failed
+	ck_assert_int_eq(reqs[2].status, AFB_ERRNO_UNKNOWN_VERB);
+	ck_assert_int_eq(reqs[3].status, AFB_ERRNO_NOT_AVAILABLE);
+	ck_assert_int_eq(reqs[4].status, AFB_ERRNO_NOT_AVAILABLE);
+	ck_assert_int_eq(reqs[6].status, AFB_ERRNO_NOT_AVAILABLE);
+
+	afb_apiset_unref(declare_set);
+	afb_apiset_unref(call_set);
+#endif
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("api-lazy");
+		addtcase("api-lazy");
+			addtest(manifest);
+			addtest(load);
+	return !!srun();
+}
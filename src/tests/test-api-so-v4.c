@@ -33,6 +33,8 @@
 #include <check.h>
 
 #include "sys/x-dynlib.h"
+#include "sys/x-errno.h"
+#include "misc/afb-so-probe.h"
 #include "apis/afb-api-so-v4.h"
 #include "core/afb-apiset.h"
 #include "core/afb-sig-monitor.h"
@@ -189,6 +191,44 @@ START_TEST (dirty_test)
 }
 END_TEST
 
+/*********************************************************************/
+/* Test probing shared objects without loading them */
+START_TEST (probe_test)
+{
+#if WITH_DYNAMIC_BINDING
+
+	static const char * const names[] = { "afbBindingV4", "afbBindingV4entry", "AfbExtensionManifest" };
+	char hello_path[PATH_BUF_SIZE], bug_path[PATH_BUF_SIZE];
+	const char *paths[4];
+	int kinds[4];
+
+	ck_assert_int_eq(getpath(hello_path, TEST_LIB_PATH, 0), 0);
+	ck_assert_int_eq(getpath(bug_path, "libbug%d.so", 12), 0);
+
+	// a binding exports afbBindingV4
+	ck_assert_int_eq(x_dynlib_probe(hello_path, names, 3), 1);
+
+	// a shared object without binding symbols exports none of them
+	ck_assert_int_eq(x_dynlib_probe(bug_path, names, 3), 0);
+
+	// a file that isn't a shared object can't be probed
+	ck_assert_int_eq(x_dynlib_probe(TEST_SOURCE_DIR "test-api-so-v4.c", names, 3), X_ENOTSUP);
+	ck_assert_int_eq(x_dynlib_probe("no-such-file.so", names, 3), X_ENOENT);
+
+	// same results when probing them together
+	paths[0] = hello_path;
+	paths[1] = bug_path;
+	paths[2] = TEST_SOURCE_DIR "test-api-so-v4.c";
+	paths[3] = "no-such-file.so";
+	afb_so_probe(4, paths, kinds, AFB_SO_PROBE_BINDING);
+	ck_assert_int_eq(kinds[0], AFB_SO_PROBE_BINDING_V4);
+	ck_assert_int_eq(kinds[1], 0);
+	ck_assert_int_lt(kinds[2], 0);
+	ck_assert_int_lt(kinds[3], 0);
+#endif
+}
+END_TEST
+
 /*********************************************************************/
 
 static Suite *suite;
@@ -213,5 +253,6 @@ int main(int ac, char **av)
 		addtcase("api-so-v4");
 			addtest(test);
 			addtest(dirty_test);
+			addtest(probe_test);
 	return !!srun();
 }
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <check.h>
 #if !defined(ck_assert_ptr_null)
@@ -39,6 +40,7 @@
 #include "libafb-config.h"
 
 #include "core/afb-apiset.h"
+#include "core/afb-sched.h"
 #include "sys/x-errno.h"
 #include "utils/namecmp.h"
 
@@ -615,6 +617,111 @@ END_TEST
 
 /*********************************************************************/
 
+struct clapi clpar[] = {
+	{ "Ada", "", "Ruth", "", 0, 0 },
+	{ "Bert", "Lena", "", "Cleo", 0, 0 },
+	{ "Cleo", "Lena", "", "Dale", 0, 0 },
+	{ "Dale", "Lena", "", "", 0, 0 },
+	{ "Edna", "Vera", "", "Hugo", 0, 0 },
+	{ "Fern", "Vera", "Lena", "Edna", 0, 0 },
+	{ "Gus", "Ruth", "Vera", "", 0, 0 },
+	{ "Hugo", "Ruth", "Lena", "Ivan", 0, 0 },
+	{ "Ivan", "Ruth", "Lena", "", 0, 0 },
+	{ "Jude", "", "", "", 0, 0 },
+	{ "Kurt", "", "", "", 0, 0 },
+	{ "Lola", "", "", "", 0, 0 },
+	{ NULL, NULL, NULL, NULL, 0, 0 }
+};
+
+int clpar_running, clpar_max;
+
+int clparcb_start(void *closure)
+{
+	struct clapi *a = closure;
+	int i, n;
+
+	ck_assert_int_eq(0, a->init);
+	n = __atomic_add_fetch(&clpar_running, 1, __ATOMIC_SEQ_CST);
+	if (n > clpar_max)
+		clpar_max = n;
+
+	for (i = 0 ; clpar[i].name ; i++) {
+		if (a->requires[0] && !strcmp(a->requires, clpar[i].provides))
+			ck_assert_int_ne(0, __atomic_load_n(&clpar[i].init, __ATOMIC_SEQ_CST));
+		if (a->apireq[0] && !strcmp(a->apireq, clpar[i].name))
+			ck_assert_int_ne(0, __atomic_load_n(&clpar[i].init, __ATOMIC_SEQ_CST));
+	}
+	usleep(10000);
+	__atomic_sub_fetch(&clpar_running, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&a->init, __atomic_add_fetch(&clorder, 1, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+
+	return 0;
+}
+
+struct afb_api_itf clparitf = {
+	.process = NULL,
+	.service_start = clparcb_start,
+#if WITH_AFB_HOOK
+	.update_hooks = NULL,
+#endif
+	.get_logmask = NULL,
+	.set_logmask = NULL,
+	.unref = NULL
+};
+
+void clpar_start(int signum, void *closure)
+{
+	struct afb_apiset *a = closure;
+	int rc;
+
+	rc = signum ? -1 : afb_apiset_start_all_services_parallel(a, 4);
+	afb_sched_exit(0, NULL, NULL, rc);
+}
+
+START_TEST (check_classes_parallel)
+{
+	int i;
+	struct afb_apiset *a;
+	struct afb_api_item sa;
+
+	/* create a apiset */
+	a = afb_apiset_create(NULL, 0);
+	ck_assert_ptr_nonnull(a);
+
+	/* add apis */
+	clorder = 0;
+	for (i = 0 ; clpar[i].name != NULL ; i++) {
+		clpar[i].init = 0;
+		sa.itf = &clparitf;
+		sa.closure = &clpar[i];
+		sa.group = NULL;
+		ck_assert_int_eq(0, afb_apiset_add(a, clpar[i].name, sa));
+	}
+
+	/* add constraints */
+	for (i = 0 ; clpar[i].name != NULL ; i++) {
+		if (clpar[i].provides && clpar[i].provides[0])
+			ck_assert_int_eq(0, afb_apiset_provide_class(a, clpar[i].name, clpar[i].provides));
+		if (clpar[i].requires && clpar[i].requires[0])
+			ck_assert_int_eq(0, afb_apiset_require_class(a, clpar[i].name, clpar[i].requires));
+		if (clpar[i].apireq && clpar[i].apireq[0])
+			ck_assert_int_eq(0, afb_apiset_require(a, clpar[i].name, a, clpar[i].apireq));
+	}
+
+	/* start all in parallel */
+	ck_assert_int_eq(0, afb_sched_start(5, 1, 20, clpar_start, a));
+	for (i = 0 ; clpar[i].name != NULL ; i++)
+		ck_assert_int_ne(0, clpar[i].init);
+	ck_assert_int_eq(i, clorder);
+	ck_assert_int_gt(clpar_max, 1);
+	ck_assert_int_le(clpar_max, 4);
+
+	afb_apiset_unref(a);
+}
+END_TEST
+
+/*********************************************************************/
+
 START_TEST (check_subset)
 {
 	int rc;
@@ -684,6 +791,7 @@ int main(int ac, char **av)
 			addtest(check_onlack);
 			addtest(check_settings);
 			addtest(check_classes);
+			addtest(check_classes_parallel);
 			addtest(check_subset);
 	return !!srun();
 }
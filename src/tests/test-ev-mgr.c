@@ -35,6 +35,8 @@
 #include <signal.h>
 
 #include "sys/ev-mgr.h"
+#include "core/afb-ev-mgr.h"
+#include "sys/x-errno.h"
 
 /*********************************************************************/
 
@@ -154,6 +156,142 @@ START_TEST (timer)
 }
 END_TEST
 
+#define NB_FDS 8
+
+int fdsdata[NB_FDS];
+
+void fdscb(struct ev_fd *efd, int fd, uint32_t revents, void *closure)
+{
+	int x;
+	ssize_t rc;
+	rc = read(fd, &x, sizeof x);
+	ck_assert_int_eq(rc, (ssize_t)(sizeof x));
+	fdsdata[x]++;
+}
+
+START_TEST (fds)
+{
+	int rc, i, n;
+	ssize_t szrc;
+	int fds[NB_FDS][2];
+	struct ev_mgr *mgr;
+	struct ev_fd *efd[NB_FDS];
+
+	rc = ev_mgr_create(&mgr);
+	ck_assert_int_eq(rc, 0);
+
+	for (i = 0 ; i < NB_FDS ; i++) {
+		rc = pipe2(fds[i], O_CLOEXEC|O_NONBLOCK);
+		ck_assert_int_eq(rc, 0);
+		rc = ev_mgr_add_fd(mgr, &efd[i], fds[i][0], EV_FD_IN, fdscb, NULL, 0, 1);
+		ck_assert_int_eq(rc, 0);
+	}
+
+	/* all files ready at once are dispatched one by one */
+	memset(fdsdata, 0, sizeof fdsdata);
+	for (i = 0 ; i < NB_FDS ; i++) {
+		szrc = write(fds[i][1], &i, sizeof i);
+		ck_assert_int_eq(szrc, sizeof i);
+	}
+	for (n = 0 ; ev_mgr_run(mgr, 100) == 1 ; n++);
+	ck_assert_int_eq(n, NB_FDS);
+	for (i = 0 ; i < NB_FDS ; i++)
+		ck_assert_int_eq(fdsdata[i], 1);
+
+	/* files not expecting events are not dispatched */
+	memset(fdsdata, 0, sizeof fdsdata);
+	for (i = 0 ; i < NB_FDS ; i += 2)
+		ev_fd_set_events(efd[i], 0);
+	for (i = 0 ; i < NB_FDS ; i++) {
+		szrc = write(fds[i][1], &i, sizeof i);
+		ck_assert_int_eq(szrc, sizeof i);
+	}
+	for (n = 0 ; ev_mgr_run(mgr, 100) == 1 ; n++);
+	ck_assert_int_eq(n, NB_FDS / 2);
+	for (i = 0 ; i < NB_FDS ; i++)
+		ck_assert_int_eq(fdsdata[i], i & 1);
+
+	/* and are dispatched again when expecting */
+	for (i = 0 ; i < NB_FDS ; i += 2)
+		ev_fd_set_events(efd[i], EV_FD_IN);
+	for (n = 0 ; ev_mgr_run(mgr, 100) == 1 ; n++);
+	ck_assert_int_eq(n, NB_FDS / 2);
+	for (i = 0 ; i < NB_FDS ; i++)
+		ck_assert_int_eq(fdsdata[i], 1);
+
+	for (i = 0 ; i < NB_FDS ; i++) {
+		ev_fd_unref(efd[i]);
+		close(fds[i][1]);
+	}
+	ev_mgr_unref(mgr);
+}
+END_TEST
+
+#if WITH_EV_REACTORS
+
+#define NB_REACTORS 3
+#define NB_PIPES 6
+
+x_thread_t readthread[NB_PIPES];
+int readcount;
+
+void reactorcb(struct ev_fd *efd, int fd, uint32_t revents, void *closure)
+{
+	int x;
+	ssize_t rc;
+	rc = read(fd, &x, sizeof x);
+	ck_assert_int_eq(rc, (ssize_t)(sizeof x));
+	readthread[x] = x_thread_self();
+	__atomic_add_fetch(&readcount, 1, __ATOMIC_RELEASE);
+}
+
+START_TEST (reactors)
+{
+	int rc, i, j;
+	ssize_t szrc;
+	int fds[NB_PIPES][2];
+	struct ev_fd *efd[NB_PIPES];
+
+	ck_assert_uint_eq(afb_ev_mgr_reactor_count(), 0);
+	ck_assert_int_eq(afb_ev_mgr_start_reactors(0), X_EINVAL);
+	rc = afb_ev_mgr_start_reactors(NB_REACTORS);
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_eq(afb_ev_mgr_start_reactors(1), X_EBUSY);
+	ck_assert_uint_eq(afb_ev_mgr_reactor_count(), NB_REACTORS);
+
+	for (i = 0 ; i < NB_PIPES ; i++) {
+		rc = pipe2(fds[i], O_CLOEXEC|O_NONBLOCK);
+		ck_assert_int_eq(rc, 0);
+		rc = afb_ev_mgr_add_fd_sharded(&efd[i], fds[i][0], EV_FD_IN, reactorcb, NULL, 0, 1);
+		ck_assert_int_eq(rc, 0);
+	}
+
+	/* each reactor thread reads from its own pipes */
+	readcount = 0;
+	for (i = 0 ; i < NB_PIPES ; i++) {
+		szrc = write(fds[i][1], &i, sizeof i);
+		ck_assert_int_eq(szrc, sizeof i);
+	}
+	for (j = 0 ; j < 100 && __atomic_load_n(&readcount, __ATOMIC_ACQUIRE) < NB_PIPES ; j++)
+		usleep(10000);
+	ck_assert_int_eq(readcount, NB_PIPES);
+	for (i = 0 ; i < NB_PIPES ; i++) {
+		ck_assert(!x_thread_equal(readthread[i], x_thread_self()));
+		ck_assert(x_thread_equal(readthread[i], readthread[(i + NB_REACTORS) % NB_PIPES]));
+		for (j = 1 ; j < NB_REACTORS ; j++)
+			ck_assert(!x_thread_equal(readthread[i], readthread[(i + j) % NB_PIPES]));
+	}
+
+	afb_ev_mgr_stop_reactors();
+	ck_assert_uint_eq(afb_ev_mgr_reactor_count(), 0);
+	for (i = 0 ; i < NB_PIPES ; i++) {
+		ev_fd_unref(efd[i]);
+		close(fds[i][1]);
+	}
+}
+END_TEST
+#endif
+
 /*********************************************************************/
 
 static Suite *suite;
@@ -179,5 +317,9 @@ int main(int ac, char **av)
 			addtest(basic);
 			addtest(fd);
 			addtest(timer);
+			addtest(fds);
+#if WITH_EV_REACTORS
+			addtest(reactors);
+#endif
 	return !!srun();
 }
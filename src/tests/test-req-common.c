@@ -387,6 +387,68 @@ START_TEST (process)
 }
 END_TEST
 
+START_TEST (deadline)
+{
+	struct afb_req_common *req = &comreq;
+
+	struct afb_api_itf itf = {
+		.process = api_process,
+		.unref = apiClosureCB
+	};
+	struct afb_apiset *test_apiset;
+	struct afb_api_item api_item = {
+		.closure = i2p(255),
+		.group = 0,
+		.itf = &itf
+	};
+
+	fprintf(stderr, "\n### Deadline of Request...\n");
+
+	afb_req_common_init(req, &test_queryitf, apiname, verbname, 0, NULL, NULL);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 0);
+
+	/* timeouts only make the deadline earlier */
+	afb_req_common_set_timeout(req, 10);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 10);
+	afb_req_common_set_timeout(req, 20);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 10);
+	afb_req_common_set_timeout(req, 0);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 10);
+	afb_req_common_set_timeout(req, 2);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 2);
+
+	/* an expired request is not processed */
+	afb_req_common_set_deadline(req, 1);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 1);
+
+	test_apiset = afb_apiset_create("toto", 1);
+	afb_apiset_add(test_apiset, req->apiname, api_item);
+
+	gApiVal = 0;
+	test_reply_status = 0;
+	test_unref_req = NULL;
+	afb_req_common_process(req, test_apiset);
+
+	ck_assert_int_eq(gApiVal, 0);
+	ck_assert_int_eq(test_reply_status, AFB_ERRNO_TIMEOUT);
+	ck_assert_ptr_eq(test_unref_req, req);
+
+	/* the timeout of the apiset only limits the execution */
+	afb_req_common_init(req, &test_queryitf, apiname, verbname, 0, NULL, NULL);
+	afb_apiset_timeout_set(test_apiset, 1);
+
+	gApiVal = 0;
+	afb_req_common_process(req, test_apiset);
+	ck_assert_int_eq(afb_req_common_get_timeout(req), 0);
+
+	sched_jobs("DEADLINE");
+
+	afb_req_common_unref(req);
+
+	ck_assert_int_eq(gApiVal, 255);
+}
+END_TEST
+
 START_TEST(process_on_behalf)
 {
 	struct afb_req_common *req = &comreq;
@@ -702,6 +764,79 @@ START_TEST(reply)
 END_TEST
 /*********************************************************************/
 
+#if WITH_AFB_HOOK
+#include <pthread.h>
+#include "core/afb-hook.h"
+
+int hook_stop;
+int hook_replaced_count;
+
+void hook_count(void *closure, const struct afb_hookid *hookid, const struct afb_req_common *req)
+{
+	__atomic_add_fetch((int*)closure, 1, __ATOMIC_RELAXED);
+}
+
+struct afb_hook_req_itf hook_count_itf =
+{
+	.hook_req_begin = hook_count,
+	.hook_req_end = hook_count
+};
+
+void *hook_replacer(void *arg)
+{
+	struct afb_hook_req *hook;
+
+	while (!__atomic_load_n(&hook_stop, __ATOMIC_RELAXED)) {
+		hook = afb_hook_create_req(apiname, NULL, NULL, afb_hook_flags_req_life, &hook_count_itf, &hook_replaced_count);
+		ck_assert_ptr_nonnull(hook);
+		afb_hook_unref_req(hook);
+	}
+	return NULL;
+}
+
+START_TEST (hooks_snapshot)
+{
+	int i, count = 0;
+	struct afb_req_common req1, req2;
+	struct afb_hook_req *hook;
+	pthread_t tid;
+
+	/* a request in flight keeps the hooks matching it */
+	hook = afb_hook_create_req(apiname, NULL, NULL, afb_hook_flags_req_life, &hook_count_itf, &count);
+	ck_assert_ptr_nonnull(hook);
+	afb_req_common_init(&req1, &test_queryitf, apiname, verbname, 0, NULL, NULL);
+	afb_hook_init_req(&req1);
+	ck_assert_uint_ne(req1.hookflags, 0);
+
+	/* requests are processed while an other thread replaces the snapshot */
+	hook_stop = 0;
+	ck_assert_int_eq(0, pthread_create(&tid, NULL, hook_replacer, NULL));
+	for (i = 0 ; i < 10000 ; i++) {
+		afb_req_common_init(&req2, &test_queryitf, (i & 1) ? apiname : "other", verbname, 0, NULL, NULL);
+		afb_hook_init_req(&req2);
+		afb_hook_req_begin(&req2);
+		afb_req_common_cleanup(&req2);
+	}
+	__atomic_store_n(&hook_stop, 1, __ATOMIC_RELAXED);
+	pthread_join(tid, NULL);
+
+	/* the hook fired once for each request of its api */
+	ck_assert_int_eq(count, 5000);
+	afb_hook_req_begin(&req1);
+	ck_assert_int_eq(count, 5001);
+
+	/* the released hook stays valid for the request but no longer fires */
+	afb_hook_unref_req(hook);
+	afb_hook_req_end(&req1);
+	ck_assert_int_eq(count, 5001);
+	afb_req_common_cleanup(&req1);
+	ck_assert_ptr_null(req1.hooks);
+}
+END_TEST
+#endif
+
+/*********************************************************************/
+
 static Suite *suite;
 static TCase *tcase;
 
@@ -727,10 +862,14 @@ int main(int ac, char **av)
 			addtest(prepare_forwarding);
 			addtest(push_and_pop);
 			addtest(process);
+			addtest(deadline);
 			addtest(process_on_behalf);
 			addtest(errors);
 			addtest(subscribe);
 			addtest(check_perm);
 			addtest(reply);
+#if WITH_AFB_HOOK
+			addtest(hooks_snapshot);
+#endif
 	return !!srun();
 }
@@ -40,6 +40,8 @@
 #include "core/afb-jobs.h"
 #include "core/afb-sig-monitor.h"
 #include "core/afb-threads.h"
+#include "core/afb-fibers.h"
+#include "sys/x-errno.h"
 
 /*********************************************************************/
 
@@ -346,6 +348,76 @@ END_TEST
 
 /*********************************************************************/
 
+#define GROW_CEILING 4
+#define GROW_JOBS    6
+
+int grow_running;
+int grow_max_running;
+int grow_done;
+unsigned grow_shrinks;
+
+void grow_job(int sig, void *arg){
+    pthread_mutex_lock(&gval.mutex);
+    if (++grow_running > grow_max_running)
+        grow_max_running = grow_running;
+    pthread_mutex_unlock(&gval.mutex);
+    nsleep(100000);
+    pthread_mutex_lock(&gval.mutex);
+    grow_running--;
+    grow_done++;
+    pthread_mutex_unlock(&gval.mutex);
+}
+
+void test_start_grow(int sig, void *arg){
+    int i, r, done;
+
+    /* the only normal thread is busy here, so jobs wait and the pool grows */
+    for (i = 0 ; i < GROW_JOBS ; i++) {
+        r = afb_sched_post_job(NULL, 0, 0, grow_job, NULL, Afb_Sched_Mode_Normal);
+        if (r < 0) reachError++;
+        nsleep(20000);
+    }
+    do {
+        nsleep(10000);
+        pthread_mutex_lock(&gval.mutex);
+        done = grow_done;
+        pthread_mutex_unlock(&gval.mutex);
+    } while (done < GROW_JOBS);
+
+    /* let extra threads linger then stop */
+    nsleep(300000);
+    afb_threads_adaptive_counts(NULL, &grow_shrinks);
+    afb_sched_exit(0, NULL, NULL, 0);
+}
+
+START_TEST(test_sched_grow){
+    unsigned grows, grows0, shrinks0;
+
+    reachError = 0;
+    grow_running = grow_max_running = grow_done = 0;
+    pthread_mutex_init(&gval.mutex, NULL);
+
+    fprintf(stderr, "\n************************test_sched_grow************************\n");
+
+    ck_assert_int_eq(afb_sig_monitor_init(TRUE), 0);
+    afb_sched_set_adaptive(GROW_CEILING, 10, 50);
+    afb_threads_adaptive_counts(&grows0, &shrinks0);
+
+    ck_assert_int_eq(afb_sched_start(1, 1, GROW_JOBS + 1, test_start_grow, NULL), 0);
+    afb_sched_set_adaptive(0, 0, 0);
+
+    afb_threads_adaptive_counts(&grows, NULL);
+    fprintf(stderr, "grows %u shrinks %u max running %d\n", grows, grow_shrinks, grow_max_running);
+    ck_assert_int_eq(reachError, 0);
+    ck_assert_uint_gt(grows, grows0);
+    ck_assert_uint_gt(grow_shrinks, shrinks0);
+    ck_assert_int_gt(grow_max_running, 1);
+    ck_assert_int_lt(grow_max_running, GROW_CEILING);
+}
+END_TEST
+
+/*********************************************************************/
+
 int evmgr_gotten;
 int evmgr_expected;
 pthread_mutex_t evmgr_mutex;
@@ -414,6 +486,198 @@ END_TEST
 
 /*********************************************************************/
 
+#if WITH_SCHED_FIBERS
+
+int fiber_signum;
+
+void fiber_leave_job(int sig, void *arg){
+    int r;
+    fprintf(stderr, "fiber_leave_job sig=%d\n", sig);
+    r = afb_sched_leave(arg);
+    if (r) reachError++;
+}
+
+void fiber_enter(int sig, void *arg, struct afb_sched_lock *sched_lock){
+    int r;
+    fprintf(stderr, "fiber_enter sig=%d\n", sig);
+    if (sig == 0) {
+        /* with one thread, the leave job can only run if the thread is given back */
+        r = afb_sched_post_job(NULL, 0, 0, fiber_leave_job, sched_lock, Afb_Sched_Mode_Normal);
+        if (r < 0) reachError++;
+    }
+}
+
+void fiber_enter_timeout(int sig, void *arg, struct afb_sched_lock *sched_lock){
+    fprintf(stderr, "fiber_enter_timeout sig=%d\n", sig);
+    fiber_signum = sig;
+}
+
+int fiber_runs;
+int fiber_stuck_runs;
+int fiber_stuck_alarmed;
+
+void fiber_stuck_job(int sig, void *arg){
+    int r;
+
+    if (sig == 0){
+        r = afb_sched_sync(0, fiber_enter, arg);
+        if (r) reachError++;
+        /* in a fiber, the timeout of the job is rearmed after resuming */
+        if (afb_fiber_current() != NULL)
+            for(;;);
+    }
+    else if (sig == SIGALRM)
+        fiber_stuck_alarmed = 1;
+    if (++fiber_stuck_runs < 2) {
+        r = afb_sched_post_job(NULL, 0, 1, fiber_stuck_job, arg, Afb_Sched_Mode_Normal);
+        if (r < 0) reachError++;
+    }
+    else
+        afb_sched_exit(0, NULL, NULL, 0);
+}
+
+void fiber_job(int sig, void *arg){
+    int r;
+
+    if (sig == 0){
+        /* the first run teaches that the job waits, next ones run in a fiber */
+        if ((afb_fiber_current() != NULL) != (fiber_runs != 0)) reachError++;
+        r = afb_sched_sync(0, fiber_enter, arg);
+        fprintf(stderr, "fiber sync %d\n", r);
+        if (r) reachError++;
+        fiber_signum = 0;
+        r = afb_sched_sync(1, fiber_enter_timeout, arg);
+        fprintf(stderr, "fiber sync timeout %d\n", r);
+        if (r >= 0 || fiber_signum != SIGALRM) reachError++;
+    }
+    if (++fiber_runs < 2)
+        r = afb_sched_post_job(NULL, 0, 0, fiber_job, arg, Afb_Sched_Mode_Normal);
+    else
+        r = afb_sched_post_job(NULL, 0, 1, fiber_stuck_job, arg, Afb_Sched_Mode_Normal);
+    if (r < 0) {
+        reachError++;
+        afb_sched_exit(0, NULL, NULL, 0);
+    }
+}
+
+void test_start_fibers(int sig, void *arg){
+    if (sig == 0 && afb_sched_post_job(NULL, 0, 0, fiber_job, arg, Afb_Sched_Mode_Normal) >= 0)
+        return;
+    reachError++;
+    afb_sched_exit(0, NULL, NULL, 0);
+}
+
+const void *kind_of_job(void *arg1, void *arg2){
+    return arg1;
+}
+
+void kind_job(int sig, void *arg1, void *arg2){
+    int r, step = p2i(arg2);
+
+    if (sig != 0) {
+        reachError++;
+        afb_sched_exit(0, NULL, NULL, 0);
+        return;
+    }
+    /* only the kind known to wait runs in a fiber */
+    if ((afb_fiber_current() != NULL) != (step == 2)) reachError++;
+    if (arg1 == i2p(16)) {
+        r = afb_sched_sync(0, fiber_enter, NULL);
+        if (r) reachError++;
+    }
+    if (step == 0)
+        r = afb_sched_post_job2(NULL, 0, 0, kind_job, i2p(32), i2p(1), Afb_Sched_Mode_Normal);
+    else if (step == 1)
+        r = afb_sched_post_job2(NULL, 0, 0, kind_job, i2p(16), i2p(2), Afb_Sched_Mode_Normal);
+    else {
+        afb_sched_exit(0, NULL, NULL, 0);
+        r = 0;
+    }
+    if (r < 0) {
+        reachError++;
+        afb_sched_exit(0, NULL, NULL, 0);
+    }
+}
+
+void test_start_kinds(int sig, void *arg){
+    if (sig == 0 && afb_sched_post_job2(NULL, 0, 0, kind_job, i2p(16), i2p(0), Afb_Sched_Mode_Normal) >= 0)
+        return;
+    reachError++;
+    afb_sched_exit(0, NULL, NULL, 0);
+}
+
+START_TEST(test_sched_fibers){
+
+    reachError = 0;
+    fiber_signum = 0;
+    fiber_runs = 0;
+    fiber_stuck_runs = 0;
+    fiber_stuck_alarmed = 0;
+
+    fprintf(stderr, "\n************************test_sched_fibers************************\n");
+
+    ck_assert_int_eq(afb_sig_monitor_init(TRUE), 0);
+    ck_assert_int_eq(afb_sched_set_fibers(256 * 1024), 0);
+
+    // run the sync jobs with only one thread
+    ck_assert_int_eq(afb_sched_start(1, 1, NBJOBS, test_start_fibers, NULL), 0);
+
+    ck_assert_int_eq(afb_sched_set_fibers(0), 0);
+    ck_assert_int_eq(reachError, 0);
+    ck_assert_int_eq(fiber_stuck_alarmed, 1);
+
+    // jobs of the same callback but of different kinds
+    ck_assert_int_eq(afb_sched_set_job_kind((const void*)kind_job, kind_of_job), 0);
+    ck_assert_int_eq(afb_sched_set_fibers(256 * 1024), 0);
+    ck_assert_int_eq(afb_sched_start(1, 1, NBJOBS, test_start_kinds, NULL), 0);
+    ck_assert_int_eq(afb_sched_set_fibers(0), 0);
+    ck_assert_int_eq(reachError, 0);
+}
+END_TEST
+
+#endif
+
+#if WITH_THREADS_AFFINITY
+/*********************************************************************/
+
+START_TEST(test_set_cpus){
+
+    fprintf(stderr, "\n************************test_set_cpus************************\n");
+
+    // lists of numbers and ranges
+    ck_assert_int_eq(afb_threads_set_cpus("0", NULL), 0);
+    ck_assert_int_eq(afb_threads_set_cpus("0-1,3", "2"), 0);
+    ck_assert_int_eq(afb_threads_set_cpus("0,0-0,1-1", "0-3,8"), 0);
+    ck_assert_int_eq(afb_threads_set_cpus(NULL, "0"), 0);
+
+    // invalid lists are rejected
+    ck_assert_int_eq(afb_threads_set_cpus("", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("x", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("3-1", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("1-", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("-1", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("0,", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("0;1", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("0 ", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("99999", NULL), X_EINVAL);
+    ck_assert_int_eq(afb_threads_set_cpus("0", "1,x"), X_EINVAL);
+
+    // only one thread is elected for the event loop
+    ck_assert_int_eq(afb_threads_set_cpus("0", NULL), 0);
+    ck_assert_int_eq(afb_threads_elect_evloop(), 1);
+    ck_assert_int_eq(afb_threads_elect_evloop(), 1);
+    ck_assert_int_eq(afb_threads_set_cpus(NULL, NULL), 0);
+    ck_assert_int_eq(afb_threads_elect_evloop(), 0);
+
+    // the NUMA node of the thread is known
+    ck_assert_int_ge(afb_threads_numa_node(), 0);
+    ck_assert_int_lt(afb_threads_numa_node(), afb_threads_numa_count());
+}
+END_TEST
+#endif
+
+/*********************************************************************/
+
 static Suite *suite;
 static TCase *tcase;
 
@@ -438,5 +702,12 @@ int main(int ac, char **av)
 			addtest(test_sched_enter);
 			addtest(test_sched_adapt);
 			addtest(test_evmgr);
+			addtest(test_sched_grow);
+#if WITH_SCHED_FIBERS
+			addtest(test_sched_fibers);
+#endif
+#if WITH_THREADS_AFFINITY
+			addtest(test_set_cpus);
+#endif
 	return !!srun();
 }
@@ -253,6 +253,100 @@ START_TEST(sigterm_test)
 END_TEST
 /*********************************************************************/
 
+#define PROGRESS_STEPS 6
+#define PROGRESS_STEP_USEC 250000
+
+int stuck_stop;
+int stuck_alarmed;
+int stuck_completed;
+int progress_steps;
+int progress_alarmed;
+
+/* a job that spins until stopped or alarmed */
+void stuck_job(int sig, void *arg)
+{
+	if (sig == 0) {
+		while (!__atomic_load_n(&stuck_stop, __ATOMIC_RELAXED));
+		__atomic_store_n(&stuck_completed, TRUE, __ATOMIC_RELAXED);
+	}
+	else if (sig == SIGALRM)
+		__atomic_store_n(&stuck_alarmed, TRUE, __ATOMIC_RELAXED);
+}
+
+/* a job that completes before its timeout */
+void progress_job(int sig, void *arg)
+{
+	if (sig == 0) {
+		nsleep(PROGRESS_STEP_USEC);
+		progress_steps++;
+	}
+	else if (sig == SIGALRM)
+		progress_alarmed++;
+}
+
+/* runs successive jobs whose total duration exceeds their timeout */
+void *progress_thread(void *arg)
+{
+	int i;
+
+	for (i = 0 ; i < PROGRESS_STEPS ; i++)
+		afb_sig_monitor_run(1, progress_job, NULL);
+	afb_sig_monitor_clean_timeouts();
+	return NULL;
+}
+
+/* runs the stuck job */
+void *stuck_thread(void *arg)
+{
+	afb_sig_monitor_run(1, stuck_job, NULL);
+	afb_sig_monitor_clean_timeouts();
+	return NULL;
+}
+
+START_TEST (progressing_job_test)
+{
+	fprintf(stderr,"\n*************** progressing_job_test ***************\n");
+
+	ck_assert_int_eq(afb_sig_monitor_init(TRUE), 0);
+
+	// jobs of 250ms with a timeout of 1s during 1.5s never expire
+	progress_steps = progress_alarmed = 0;
+	progress_thread(NULL);
+	ck_assert_int_eq(progress_steps, PROGRESS_STEPS);
+	ck_assert_int_eq(progress_alarmed, 0);
+}
+END_TEST
+
+START_TEST (stuck_job_test)
+{
+	int i;
+	pthread_t stuck, progress;
+
+	fprintf(stderr,"\n*************** stuck_job_test ***************\n");
+
+	ck_assert_int_eq(afb_sig_monitor_init(TRUE), 0);
+
+	// a stuck job and progressing jobs run concurrently
+	stuck_stop = stuck_alarmed = stuck_completed = FALSE;
+	progress_steps = progress_alarmed = 0;
+	ck_assert_int_eq(pthread_create(&stuck, NULL, stuck_thread, NULL), 0);
+	ck_assert_int_eq(pthread_create(&progress, NULL, progress_thread, NULL), 0);
+
+	// only the stuck job is alarmed
+	pthread_join(progress, NULL);
+	ck_assert_int_eq(progress_steps, PROGRESS_STEPS);
+	ck_assert_int_eq(progress_alarmed, 0);
+	for (i = 0 ; i < 20 && !__atomic_load_n(&stuck_alarmed, __ATOMIC_RELAXED) ; i++)
+		nsleep(100000);
+	__atomic_store_n(&stuck_stop, TRUE, __ATOMIC_RELAXED);
+	pthread_join(stuck, NULL);
+	ck_assert_int_eq(stuck_alarmed, TRUE);
+	ck_assert_int_eq(stuck_completed, FALSE);
+}
+END_TEST
+
+/*********************************************************************/
+
 static Suite *suite;
 static TCase *tcase;
 
@@ -277,6 +371,8 @@ int main(int ac, char **av)
 			addtest(timeout_test);
 			addtest(clean_timeout_test);
 			addtest(dumpstack_test);
+			addtest(progressing_job_test);
+			addtest(stuck_job_test);
 			addtest(sigterm_test);
 	return !!srun();
 }
@@ -0,0 +1,264 @@
+/*
+ Copyright (C) 2015-2026 IoT.bzh Company
+
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ $RP_BEGIN_LICENSE$
+ Commercial License Usage
+  Licensees holding valid commercial IoT.bzh licenses may use this file in
+  accordance with the commercial license agreement provided with the
+  Software or, alternatively, in accordance with the terms contained in
+  a written agreement between you and The IoT.bzh Company. For licensing terms
+  and conditions see https://www.iot.bzh/terms-conditions. For further
+  information use the contact form at https://www.iot.bzh/contact.
+
+ GNU General Public License Usage
+  Alternatively, this file may be used under the terms of the GNU General
+  Public license version 3. This license is as published by the Free Software
+  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+  of this file. Please review the following information to ensure the GNU
+  General Public License requirements will be met
+  https://www.gnu.org/licenses/gpl-3.0.html.
+ $RP_END_LICENSE$
+*/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <check.h>
+
+#include "sys/x-uio.h"
+#include "utils/websock.h"
+
+/*********************************************************************/
+
+#define NFRAMES   100
+#define BIGSIZE   50000
+#define MAXSIZE   (NFRAMES * 64 + BIGSIZE + 1024)
+
+/* a memory transport */
+struct transport {
+	struct websock *ws;
+	size_t length;		/* count of bytes written */
+	size_t rdpos;		/* read position */
+	size_t chunk;		/* maximum count of bytes per read */
+	int nreads;		/* count of reads */
+	int nframes;		/* count of received frames */
+	size_t received;	/* count of received bytes */
+	int errors;		/* count of errors */
+	char buffer[MAXSIZE];
+	char payload[BIGSIZE];
+};
+
+static struct transport out, in;
+
+static ssize_t t_writev(void *closure, const struct iovec *iov, int iovcnt)
+{
+	struct transport *t = closure;
+	size_t total = 0;
+	int i;
+
+	for (i = 0 ; i < iovcnt ; i++) {
+		ck_assert_uint_le(t->length + iov[i].iov_len, MAXSIZE);
+		memcpy(&t->buffer[t->length], iov[i].iov_base, iov[i].iov_len);
+		t->length += iov[i].iov_len;
+		total += iov[i].iov_len;
+	}
+	return (ssize_t)total;
+}
+
+static ssize_t t_readv(void *closure, const struct iovec *iov, int iovcnt)
+{
+	struct transport *t = closure;
+	size_t sz, avail, total = 0;
+	int i;
+
+	t->nreads++;
+	for (i = 0 ; i < iovcnt ; i++) {
+		avail = t->length - t->rdpos;
+		if (avail > t->chunk - total)
+			avail = t->chunk - total;
+		sz = iov[i].iov_len > avail ? avail : iov[i].iov_len;
+		memcpy(iov[i].iov_base, &t->buffer[t->rdpos], sz);
+		t->rdpos += sz;
+		total += sz;
+	}
+	return (ssize_t)total;
+}
+
+static void t_on_close(void *closure, uint16_t code, size_t size)
+{
+	struct transport *t = closure;
+	t->errors++;
+}
+
+static void t_on_data(void *closure, int last, size_t size)
+{
+	struct transport *t = closure;
+	ssize_t rc;
+	size_t pos = 0;
+
+	ck_assert_uint_le(size, BIGSIZE);
+	while (pos < size) {
+		rc = websock_read(t->ws, &t->payload[pos], size - pos);
+		ck_assert_int_gt(rc, 0);
+		pos += (size_t)rc;
+	}
+	/* the payload of frame i is made of size bytes 'A' + i % 26 */
+	while (pos)
+		if (t->payload[--pos] != 'A' + t->nframes % 26)
+			t->errors++;
+	t->received += size;
+	t->nframes++;
+}
+
+static void t_on_error(void *closure, uint16_t code, const void *data, size_t size)
+{
+	struct transport *t = closure;
+	t->errors++;
+}
+
+static const struct websock_itf itf = {
+	.writev = t_writev,
+	.readv = t_readv,
+	.on_close = t_on_close,
+	.on_text = t_on_data,
+	.on_binary = t_on_data,
+	.on_continue = t_on_data,
+	.on_error = t_on_error
+};
+
+/* emit the frames in 'out' */
+static size_t emit(int masked)
+{
+	char data[BIGSIZE];
+	size_t size, total = 0;
+	int i;
+
+	memset(&out, 0, sizeof out);
+	out.ws = websock_create_v13(&itf, &out);
+	ck_assert_ptr_ne(out.ws, NULL);
+	websock_set_masking(out.ws, masked);
+	for (i = 0 ; i < NFRAMES ; i++) {
+		size = i == NFRAMES / 2 ? BIGSIZE : (size_t)(i % 50);
+		memset(data, 'A' + i % 26, size);
+		if (i & 1)
+			websock_text(out.ws, 1, data, size);
+		else
+			websock_binary(out.ws, 1, data, size);
+		total += size;
+	}
+	return total;
+}
+
+/* receive the frames of 'out' reading at most 'chunk' bytes at once */
+static int receive(size_t bufsize, size_t chunk, size_t total)
+{
+	int rc;
+
+	memset(&in, 0, sizeof in);
+	memcpy(in.buffer, out.buffer, out.length);
+	in.length = out.length;
+	in.chunk = chunk;
+	in.ws = websock_create_v13(&itf, &in);
+	ck_assert_ptr_ne(in.ws, NULL);
+	websock_set_max_length(in.ws, BIGSIZE);
+	rc = websock_set_input_buffer(in.ws, bufsize);
+	ck_assert_int_eq(rc, 0);
+
+	while (in.rdpos < in.length || websock_pending_input(in.ws) != 0) {
+		rc = websock_dispatch(in.ws, 1);
+		ck_assert_int_ge(rc, 0);
+	}
+	ck_assert_int_eq(in.errors, 0);
+	ck_assert_int_eq(in.nframes, NFRAMES);
+	ck_assert_uint_eq(in.received, total);
+	ck_assert_uint_eq(websock_pending_input(in.ws), 0);
+	websock_destroy(in.ws);
+	return in.nreads;
+}
+
+START_TEST (check_unbuffered)
+{
+	size_t total;
+
+	total = emit(0);
+	receive(0, MAXSIZE, total);
+	receive(0, 7, total);
+	websock_destroy(out.ws);
+	total = emit(1);
+	receive(0, MAXSIZE, total);
+	receive(0, 7, total);
+	websock_destroy(out.ws);
+}
+END_TEST
+
+START_TEST (check_buffered)
+{
+	size_t total;
+	int unbuffered, buffered;
+
+	total = emit(0);
+	unbuffered = receive(0, MAXSIZE, total);
+	buffered = receive(4096, MAXSIZE, total);
+	fprintf(stderr, "reads: unbuffered %d, buffered %d\n", unbuffered, buffered);
+	ck_assert_int_lt(buffered * 10, unbuffered);
+	receive(4096, 7, total);
+	receive(4096, 1000, total);
+	receive(16, 1000, total);
+	websock_destroy(out.ws);
+
+	total = emit(1);
+	receive(4096, MAXSIZE, total);
+	receive(4096, 7, total);
+	receive(4096, 1000, total);
+	receive(3, 1000, total);
+	websock_destroy(out.ws);
+}
+END_TEST
+
+START_TEST (check_set_input_buffer)
+{
+	struct websock *ws;
+
+	ws = websock_create_v13(&itf, &in);
+	ck_assert_ptr_ne(ws, NULL);
+	ck_assert_uint_eq(websock_pending_input(ws), 0);
+	ck_assert_int_eq(websock_set_input_buffer(ws, 100), 0);
+	ck_assert_int_eq(websock_set_input_buffer(ws, 1000), 0);
+	ck_assert_int_eq(websock_set_input_buffer(ws, 0), 0);
+	ck_assert_uint_eq(websock_pending_input(ws), 0);
+	websock_destroy(ws);
+}
+END_TEST
+
+/*********************************************************************/
+
+static Suite *suite;
+static TCase *tcase;
+
+void mksuite(const char *name) { suite = suite_create(name); }
+void addtcase(const char *name) { tcase = tcase_create(name); suite_add_tcase(suite, tcase); tcase_set_timeout(tcase, 120); }
+#define addtest(test) tcase_add_test(tcase, test)
+int srun()
+{
+	int nerr;
+	SRunner *srunner = srunner_create(suite);
+	srunner_run_all(srunner, CK_NORMAL);
+	nerr = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+	return nerr;
+}
+
+int main(int ac, char **av)
+{
+	mksuite("websock");
+		addtcase("websock");
+			addtest(check_set_input_buffer);
+			addtest(check_unbuffered);
+			addtest(check_buffered);
+	return !!srun();
+}
@@ -0,0 +1,654 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Load generator
+ *
+ * Drives a binder through the client protocols of libafbcli
+ * (wsj1 or, with option -d, wsapi) and reports the throughput
+ * and the latency percentiles of the calls.
+ *
+ * Calls are issued on one or more connections, each keeping up
+ * to DEPTH calls in flight (pipelining). By default the load is
+ * closed loop: a new call is sent as soon as a slot is free. With
+ * a rate (option -r), the load is open loop: calls are scheduled
+ * at the given rate and their latency is measured from their
+ * scheduled time, so late sends due to saturation are accounted.
+ *
+ * With option -R, each connection is closed after its call and opened
+ * again for the next one: it drives storms of reconnections and the
+ * latency of closed loop calls includes the setup of the connection.
+ *
+ * Example, against the binding tests/test-bindings/hello.c:
+ *
+ *   afb-binder --port 1234 --binding hello.so &
+ *   afb-load -c 4 -q 16 -s 256 ws://localhost:1234/api hello call
+ *   afb-load -c 4 -e subscribe -r 1000 ws://localhost:1234/api hello evpush
+ *   afb-load -R -c 64 -n 100000 ws://localhost:1234/api hello call
+ */
+
+#include "libafb-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <systemd/sd-event.h>
+#include <json-c/json.h>
+
+#include "afb-ws-client.h"
+#if WITH_WSJ1
+#include "wsj1/afb-wsj1.h"
+#endif
+#if WITH_WSAPI
+#include "wsapi/afb-proto-ws.h"
+#endif
+
+/* a connection */
+struct conn {
+	struct afb_wsj1 *wsj1;		/**< the wsj1 client or NULL */
+	struct afb_proto_ws *pws;	/**< the wsapi client or NULL */
+	int pending;			/**< count of calls in flight */
+	int hangup;			/**< was hung up */
+	int dropping;			/**< is closed by the tool */
+	int recycling;			/**< waits to be reopened */
+	uint64_t since;			/**< time of the reopening */
+	struct sd_event_source *recycler; /**< reopens the connection */
+};
+
+/* a call */
+struct call {
+	struct conn *conn;		/**< connection of the call */
+	uint64_t ref;			/**< reference time, 0 for subscriptions */
+};
+
+/* settings */
+static int direct;
+static int nconns = 1;
+static int depth = 1;
+static double rate;
+static long total = 10000;
+static double duration;
+static size_t size;
+static int json;
+static int reconnect;
+static const char *evverb;
+static const char *uri;
+static const char *api;
+static const char *verb;
+static const char *args_s = "null";
+static struct json_object *args_j;
+
+/* state */
+static struct sd_event *loop;
+static struct sd_event_source *timer;
+static struct conn *conns;
+static int nextconn;
+static int inflight;
+static int subscribing;
+static int sending;
+static int alive;
+static uint64_t start, end;
+static long sent, okays, errors, events, reconnects;
+
+/* latencies in nanoseconds */
+static uint64_t *lats;
+static size_t nlats, alats;
+
+/* returns the monotonic time in nanoseconds */
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void pump();
+static void recycle(struct conn *conn);
+
+/***********************************************************************/
+/* completion of calls                                                 */
+/***********************************************************************/
+
+static void record(uint64_t latency)
+{
+	uint64_t *l;
+
+	if (nlats == alats) {
+		alats = alats ? 2 * alats : 65536;
+		l = realloc(lats, alats * sizeof *lats);
+		if (l == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		lats = l;
+	}
+	lats[nlats++] = latency;
+}
+
+static void completed(struct call *call, int ok)
+{
+	uint64_t t = now_ns();
+
+	call->conn->pending--;
+	inflight--;
+	if (call->ref == 0) {
+		if (!ok)
+			fprintf(stderr, "subscription failed\n");
+		subscribing--;
+	}
+	else {
+		if (ok) {
+			okays++;
+			record(t - call->ref);
+		}
+		else
+			errors++;
+		end = t;
+		if (reconnect)
+			recycle(call->conn);
+	}
+	free(call);
+	pump();
+}
+
+static void hangup(struct conn *conn)
+{
+	if (!conn->hangup && !conn->dropping) {
+		conn->hangup = 1;
+		if (--alive == 0) {
+			fprintf(stderr, "all connections hung up\n");
+			sd_event_exit(loop, 1);
+		}
+	}
+}
+
+/***********************************************************************/
+/* protocol wsj1                                                       */
+/***********************************************************************/
+
+#if WITH_WSJ1 && !WITHOUT_JSON_C
+
+static void wsj1_on_hangup(void *closure, struct afb_wsj1 *wsj1)
+{
+	hangup(closure);
+}
+
+static void wsj1_on_call(void *closure, const char *api, const char *verb, struct afb_wsj1_msg *msg)
+{
+	afb_wsj1_reply_error_s(msg, "\"unexpected\"", NULL);
+	afb_wsj1_msg_unref(msg);
+}
+
+static void wsj1_on_event(void *closure, const char *event, struct afb_wsj1_msg *msg)
+{
+	events++;
+	afb_wsj1_msg_unref(msg);
+}
+
+static void wsj1_on_reply(void *closure, struct afb_wsj1_msg *msg)
+{
+	completed(closure, afb_wsj1_msg_is_reply_ok(msg));
+	afb_wsj1_msg_unref(msg);
+}
+
+static struct afb_wsj1_itf wsj1_itf = {
+	.on_hangup = wsj1_on_hangup,
+	.on_call = wsj1_on_call,
+	.on_event = wsj1_on_event
+};
+
+#endif
+
+/***********************************************************************/
+/* protocol wsapi                                                      */
+/***********************************************************************/
+
+#if WITH_WSAPI && !WITHOUT_JSON_C
+
+static void pws_on_reply(void *closure, void *request, struct json_object *obj, const char *error, const char *info)
+{
+	json_object_put(obj);
+	completed(request, error == NULL);
+}
+
+static void pws_on_event_push(void *closure, uint16_t event_id, struct json_object *data)
+{
+	events++;
+	json_object_put(data);
+}
+
+static void pws_on_event_broadcast(void *closure, const char *event_name, struct json_object *data, const afb_proto_ws_uuid_t uuid, uint8_t hop)
+{
+	events++;
+	json_object_put(data);
+}
+
+static struct afb_proto_ws_client_itf pws_itf = {
+	.on_reply = pws_on_reply,
+	.on_event_push = pws_on_event_push,
+	.on_event_broadcast = pws_on_event_broadcast
+};
+
+static void pws_on_hangup(void *closure)
+{
+	hangup(closure);
+}
+
+#endif
+
+/***********************************************************************/
+/* sending                                                             */
+/***********************************************************************/
+
+static int connect_one(struct conn *conn)
+{
+	if (direct) {
+#if WITH_WSAPI && !WITHOUT_JSON_C
+		conn->pws = afb_ws_client_connect_api(loop, uri, &pws_itf, conn);
+		if (conn->pws != NULL)
+			afb_proto_ws_on_hangup(conn->pws, pws_on_hangup);
+#endif
+	}
+	else {
+#if WITH_WSJ1 && !WITHOUT_JSON_C
+		conn->wsj1 = afb_ws_client_connect_wsj1(loop, uri, &wsj1_itf, conn);
+#endif
+	}
+	if (conn->pws == NULL && conn->wsj1 == NULL)
+		return errno ? -errno : -ENOTSUP;
+	return 0;
+}
+
+static void disconnect_one(struct conn *conn)
+{
+	conn->dropping = 1;
+#if WITH_WSAPI && !WITHOUT_JSON_C
+	afb_proto_ws_unref(conn->pws);
+#endif
+#if WITH_WSJ1 && !WITHOUT_JSON_C
+	afb_wsj1_unref(conn->wsj1);
+#endif
+	conn->pws = NULL;
+	conn->wsj1 = NULL;
+	conn->dropping = 0;
+}
+
+static int connect_all()
+{
+	int i, rc;
+
+	conns = calloc((size_t)nconns, sizeof *conns);
+	if (conns == NULL)
+		return -ENOMEM;
+	for (i = 0 ; i < nconns ; i++) {
+		rc = connect_one(&conns[i]);
+		if (rc < 0)
+			return rc;
+		alive++;
+	}
+	return 0;
+}
+
+/* reopens the connection, out of the callbacks of the connection */
+static int on_recycle(sd_event_source *source, void *closure)
+{
+	struct conn *conn = closure;
+	int rc;
+
+	disconnect_one(conn);
+	conn->since = now_ns();
+	rc = connect_one(conn);
+	if (rc < 0) {
+		fprintf(stderr, "can't reconnect to %s: %s\n", uri, strerror(-rc));
+		hangup(conn);
+	}
+	else
+		reconnects++;
+	conn->recycling = 0;
+	pump();
+	return 0;
+}
+
+/* schedules the reopening of the connection */
+static void recycle(struct conn *conn)
+{
+	int rc;
+
+	conn->recycling = 1;
+	if (conn->recycler == NULL)
+		rc = sd_event_add_defer(loop, &conn->recycler, on_recycle, conn);
+	else
+		rc = sd_event_source_set_enabled(conn->recycler, SD_EVENT_ONESHOT);
+	if (rc < 0) {
+		fprintf(stderr, "can't reconnect: %s\n", strerror(-rc));
+		conn->recycling = 0;
+		hangup(conn);
+	}
+}
+
+static int send_call(struct conn *conn, const char *vrb, uint64_t ref)
+{
+	struct call *call;
+	int rc;
+
+	call = malloc(sizeof *call);
+	if (call == NULL)
+		return -ENOMEM;
+	call->conn = conn;
+	call->ref = ref;
+	conn->pending++;
+	inflight++;
+	rc = -ENOTSUP;
+#if WITH_WSAPI && !WITHOUT_JSON_C
+	if (conn->pws != NULL)
+		rc = afb_proto_ws_client_call(conn->pws, vrb, args_j, 0, 0, call, NULL);
+#endif
+#if WITH_WSJ1 && !WITHOUT_JSON_C
+	if (conn->wsj1 != NULL)
+		rc = afb_wsj1_call_s(conn->wsj1, api, vrb, args_s, wsj1_on_reply, call);
+#endif
+	if (rc < 0) {
+		conn->pending--;
+		inflight--;
+		free(call);
+	}
+	return rc;
+}
+
+/* get a connection having a free slot */
+static struct conn *free_conn()
+{
+	struct conn *conn;
+	int i;
+
+	for (i = 0 ; i < nconns ; i++) {
+		conn = &conns[nextconn];
+		nextconn = (nextconn + 1) % nconns;
+		if (!conn->hangup && !conn->recycling && conn->pending < depth)
+			return conn;
+	}
+	return NULL;
+}
+
+/* returns the count of connections waiting to be reopened */
+static int count_recycling()
+{
+	int i, n;
+
+	for (n = i = 0 ; i < nconns ; i++)
+		n += conns[i].recycling;
+	return n;
+}
+
+/* timer of scheduled calls */
+static int on_timer(sd_event_source *source, uint64_t usec, void *closure)
+{
+	pump();
+	return 0;
+}
+
+/* arm the timer for the next scheduled call */
+static void arm(uint64_t ns)
+{
+	uint64_t usec = ns / 1000;
+
+	if (timer == NULL)
+		sd_event_add_time(loop, &timer, CLOCK_MONOTONIC, usec, 1, on_timer, NULL);
+	else {
+		sd_event_source_set_time(timer, usec);
+		sd_event_source_set_enabled(timer, SD_EVENT_ONESHOT);
+	}
+}
+
+/* sends as many calls as possible */
+static void pump()
+{
+	struct conn *conn;
+	uint64_t t, ref;
+	int rc;
+
+	if (subscribing)
+		return;
+
+	if (!sending) {
+		if (start == 0) {
+			/* subscriptions done, start the load */
+			start = end = now_ns();
+			sending = 1;
+		}
+	}
+
+	t = now_ns();
+	while (sending) {
+		if ((total > 0 && sent >= total)
+		 || (duration > 0 && (double)(t - start) >= duration * 1e9)) {
+			sending = 0;
+			break;
+		}
+		if (rate > 0) {
+			ref = start + (uint64_t)((double)sent * 1e9 / rate);
+			if (ref > t) {
+				arm(ref);
+				break;
+			}
+		}
+		else
+			ref = t;
+		conn = free_conn();
+		if (conn == NULL)
+			break;
+		/* in closed loop, a reopened connection is part of the call */
+		if (rate <= 0 && conn->since != 0)
+			ref = conn->since;
+		conn->since = 0;
+		rc = send_call(conn, verb, ref);
+		sent++;
+		if (rc < 0)
+			errors++;
+	}
+
+	if (!sending && inflight == 0 && !count_recycling())
+		sd_event_exit(loop, 0);
+}
+
+/* subscribe the connections */
+static void subscribe_all()
+{
+	int i;
+
+	for (i = 0 ; i < nconns ; i++) {
+		if (send_call(&conns[i], evverb, 0) < 0)
+			fprintf(stderr, "can't subscribe\n");
+		else
+			subscribing++;
+	}
+}
+
+/***********************************************************************/
+/* report                                                              */
+/***********************************************************************/
+
+static int cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static double pct(double p)
+{
+	size_t idx;
+
+	if (nlats == 0)
+		return 0;
+	idx = (size_t)(p * (double)(nlats - 1) / 100.0 + 0.5);
+	return (double)lats[idx] / 1e3;
+}
+
+static void report()
+{
+	double secs, mean, sum;
+	size_t i;
+
+	secs = (double)(end - start) / 1e9;
+	qsort(lats, nlats, sizeof *lats, cmp);
+	for (sum = 0, i = 0 ; i < nlats ; i++)
+		sum += (double)lats[i];
+	mean = nlats ? sum / (double)nlats / 1e3 : 0;
+
+	if (json) {
+		printf("{\"protocol\":\"%s\",\"connections\":%d,\"depth\":%d,\"rate\":%.1f,\"size\":%zu,"
+			"\"reconnects\":%ld,\"sent\":%ld,\"ok\":%ld,\"errors\":%ld,\"events\":%ld,\"duration\":%.6f,"
+			"\"throughput\":%.1f,\"latency_us\":{\"min\":%.1f,\"mean\":%.1f,\"p50\":%.1f,"
+			"\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}\n",
+			direct ? "wsapi" : "wsj1", nconns, depth, rate, size,
+			reconnects, sent, okays, errors, events, secs,
+			secs > 0 ? (double)okays / secs : 0.0,
+			pct(0), mean, pct(50), pct(90), pct(99), pct(99.9), pct(100));
+		return;
+	}
+	printf("protocol %s, connections %d, depth %d, ", direct ? "wsapi" : "wsj1", nconns, depth);
+	if (rate > 0)
+		printf("rate %.1f/s\n", rate);
+	else
+		printf("closed loop\n");
+	printf("requests: sent %ld, ok %ld, errors %ld\n", sent, okays, errors);
+	printf("duration: %.3f s, throughput: %.1f req/s\n", secs, secs > 0 ? (double)okays / secs : 0.0);
+	printf("latency (us): min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+		pct(0), mean, pct(50), pct(90), pct(99), pct(99.9), pct(100));
+	if (evverb != NULL)
+		printf("events: %ld (%.1f/s)\n", events, secs > 0 ? (double)events / secs : 0.0);
+	if (reconnect)
+		printf("reconnections: %ld (%.1f/s)\n", reconnects, secs > 0 ? (double)reconnects / secs : 0.0);
+}
+
+/***********************************************************************/
+/* main                                                                */
+/***********************************************************************/
+
+static void usage(const char *prog, int code)
+{
+	fprintf(code ? stderr : stdout,
+		"usage: %s [options] URI API VERB [ARGS]\n"
+		"       %s -d [options] URI VERB [ARGS]\n"
+		"\n"
+		"  -d          direct connection to the API of URI (wsapi)\n"
+		"  -c COUNT    count of connections (default 1)\n"
+		"  -q DEPTH    count of calls in flight per connection (default 1)\n"
+		"  -r RATE     open loop at RATE calls per second (default closed loop)\n"
+		"  -n COUNT    count of calls (default 10000, 0 for no limit)\n"
+		"  -t SECONDS  duration of the load (default no limit)\n"
+		"  -s SIZE     send a JSON string of SIZE bytes when ARGS is not given\n"
+		"  -e VERB     call VERB once per connection before the load (subscription)\n"
+		"  -R          reopen the connection after each call (implies -q 1)\n"
+		"  -j          report in JSON\n"
+		"  -h          help\n",
+		prog, prog);
+	exit(code);
+}
+
+int main(int ac, char **av)
+{
+	char *payload;
+	int opt, rc;
+
+	while ((opt = getopt(ac, av, "dc:q:r:n:t:s:e:Rjh")) != -1) {
+		switch (opt) {
+		case 'd': direct = 1; break;
+		case 'c': nconns = atoi(optarg); break;
+		case 'q': depth = atoi(optarg); break;
+		case 'r': rate = atof(optarg); break;
+		case 'n': total = atol(optarg); break;
+		case 't': duration = atof(optarg); break;
+		case 's': size = (size_t)atol(optarg); break;
+		case 'e': evverb = optarg; break;
+		case 'R': reconnect = 1; break;
+		case 'j': json = 1; break;
+		case 'h': usage(av[0], 0); break;
+		default: usage(av[0], 1); break;
+		}
+	}
+	if (nconns < 1 || depth < 1 || rate < 0 || total < 0 || duration < 0
+	 || (total == 0 && duration == 0))
+		usage(av[0], 1);
+	if (reconnect)
+		depth = 1;
+
+	/* positional arguments */
+	if (optind >= ac)
+		usage(av[0], 1);
+	uri = av[optind++];
+	if (!direct) {
+		if (optind >= ac)
+			usage(av[0], 1);
+		api = av[optind++];
+	}
+	if (optind >= ac)
+		usage(av[0], 1);
+	verb = av[optind++];
+	if (optind < ac)
+		args_s = av[optind++];
+	else if (size > 0) {
+		payload = malloc(size + 3);
+		if (payload == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		payload[0] = payload[size + 1] = '"';
+		memset(&payload[1], 'x', size);
+		payload[size + 2] = 0;
+		args_s = payload;
+	}
+	if (optind < ac)
+		usage(av[0], 1);
+	args_j = json_tokener_parse(args_s);
+	if (args_j == NULL && strcmp(args_s, "null")) {
+		fprintf(stderr, "invalid JSON arguments %s\n", args_s);
+		return 1;
+	}
+
+	/* connect */
+	rc = sd_event_default(&loop);
+	if (rc < 0) {
+		fprintf(stderr, "can't create event loop: %s\n", strerror(-rc));
+		return 1;
+	}
+	rc = connect_all();
+	if (rc < 0) {
+		fprintf(stderr, "can't connect to %s: %s\n", uri, strerror(-rc));
+		return 1;
+	}
+
+	/* run */
+	if (evverb != NULL)
+		subscribe_all();
+	pump();
+	rc = sd_event_loop(loop);
+
+	report();
+	return rc < 0 || errors != 0;
+}
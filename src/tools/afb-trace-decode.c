@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2015-2026 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+/*
+ * Decoder of binary traces
+ *
+ * Reads a binary trace (either the file mapped by the binder or
+ * the result of 'monitor trace {"dump":true}') and prints its
+ * records, ordered by time, as JSON lines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libafb/misc/afb-trace-ring.h"
+
+static const char *req_actions[] = {
+	NULL, "begin", "end", "reply", "subcall", "subcall_result",
+	"subcallsync", "subcallsync_result", "subscribe", "unsubscribe"
+};
+
+static const char *evt_actions[] = {
+	NULL, "create", "push_before", "push_after",
+	"broadcast_before", "broadcast_after"
+};
+
+static const struct afb_trace_ring_header *header;
+
+/* read the whole file */
+static void *readall(FILE *file, size_t *size)
+{
+	char *buffer = NULL, *newbuf;
+	size_t length = 0, alloc = 0, rd;
+
+	do {
+		if (length == alloc) {
+			alloc = alloc ? 2 * alloc : 65536;
+			newbuf = realloc(buffer, alloc);
+			if (newbuf == NULL) {
+				free(buffer);
+				return NULL;
+			}
+			buffer = newbuf;
+		}
+		rd = fread(&buffer[length], 1, alloc - length, file);
+		length += rd;
+	} while (rd);
+	*size = length;
+	return buffer;
+}
+
+/* check the header */
+static int check(const struct afb_trace_ring_header *hdr, size_t size)
+{
+	struct afb_trace_ring_header ref;
+
+	if (size < sizeof *hdr
+	 || hdr->magic != AFB_TRACE_RING_MAGIC
+	 || hdr->version != AFB_TRACE_RING_VERSION
+	 || hdr->record_size != sizeof(struct afb_trace_ring_record)
+	 || hdr->ring_length == 0
+	 || (hdr->ring_length & (hdr->ring_length - 1)) != 0)
+		return 0;
+	afb_trace_ring_layout(&ref, hdr->ring_count, hdr->ring_length,
+				hdr->name_count, hdr->strings_size);
+	return ref.total_size == hdr->total_size && hdr->total_size <= size;
+}
+
+/* compare records by time */
+static int cmp(const void *a, const void *b)
+{
+	const struct afb_trace_ring_record *ra = *(const struct afb_trace_ring_record * const*)a;
+	const struct afb_trace_ring_record *rb = *(const struct afb_trace_ring_record * const*)b;
+
+	if (ra->time != rb->time)
+		return ra->time < rb->time ? -1 : 1;
+	if (ra->hookid != rb->hookid)
+		return ra->hookid < rb->hookid ? -1 : 1;
+	return 0;
+}
+
+/* print a JSON string, escaping it */
+static void pjson(const char *str)
+{
+	unsigned char c;
+
+	putchar('"');
+	while ((c = (unsigned char)*str++)) {
+		switch (c) {
+		case '"': fputs("\\\"", stdout); break;
+		case '\\': fputs("\\\\", stdout); break;
+		case '\b': fputs("\\b", stdout); break;
+		case '\f': fputs("\\f", stdout); break;
+		case '\n': fputs("\\n", stdout); break;
+		case '\r': fputs("\\r", stdout); break;
+		case '\t': fputs("\\t", stdout); break;
+		default:
+			if (c < ' ')
+				printf("\\u%04x", c);
+			else
+				putchar(c);
+			break;
+		}
+	}
+	putchar('"');
+}
+
+/* print a string value or null */
+static void pstr(const char *key, uint32_t index)
+{
+	const char *str = afb_trace_ring_name_string(header, index);
+	printf("\"%s\":", key);
+	if (str)
+		pjson(str);
+	else
+		printf("null");
+}
+
+/* print one record */
+static void print(const struct afb_trace_ring_record *rec)
+{
+	const char *action;
+
+	printf("{\"time\":\"%llu.%09llu\",",
+		(unsigned long long)(rec->time / 1000000000),
+		(unsigned long long)(rec->time % 1000000000));
+	pstr("tag", rec->tag);
+	printf(",\"id\":%u,\"thread\":%u,", rec->hookid, rec->thread);
+	if (rec->kind == AFB_TRACE_RING_KIND_REQUEST) {
+		action = rec->action < sizeof req_actions / sizeof *req_actions ? req_actions[rec->action] : NULL;
+		printf("\"type\":\"request\",\"request\":{\"index\":%u,", rec->index);
+		pstr("api", rec->api);
+		putchar(',');
+		pstr("verb", rec->verb);
+		printf(",\"action\":\"%s\"}", action ?: "?");
+		switch (rec->action) {
+		case AFB_TRACE_RING_REQ_SUBCALL:
+		case AFB_TRACE_RING_REQ_SUBCALLSYNC:
+			printf(",\"data\":{");
+			pstr("api", rec->arg1);
+			putchar(',');
+			pstr("verb", rec->arg2);
+			printf(",\"count\":%u,\"size\":%u}", rec->count, rec->size);
+			break;
+		case AFB_TRACE_RING_REQ_SUBSCRIBE:
+		case AFB_TRACE_RING_REQ_UNSUBSCRIBE:
+			printf(",\"data\":{\"event\":{");
+			pstr("name", rec->arg1);
+			printf(",\"id\":%u},\"result\":%d}", rec->arg2, (int)rec->status);
+			break;
+		case AFB_TRACE_RING_REQ_SUBCALLSYNC_RESULT:
+			printf(",\"data\":{\"result\":%d,\"status\":%d,\"count\":%u,\"size\":%u}",
+				(int)rec->arg1, (int)rec->status, rec->count, rec->size);
+			break;
+		default:
+			printf(",\"data\":{\"status\":%d,\"count\":%u,\"size\":%u}",
+				(int)rec->status, rec->count, rec->size);
+			break;
+		}
+	}
+	else {
+		action = rec->action < sizeof evt_actions / sizeof *evt_actions ? evt_actions[rec->action] : NULL;
+		printf("\"type\":\"event\",\"event\":{\"id\":%u,", rec->index);
+		pstr("name", rec->api);
+		printf(",\"action\":\"%s\"},\"data\":{\"result\":%d,\"count\":%u,\"size\":%u}",
+			action ?: "?", (int)rec->status, rec->count, rec->size);
+	}
+	printf("}\n");
+}
+
+int main(int ac, char **av)
+{
+	FILE *file;
+	void *buffer;
+	size_t size, count;
+	uint32_t iring, irec;
+	struct afb_trace_ring *ring;
+	struct afb_trace_ring_record *recs, **sorted;
+
+	if (ac > 2 || (ac == 2 && av[1][0] == '-' && av[1][1])) {
+		fprintf(stderr, "usage: %s [file]\n", av[0]);
+		return 1;
+	}
+	file = ac == 2 && strcmp(av[1], "-") ? fopen(av[1], "r") : stdin;
+	if (file == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", av[1], strerror(errno));
+		return 1;
+	}
+	buffer = readall(file, &size);
+	if (buffer == NULL) {
+		fprintf(stderr, "can't read: %s\n", strerror(errno));
+		return 1;
+	}
+	if (!check(buffer, size)) {
+		fprintf(stderr, "not a valid binary trace\n");
+		return 1;
+	}
+	header = buffer;
+
+	/* collect the records */
+	sorted = malloc((size_t)header->ring_count * header->ring_length * sizeof *sorted);
+	if (sorted == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	count = 0;
+	for (iring = 0 ; iring < header->ring_count ; iring++) {
+		ring = afb_trace_ring_get(header, iring);
+		recs = afb_trace_ring_records(ring);
+		for (irec = 0 ; irec < header->ring_length ; irec++)
+			/* skip records never written or being written */
+			if (recs[irec].seq != 0 && !(recs[irec].seq & AFB_TRACE_RING_SEQ_BUSY))
+				sorted[count++] = &recs[irec];
+	}
+
+	/* print them in order */
+	qsort(sorted, count, sizeof *sorted, cmp);
+	for (irec = 0 ; irec < count ; irec++)
+		print(sorted[irec]);
+
+	free(sorted);
+	free(buffer);
+	return 0;
+}